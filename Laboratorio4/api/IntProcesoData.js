@@ -25,6 +25,10 @@ const DIGITAL_VAR_IDS = Array.from({ length: DIGITAL_MAX_ID - DIGITAL_BASE_ID +
 
 const ALL_VAR_IDS = [...ANALOG_VAR_IDS, ...DIGITAL_VAR_IDS];
 
+// Rollup resolutions in seconds, coarsest first (see db/vars_rollup.sql)
+const ROLLUP_RESOLUTIONS = [3600, 60, 1];
+const RAW_ROW_LIMIT = 5000;
+
 const pool = mysql.createPool(DB_CONFIG);
 
 function normalizeVarIds(varIds, fallback) {
@@ -42,7 +46,7 @@ async function getVarsDataAfterId(lastId = 0, varIds = [], limit = 2000) {
   const uniqueIds = normalizeVarIds(varIds, ALL_VAR_IDS);
   if (uniqueIds.length === 0) return [];
 
-  const cappedLimit = Math.max(1, Math.min(limit, 5000));
+  const cappedLimit = Math.max(1, Math.min(limit, RAW_ROW_LIMIT));
   const placeholders = uniqueIds.map(() => '?').join(', ');
 
   const [rows] = await pool.query(
@@ -58,6 +62,79 @@ async function getVarsDataAfterId(lastId = 0, varIds = [], limit = 2000) {
   return rows;
 }
 
+/**
+ * Highest id in int_proceso_vars_data (primary key lookup), 0 when empty.
+ * Lets the WS poller resume from "now" after a pause instead of replaying the backlog.
+ */
+async function getLatestVarsDataId() {
+  const [rows] = await pool.query('SELECT COALESCE(MAX(id), 0) AS id FROM int_proceso_vars_data');
+  return Number(rows[0].id);
+}
+
+/**
+ * History for charts over a wall-clock window, sized to the points displayed.
+ * Reads the coarsest rollup whose bucket fits in one point (1 h, 1 min or 1 s)
+ * and merges buckets per point in SQL, so the cost follows maxPoints rather
+ * than the raw sample count. Windows finer than 1 s per point fall back to raw rows.
+ * @param {Array<number>} varIds ids to include (default: all)
+ * @param {number} fromMs window start (epoch ms, inclusive)
+ * @param {number} toMs window end (epoch ms, exclusive)
+ * @param {number} maxPoints points per variable the chart can show
+ * @returns {Promise<{resolution: number, stepMs: number, points: Array}>} resolution
+ *   is the rollup used in seconds (0 = raw); each point is
+ *   { varId, t, min, max, avg, count } with t the point start in epoch ms
+ */
+async function getVarsHistory(varIds = [], fromMs, toMs, maxPoints = 1000) {
+  const uniqueIds = normalizeVarIds(varIds, ALL_VAR_IDS);
+  const points = Math.max(1, Math.min(parseInt(maxPoints, 10) || 1000, RAW_ROW_LIMIT));
+  if (uniqueIds.length === 0 || !(toMs > fromMs)) return { resolution: 0, stepMs: 0, points: [] };
+
+  const stepMs = Math.ceil((toMs - fromMs) / points);
+  const resolution = ROLLUP_RESOLUTIONS.find((res) => res * 1000 <= stepMs);
+  const placeholders = uniqueIds.map(() => '?').join(', ');
+
+  if (!resolution) {
+    // Sub-second points: raw rows (fecha/hora only resolve whole seconds).
+    // The fecha range is sargable: partition pruning and the (var, fecha, hora) index
+    // of db/vars_data_partitioned.sql
+    const [rows] = await pool.query(
+      `SELECT int_proceso_vars_id AS varId, UNIX_TIMESTAMP(TIMESTAMP(fecha, hora)) * 1000 AS t,
+              valor AS min, valor AS max, valor AS avg, 1 AS count
+       FROM int_proceso_vars_data
+       WHERE int_proceso_vars_id IN (${placeholders})
+         AND fecha BETWEEN DATE(FROM_UNIXTIME(?)) AND DATE(FROM_UNIXTIME(?))
+         AND TIMESTAMP(fecha, hora) >= FROM_UNIXTIME(?)
+         AND TIMESTAMP(fecha, hora) < FROM_UNIXTIME(?)
+       ORDER BY id ASC
+       LIMIT ?`,
+      [...uniqueIds, Math.floor(fromMs / 1000), Math.ceil(toMs / 1000),
+        Math.floor(fromMs / 1000), Math.ceil(toMs / 1000), RAW_ROW_LIMIT]
+    );
+    return { resolution: 0, stepMs, points: rows };
+  }
+
+  // Whole buckets per point: a point never splits a rollup bucket. Buckets count
+  // seconds of fecha/hora since 1970-01-01 (db/vars_rollup.sql), so the window and
+  // t go through the session time zone like the raw path above
+  const stepSec = Math.floor(stepMs / 1000 / resolution) * resolution;
+  const [rows] = await pool.query(
+    `SELECT int_proceso_vars_id AS varId,
+            UNIX_TIMESTAMP(TIMESTAMP('1970-01-01') + INTERVAL (MIN(bucket) DIV ?) * ? SECOND) * 1000 AS t,
+            MIN(vmin) AS min, MAX(vmax) AS max, SUM(vsum) / SUM(muestras) AS avg,
+            SUM(muestras) AS count
+     FROM int_proceso_vars_rollup
+     WHERE resolucion = ?
+       AND int_proceso_vars_id IN (${placeholders})
+       AND bucket >= TIMESTAMPDIFF(SECOND, '1970-01-01', FROM_UNIXTIME(?))
+       AND bucket < TIMESTAMPDIFF(SECOND, '1970-01-01', FROM_UNIXTIME(?))
+     GROUP BY int_proceso_vars_id, bucket DIV ?
+     ORDER BY t ASC, varId ASC`,
+    [stepSec, stepSec, resolution, ...uniqueIds,
+      Math.floor(fromMs / 1000), Math.ceil(toMs / 1000), stepSec]
+  );
+  return { resolution, stepMs: stepSec * 1000, points: rows };
+}
+
 /**
  * Closes the underlying pool when the DAO is no longer needed.
  */
@@ -66,14 +143,23 @@ async function close() {
 }
 
 /**
- * Borra todas las filas de int_proceso_vars_data.
+ * Borra todas las filas de int_proceso_vars_data y sus agregados.
  */
 async function clearVarsData() {
   await pool.query('TRUNCATE TABLE int_proceso_vars_data');
+  try {
+    await pool.query('TRUNCATE TABLE int_proceso_vars_rollup');
+    // Los ids vuelven a empezar en 1: la marca de relleno también
+    await pool.query('UPDATE int_proceso_vars_rollup_marca SET hasta_id = 0');
+  } catch (err) {
+    if (err.code !== 'ER_NO_SUCH_TABLE') throw err; // Esquema sin db/vars_rollup.sql
+  }
 }
 
 module.exports = {
   getVarsDataAfterId,
+  getLatestVarsDataId,
+  getVarsHistory,
   clearVarsData,
   close
 };
@@ -0,0 +1,379 @@
+const {
+  CMD_HEADER_1, ADDR_CMD_HEADER_2, ADDR_RESP_HEADER_2, RESP_HEADER_2, BROADCAST_ADDRESS, COMMANDS,
+  STATUS
+} = require('./commandProtocol');
+const { FRAME_FORMATS, ADDRESS_MARK, frameSize } = require('./frameParser');
+
+/**
+ * Placas virtuales en un bus multipunto, para probar busMaster.js sin hardware
+ *   VirtualBoard  reproduce del firmware lo que decide quién transmite y cuándo: parser
+ *                 con cabeceras 55 AA / 55 AC, un solo comando pendiente, turnos TDMA
+ *                 (busTurn), Ready diferido, marca de dirección y trama compacta, cola
+ *                 de 0x15 y los comandos 0x05, 0x07, 0x08, 0x0B, 0x0C, 0x15, 0x17, 0x21,
+ *                 0x22. El canal 0 lleva la dirección y el 1 un contador, para verificar
+ *                 en el host a qué placa se atribuye cada muestra; el número de canales
+ *                 es de cada placa (firmwares de 4 y de 8 canales en el mismo bus).
+ *   SharedBus     RS-485 de 4 hilos: el par del host llega a todas las placas y el de
+ *                 retorno es compartido. Avanza de a 1 ms con el reloj real, mueve los
+ *                 bytes a 115200 baud y, si dos placas transmiten a la vez en el par de
+ *                 retorno, entrega basura y cuenta la colisión.
+ */
+
+const LINE_BYTES_PER_MS = 115200 / 10 / 1000;   // 8N1
+const BUS_TURN_LATE_MS = 1;
+const EXEC_QUEUE_LEN = 4;
+const INFO = Buffer.from('LAB2 v1.0 (sim)');
+const FORMATS_MASK = (1 << FRAME_FORMATS.LEGACY.id) | (1 << FRAME_FORMATS.COMPACT.id);
+const SERIAL_BAUD = 115200;
+
+class VirtualBoard {
+  /**
+   * @param {{address: number, slots: number, slotMs?: number, clockSkewMs?: number,
+   *   channels?: number}} options
+   *   clockSkewMs: diferencia de millis() con el bus al arrancar (antes de 0x22);
+   *   channels: canales de la trama compacta, como los anuncia 0x0C
+   */
+  constructor({ address, slots, slotMs = 10, clockSkewMs = 0, channels = 4 }) {
+    this.bus = { addr: address, slots, slotMs };
+    this.channels = channels;
+    this.clockOffset = clockSkewMs;
+    this.tx = [];
+    this.rx = { state: 'H1', addressed: false, addr: 0, cmd: 0, len: 0, payload: [] };
+    this.pending = null;             // { cmd, payload, broadcast }
+    this.readyPending = this.busMode();
+    this.turnStart = -1;
+    this.execQueue = [];
+    this.streaming = false;
+    this.periodMs = 100;
+    this.lastSample = 0;
+    this.lastTx = 0;
+    this.sampleTick = 0;
+    this.counter = 0;
+    this.markSent = false;
+    this.muted = false;
+    this.broadcast = false;
+    this.booted = false;
+  }
+
+  busMode() {
+    return this.bus.slots > 1;
+  }
+
+  /**
+   * Copia de busTurn() del firmware
+   */
+  busTurn(now) {
+    const cycle = this.bus.slots * this.bus.slotMs;
+    const start = now - (now % cycle) + (this.bus.addr - 1) * this.bus.slotMs;
+    if (now - start > BUS_TURN_LATE_MS || now < start || start === this.turnStart) return false;
+    this.turnStart = start;
+    return true;
+  }
+
+  write(bytes) {
+    if (!this.muted) for (const b of bytes) this.tx.push(b);
+  }
+
+  writeFrame(frame) {
+    if (this.muted) return;
+    if (this.busMode() && !this.markSent) {
+      this.markSent = true;
+      this.write([0x7A, ADDRESS_MARK.header2, this.bus.addr, 0x7C]);
+    }
+    this.write(frame);
+  }
+
+  respond(status, cmd, payload = []) {
+    const head = this.busMode()
+      ? [CMD_HEADER_1, ADDR_RESP_HEADER_2, this.bus.addr, status, cmd, payload.length]
+      : [CMD_HEADER_1, RESP_HEADER_2, status, cmd, payload.length];
+    const bytes = [...head, ...payload];
+    let chk = 0;
+    for (let i = 2; i < bytes.length; i++) chk ^= bytes[i];
+    this.write([...bytes, chk]);
+  }
+
+  /**
+   * Byte recibido por el par del host (misma máquina de estados que el firmware)
+   */
+  receive(byte, now) {
+    const rx = this.rx;
+    switch (rx.state) {
+      case 'H1':
+        if (byte === CMD_HEADER_1) rx.state = 'H2';
+        break;
+      case 'H2':
+        rx.addressed = byte === ADDR_CMD_HEADER_2;
+        rx.state = byte === 0xAA ? 'CMD' : rx.addressed ? 'ADDR' : byte === CMD_HEADER_1 ? 'H2' : 'H1';
+        break;
+      case 'ADDR':
+        rx.addr = byte;
+        rx.state = 'CMD';
+        break;
+      case 'CMD':
+        rx.cmd = byte;
+        rx.state = 'LEN';
+        break;
+      case 'LEN':
+        rx.len = byte;
+        rx.payload = [];
+        rx.state = byte > 0 ? 'PAYLOAD' : 'CHK';
+        break;
+      case 'PAYLOAD':
+        rx.payload.push(byte);
+        if (rx.payload.length === rx.len) rx.state = 'CHK';
+        break;
+      case 'CHK':
+        rx.state = 'H1';
+        this.dispatch(byte, now);
+        break;
+    }
+  }
+
+  dispatch(chk, now) {
+    const rx = this.rx;
+    const broadcast = rx.addressed && rx.addr === BROADCAST_ADDRESS;
+    const forMe = !rx.addressed ? !this.busMode() : broadcast || rx.addr === this.bus.addr;
+    if (!forMe) return;
+    let sum = rx.cmd ^ rx.len ^ (rx.addressed ? rx.addr : 0);
+    for (const b of rx.payload) sum ^= b;
+    if (sum !== chk) return;   // En el bus un comando dañado no se contesta
+    if (this.busMode() && rx.cmd !== COMMANDS.BUS_SYNC) {
+      if (!this.pending) this.pending = { cmd: rx.cmd, payload: rx.payload, broadcast };
+      return;
+    }
+    this.muted = broadcast && !this.busMode();
+    this.broadcast = broadcast;
+    this.handleCommand(rx.cmd, rx.payload, now);
+    this.muted = false;
+    this.broadcast = false;
+  }
+
+  handleCommand(cmd, pl, now) {
+    switch (cmd) {
+      case COMMANDS.SET_TSAMPLE_ADC:
+        if (pl.length !== 2) return this.respond(STATUS.PARAM_INVALID, cmd);
+        this.periodMs = Math.max(10, Math.min(5000, pl[0] | (pl[1] << 8)));
+        return this.respond(STATUS.OK, cmd, pl);
+      case COMMANDS.STREAMING_ENABLE:
+        if (pl.length !== 1) return this.respond(STATUS.PARAM_INVALID, cmd);
+        this.streaming = pl[0] !== 0;
+        return this.respond(STATUS.OK, cmd, pl);
+      case COMMANDS.GET_INFO:
+        return this.respond(STATUS.OK, cmd, [...INFO]);
+      case COMMANDS.GET_CAPS:
+        // Mismo descriptor que sendCaps() del firmware (24 bytes)
+        return this.respond(STATUS.OK, cmd, [1, FORMATS_MASK, this.channels, 10, 4, 4,
+          ...u32(10000), ...u32(5000000), 64, 0, 64, 0, 19, 1, ...u32(SERIAL_BAUD)]);
+      case COMMANDS.SYNC:
+        return this.respond(STATUS.OK, cmd, pl);
+      case COMMANDS.EXEC_AT: {
+        if (pl.length < 5 || this.execQueue.length >= EXEC_QUEUE_LEN) {
+          return this.respond(STATUS.PARAM_INVALID, cmd);
+        }
+        const at = (pl[0] | (pl[1] << 8) | (pl[2] << 16) | (pl[3] << 24)) >>> 0;
+        this.execQueue.push({ at, cmd: pl[4], payload: pl.slice(5) });
+        this.execQueue.sort((a, b) => a.at - b.at);
+        return this.respond(STATUS.OK, cmd, [this.execQueue.length - 1, this.execQueue.length]);
+      }
+      case COMMANDS.EXEC_CANCEL: {
+        const dropped = this.execQueue.length;
+        this.execQueue = [];
+        return this.respond(STATUS.OK, cmd, [dropped]);
+      }
+      case COMMANDS.SET_ADDRESS: {
+        const c = pl.length === 3 ? { addr: pl[0], slots: pl[1], slotMs: pl[2] } : this.bus;
+        if ((pl.length !== 0 && pl.length !== 3) || (pl.length === 3 && this.broadcast)) {
+          return this.respond(STATUS.PARAM_INVALID, cmd);
+        }
+        this.respond(STATUS.OK, cmd, [c.addr, c.slots, c.slotMs]);
+        this.bus = c;
+        return undefined;
+      }
+      case COMMANDS.BUS_SYNC:
+        if (pl.length === 4) this.busSync((pl[0] | (pl[1] << 8) | (pl[2] << 16) | (pl[3] << 24)) >>> 0, now);
+        return undefined;
+      default:
+        return this.respond(STATUS.CMD_UNKNOWN, cmd);
+    }
+  }
+
+  busSync(tick, now) {
+    this.clockOffset += tick - now;
+    this.lastSample = tick;
+    this.lastTx = tick;
+    this.turnStart = -1;
+  }
+
+  sendFrame() {
+    const size = frameSize(FRAME_FORMATS.COMPACT, this.channels);
+    const frame = Buffer.alloc(size);
+    frame[0] = 0x7A;
+    frame[1] = FRAME_FORMATS.COMPACT.header2;
+    frame.writeUInt16LE(this.sampleTick & 0xFFFF, 2);
+    frame[4] = 0;
+    const channels = new Array(this.channels).fill(0);
+    channels[0] = this.bus.addr;
+    channels[1] = this.counter & 0x3FF;
+    let acc = 0;
+    let bits = 0;
+    let pos = 5;
+    for (const v of channels) {
+      acc |= v << bits;
+      bits += 10;
+      while (bits >= 8) {
+        frame[pos++] = acc & 0xFF;
+        acc >>>= 8;
+        bits -= 8;
+      }
+    }
+    if (bits > 0) frame[pos] = acc & 0xFF;
+    frame[size - 1] = 0x7C;
+    this.writeFrame(frame);
+  }
+
+  /**
+   * Una pasada del bucle principal
+   * @param {number} busTime - ms del bus (la placa le suma su desfase de reloj)
+   */
+  loop(busTime) {
+    const now = busTime + this.clockOffset;
+    this.markSent = false;
+    if (!this.booted) {
+      this.booted = true;
+      this.lastSample = now;
+      this.lastTx = now;
+      if (!this.busMode()) this.respond(STATUS.OK, COMMANDS.READY, [1, 0, 1, 0, 0]);
+    }
+    while (this.execQueue.length && now >= this.execQueue[0].at) {
+      const e = this.execQueue.shift();
+      this.muted = this.busMode();
+      this.handleCommand(e.cmd, e.payload, now);
+      this.respond(STATUS.OK, COMMANDS.EXECUTED, [0, e.cmd, ...u32(now)]);
+      this.muted = false;
+    }
+
+    const turn = !this.busMode() || this.busTurn(now);
+    if (this.busMode() && turn) {
+      if (this.readyPending) {
+        this.readyPending = false;
+        this.respond(STATUS.OK, COMMANDS.READY, [1, 0, 1, 0, 0]);
+      }
+      if (this.pending) {
+        const p = this.pending;
+        this.pending = null;
+        this.broadcast = p.broadcast;
+        this.handleCommand(p.cmd, p.payload, now);
+        this.broadcast = false;
+      }
+    }
+
+    if (now - this.lastSample >= this.periodMs) {
+      this.lastSample = now;
+      this.sampleTick = now;
+      this.counter++;
+    }
+    if (this.streaming && turn && now - this.lastTx >= this.periodMs) {
+      this.lastTx = this.busMode() ? this.turnStart : now;
+      this.sendFrame();
+    }
+  }
+}
+
+function u32(v) {
+  return [v & 0xFF, (v >>> 8) & 0xFF, (v >>> 16) & 0xFF, (v >>> 24) & 0xFF];
+}
+
+class SharedBus {
+  /**
+   * @param {VirtualBoard[]} boards
+   * @param {Function} onHostData - Recibe los Buffer que llegan al host por el par de retorno
+   */
+  constructor(boards, onHostData) {
+    this.boards = boards;
+    this.onHostData = onHostData;
+    this.time = 0;                 // ms del bus
+    this.downlink = [];            // { at, byte }: at en tiempos de byte
+    this.downFree = 0;
+    this.segments = [];            // Ráfagas de las placas en el par de retorno
+    this.lineFree = new Map();     // Placa -> fin de su última ráfaga
+    this.stats = { collisions: 0, corruptedBytes: 0, bytesToHost: 0, bytesToBoards: 0 };
+    this.timer = null;
+  }
+
+  /**
+   * Bytes del host: llegan a todas las placas al ritmo de la línea
+   */
+  write(data) {
+    let at = Math.max(this.time * LINE_BYTES_PER_MS, this.downFree);
+    for (const byte of data) this.downlink.push({ at: ++at, byte });
+    this.downFree = at;
+    this.stats.bytesToBoards += data.length;
+  }
+
+  start() {
+    const t0 = Date.now();
+    this.timer = setInterval(() => this.advance(Date.now() - t0), 1);
+  }
+
+  stop() {
+    clearInterval(this.timer);
+  }
+
+  /**
+   * Pone el bus al día con el reloj real, de a 1 ms
+   */
+  advance(elapsedMs) {
+    const out = [];
+    while (this.time < elapsedMs) this.step(out);
+    if (out.length) {
+      this.stats.bytesToHost += out.length;
+      this.onHostData(Buffer.from(out));
+    }
+  }
+
+  step(out) {
+    this.time++;
+    const byteTime = this.time * LINE_BYTES_PER_MS;
+    while (this.downlink.length && this.downlink[0].at <= byteTime) {
+      const { byte } = this.downlink.shift();
+      for (const board of this.boards) board.receive(byte, this.time + board.clockOffset);
+    }
+    for (const board of this.boards) {
+      board.loop(this.time);
+      if (board.tx.length) this.transmit(board, byteTime);
+    }
+    this.segments.sort((a, b) => a.start - b.start);
+    while (this.segments.length && this.segments[0].end <= byteTime) {
+      const s = this.segments.shift();
+      if (s.corrupted) {
+        this.stats.corruptedBytes += s.bytes.length;
+        for (const b of s.bytes) out.push(b ^ 0xA5);
+      } else {
+        out.push(...s.bytes);
+      }
+    }
+  }
+
+  /**
+   * La UART de la placa empieza a transmitir; choca con toda ráfaga de otra placa
+   * que se superponga en el par de retorno
+   */
+  transmit(board, byteTime) {
+    const bytes = board.tx;
+    board.tx = [];
+    const start = Math.max(byteTime, this.lineFree.get(board) || 0);
+    const segment = { board, start, end: start + bytes.length, bytes, corrupted: false };
+    for (const other of this.segments) {
+      if (other.board !== board && other.start < segment.end && segment.start < other.end) {
+        if (!other.corrupted || !segment.corrupted) this.stats.collisions++;
+        other.corrupted = true;
+        segment.corrupted = true;
+      }
+    }
+    this.lineFree.set(board, segment.end);
+    this.segments.push(segment);
+  }
+}
+
+module.exports = { VirtualBoard, SharedBus, LINE_BYTES_PER_MS };
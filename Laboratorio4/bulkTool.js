@@ -0,0 +1,123 @@
+require('dotenv').config();
+const { SerialPort } = require('serialport');
+const crypto = require('crypto');
+const fs = require('fs');
+const {
+  streamingEnable, sync, findResponse, COMMANDS, BULK_OBJECTS, BULK_RESULTS
+} = require('./commandProtocol');
+const { BulkDownload, BulkUpload } = require('./bulkTransfer');
+
+/**
+ * Volcado y restauración de memorias del micro con transferencias en bloques (0x1D..0x20)
+ * Uso: node bulkTool.js get|put eeprom|flash archivo [offset] [bytes] [puerto] [baudios]
+ *   get eeprom cal.bin          guarda la EEPROM completa (calibración y arranques)
+ *   put eeprom cal.bin          la restaura (el micro recarga las tablas de calibración)
+ *   get flash firmware.bin      imagen de la flash para compararla con el .hex compilado
+ * offset y bytes por defecto: el objeto completo (get) o el tamaño del archivo (put).
+ */
+
+const READY_WAIT_MS = 2500;   // El UNO se resetea al abrir el puerto
+const OBJECT_SIZES = { eeprom: 1024, flash: 32768 };
+
+const [action, objectName, file, offsetArg, bytesArg, portArg, baudArg] = process.argv.slice(2);
+const config = {
+  port: portArg || process.env.SERIAL_PORT || 'COM2',
+  baudRate: parseInt(baudArg) || parseInt(process.env.SERIAL_BAUDRATE) || 115200
+};
+
+/**
+ * Escribe y espera a que el sistema operativo entregue los bytes al puerto
+ */
+function writeAll(port, data) {
+  return new Promise((resolve, reject) => {
+    port.write(data, (err) => {
+      if (err) return reject(err);
+      port.drain((e) => (e ? reject(e) : resolve()));
+    });
+  });
+}
+
+/**
+ * Respuestas del puerto en orden; cada una se entrega al manejador actual
+ */
+function routeResponses(port) {
+  let buffer = Buffer.alloc(0);
+  const router = { handler: null };
+  port.on('data', (data) => {
+    buffer = Buffer.concat([buffer, data]);
+    let found;
+    while ((found = findResponse(buffer)) !== null) {
+      buffer = buffer.slice(found.end);
+      if (router.handler) router.handler(found.response);
+    }
+  });
+  return router;
+}
+
+/**
+ * Espera la respuesta con el CMD indicado
+ */
+function waitResponse(router, cmd, timeout, match = null) {
+  return new Promise((resolve) => {
+    const timer = setTimeout(() => { router.handler = null; resolve(null); }, timeout);
+    router.handler = (response) => {
+      if (response.cmd !== cmd || (match && !match(response))) return;
+      clearTimeout(timer);
+      router.handler = null;
+      resolve(response);
+    };
+  });
+}
+
+async function run() {
+  const object = BULK_OBJECTS[(objectName || '').toUpperCase()];
+  if (!['get', 'put'].includes(action) || object === undefined || !file) {
+    throw new Error('Uso: node bulkTool.js get|put eeprom|flash archivo [offset] [bytes] [puerto] [baudios]');
+  }
+  const offset = parseInt(offsetArg) || 0;
+  const size = OBJECT_SIZES[objectName.toLowerCase()];
+  const data = action === 'put' ? fs.readFileSync(file) : null;
+  const length = parseInt(bytesArg) || (data ? data.length : size - offset);
+
+  const port = new SerialPort({ path: config.port, baudRate: config.baudRate, autoOpen: false });
+  await new Promise((resolve, reject) => port.open((err) => (err ? reject(err) : resolve())));
+  const router = routeResponses(port);
+  console.log(`[Bulk] ${config.port} @ ${config.baudRate} baud: ${action} ${objectName} ` +
+    `[${offset}, ${offset + length})`);
+
+  // Esperar el arranque (Ready) y dejar el flujo limpio con streaming apagado + Sync
+  await waitResponse(router, COMMANDS.READY, READY_WAIT_MS);
+  await writeAll(port, streamingEnable(false));
+  const token = crypto.randomBytes(4);
+  const synced = waitResponse(router, COMMANDS.SYNC, 1000,
+    (r) => r.payload.slice(0, token.length).equals(token));
+  await writeAll(port, sync(token));
+  if (!(await synced)) throw new Error('El micro no respondió a Sync');
+
+  const write = (command) => port.write(command);
+  const transfer = action === 'get'
+    ? new BulkDownload(write, { object, offset, length })
+    : new BulkUpload(write, { object, offset, data: data.subarray(0, length) });
+  router.handler = (response) => transfer.handleResponse(response);
+  const result = await transfer.run();
+  router.handler = null;
+
+  const capacity = config.baudRate / 10;   // bytes/s con 8N1
+  console.log(`[Bulk] Resultado ${result.result}: ${result.bytes} bytes en ${result.elapsedMs} ms, ` +
+    `${result.bytesPerSecond.toFixed(0)} B/s (${((result.bytesPerSecond / capacity) * 100).toFixed(1)}% de ${capacity} B/s), ` +
+    `reenvíos host ${result.retransmits} / micro ${result.deviceRetransmits ?? '?'}`);
+  if (result.result !== BULK_RESULTS.OK) throw new Error('Transferencia incompleta');
+  if (action === 'get') {
+    fs.writeFileSync(file, result.data);
+    console.log(`[Bulk] Guardado en ${file}`);
+  }
+
+  await new Promise((resolve) => port.close(() => resolve()));
+}
+
+if (require.main === module) {
+  run().catch((error) => {
+    console.error('[Bulk] Error:', error.message);
+    process.exit(1);
+  });
+}
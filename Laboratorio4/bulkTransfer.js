@@ -0,0 +1,332 @@
+const {
+  bulkOpen, parseBulkOpen, bulkData, parseBulkData, bulkAck, bulkEnd, parseBulkEnd,
+  COMMANDS, STATUS, BULK_DIR, BULK_RESULTS
+} = require('./commandProtocol');
+
+/**
+ * Transferencias en bloques con el firmware (0x1D..0x20)
+ * Cada transferencia es independiente del puerto: recibe una función write(buffer)
+ * y se le entregan las respuestas ya parseadas con handleResponse(). Así la usan
+ * tanto bulkTool.js (puerto propio) como SerialListener.bulkTransfer().
+ *   BulkDownload  el micro envía bloques (tamaño en la respuesta a 0x1D) en una ventana; el
+ *                 host confirma cada bloque con 0x1F y pide en el mismo comando los
+ *                 que faltan (hueco en los offsets o CRC inválido)
+ *   BulkUpload    el host mantiene la ventana del micro (bloques de 16 bytes, 2 en
+ *                 vuelo: lo que cabe en su buffer RX mientras escribe la EEPROM) y
+ *                 reenvía los que vuelven con 0x01 o no se confirman a tiempo
+ */
+
+const OPEN_RETRY_MS = 300;
+const OPEN_TRIES = 3;
+const RESEND_HOLD_MS = 150;    // Espera antes de volver a pedir el mismo bloque
+const IDLE_ACK_MS = 100;       // Sin bloques: repetir la última confirmación
+const UPLOAD_ACK_MS = 500;     // Escritura de la EEPROM incluida (~3.4 ms por byte)
+const MAX_RETRIES = 10;        // Reenvíos del mismo bloque antes de abortar
+const TICK_MS = 25;
+
+class BulkTransfer {
+  /**
+   * @param {Function} write - Envía un comando ya construido al micro
+   * @param {{object: number, offset?: number}} options - Objeto de BULK_OBJECTS
+   */
+  constructor(write, { object, offset = 0 }) {
+    this.write = write;
+    this.object = object;
+    this.offset = offset;
+    this.chunkSize = 0;
+    this.window = 0;
+    this.retransmits = 0;      // Pedidos o reenviados por el host
+    this.opened = false;
+    this.openTries = 0;
+    this.timer = null;
+    this.startedAt = 0;
+  }
+
+  /**
+   * Abre la transferencia y espera a que termine
+   * @returns {Promise<{result: number, bytes: number, retransmits: number,
+   *   deviceRetransmits: number|null, elapsedMs: number, bytesPerSecond: number, data?: Buffer}>}
+   *   deviceRetransmits es null si se perdió el 0x20 del micro
+   */
+  run() {
+    return new Promise((resolve, reject) => {
+      this.resolve = resolve;
+      this.reject = reject;
+      this.startedAt = Date.now();
+      this.sendOpen();
+      this.timer = setInterval(() => this.onTick(Date.now()), TICK_MS);
+    });
+  }
+
+  /**
+   * Respuesta o evento del micro
+   * @param {Object} response - Respuesta parseada (findResponse / FrameDecoder)
+   * @returns {boolean} true si pertenece a la transferencia
+   */
+  handleResponse(response) {
+    const { cmd, payload } = response;
+    if (cmd === COMMANDS.BULK_OPEN) {
+      if (this.opened) return true;
+      const info = response.isOk ? parseBulkOpen(payload) : null;
+      if (!info || info.dir !== this.dir) {
+        this.fail(new Error('El micro rechazó la transferencia (0x1D)'));
+        return true;
+      }
+      this.opened = true;
+      this.chunkSize = info.chunkSize;
+      this.window = info.window;
+      this.chunks = Math.ceil(this.length / this.chunkSize);
+      this.onOpen();
+      return true;
+    }
+    if (cmd === COMMANDS.BULK_DATA) {
+      if (this.opened) this.onData(response);
+      return true;
+    }
+    if (cmd === COMMANDS.BULK_ACK) {
+      // 0x1F solo responde si no hay descarga abierta: se perdió el evento 0x20
+      if (this.opened && !response.isOk) this.onClosedUnseen();
+      return true;
+    }
+    if (cmd === COMMANDS.BULK_END) {
+      if (this.opened) this.onEnd(response);
+      return true;
+    }
+    return false;
+  }
+
+  sendOpen() {
+    this.openTries++;
+    this.openSentAt = Date.now();
+    this.write(bulkOpen(this.dir, this.object, this.offset, this.length));
+  }
+
+  onTick(now) {
+    if (this.opened || now - this.openSentAt < OPEN_RETRY_MS) return;
+    if (this.openTries < OPEN_TRIES) this.sendOpen();
+    else this.fail(new Error('Sin respuesta a 0x1D: el firmware no soporta transferencias en bloques'));
+  }
+
+  /**
+   * El micro ya cerró la transferencia pero su 0x20 no llegó: si el host tiene
+   * todo confirmado se da por completa (sin los contadores del micro)
+   */
+  onClosedUnseen() {
+    if (!this.isComplete()) {
+      this.fail(new Error('El micro cerró la transferencia y se perdió su resultado (0x20)'));
+      return;
+    }
+    this.finish({ result: BULK_RESULTS.OK, bytes: this.length, retransmits: null });
+  }
+
+  onEnd(response) {
+    const end = response.isOk ? parseBulkEnd(response.payload) : null;
+    if (end) this.finish(end);
+  }
+
+  finish(end) {
+    clearInterval(this.timer);
+    const elapsedMs = Date.now() - this.startedAt;
+    this.resolve({
+      result: end.result,
+      bytes: end.bytes,
+      retransmits: this.retransmits,
+      deviceRetransmits: end.retransmits,
+      elapsedMs,
+      bytesPerSecond: elapsedMs > 0 ? (end.bytes * 1000) / elapsedMs : 0,
+      data: this.data
+    });
+  }
+
+  fail(error) {
+    clearInterval(this.timer);
+    this.reject(error);
+  }
+
+  /**
+   * Cancela la transferencia; el micro contesta 0x20 con lo hecho hasta ahora
+   */
+  cancel() {
+    this.write(bulkEnd());
+  }
+}
+
+class BulkDownload extends BulkTransfer {
+  /**
+   * @param {Function} write - Envía un comando al micro
+   * @param {{object: number, offset?: number, length: number}} options
+   */
+  constructor(write, { object, offset = 0, length }) {
+    super(write, { object, offset });
+    this.dir = BULK_DIR.DOWNLOAD;
+    this.length = length;
+    this.data = Buffer.alloc(length);
+  }
+
+  onOpen() {
+    this.received = new Uint8Array(this.chunks);
+    this.requestedAt = new Float64Array(this.chunks);
+    this.nextMissing = 0;        // Todo lo anterior ya llegó
+    this.highest = -1;           // Mayor bloque recibido
+    this.lastRxAt = Date.now();
+  }
+
+  onData(response) {
+    const chunk = parseBulkData(response.payload);
+    this.lastRxAt = Date.now();
+    // Con CRC inválido no se confía en el offset: el hueco lo delata el siguiente bloque
+    if (!chunk || !chunk.crcOk) return;
+    const rel = chunk.offset - this.offset;
+    const idx = rel / this.chunkSize;
+    if (!Number.isInteger(idx) || idx < 0 || idx >= this.chunks ||
+        rel + chunk.data.length > this.length) return;
+    if (!this.received[idx]) {
+      chunk.data.copy(this.data, rel);
+      this.received[idx] = 1;
+    }
+    if (idx > this.highest) this.highest = idx;
+    while (this.nextMissing < this.chunks && this.received[this.nextMissing]) this.nextMissing++;
+    this.acknowledge(this.lastRxAt);
+  }
+
+  /**
+   * 0x1F con el primer bloque pendiente y los huecos detrás del mayor recibido
+   * (por enlace serial no hay reordenamiento: un hueco es un bloque perdido)
+   */
+  acknowledge(now) {
+    let mask = 0;
+    for (let i = 0; i < 8; i++) {
+      const idx = this.nextMissing + i;
+      if (idx >= this.highest) break;
+      if (this.received[idx] || now - this.requestedAt[idx] < RESEND_HOLD_MS) continue;
+      this.requestedAt[idx] = now;
+      this.retransmits++;
+      mask |= 1 << i;
+    }
+    const next = Math.min(this.offset + this.nextMissing * this.chunkSize, this.offset + this.length);
+    this.write(bulkAck(next, mask));
+  }
+
+  isComplete() {
+    return this.nextMissing === this.chunks;
+  }
+
+  onTick(now) {
+    super.onTick(now);
+    // Confirmación perdida: el micro también reenvía la ventana tras su timeout
+    if (this.opened && now - this.lastRxAt > IDLE_ACK_MS) {
+      this.lastRxAt = now;
+      this.acknowledge(now);
+    }
+  }
+}
+
+class BulkUpload extends BulkTransfer {
+  /**
+   * @param {Function} write - Envía un comando al micro
+   * @param {{object: number, offset?: number, data: Buffer}} options
+   */
+  constructor(write, { object, offset = 0, data }) {
+    super(write, { object, offset });
+    this.dir = BULK_DIR.UPLOAD;
+    this.length = data.length;
+    this.source = data;
+    this.closing = false;
+    this.closeSentAt = 0;
+  }
+
+  onOpen() {
+    this.acked = new Uint8Array(this.chunks);
+    this.ackedCount = 0;
+    this.inFlight = new Map();   // Índice -> { sentAt, tries }
+    this.nextToSend = 0;
+    this.pump(Date.now());
+  }
+
+  sendChunk(idx, now) {
+    const rel = idx * this.chunkSize;
+    const data = this.source.subarray(rel, Math.min(rel + this.chunkSize, this.length));
+    const entry = this.inFlight.get(idx);
+    const tries = entry ? entry.tries + 1 : 0;
+    if (tries > MAX_RETRIES) {
+      this.cancel();
+      this.fail(new Error(`El bloque en ${this.offset + rel} no se confirmó tras ${MAX_RETRIES} reenvíos`));
+      return;
+    }
+    if (entry) this.retransmits++;
+    this.inFlight.set(idx, { sentAt: now, tries });
+    this.write(bulkData(this.offset + rel, data));
+  }
+
+  pump(now) {
+    while (this.inFlight.size < this.window && this.nextToSend < this.chunks) {
+      const idx = this.nextToSend++;
+      if (!this.acked[idx]) this.sendChunk(idx, now);
+    }
+    if (this.ackedCount === this.chunks && !this.closing) {
+      this.closing = true;
+      this.closeSentAt = now;
+      this.write(bulkEnd());
+    }
+  }
+
+  onData(response) {
+    const now = Date.now();
+    const { status, payload } = response;
+    if (status === STATUS.PARAM_INVALID) {
+      this.fail(new Error('El micro rechazó un bloque (0x1E): la carga ya no está abierta'));
+      return;
+    }
+    if (payload.length < 2) {
+      // CHK del comando inválido: no se sabe cuál, reenviar el más antiguo
+      const oldest = this.inFlight.keys().next();
+      if (!oldest.done) this.sendChunk(oldest.value, now);
+      return;
+    }
+    const idx = (payload.readUInt16LE(0) - this.offset) / this.chunkSize;
+    if (!this.inFlight.has(idx)) return;   // Confirmación repetida
+    if (status === STATUS.CHK_INVALID) {
+      this.sendChunk(idx, now);            // CRC del bloque inválido: reenvío selectivo
+      return;
+    }
+    this.inFlight.delete(idx);
+    this.acked[idx] = 1;
+    this.ackedCount++;
+    this.pump(now);
+  }
+
+  onTick(now) {
+    super.onTick(now);
+    if (!this.opened) return;
+    for (const [idx, entry] of this.inFlight) {
+      if (now - entry.sentAt > UPLOAD_ACK_MS) this.sendChunk(idx, now);
+    }
+    if (this.closing && now - this.closeSentAt > UPLOAD_ACK_MS) {
+      this.closeSentAt = now;
+      this.write(bulkEnd());
+    }
+  }
+
+  isComplete() {
+    return this.ackedCount === this.chunks;
+  }
+
+  onEnd(response) {
+    // Reenvío de 0x20 cuyo primer cierre sí llegó: ya no hay carga abierta
+    if (this.closing && !response.isOk) {
+      this.onClosedUnseen();
+      return;
+    }
+    super.onEnd(response);
+  }
+
+  finish(end) {
+    if (end.result !== BULK_RESULTS.OK && !this.closing) {
+      this.fail(new Error(`Carga interrumpida por el micro (resultado ${end.result})`));
+      return;
+    }
+    super.finish(end);
+  }
+}
+
+module.exports = { BulkDownload, BulkUpload };
@@ -0,0 +1,225 @@
+const EventEmitter = require('events');
+const { FrameDecoder } = require('./frameDecoder');
+const {
+  toAddress, busSync, execAt, getCaps, parseCaps, parseReady, COMMANDS, STATUS, BROADCAST_ADDRESS
+} = require('./commandProtocol');
+
+/**
+ * Maestro de un bus multipunto: un solo puerto (y un solo hilo del host) para varias placas
+ * Las placas se configuran antes, de a una en el puerto, con setAddress(addr, slots, slotMs)
+ * (0x21); en el bus transmiten por turnos (ver "Bus multipunto" en main.cpp) y el
+ * maestro solo necesita:
+ *   - request()    comando a una placa; espera la respuesta con su dirección y CMD.
+ *                  Las placas tienen un solo comando pendiente: por dirección se
+ *                  encolan, entre direcciones distintas van en paralelo
+ *   - broadcast()  comando a todas (ADDR 0xFF); recoge una respuesta por placa, que
+ *                  llegan ordenadas por ranura
+ *   - syncClocks() 0x22 por difusión: mismo reloj (y mismo TICK) en todas las placas
+ *   - startAt()    0x15 por difusión: "todas empiezan en T"
+ *   - discoverChannels() 0x0C por difusión: canales de cada placa; el decodificador
+ *                  mide las tramas de cada dirección con los suyos (setChannels)
+ * No depende del puerto: recibe write(buffer) y los bytes con push(data), igual que
+ * bulkTransfer.js; así lo usan tanto un SerialPort como boardSimulator.js.
+ * Eventos: 'batch' (SampleBatch con la columna address), 'inputs' (con address),
+ * 'ready' (address, info) y 'response' (respuestas que nadie esperaba).
+ */
+
+const RESPONSE_MARGIN_MS = 50;   // Latencia del host/USB sobre el ciclo de turnos
+
+class BusMaster extends EventEmitter {
+  /**
+   * @param {Function} write - Envía bytes al bus
+   * @param {{slots: number, slotMs?: number}} options - Los mismos de 0x21 en las placas
+   */
+  constructor(write, { slots, slotMs = 10 }) {
+    super();
+    this.write = write;
+    this.slots = slots;
+    this.slotMs = slotMs;
+    this.decoder = new FrameDecoder();
+    this.waiters = [];              // { match(response), resolve }
+    this.tails = new Map();         // Dirección -> último comando encolado
+    this.samples = new Map();       // Dirección -> muestras recibidas
+    this.syncedAt = null;           // Date.now() del último 0x22
+    this.syncTick = 0;
+  }
+
+  /**
+   * Duración de un ciclo de turnos: espera máxima de una placa hasta poder responder
+   */
+  get cycleMs() {
+    return this.slots * this.slotMs;
+  }
+
+  /**
+   * Bytes recibidos del bus
+   * @param {Buffer} data
+   */
+  push(data) {
+    const batch = this.decoder.push(data, (response) => this.handleResponse(response));
+    for (const report of this.decoder.inputReports) this.emit('inputs', report);
+    if (batch.count === 0) return;
+    for (let i = 0; i < batch.count; i++) {
+      const address = batch.address[i];
+      this.samples.set(address, (this.samples.get(address) || 0) + 1);
+    }
+    this.emit('batch', batch);
+  }
+
+  /**
+   * Entrega cada respuesta al primer pedido que la espera
+   * @param {Object} response - Respuesta parseada (address = placa de origen)
+   */
+  handleResponse(response) {
+    if (response.cmd === COMMANDS.READY) {
+      this.emit('ready', response.address, parseReady(response.payload));
+      return false;
+    }
+    const i = this.waiters.findIndex((w) => w.match(response));
+    if (i < 0) {
+      this.emit('response', response);
+      return false;
+    }
+    if (this.waiters[i].take(response)) this.waiters.splice(i, 1);
+    return false;
+  }
+
+  /**
+   * Registra una espera con timeout
+   * @param {Function} match - Predicado sobre la respuesta
+   * @param {Function} take - Recibe la respuesta; true si la espera terminó
+   * @param {number} timeoutMs
+   * @param {Function} onTimeout - Valor con que se resuelve al vencer
+   */
+  wait(match, take, timeoutMs, onTimeout) {
+    return new Promise((resolve) => {
+      const waiter = { match };
+      const timer = setTimeout(() => {
+        this.waiters.splice(this.waiters.indexOf(waiter), 1);
+        resolve(onTimeout());
+      }, timeoutMs);
+      waiter.take = (response) => {
+        const done = take(response);
+        if (done) {
+          clearTimeout(timer);
+          resolve(done === true ? response : done);
+        }
+        return !!done;
+      };
+      this.waiters.push(waiter);
+    });
+  }
+
+  /**
+   * Encola fn detrás del último comando de las direcciones indicadas
+   */
+  enqueue(addresses, fn) {
+    const previous = Promise.all(addresses.map((a) => this.tails.get(a)));
+    const run = previous.then(fn);
+    const tail = run.catch(() => {});
+    for (const a of addresses) this.tails.set(a, tail);
+    return run;
+  }
+
+  /**
+   * Comando a una placa
+   * @param {number} address - 1..slots
+   * @param {Buffer} command - Comando sin dirección (cualquier constructor de commandProtocol)
+   * @param {number} timeoutMs - Por defecto dos ciclos más el margen del host
+   * @returns {Promise<Object|null>} Respuesta o null si venció el timeout
+   */
+  request(address, command, timeoutMs = 2 * this.cycleMs + RESPONSE_MARGIN_MS) {
+    const cmd = command[2];
+    return this.enqueue([address], () => {
+      const response = this.wait(
+        (r) => r.address === address && r.cmd === cmd,
+        () => true, timeoutMs, () => null);
+      this.write(toAddress(command, address));
+      return response;
+    });
+  }
+
+  /**
+   * Comando a todas las placas; cada una responde en su ranura
+   * @param {Buffer} command - Comando sin dirección
+   * @param {{expect?: number, timeoutMs?: number}} options - expect = respuestas a
+   *   esperar (por defecto slots); se resuelve antes si llegan todas
+   * @returns {Promise<Map<number, Object>>} Respuesta por dirección
+   */
+  broadcast(command, { expect = this.slots, timeoutMs = 2 * this.cycleMs + RESPONSE_MARGIN_MS } = {}) {
+    const cmd = command[2];
+    const addresses = Array.from({ length: this.slots }, (_, i) => i + 1);
+    return this.enqueue(addresses, () => {
+      const responses = new Map();
+      const collected = this.wait(
+        (r) => r.cmd === cmd && r.address !== null && !responses.has(r.address),
+        (r) => {
+          responses.set(r.address, r);
+          return responses.size >= expect ? responses : false;
+        },
+        timeoutMs, () => responses);
+      this.write(toAddress(command, BROADCAST_ADDRESS));
+      return collected;
+    });
+  }
+
+  /**
+   * Alinea el reloj de todas las placas (0x22, sin respuesta)
+   * También reinicia la grilla de muestreo: repetirlo tras cambiar Ts, que cada placa
+   * aplica en su propio turno, si las muestras deben coincidir en TICK
+   * @param {number} tick - millis() que toman las placas al recibirlo
+   */
+  syncClocks(tick = 0) {
+    this.write(busSync(tick));
+    this.syncedAt = Date.now();
+    this.syncTick = tick;
+  }
+
+  /**
+   * Tick estimado de las placas (desde el último syncClocks, sin la latencia del enlace)
+   * @param {number} hostTime - Date.now() a convertir
+   */
+  boardTick(hostTime = Date.now()) {
+    if (this.syncedAt === null) throw new Error('Sin reloj común: llamar antes a syncClocks()');
+    return (this.syncTick + hostTime - this.syncedAt) >>> 0;
+  }
+
+  /**
+   * Programa el mismo comando en todas las placas para el tick T (0x15 por difusión)
+   * @param {number} tick - millis() común de ejecución
+   * @param {Buffer} command - Comando sin dirección (p. ej. streamingEnable(true))
+   * @returns {Promise<Map<number, Object>>} Respuesta de 0x15 por dirección
+   */
+  startAt(tick, command) {
+    return this.broadcast(execAt(tick, command));
+  }
+
+  /**
+   * Canales de las tramas empaquetadas de una placa
+   * @param {number} address - 1..slots
+   * @param {number} n - Canales (0x0C byte 2)
+   */
+  setChannels(address, n) {
+    this.decoder.setChannels(n, address);
+  }
+
+  /**
+   * Consulta 0x0C a todas las placas y configura los canales de cada dirección
+   * Llamarlo antes de habilitar el streaming: las placas pueden tener firmwares
+   * distintos (p. ej. 4 y 8 canales) y sus tramas compactas miden distinto
+   * @returns {Promise<Map<number, number>>} Canales por dirección que respondió
+   */
+  async discoverChannels() {
+    const responses = await this.broadcast(getCaps());
+    const channels = new Map();
+    for (const [address, response] of responses) {
+      const caps = response.status === STATUS.OK ? parseCaps(response.payload) : null;
+      if (!caps) continue;
+      this.setChannels(address, caps.adcChannels);
+      channels.set(address, caps.adcChannels);
+    }
+    return channels;
+  }
+}
+
+module.exports = { BusMaster };
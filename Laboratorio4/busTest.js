@@ -0,0 +1,139 @@
+const { BusMaster } = require('./busMaster');
+const { VirtualBoard, SharedBus } = require('./boardSimulator');
+const { getInfo, setTsampleAdc, streamingEnable, STATUS } = require('./commandProtocol');
+const { DEFAULT_CHANNELS } = require('./frameParser');
+
+/**
+ * Prueba del bus multipunto (0x21/0x22, cabeceras 55 AC / 55 AD) con placas simuladas
+ * Uso: node busTest.js [placas] [msPorRanura] [segundos]
+ * Recorre lo que hace un host con varias placas en un solo puerto y verifica que:
+ *   - tras 0x22 ninguna respuesta ni trama choca en el par de retorno compartido
+ *   - una difusión recibe una respuesta por placa, ordenadas por ranura
+ *   - los comandos a placas distintas van en paralelo y a la misma placa se encolan
+ *   - "todas empiezan en T" (0x15 por difusión) da los mismos TICK en todas las placas
+ *   - cada muestra se atribuye a su placa (el canal 0 de la simulación es su dirección)
+ *   - placas con distinto número de canales (las pares tienen 8, las impares 4; 0x0C por
+ *     difusión) se decodifican cada una con el suyo
+ * Antes de 0x22 los relojes están desfasados y los Ready de arranque pueden chocar:
+ * esas colisiones se informan aparte y no cuentan como error.
+ */
+
+const config = {
+  boards: parseInt(process.argv[2]) || 4,
+  slotMs: parseInt(process.argv[3]) || 5,
+  seconds: parseFloat(process.argv[4]) || 2
+};
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+async function run() {
+  const { boards: n, slotMs } = config;
+  const cycle = n * slotMs;
+  const sampleMs = cycle * Math.ceil(40 / cycle);   // Ts múltiplo del ciclo de turnos
+  const addresses = Array.from({ length: n }, (_, i) => i + 1);
+  const channelsOf = (address) => (address % 2 === 0 ? 8 : DEFAULT_CHANNELS);
+  const boards = addresses.map((address) => new VirtualBoard({
+    address, slots: n, slotMs, clockSkewMs: (address * 7) % cycle, channels: channelsOf(address)
+  }));
+
+  let master = null;
+  const bus = new SharedBus(boards, (data) => master.push(data));
+  master = new BusMaster((data) => bus.write(data), { slots: n, slotMs });
+  const errors = [];
+  const readies = new Set();
+  master.on('ready', (address) => readies.add(address));
+
+  console.log(`[Bus] ${n} placas, ranuras de ${slotMs} ms (ciclo ${cycle} ms), Ts ${sampleMs} ms`);
+  bus.start();
+
+  // Arranque: Ready en el primer turno de cada placa, con relojes todavía sin alinear
+  await sleep(3 * cycle + 20);
+  const bootCollisions = bus.stats.collisions;
+  console.log(`[Bus] Ready de ${readies.size}/${n} placas, colisiones antes de 0x22: ${bootCollisions}`);
+
+  master.syncClocks(0);
+  await sleep(5);
+
+  // Difusión: una respuesta por placa
+  let t = Date.now();
+  const info = await master.broadcast(getInfo());
+  console.log(`[Bus] Difusión 0x07: ${info.size}/${n} respuestas en ${Date.now() - t} ms ` +
+    `(orden ${[...info.keys()].join(', ')})`);
+  if (info.size !== n) errors.push('faltan respuestas a la difusión');
+
+  // Canales por placa (0x0C por difusión): cada dirección con su tamaño de trama
+  const channels = await master.discoverChannels();
+  console.log(`[Bus] Canales: ${[...channels].map(([a, c]) => `${a}:${c}`).join(', ')}`);
+  if (addresses.some((a) => channels.get(a) !== channelsOf(a))) errors.push('canales por placa sin descubrir');
+
+  // Comandos a cada placa en paralelo, y dos seguidos a la misma (se encolan)
+  t = Date.now();
+  const set = await Promise.all([
+    ...addresses.map((a) => master.request(a, setTsampleAdc(sampleMs))),
+    master.request(1, getInfo())
+  ]);
+  const ok = set.filter((r) => r && r.status === STATUS.OK).length;
+  console.log(`[Bus] ${n + 1} comandos dirigidos: ${ok} respuestas OK en ${Date.now() - t} ms`);
+  if (ok !== n + 1) errors.push('comandos dirigidos sin respuesta');
+
+  // Otro 0x22 tras cambiar Ts: cada placa lo aplicó en su turno y el muestreo debe
+  // volver a la misma grilla antes de empezar
+  master.syncClocks(master.boardTick());
+  await sleep(5);
+
+  // Todas empiezan en T
+  const T = master.boardTick() + 2 * cycle + 50;
+  const started = await master.startAt(T, streamingEnable(true));
+  if (started.size !== n) errors.push('0x15 por difusión sin respuesta de todas las placas');
+
+  const perBoard = new Map(addresses.map((a) => [a, { samples: 0, ticks: new Set(), wrong: 0, width: 0 }]));
+  let unattributed = 0;
+  master.on('batch', (batch) => {
+    for (let i = 0; i < batch.count; i++) {
+      const stats = perBoard.get(batch.address[i]);
+      if (!stats) {
+        unattributed++;
+        continue;
+      }
+      stats.samples++;
+      stats.ticks.add(batch.tick[i]);
+      if (batch.values[i * batch.stride] !== batch.address[i]) stats.wrong++;
+      if (batch.width[i] !== channelsOf(batch.address[i])) stats.width++;
+    }
+  });
+  await sleep(Math.max(0, T - master.boardTick()) + config.seconds * 1000);
+  const stopped = await master.broadcast(streamingEnable(false));
+  if (stopped.size !== n) errors.push('faltan respuestas al detener el streaming');
+  await sleep(2 * cycle);
+  bus.stop();
+
+  // Resultados
+  const expected = Math.floor((config.seconds * 1000) / sampleMs);
+  const first = perBoard.get(1).ticks;
+  for (const [address, stats] of perBoard) {
+    const common = [...stats.ticks].filter((tick) => first.has(tick)).length;
+    console.log(`[Bus] Placa ${address}: ${stats.samples} muestras (~${expected} esperadas), ` +
+      `TICK comunes con la placa 1 ${common}/${stats.ticks.size}, mal atribuidas ${stats.wrong}, ` +
+      `con otro número de canales ${stats.width}`);
+    if (stats.samples < expected * 0.9) errors.push(`placa ${address}: faltan muestras`);
+    if (stats.wrong) errors.push(`placa ${address}: muestras atribuidas a otra placa`);
+    if (stats.width) errors.push(`placa ${address}: tramas decodificadas con otros canales`);
+    if (common < stats.ticks.size - 1) errors.push(`placa ${address}: no empezó en T`);
+  }
+  const collisions = bus.stats.collisions - bootCollisions;
+  console.log(`[Bus] Colisiones tras 0x22: ${collisions}, bytes dañados ${bus.stats.corruptedBytes}, ` +
+    `muestras sin dirección ${unattributed}, bytes host->placas ${bus.stats.bytesToBoards}, ` +
+    `placas->host ${bus.stats.bytesToHost}`);
+  if (collisions) errors.push('colisiones en el par de retorno');
+  if (unattributed) errors.push('muestras sin marca de dirección');
+
+  if (errors.length) throw new Error(errors.join('; '));
+  console.log('[Bus] OK');
+}
+
+if (require.main === module) {
+  run().catch((error) => {
+    console.error('[Bus] Error:', error.message);
+    process.exit(1);
+  });
+}
@@ -0,0 +1,361 @@
+const os = require('os');
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+const {
+  CaptureStore, aggregate, countEdges, countCrossings, dipMask, SUMMARY_FIELDS: S
+} = require('./captureStore');
+
+/**
+ * Consultas sobre capturas grabadas (SERIAL_CAPTURE) sin pasar por CSV ni por la base
+ * Uso: node captureQuery.js agg|edges|cross|index captura.bin [opciones]
+ *   agg    --ch=0,2 [--every=1m]               mín, máx, media y filas de cada canal
+ *   edges  --dip=0,1 [--every=1m]              flancos de subida y bajada de cada DIP
+ *   cross  --ch=2 --above=512 [--every=1m]     cruces del umbral (valor > above)
+ *   index                                      solo construye el almacén columnar
+ * Comunes: --from=90s --to=10m (tiempo desde el comienzo de la captura, en ms, s, m
+ * o h), --threads=N (por defecto los núcleos del equipo), --channels=4 y --address=N
+ * (placa de una captura del bus multipunto) para construir el almacén.
+ * La primera consulta construye captura.bin.cols/ (captureStore.js); las siguientes
+ * usan sus columnas y resúmenes por bloque:
+ *   - los bloques fuera de [from, to) se descartan por su primer/último t
+ *   - los bloques enteros dentro del rango y de un solo intervalo (--every) se
+ *     responden desde el resumen, sin leer filas; cross además descarta los bloques
+ *     con mín y máx del mismo lado del umbral
+ *   - el resto se leen (solo t y las columnas pedidas) y se recorren repartidos entre
+ *     hilos de trabajo por tramos de bloques contiguos
+ * Las DIP se ven a la tasa de muestreo: los flancos más rápidos que Ts se cuentan en
+ * el micro con 0x1C (modo contador).
+ */
+
+const MIN_WORKER_BLOCKS = 1024; // ~4 M filas: arrancar un hilo cuesta ~50 ms, lo que se recorren ~2 M
+const OPS = ['agg', 'edges', 'cross'];
+const FIELDS = 4;               // Valores parciales por intervalo y columna
+
+/**
+ * Parciales vacíos de un intervalo: agg [filas, mín, máx, suma], edges [subida,
+ * bajada], cross [hacia arriba, hacia abajo]
+ */
+function emptyPartial(spec) {
+  const p = new Float64Array(spec.columns.length * FIELDS);
+  if (spec.op === 'agg') {
+    for (let c = 0; c < spec.columns.length; c++) {
+      p[c * FIELDS + 1] = Infinity;
+      p[c * FIELDS + 2] = -Infinity;
+    }
+  }
+  return p;
+}
+
+/**
+ * Acumula en results (Map intervalo -> parciales) los valores de una columna
+ */
+function addPartial(results, spec, bucket, c, a, b, min = 0, max = 0) {
+  let p = results.get(bucket);
+  if (!p) {
+    p = emptyPartial(spec);
+    results.set(bucket, p);
+  }
+  const o = c * FIELDS;
+  p[o] += a;
+  p[o + 1] = spec.op === 'agg' ? Math.min(p[o + 1], min) : p[o + 1] + b;
+  if (spec.op === 'agg') {
+    p[o + 2] = Math.max(p[o + 2], max);
+    p[o + 3] += b;
+  }
+}
+
+function mergeResults(into, spec, pairs) {
+  for (const [bucket, p] of pairs) {
+    for (let c = 0; c < spec.columns.length; c++) {
+      const o = c * FIELDS;
+      addPartial(into, spec, bucket, c, p[o], spec.op === 'agg' ? p[o + 3] : p[o + 1], p[o + 1], p[o + 2]);
+    }
+  }
+}
+
+function bucketOf(spec, t) {
+  return spec.every ? Math.floor((t - spec.from) / spec.every) : 0;
+}
+
+/**
+ * Primer índice de [lo, hi) con t[i] >= value
+ */
+function lowerBound(t, lo, hi, value) {
+  while (lo < hi) {
+    const mid = (lo + hi) >> 1;
+    if (t[mid] < value) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * Recorre las filas de un bloque (begin..end en las columnas leídas); las
+ * transiciones con el bloque anterior las agrega el hilo principal desde el resumen
+ */
+function scanBlock(spec, t, cols, begin, end, results) {
+  const lo = lowerBound(t, begin, end, spec.from);
+  const hi = lowerBound(t, lo, end, spec.to);
+  let i = lo;
+  while (i < hi) {
+    const bucket = bucketOf(spec, t[i]);
+    const j = spec.every ? lowerBound(t, i, hi, spec.from + (bucket + 1) * spec.every) : hi;
+    const first = Math.max(i, begin + 1);   // Filas con la anterior en el mismo bloque
+    for (let c = 0; c < spec.columns.length; c++) {
+      const col = cols[c];
+      if (spec.op === 'agg') {
+        const a = aggregate(col, i, j);
+        addPartial(results, spec, bucket, c, j - i, a.sum, a.min, a.max);
+      } else if (first < j && spec.op === 'edges') {
+        const e = countEdges(col, first - 1, j, dipMask(spec.columns[c]));
+        addPartial(results, spec, bucket, c, e.rise, e.fall);
+      } else if (first < j) {
+        const x = countCrossings(col, first - 1, j, spec.threshold);
+        addPartial(results, spec, bucket, c, x.up, x.down);
+      }
+    }
+    i = j;
+  }
+}
+
+/**
+ * Lee y recorre tramos de bloques contiguos
+ * @param {[number, number][]} runs - [primero, último + 1)
+ * @returns {{pairs: [number, Float64Array][], bytes: number}}
+ */
+function scanRuns(store, spec, runs) {
+  const results = new Map();
+  const names = spec.columns.map((k) => (spec.op === 'edges' ? 'digital' : `ch${k}`));
+  const blockRows = store.meta.blockRows;
+  let bytes = 0;
+  for (const [first, last] of runs) {
+    const t = store.readColumn('t', first, last);
+    const read = new Map();
+    const cols = names.map((name) => {
+      if (!read.has(name)) read.set(name, store.readColumn(name, first, last));
+      return read.get(name);
+    });
+    bytes += t.byteLength;
+    for (const col of read.values()) bytes += col.byteLength;
+    for (let b = first; b < last; b++) {
+      const begin = (b - first) * blockRows;
+      scanBlock(spec, t, cols, begin, Math.min(begin + blockRows, t.length), results);
+    }
+  }
+  return { pairs: [...results], bytes };
+}
+
+/**
+ * Reparte los bloques a recorrer en hasta n tareas de tramos contiguos
+ */
+function splitRuns(blocks, n) {
+  const per = Math.ceil(blocks.length / n);
+  const tasks = [];
+  for (let i = 0; i < blocks.length; i += per) {
+    const runs = [];
+    for (const b of blocks.slice(i, i + per)) {
+      const run = runs[runs.length - 1];
+      if (run && run[1] === b) run[1]++;
+      else runs.push([b, b + 1]);
+    }
+    tasks.push(runs);
+  }
+  return tasks;
+}
+
+function runWorker(store, spec, runs) {
+  return new Promise((resolve, reject) => {
+    const worker = new Worker(__filename, { workerData: { dir: store.dir, spec, runs } });
+    worker.once('message', resolve);
+    worker.once('error', reject);
+  });
+}
+
+/**
+ * Ejecuta una consulta
+ * @param {CaptureStore} store
+ * @param {{op: string, columns: number[], from?: number, to?: number, every?: number,
+ *   threshold?: number}} query - columns: canales (agg, cross) o DIP (edges)
+ * @param {{threads?: number}} options
+ * @returns {Promise<{buckets: {start: number, values: Object[]}[], stats: Object}>}
+ *   values por columna: agg {rows, min, max, mean}, edges {rise, fall}, cross {up, down}
+ */
+async function runQuery(store, query, { threads = cpuCount() } = {}) {
+  const started = process.hrtime.bigint();
+  const spec = { from: 0, to: Infinity, every: 0, threshold: 0, ...query };
+  const [first, last] = store.blockRange(spec.from, spec.to);
+  const results = new Map();
+  const toScan = [];
+  let fromSummary = 0;
+
+  for (let b = first; b < last; b++) {
+    const t0 = store.field(b, S.T_FIRST);
+    const t1 = store.field(b, S.T_LAST);
+    const inside = t0 >= spec.from && t1 < spec.to;
+    const bucket = bucketOf(spec, t0);
+
+    // Transición entre el bloque anterior y este (su primera fila)
+    if (b > 0 && spec.op !== 'agg' && t0 >= spec.from && t0 < spec.to) {
+      spec.columns.forEach((k, c) => {
+        if (spec.op === 'edges') {
+          const mask = dipMask(k);
+          const prev = store.field(b - 1, S.DIG_LAST) & mask;
+          const cur = store.field(b, S.DIG_FIRST) & mask;
+          addPartial(results, spec, bucket, c, cur > prev ? 1 : 0, cur < prev ? 1 : 0);
+        } else {
+          const prev = store.channelField(b - 1, k, S.LAST) > spec.threshold;
+          const cur = store.channelField(b, k, S.FIRST) > spec.threshold;
+          addPartial(results, spec, bucket, c, cur && !prev ? 1 : 0, prev && !cur ? 1 : 0);
+        }
+      });
+    }
+
+    let summarized = inside && bucket === bucketOf(spec, t1);
+    if (summarized && spec.op === 'cross') {
+      summarized = spec.columns.every((k) => store.channelField(b, k, S.MIN) > spec.threshold ||
+        store.channelField(b, k, S.MAX) <= spec.threshold);
+    }
+    if (!summarized) {
+      toScan.push(b);
+      continue;
+    }
+    fromSummary++;
+    spec.columns.forEach((k, c) => {
+      if (spec.op === 'agg') {
+        addPartial(results, spec, bucket, c, store.field(b, S.ROWS), store.channelField(b, k, S.SUM),
+          store.channelField(b, k, S.MIN), store.channelField(b, k, S.MAX));
+      } else if (spec.op === 'edges') {
+        addPartial(results, spec, bucket, c, store.field(b, S.RISE + k), store.field(b, S.FALL + k));
+      }
+      // cross: bloque entero de un lado del umbral, sin cruces internos
+    });
+  }
+
+  const workers = Math.max(1, Math.min(threads, Math.floor(toScan.length / MIN_WORKER_BLOCKS)));
+  let bytes = 0;
+  if (workers === 1) {
+    const scanned = scanRuns(store, spec, splitRuns(toScan, 1)[0] || []);
+    mergeResults(results, spec, scanned.pairs);
+    bytes = scanned.bytes;
+  } else {
+    const parts = await Promise.all(splitRuns(toScan, workers).map((runs) => runWorker(store, spec, runs)));
+    for (const part of parts) {
+      mergeResults(results, spec, part.pairs);
+      bytes += part.bytes;
+    }
+  }
+
+  const buckets = [...results.keys()].sort((a, b) => a - b).map((bucket) => {
+    const p = results.get(bucket);
+    return {
+      start: spec.from + bucket * (spec.every || 0),
+      values: spec.columns.map((_, c) => {
+        const o = c * FIELDS;
+        if (spec.op === 'agg') {
+          return { rows: p[o], min: p[o + 1], max: p[o + 2], mean: p[o] ? p[o + 3] / p[o] : NaN };
+        }
+        return spec.op === 'edges' ? { rise: p[o], fall: p[o + 1] } : { up: p[o], down: p[o + 1] };
+      })
+    };
+  });
+  return {
+    buckets,
+    stats: {
+      blocks: store.blocks,
+      pruned: store.blocks - (last - first),
+      fromSummary,
+      scanned: toScan.length,
+      workers,
+      bytesRead: bytes,
+      elapsedMs: Number(process.hrtime.bigint() - started) / 1e6
+    }
+  };
+}
+
+function cpuCount() {
+  return os.availableParallelism ? os.availableParallelism() : os.cpus().length;
+}
+
+/**
+ * "90s", "5m", "1.5h" o ms
+ */
+function parseTime(text) {
+  const m = /^(\d+(?:\.\d+)?)(ms|s|m|h)?$/.exec(text);
+  if (!m) throw new Error(`Tiempo inválido: ${text}`);
+  return parseFloat(m[1]) * { ms: 1, s: 1000, m: 60000, h: 3600000 }[m[2] || 'ms'];
+}
+
+function formatTime(ms) {
+  const s = Math.floor(ms / 1000);
+  const pad = (v, n = 2) => String(v).padStart(n, '0');
+  return `${Math.floor(s / 3600)}:${pad(Math.floor(s / 60) % 60)}:${pad(s % 60)}.${pad(ms % 1000, 3)}`;
+}
+
+async function run() {
+  const [op, capture, ...rest] = process.argv.slice(2);
+  if (![...OPS, 'index'].includes(op) || !capture) {
+    throw new Error('Uso: node captureQuery.js agg|edges|cross|index captura.bin [--ch=0,2] [--dip=0] ' +
+      '[--above=512] [--every=1m] [--from=0] [--to=10m] [--threads=N] [--channels=4] [--address=N]');
+  }
+  const args = {};
+  for (const arg of rest) {
+    const m = /^--(\w+)=(.+)$/.exec(arg);
+    if (!m) throw new Error(`Opción inválida: ${arg}`);
+    args[m[1]] = m[2];
+  }
+  const list = (text) => (text || '0').split(',').map((v) => parseInt(v));
+
+  let t = process.hrtime.bigint();
+  const { store, built } = CaptureStore.forCapture(capture, {
+    channels: parseInt(args.channels) || 4,
+    address: args.address !== undefined ? parseInt(args.address) : null
+  });
+  const { meta } = store;
+  console.log(`[Query] ${meta.rows} filas, ${meta.channels} canales, ${meta.blocks} bloques` +
+    (built ? ` (almacén construido en ${(Number(process.hrtime.bigint() - t) / 1e6).toFixed(0)} ms)` : ''));
+  if (op === 'index') return;
+
+  const query = {
+    op,
+    columns: list(op === 'edges' ? args.dip : args.ch),
+    from: args.from ? parseTime(args.from) : 0,
+    to: args.to ? parseTime(args.to) : Infinity,
+    every: args.every ? parseTime(args.every) : 0,
+    threshold: parseFloat(args.above) || 0
+  };
+  const limit = op === 'edges' ? 4 : meta.channels;
+  if (query.columns.some((k) => !(k >= 0 && k < limit))) {
+    throw new Error(`${op === 'edges' ? 'DIP' : 'Canal'} fuera de rango (0..${limit - 1})`);
+  }
+  if (op === 'cross' && args.above === undefined) throw new Error('cross necesita --above=umbral');
+
+  const { buckets, stats } = await runQuery(store, query, {
+    threads: parseInt(args.threads) || cpuCount()
+  });
+  const label = op === 'edges' ? 'DIP' : 'ch';
+  for (const bucket of buckets) {
+    const cells = bucket.values.map((v, c) => {
+      const name = `${label}${query.columns[c]}`;
+      if (op === 'agg') {
+        return `${name} mín ${v.min} máx ${v.max} media ${v.mean.toFixed(2)} (${v.rows} filas)`;
+      }
+      return op === 'edges' ? `${name} ↑${v.rise} ↓${v.fall}` : `${name} ↑${v.up} ↓${v.down}`;
+    });
+    console.log(`[Query] ${formatTime(bucket.start)}  ${cells.join('  ')}`);
+  }
+  console.log(`[Query] ${stats.elapsedMs.toFixed(1)} ms: ${stats.pruned} bloques fuera de rango, ` +
+    `${stats.fromSummary} desde el resumen, ${stats.scanned} recorridos en ${stats.workers} ` +
+    `hilo(s), ${(stats.bytesRead / 1048576).toFixed(1)} MB leídos` +
+    (meta.calibrated ? ' (valores calibrados)' : ''));
+}
+
+if (!isMainThread) {
+  const { dir, spec, runs } = workerData;
+  parentPort.postMessage(scanRuns(new CaptureStore(dir), spec, runs));
+} else if (require.main === module) {
+  run().catch((error) => {
+    console.error('[Query] Error:', error.message);
+    process.exit(1);
+  });
+}
+
+module.exports = { runQuery, parseTime };
@@ -0,0 +1,318 @@
+const fs = require('fs');
+const path = require('path');
+const { FrameDecoder } = require('./frameDecoder');
+
+/**
+ * Almacén columnar de una captura (SERIAL_CAPTURE) para consultas sobre la sesión
+ * La captura cruda se decodifica una sola vez (buildStore) a un directorio
+ * captura.bin.cols/ con una columna por archivo:
+ *   t.u32         ms desde el comienzo de la captura (TICK de 16 bits desenrollado)
+ *   digital.u8    DIP (nibble alto) + LEDs (nibble bajo)
+ *   chK.i16       canal K (cuentas, o la unidad de su tabla con salida calibrada)
+ *   summary.f64   resumen por bloque de BLOCK_ROWS filas: filas, primer/último t,
+ *                 primer/último digital, flancos por DIP y, por canal, mín, máx,
+ *                 suma, primer y último valor
+ *   meta.json     filas, canales, bloques y la captura de origen (tamaño y fecha)
+ * Las consultas (captureQuery.js) descartan bloques por t, responden los bloques
+ * enteros desde el resumen y solo leen y recorren las columnas pedidas del resto.
+ * Limitaciones: las tramas legacy no traen TICK y toman el t de la fila anterior, y
+ * una pausa de más de 65.5 s sin tramas (TICK de 16 bits) no se puede medir.
+ */
+
+const BLOCK_ROWS = 4096;
+const STORE_VERSION = 1;
+const READ_CHUNK = 1 << 20;
+const DIP_BITS = 4;
+
+// Campos del resumen de cada bloque (Float64)
+const S = {
+  ROWS: 0, T_FIRST: 1, T_LAST: 2, DIG_FIRST: 3, DIG_LAST: 4,
+  RISE: 5,                     // DIP_BITS campos: flancos de subida de DIP0..DIP3
+  FALL: 5 + DIP_BITS,          // DIP_BITS campos: flancos de bajada
+  CH: 5 + 2 * DIP_BITS,        // Por canal: CH_FIELDS campos
+  CH_FIELDS: 5,
+  MIN: 0, MAX: 1, SUM: 2, FIRST: 3, LAST: 4
+};
+
+/**
+ * Bit del DIP n dentro del byte digital (nibble alto)
+ */
+function dipMask(dip) {
+  return 1 << (4 + dip);
+}
+
+/**
+ * Columnas de un bloque en construcción y su resumen
+ */
+class BlockWriter {
+  constructor(dir, channels, blockRows) {
+    this.channels = channels;
+    this.blockRows = blockRows;
+    this.t = new Uint32Array(blockRows);
+    this.digital = new Uint8Array(blockRows);
+    this.values = Array.from({ length: channels }, () => new Int16Array(blockRows));
+    this.count = 0;
+    this.rows = 0;
+    this.blocks = 0;
+    this.width = S.CH + S.CH_FIELDS * channels;
+    this.fds = {
+      t: fs.openSync(path.join(dir, 't.u32'), 'w'),
+      digital: fs.openSync(path.join(dir, 'digital.u8'), 'w'),
+      summary: fs.openSync(path.join(dir, 'summary.f64'), 'w'),
+      ch: this.values.map((_, k) => fs.openSync(path.join(dir, `ch${k}.i16`), 'w'))
+    };
+  }
+
+  add(t, digital, values, base, width) {
+    const i = this.count++;
+    this.t[i] = t;
+    this.digital[i] = digital;
+    for (let k = 0; k < this.channels; k++) this.values[k][i] = k < width ? values[base + k] : 0;
+    if (this.count === this.blockRows) this.flush();
+  }
+
+  flush() {
+    const n = this.count;
+    if (n === 0) return;
+    const s = new Float64Array(this.width);
+    const { t, digital } = this;
+    s[S.ROWS] = n;
+    s[S.T_FIRST] = t[0];
+    s[S.T_LAST] = t[n - 1];
+    s[S.DIG_FIRST] = digital[0];
+    s[S.DIG_LAST] = digital[n - 1];
+    for (let b = 0; b < DIP_BITS; b++) {
+      const edges = countEdges(digital, 0, n, dipMask(b));
+      s[S.RISE + b] = edges.rise;
+      s[S.FALL + b] = edges.fall;
+    }
+    for (let k = 0; k < this.channels; k++) {
+      const v = this.values[k];
+      const agg = aggregate(v, 0, n);
+      const o = S.CH + k * S.CH_FIELDS;
+      s[o + S.MIN] = agg.min;
+      s[o + S.MAX] = agg.max;
+      s[o + S.SUM] = agg.sum;
+      s[o + S.FIRST] = v[0];
+      s[o + S.LAST] = v[n - 1];
+      fs.writeSync(this.fds.ch[k], v, 0, n * 2);
+    }
+    fs.writeSync(this.fds.t, t, 0, n * 4);
+    fs.writeSync(this.fds.digital, digital, 0, n);
+    fs.writeSync(this.fds.summary, s);
+    this.rows += n;
+    this.blocks++;
+    this.count = 0;
+  }
+
+  close() {
+    this.flush();
+    const { t, digital, summary, ch } = this.fds;
+    for (const fd of [t, digital, summary, ...ch]) fs.closeSync(fd);
+  }
+}
+
+// Núcleos sobre un tramo [begin, end) de una columna: bucles sin ramas por fila
+// más allá de la comparación, que V8 compila a código de máquina compacto
+
+/**
+ * @returns {{min: number, max: number, sum: number}}
+ */
+function aggregate(v, begin, end) {
+  let min = 32767;
+  let max = -32768;
+  let sum = 0;
+  for (let i = begin; i < end; i++) {
+    const x = v[i];
+    min = x < min ? x : min;
+    max = x > max ? x : max;
+    sum += x;
+  }
+  return { min, max, sum };
+}
+
+/**
+ * Flancos del bit mask entre filas consecutivas de [begin, end)
+ */
+function countEdges(digital, begin, end, mask) {
+  let rise = 0;
+  let fall = 0;
+  let prev = digital[begin] & mask;
+  for (let i = begin + 1; i < end; i++) {
+    const cur = digital[i] & mask;
+    rise += (cur > prev) | 0;
+    fall += (cur < prev) | 0;
+    prev = cur;
+  }
+  return { rise, fall };
+}
+
+/**
+ * Cruces del umbral (valor > threshold) entre filas consecutivas de [begin, end)
+ */
+function countCrossings(v, begin, end, threshold) {
+  let up = 0;
+  let down = 0;
+  let prev = v[begin] > threshold;
+  for (let i = begin + 1; i < end; i++) {
+    const cur = v[i] > threshold;
+    up += (cur && !prev) | 0;
+    down += (prev && !cur) | 0;
+    prev = cur;
+  }
+  return { up, down };
+}
+
+/**
+ * Decodifica una captura cruda y escribe su almacén columnar
+ * @param {string} capturePath - Bytes grabados con SERIAL_CAPTURE
+ * @param {{dir?: string, channels?: number, address?: number|null, blockRows?: number}} options
+ *   channels: canales de las tramas empaquetadas (0x0C/0x11); address: placa del bus a
+ *   extraer de una captura multipunto (sin ella se mezclan todas)
+ * @returns {CaptureStore}
+ */
+function buildStore(capturePath, { dir = storeDir(capturePath), channels = 4, address = null,
+  blockRows = BLOCK_ROWS } = {}) {
+  fs.mkdirSync(dir, { recursive: true });
+  const stat = fs.statSync(capturePath);
+  const decoder = new FrameDecoder({ channels });
+  let writer = null;
+  let lastTick = null;
+  let t = 0;
+  let calibrated = false;
+
+  const fd = fs.openSync(capturePath, 'r');
+  const chunk = Buffer.alloc(READ_CHUNK);
+  let n;
+  while ((n = fs.readSync(fd, chunk, 0, READ_CHUNK, null)) > 0) {
+    const batch = decoder.push(chunk.subarray(0, n));
+    for (let i = 0; i < batch.count; i++) {
+      if (address !== null && batch.address[i] !== address) continue;
+      const tick = batch.tick[i];
+      if (tick >= 0) {
+        if (lastTick !== null) t += (tick - lastTick) & 0xFFFF;
+        lastTick = tick;
+      }
+      if (!writer) writer = new BlockWriter(dir, Math.max(channels, batch.width[i]), blockRows);
+      calibrated = calibrated || batch.calibrated[i] === 1;
+      writer.add(t, batch.digital[i], batch.values, i * batch.stride, batch.width[i]);
+    }
+  }
+  fs.closeSync(fd);
+  if (!writer) writer = new BlockWriter(dir, channels, blockRows);
+  writer.close();
+
+  const meta = {
+    version: STORE_VERSION,
+    source: path.resolve(capturePath),
+    sourceBytes: stat.size,
+    sourceMtimeMs: stat.mtimeMs,
+    address,
+    rows: writer.rows,
+    channels: writer.channels,
+    blockRows,
+    blocks: writer.blocks,
+    summaryWidth: writer.width,
+    calibrated
+  };
+  fs.writeFileSync(path.join(dir, 'meta.json'), JSON.stringify(meta, null, 2));
+  return new CaptureStore(dir, meta);
+}
+
+function storeDir(capturePath) {
+  return `${capturePath}.cols`;
+}
+
+class CaptureStore {
+  /**
+   * @param {string} dir - Directorio de buildStore
+   * @param {Object} [meta] - Contenido de meta.json (se lee si falta)
+   */
+  constructor(dir, meta = null) {
+    this.dir = dir;
+    this.meta = meta || JSON.parse(fs.readFileSync(path.join(dir, 'meta.json'), 'utf8'));
+    const raw = fs.readFileSync(path.join(dir, 'summary.f64'));
+    this.summary = new Float64Array(raw.buffer, raw.byteOffset, raw.length / 8);
+    this.width = this.meta.summaryWidth;
+  }
+
+  /**
+   * Abre el almacén de una captura, reconstruyéndolo si falta o si la captura cambió
+   * @param {string} capturePath
+   * @param {Object} options - Los de buildStore
+   * @returns {{store: CaptureStore, built: boolean}}
+   */
+  static forCapture(capturePath, options = {}) {
+    const dir = options.dir || storeDir(capturePath);
+    try {
+      const meta = JSON.parse(fs.readFileSync(path.join(dir, 'meta.json'), 'utf8'));
+      const stat = fs.statSync(capturePath);
+      const same = meta.version === STORE_VERSION && meta.sourceBytes === stat.size &&
+        meta.sourceMtimeMs === stat.mtimeMs && meta.address === (options.address ?? null);
+      if (same) return { store: new CaptureStore(dir, meta), built: false };
+    } catch (e) {
+      // Sin almacén o ilegible: se construye
+    }
+    return { store: buildStore(capturePath, { ...options, dir }), built: true };
+  }
+
+  get blocks() {
+    return this.meta.blocks;
+  }
+
+  /**
+   * Campo f del resumen del bloque b
+   */
+  field(b, f) {
+    return this.summary[b * this.width + f];
+  }
+
+  channelField(b, k, f) {
+    return this.summary[b * this.width + S.CH + k * S.CH_FIELDS + f];
+  }
+
+  /**
+   * Bloques que pueden tener filas con t en [from, to) (t crece con las filas)
+   * @returns {[number, number]} [primero, último + 1)
+   */
+  blockRange(from, to) {
+    let lo = 0;
+    let hi = this.blocks;
+    while (lo < hi) {               // Primer bloque con T_LAST >= from
+      const mid = (lo + hi) >> 1;
+      if (this.field(mid, S.T_LAST) < from) lo = mid + 1;
+      else hi = mid;
+    }
+    const first = lo;
+    hi = this.blocks;
+    while (lo < hi) {               // Primer bloque con T_FIRST >= to
+      const mid = (lo + hi) >> 1;
+      if (this.field(mid, S.T_FIRST) < to) lo = mid + 1;
+      else hi = mid;
+    }
+    return [first, lo];
+  }
+
+  /**
+   * Lee una columna para los bloques [first, last)
+   * @param {string} name - 't', 'digital' o 'chK'
+   * @returns {Uint32Array|Uint8Array|Int16Array}
+   */
+  readColumn(name, first, last) {
+    const [file, Type] = name === 't' ? ['t.u32', Uint32Array]
+      : name === 'digital' ? ['digital.u8', Uint8Array]
+        : [`${name}.i16`, Int16Array];
+    const rowStart = first * this.meta.blockRows;
+    const rowEnd = Math.min(last * this.meta.blockRows, this.meta.rows);
+    const out = new Type(rowEnd - rowStart);
+    const fd = fs.openSync(path.join(this.dir, file), 'r');
+    fs.readSync(fd, new Uint8Array(out.buffer), 0, out.byteLength, rowStart * Type.BYTES_PER_ELEMENT);
+    fs.closeSync(fd);
+    return out;
+  }
+}
+
+module.exports = {
+  CaptureStore, buildStore, storeDir, aggregate, countEdges, countCrossings, dipMask,
+  SUMMARY_FIELDS: S, BLOCK_ROWS, DIP_BITS
+};
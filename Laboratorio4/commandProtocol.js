@@ -2,11 +2,17 @@
  * Implementación de protocolo de comandos binario
  * Gestiona la construcción, envío y validación de comandos al microcontrolador
  * Formato: [Header][CMD][LEN][Payload][Checksum]
+ * Direccionado (bus multipunto): [0x55 0xAC][ADDR][CMD][LEN][Payload][Checksum] y
+ * respuestas [0x55 0xAD][ADDR][STATUS][CMD][LEN][Payload][Checksum]; el checksum
+ * incluye ADDR
  */
 
 const CMD_HEADER_1 = 0x55;
 const CMD_HEADER_2 = 0xAA;
 const RESP_HEADER_2 = 0xAB;
+const ADDR_CMD_HEADER_2 = 0xAC;
+const ADDR_RESP_HEADER_2 = 0xAD;
+const BROADCAST_ADDRESS = 0xFF;
 
 // Códigos de comando
 const COMMANDS = {
@@ -18,7 +24,95 @@ const COMMANDS = {
   SNAPSHOT: 0x06,
   GET_INFO: 0x07,
   SET_TSAMPLE_ADC: 0x08,
-  GET_TSAMPLE_ADC: 0x09
+  GET_TSAMPLE_ADC: 0x09,
+  READY: 0x0A,          // Evento no solicitado al arrancar el firmware
+  SYNC: 0x0B,
+  GET_CAPS: 0x0C,
+  SET_FRAME_FORMAT: 0x0D,
+  GET_FRAME_FORMAT: 0x0E,
+  SET_ADAPTIVE_RATE: 0x0F,
+  RATE: 0x10,           // Get rate y evento no solicitado al cambiar la tasa efectiva
+  GET_CHANNELS: 0x11,
+  SET_CAL_OUTPUT: 0x12,
+  GET_CAL: 0x13,
+  SET_CAL: 0x14,
+  EXEC_AT: 0x15,
+  EXECUTED: 0x16,       // Evento no solicitado al ejecutar un comando programado
+  EXEC_CANCEL: 0x17,
+  LINK_TEST: 0x18,
+  LINK_RESULT: 0x19,    // Evento no solicitado al terminar una prueba de enlace
+  SET_GENERATOR: 0x1A,
+  GET_MEM: 0x1B,        // Sin bit en CAPS: un firmware previo responde 0x03
+  SET_INPUT_MODE: 0x1C, // Ídem
+  BULK_OPEN: 0x1D,      // Transferencia en bloques (bulkTransfer.js), sin bit en CAPS
+  BULK_DATA: 0x1E,      // Bloque: evento en descargas, comando en cargas
+  BULK_ACK: 0x1F,       // Sin respuesta si es válido
+  BULK_END: 0x20,       // Respuesta y evento al terminar una descarga
+  SET_ADDRESS: 0x21,    // Dirección y turnos del bus multipunto (busMaster.js), sin bit en CAPS
+  BUS_SYNC: 0x22        // Reloj común del bus, sin respuesta
+};
+
+// Bits de capacidades anunciados en Ready (0x0A)
+const DEVICE_CAPS = {
+  SYNC: 0x01,
+  CAPS: 0x02,
+  ADAPTIVE_RATE: 0x04,
+  CHANNELS: 0x08,
+  CALIBRATION: 0x10,
+  EXEC_AT: 0x20,
+  LINK_TEST: 0x40,
+  GENERATOR: 0x80
+};
+
+// Byte RESET del evento Ready (0x0A): causa según MCUSR y reinicio en caliente
+const RESET_FLAGS = {
+  POWER_ON: 0x01,
+  EXTERNAL: 0x02,
+  BROWN_OUT: 0x04,
+  WATCHDOG: 0x08,
+  WARM: 0x80          // Estado restaurado: el streaming siguió con la misma configuración
+};
+
+// Formas de onda del generador de señales sintéticas (0x1A)
+const GENERATOR_WAVES = {
+  OFF: 0,        // Lectura real
+  RAMP: 1,
+  SINE: 2,
+  STEP: 3,
+  PRBS: 4,
+  COUNTER: 5
+};
+
+// Destino del generador para el DIP (los canales analógicos son 0..N-1)
+const GENERATOR_DIP = 0xFF;
+
+// Transferencia en bloques (0x1D..0x20): dirección, objetos y resultado de 0x20
+const BULK_DIR = {
+  DOWNLOAD: 0,   // MCU -> PC
+  UPLOAD: 1      // PC -> MCU
+};
+const BULK_OBJECTS = {
+  EEPROM: 0,     // 1 KB: tablas de calibración y contador de arranques
+  FLASH: 1       // 32 KB, solo descarga
+};
+const BULK_RESULTS = {
+  OK: 0,
+  INCOMPLETE: 1,
+  TIMEOUT: 2
+};
+
+// Tipos de canal en los descriptores de 0x11 (nibble alto)
+const CHANNEL_KINDS = {
+  0x0: 'A',      // Entrada analógica An
+  0x1: 'TEMP',   // Sensor de temperatura interno
+  0x2: 'VBG'     // Bandgap 1.1 V contra AVcc
+};
+
+// Unidades de las tablas de calibración (0x13/0x14)
+const CAL_UNITS = {
+  0: 'counts',
+  1: 'mV',
+  2: 'c°C'       // Centésimas de grado Celsius
 };
 
 // Códigos de estado de respuesta
@@ -46,9 +140,11 @@ function calculateChecksum(data) {
  * Construye un comando para enviar al microcontrolador
  * @param {number} cmd - Código de comando
  * @param {Buffer|Array} payload - Datos del payload (opcional)
+ * @param {number|null} address - Dirección en el bus (0xFF = difusión); null = 55 AA
  * @returns {Buffer}
  */
-function buildCommand(cmd, payload = []) {
+function buildCommand(cmd, payload = [], address = null) {
+  if (address !== null) return toAddress(buildCommand(cmd, payload), address);
   const payloadBuffer = Buffer.isBuffer(payload) ? payload : Buffer.from(payload);
   const len = payloadBuffer.length;
   
@@ -69,10 +165,27 @@ function buildCommand(cmd, payload = []) {
   return command;
 }
 
+/**
+ * Convierte un comando 55 AA ya construido en su forma direccionada 55 AC ADDR
+ * (así cualquier constructor de este módulo sirve para el bus)
+ * @param {Buffer} command - Comando sin dirección
+ * @param {number} address - 0..254, o BROADCAST_ADDRESS
+ * @returns {Buffer}
+ */
+function toAddress(command, address) {
+  const out = Buffer.alloc(command.length + 1);
+  out[0] = CMD_HEADER_1;
+  out[1] = ADDR_CMD_HEADER_2;
+  out[2] = address & 0xFF;
+  command.copy(out, 3, 2);
+  out[out.length - 1] ^= out[2];
+  return out;
+}
+
 /**
  * Parsea una respuesta del microcontrolador
- * @param {Buffer} response - Buffer de respuesta
- * @returns {Object|null}
+ * @param {Buffer} response - Buffer de respuesta (55 AB o 55 AD)
+ * @returns {Object|null} address = dirección de la placa (null sin dirección)
  */
 function parseResponse(response) {
   if (!response || response.length < 6) {
@@ -80,23 +193,25 @@ function parseResponse(response) {
   }
   
   // Verificar header
-  if (response[0] !== CMD_HEADER_1 || response[1] !== RESP_HEADER_2) {
+  if (response[0] !== CMD_HEADER_1 ||
+      (response[1] !== RESP_HEADER_2 && response[1] !== ADDR_RESP_HEADER_2)) {
     return null;
   }
+  const base = response[1] === ADDR_RESP_HEADER_2 ? 3 : 2;  // Primer byte tras ADDR
   
-  const status = response[2];
-  const cmd = response[3];
-  const len = response[4];
+  const status = response[base];
+  const cmd = response[base + 1];
+  const len = response[base + 2];
   
-  if (response.length < 6 + len) {
+  if (response.length < base + 4 + len) {
     return null;
   }
   
-  const payload = len > 0 ? response.slice(5, 5 + len) : Buffer.alloc(0);
-  const receivedChecksum = response[5 + len];
+  const payload = len > 0 ? response.slice(base + 3, base + 3 + len) : Buffer.alloc(0);
+  const receivedChecksum = response[base + 3 + len];
   
-  // Verificar checksum
-  const dataForChecksum = response.slice(2, 5 + len);
+  // Verificar checksum (desde ADDR en las direccionadas)
+  const dataForChecksum = response.slice(2, base + 3 + len);
   const calculatedChecksum = calculateChecksum(dataForChecksum);
   
   if (receivedChecksum !== calculatedChecksum) {
@@ -108,10 +223,540 @@ function parseResponse(response) {
     status,
     cmd,
     payload,
-    isOk: status === STATUS.OK
+    isOk: status === STATUS.OK,
+    address: base === 3 ? response[2] : null
+  };
+}
+
+/**
+ * Busca la primera respuesta válida (55 AB ... CHK o 55 AD ADDR ... CHK) a partir
+ * de un offset.
+ * A diferencia de parseResponse, tolera bytes previos (tramas de streaming, basura).
+ * @param {Buffer} buffer - Buffer acumulativo
+ * @param {number} from - Offset inicial de búsqueda
+ * @returns {{response: Object, start: number, end: number}|null} end es exclusivo
+ */
+function findResponse(buffer, from = 0) {
+  let idx = from;
+  while (idx < buffer.length) {
+    idx = buffer.indexOf(CMD_HEADER_1, idx);
+    if (idx === -1 || idx + 1 >= buffer.length) return null;
+    if (buffer[idx + 1] !== RESP_HEADER_2 && buffer[idx + 1] !== ADDR_RESP_HEADER_2) {
+      idx++;
+      continue;
+    }
+    const base = idx + (buffer[idx + 1] === ADDR_RESP_HEADER_2 ? 3 : 2);
+    if (base + 3 > buffer.length) return null; // Cabecera incompleta
+    const len = buffer[base + 2];
+    const end = base + 4 + len;
+    if (end > buffer.length) return null;     // Payload incompleto
+    const dataForChecksum = buffer.slice(idx + 2, base + 3 + len);
+    if (calculateChecksum(dataForChecksum) === buffer[base + 3 + len]) {
+      return {
+        response: {
+          status: buffer[base],
+          cmd: buffer[base + 1],
+          payload: buffer.slice(base + 3, base + 3 + len),
+          isOk: buffer[base] === STATUS.OK,
+          address: base === idx + 3 ? buffer[idx + 2] : null
+        },
+        start: idx,
+        end
+      };
+    }
+    idx++; // Falso positivo dentro de una trama, seguir buscando
+  }
+  return null;
+}
+
+/**
+ * Decodifica el payload del evento Ready (0x0A)
+ * @param {Buffer} payload - [PROTO_VER][CAPS][BOOT_L][BOOT_H][RESET]
+ * @returns {{protocolVersion: number, caps: number, bootCount: number,
+ *   resetFlags: number, warmRestart: boolean}|null}
+ */
+function parseReady(payload) {
+  if (!payload || payload.length < 4) return null;
+  const reset = payload.length > 4 ? payload[4] : 0;   // Firmware previo: sin byte RESET
+  return {
+    protocolVersion: payload[0],
+    caps: payload[1],
+    bootCount: payload[2] | (payload[3] << 8),
+    resetFlags: reset & 0x0F,
+    warmRestart: (reset & RESET_FLAGS.WARM) !== 0
+  };
+}
+
+/**
+ * Decodifica el descriptor de capacidades (respuesta a 0x0C)
+ * @param {Buffer} payload - Descriptor binario little endian
+ * @returns {Object|null}
+ */
+function parseCaps(payload) {
+  if (!payload || payload.length < 20) return null;
+  const baudCount = payload[19];
+  const baudRates = [];
+  for (let i = 0; i < baudCount && 20 + i * 4 + 4 <= payload.length; i++) {
+    baudRates.push(payload.readUInt32LE(20 + i * 4));
+  }
+  return {
+    protocolVersion: payload[0],
+    formats: payload[1],          // bit n = formato de trama n soportado
+    adcChannels: payload[2],
+    adcBits: payload[3],
+    dipInputs: payload[4],
+    ledOutputs: payload[5],
+    minPeriodUs: payload.readUInt32LE(6),
+    maxPeriodUs: payload.readUInt32LE(10),
+    rxBufferSize: payload.readUInt16LE(14),
+    txBufferSize: payload.readUInt16LE(16),
+    maxPayload: payload[18],
+    baudRates
+  };
+}
+
+/**
+ * Decodifica la tasa efectiva (respuesta a 0x10 o evento Rate)
+ * @param {Buffer} payload - [FMT][DECIM][TEFF_L][TEFF_H][SKIP_L][SKIP_H]
+ * @returns {{format: number, decimation: number, effectivePeriodMs: number, skipped: number}|null}
+ */
+function parseRate(payload) {
+  if (!payload || payload.length < 6) return null;
+  return {
+    format: payload[0],
+    decimation: payload[1],
+    effectivePeriodMs: payload.readUInt16LE(2),
+    skipped: payload.readUInt16LE(4)    // Acumulado, da la vuelta en 65535
+  };
+}
+
+/**
+ * Decodifica la lista de canales (respuesta a 0x11)
+ * @param {Buffer} payload - [N][DESC0..DESCN-1]
+ * @returns {Array<{kind: number, index: number, name: string}>|null} En orden de trama
+ */
+function parseChannels(payload) {
+  if (!payload || payload.length < 1 || payload.length < 1 + payload[0]) return null;
+  const channels = [];
+  for (let i = 0; i < payload[0]; i++) {
+    const desc = payload[1 + i];
+    const kind = desc >> 4;
+    const index = desc & 0x0F;
+    const prefix = CHANNEL_KINDS[kind] || `K${kind}`;
+    channels.push({ kind, index, name: kind === 0x0 ? `${prefix}${index}` : prefix });
+  }
+  return channels;
+}
+
+/**
+ * Decodifica la tabla de calibración de un canal (respuesta a 0x13/0x14)
+ * @param {Buffer} payload - [CH][SRC][UNIT][N][RAW uint16 LE][VAL int16 LE] x N
+ * @returns {{channel: number, fromEeprom: boolean, unit: number, unitName: string,
+ *   points: Array<{raw: number, value: number}>}|null}
+ */
+function parseCalibration(payload) {
+  if (!payload || payload.length < 4 || payload.length < 4 + payload[3] * 4) return null;
+  const points = [];
+  for (let i = 0; i < payload[3]; i++) {
+    points.push({
+      raw: payload.readUInt16LE(4 + i * 4),
+      value: payload.readInt16LE(6 + i * 4)
+    });
+  }
+  return {
+    channel: payload[0],
+    fromEeprom: payload[1] === 1,
+    unit: payload[2],
+    unitName: CAL_UNITS[payload[2]] || `U${payload[2]}`,
+    points
+  };
+}
+
+/**
+ * Comando: Activar/desactivar las tramas calibradas (compacta 0x79, analógica 0x78)
+ * @param {boolean} enable - true para recibir cada canal en la unidad de su tabla
+ * @returns {Buffer}
+ */
+function setCalibratedOutput(enable) {
+  return buildCommand(COMMANDS.SET_CAL_OUTPUT, [enable ? 1 : 0]);
+}
+
+/**
+ * Comando: Leer la tabla de calibración de un canal
+ * @param {number} channel - Índice en orden de trama (0x11)
+ * @returns {Buffer}
+ */
+function getCalibration(channel) {
+  return buildCommand(COMMANDS.GET_CAL, [channel & 0xFF]);
+}
+
+/**
+ * Comando: Guardar en la EEPROM del MCU la tabla de calibración de un canal
+ * @param {number} channel - Índice en orden de trama (0x11)
+ * @param {number} unit - Código de CAL_UNITS
+ * @param {Array<{raw: number, value: number}>} points - 2..4 puntos con raw creciente;
+ *   vacío para volver a la tabla por defecto del firmware
+ * @returns {Buffer}
+ */
+function setCalibration(channel, unit, points = []) {
+  const payload = Buffer.alloc(3 + points.length * 4);
+  payload[0] = channel & 0xFF;
+  payload[1] = unit & 0xFF;
+  payload[2] = points.length;
+  points.forEach((p, i) => {
+    payload.writeUInt16LE(p.raw & 0xFFFF, 3 + i * 4);
+    payload.writeInt16LE(Math.max(-32768, Math.min(32767, Math.round(p.value))), 5 + i * 4);
+  });
+  return buildCommand(COMMANDS.SET_CAL, payload);
+}
+
+/**
+ * Comando: Programar otro comando para el tick T del micro (millis(), como 0x0B)
+ * @param {number} tick - millis() del micro en que debe ejecutarse (uint32)
+ * @param {Buffer} command - Comando completo ya construido (p.ej. setLedMask(0x0F));
+ *   se reenvía su CMD y payload (máx. 8 bytes)
+ * @returns {Buffer}
+ */
+function execAt(tick, command) {
+  const len = command[3];
+  const payload = Buffer.alloc(5 + len);
+  payload.writeUInt32LE(tick >>> 0, 0);
+  payload[4] = command[2];
+  command.copy(payload, 5, 4, 4 + len);
+  return buildCommand(COMMANDS.EXEC_AT, payload);
+}
+
+/**
+ * Comando: Descartar todos los comandos programados pendientes
+ * @returns {Buffer}
+ */
+function cancelScheduled() {
+  return buildCommand(COMMANDS.EXEC_CANCEL, []);
+}
+
+/**
+ * Decodifica el evento Executed (0x16)
+ * @param {Buffer} payload - [ID][CMD][TICK uint32 LE]
+ * @returns {{id: number, cmd: number, tick: number}|null}
+ */
+function parseExecuted(payload) {
+  if (!payload || payload.length < 6) return null;
+  return { id: payload[0], cmd: payload[1], tick: payload.readUInt32LE(2) };
+}
+
+/**
+ * Comando: Prueba de enlace con patrón PRBS-15
+ * @param {number} mode - 0 = el MCU envía, 1 = el MCU verifica lo que envía el host
+ * @param {number} count - Bytes de patrón (uint32, > 0)
+ * @returns {Buffer}
+ */
+function linkTest(mode, count) {
+  const payload = Buffer.alloc(5);
+  payload[0] = mode & 0xFF;
+  payload.writeUInt32LE(count >>> 0, 1);
+  return buildCommand(COMMANDS.LINK_TEST, payload);
+}
+
+/**
+ * Decodifica el evento Link result (0x19)
+ * @param {Buffer} payload - [MODO][BYTES u32][ERR u32][FALTAN u32][T_US u32]
+ * @returns {{mode: number, bytes: number, errors: number, missing: number, elapsedUs: number}|null}
+ */
+function parseLinkResult(payload) {
+  if (!payload || payload.length < 17) return null;
+  return {
+    mode: payload[0],
+    bytes: payload.readUInt32LE(1),
+    errors: payload.readUInt32LE(5),
+    missing: payload.readUInt32LE(9),
+    elapsedUs: payload.readUInt32LE(13)
+  };
+}
+
+/**
+ * Comando: Sustituir la lectura de un canal (o del DIP) por una señal sintética
+ * @param {number} target - Canal 0..N-1 o GENERATOR_DIP
+ * @param {number} wave - Código de GENERATOR_WAVES
+ * @param {{period?: number, amplitude?: number, offset?: number}} params - Período en
+ *   muestras, amplitud y offset en cuentas (0..15 para el DIP)
+ * @returns {Buffer}
+ */
+function setGenerator(target, wave, { period = 1, amplitude = 0, offset = 0 } = {}) {
+  const payload = Buffer.alloc(8);
+  payload[0] = target & 0xFF;
+  payload[1] = wave & 0xFF;
+  payload.writeUInt16LE(period & 0xFFFF, 2);
+  payload.writeUInt16LE(amplitude & 0xFFFF, 4);
+  payload.writeUInt16LE(offset & 0xFFFF, 6);
+  return buildCommand(COMMANDS.SET_GENERATOR, payload);
+}
+
+/**
+ * Comando: Devolver todos los canales y el DIP a su lectura real
+ * @returns {Buffer}
+ */
+function clearGenerators() {
+  return buildCommand(COMMANDS.SET_GENERATOR, []);
+}
+
+/**
+ * Comando: Configurar una entrada DIP como nivel, contador de flancos o medidor de período
+ * @param {number} input - Entrada 0..3
+ * @param {number} mode - Código de INPUT_MODES (frameParser.js)
+ * @returns {Buffer}
+ */
+function setInputMode(input, mode) {
+  return buildCommand(COMMANDS.SET_INPUT_MODE, [input & 0x03, mode & 0xFF]);
+}
+
+/**
+ * Comando: Consultar el modo de las entradas DIP
+ * @returns {Buffer}
+ */
+function getInputModes() {
+  return buildCommand(COMMANDS.SET_INPUT_MODE, []);
+}
+
+/**
+ * Decodifica la respuesta a 0x1C
+ * @param {Buffer} payload - [MODOS], 2 bits por entrada
+ * @returns {Array<number>|null} Modo de las entradas 0..3
+ */
+function parseInputModes(payload) {
+  if (!payload || payload.length < 1) return null;
+  return [0, 1, 2, 3].map((i) => (payload[0] >> (2 * i)) & 0x03);
+}
+
+/**
+ * CRC-16 de un bloque 0x1E (polinomio 0xA001 reflejado, inicio 0xFFFF; igual que
+ * _crc16_update de avr-libc)
+ * @param {Buffer} data - OFS (LE) seguido de los datos
+ * @returns {number}
+ */
+function crc16(data) {
+  let crc = 0xFFFF;
+  for (let i = 0; i < data.length; i++) {
+    crc ^= data[i];
+    for (let k = 0; k < 8; k++) crc = crc & 1 ? (crc >>> 1) ^ 0xA001 : crc >>> 1;
+  }
+  return crc;
+}
+
+/**
+ * Comando: Abrir una transferencia en bloques
+ * @param {number} dir - Código de BULK_DIR
+ * @param {number} object - Código de BULK_OBJECTS
+ * @param {number} offset - Primer byte dentro del objeto
+ * @param {number} length - Bytes a transferir (> 0)
+ * @returns {Buffer}
+ */
+function bulkOpen(dir, object, offset, length) {
+  const payload = Buffer.alloc(6);
+  payload[0] = dir & 0xFF;
+  payload[1] = object & 0xFF;
+  payload.writeUInt16LE(offset & 0xFFFF, 2);
+  payload.writeUInt16LE(length & 0xFFFF, 4);
+  return buildCommand(COMMANDS.BULK_OPEN, payload);
+}
+
+/**
+ * Decodifica la respuesta a 0x1D
+ * @param {Buffer} payload - [DIR][OBJ][OFS u16][LEN u16][BLOQUE][VENTANA]
+ * @returns {{dir: number, object: number, offset: number, length: number,
+ *   chunkSize: number, window: number}|null}
+ */
+function parseBulkOpen(payload) {
+  if (!payload || payload.length < 8) return null;
+  return {
+    dir: payload[0],
+    object: payload[1],
+    offset: payload.readUInt16LE(2),
+    length: payload.readUInt16LE(4),
+    chunkSize: payload[6],
+    window: payload[7]
+  };
+}
+
+/**
+ * Comando: Bloque de una carga (PC -> MCU)
+ * @param {number} offset - Offset del bloque dentro del objeto
+ * @param {Buffer} data - Datos (el tamaño de bloque de 0x1D, el último puede ser menor)
+ * @returns {Buffer}
+ */
+function bulkData(offset, data) {
+  const payload = Buffer.alloc(4 + data.length);
+  payload.writeUInt16LE(offset & 0xFFFF, 0);
+  data.copy(payload, 2);
+  payload.writeUInt16LE(crc16(payload.subarray(0, 2 + data.length)), 2 + data.length);
+  return buildCommand(COMMANDS.BULK_DATA, payload);
+}
+
+/**
+ * Decodifica un bloque de descarga (evento 0x1E)
+ * @param {Buffer} payload - [OFS u16][DATOS][CRC u16]
+ * @returns {{offset: number, data: Buffer, crcOk: boolean}|null} data comparte memoria con payload
+ */
+function parseBulkData(payload) {
+  if (!payload || payload.length < 5) return null;
+  const end = payload.length - 2;
+  return {
+    offset: payload.readUInt16LE(0),
+    data: payload.subarray(2, end),
+    crcOk: crc16(payload.subarray(0, end)) === payload.readUInt16LE(end)
+  };
+}
+
+/**
+ * Comando: Confirmación de una descarga
+ * @param {number} nextOffset - Offset del primer bloque aún no recibido
+ * @param {number} resendMask - Bit i = reenviar el bloque nextOffset + i * BLOQUE
+ * @returns {Buffer}
+ */
+function bulkAck(nextOffset, resendMask = 0) {
+  const payload = Buffer.alloc(3);
+  payload.writeUInt16LE(nextOffset & 0xFFFF, 0);
+  payload[2] = resendMask & 0xFF;
+  return buildCommand(COMMANDS.BULK_ACK, payload);
+}
+
+/**
+ * Comando: Terminar la carga (el micro recarga la calibración) o cancelar la descarga
+ * @returns {Buffer}
+ */
+function bulkEnd() {
+  return buildCommand(COMMANDS.BULK_END, []);
+}
+
+/**
+ * Decodifica la respuesta o el evento Bulk end (0x20)
+ * @param {Buffer} payload - [RESULTADO][DIR][OBJ][BYTES u16][REENVIOS u16]
+ * @returns {{result: number, dir: number, object: number, bytes: number, retransmits: number}|null}
+ */
+function parseBulkEnd(payload) {
+  if (!payload || payload.length < 7) return null;
+  return {
+    result: payload[0],
+    dir: payload[1],
+    object: payload[2],
+    bytes: payload.readUInt16LE(3),
+    retransmits: payload.readUInt16LE(5)
   };
 }
 
+/**
+ * Comando: Asignar (o consultar, sin argumentos) la dirección y los turnos del bus
+ * @param {number} [address] - 1..254 en el bus (0 = sin asignar)
+ * @param {number} [slots] - Placas del bus; 0 o 1 = enlace punto a punto
+ * @param {number} [slotMs] - Duración de cada ranura en ms (>= 3)
+ * @returns {Buffer}
+ */
+function setAddress(address, slots = 0, slotMs = 10) {
+  if (address === undefined) return buildCommand(COMMANDS.SET_ADDRESS, []);
+  return buildCommand(COMMANDS.SET_ADDRESS, [address & 0xFF, slots & 0xFF, slotMs & 0xFF]);
+}
+
+/**
+ * Decodifica la respuesta a Set address (0x21)
+ * @param {Buffer} payload - [ADDR][RANURAS][MS]
+ * @returns {{address: number, slots: number, slotMs: number}|null}
+ */
+function parseAddress(payload) {
+  if (!payload || payload.length < 3) return null;
+  return { address: payload[0], slots: payload[1], slotMs: payload[2] };
+}
+
+/**
+ * Comando: Reloj común del bus (sin respuesta); se envía por difusión
+ * @param {number} tick - Nuevo millis() de las placas
+ * @returns {Buffer}
+ */
+function busSync(tick) {
+  const payload = Buffer.alloc(4);
+  payload.writeUInt32LE(tick >>> 0, 0);
+  return buildCommand(COMMANDS.BUS_SYNC, payload, BROADCAST_ADDRESS);
+}
+
+/**
+ * Comando: Consultar la RAM libre y la marca de agua de la pila del micro
+ * @returns {Buffer}
+ */
+function getMem() {
+  return buildCommand(COMMANDS.GET_MEM, []);
+}
+
+/**
+ * Decodifica la respuesta a Get mem (0x1B)
+ * @param {Buffer} payload - [FREE][STACK_LIBRE][ESTATICA][RAM], uint16 LE
+ * @returns {{free: number, stackUnused: number, staticBytes: number, ram: number,
+ *   stackPeak: number}|null}
+ */
+function parseMem(payload) {
+  if (!payload || payload.length < 8) return null;
+  const ram = payload.readUInt16LE(6);
+  const staticBytes = payload.readUInt16LE(4);
+  const stackUnused = payload.readUInt16LE(2);
+  return {
+    free: payload.readUInt16LE(0),
+    stackUnused,
+    staticBytes,
+    ram,
+    stackPeak: ram - staticBytes - stackUnused   // Máxima profundidad de pila observada
+  };
+}
+
+/**
+ * Comando: Obtener la lista de canales analógicos
+ * @returns {Buffer}
+ */
+function getChannels() {
+  return buildCommand(COMMANDS.GET_CHANNELS, []);
+}
+
+/**
+ * Comando: Obtener descriptor de capacidades
+ * @returns {Buffer}
+ */
+function getCaps() {
+  return buildCommand(COMMANDS.GET_CAPS, []);
+}
+
+/**
+ * Comando: Seleccionar formato de trama de streaming
+ * @param {number} format - 0=legacy (20B), 1=compacta (11B), 2=dividida (analógica + digital)
+ * @returns {Buffer}
+ */
+function setFrameFormat(format) {
+  return buildCommand(COMMANDS.SET_FRAME_FORMAT, [format & 0xFF]);
+}
+
+/**
+ * Comando: Habilitar/deshabilitar el control de tasa adaptativo
+ * @param {boolean} enable - true para que el MCU ajuste formato y diezmado al enlace
+ * @returns {Buffer}
+ */
+function setAdaptiveRate(enable) {
+  return buildCommand(COMMANDS.SET_ADAPTIVE_RATE, [enable ? 1 : 0]);
+}
+
+/**
+ * Comando: Obtener la tasa efectiva de streaming
+ * @returns {Buffer}
+ */
+function getRate() {
+  return buildCommand(COMMANDS.RATE, []);
+}
+
+/**
+ * Comando: Marcador de sincronización
+ * El MCU responde con el mismo token y su tick en ms; todo lo recibido antes
+ * de esa respuesta puede descartarse.
+ * @param {Buffer|Array} token - 1..4 bytes
+ * @returns {Buffer}
+ */
+function sync(token) {
+  return buildCommand(COMMANDS.SYNC, token);
+}
+
 /**
  * Comando: Habilitar/deshabilitar streaming de datos
  * @param {boolean} enable - true para habilitar, false para deshabilitar
@@ -181,10 +826,62 @@ function snapshot() {
 }
 
 module.exports = {
+  CMD_HEADER_1,
+  RESP_HEADER_2,
+  ADDR_CMD_HEADER_2,
+  ADDR_RESP_HEADER_2,
+  BROADCAST_ADDRESS,
   COMMANDS,
+  DEVICE_CAPS,
+  RESET_FLAGS,
+  CAL_UNITS,
+  GENERATOR_WAVES,
+  GENERATOR_DIP,
+  BULK_DIR,
+  BULK_OBJECTS,
+  BULK_RESULTS,
   STATUS,
   buildCommand,
+  toAddress,
   parseResponse,
+  findResponse,
+  parseReady,
+  parseCaps,
+  parseRate,
+  parseChannels,
+  getChannels,
+  getMem,
+  parseMem,
+  setAddress,
+  parseAddress,
+  busSync,
+  setInputMode,
+  getInputModes,
+  parseInputModes,
+  crc16,
+  bulkOpen,
+  parseBulkOpen,
+  bulkData,
+  parseBulkData,
+  bulkAck,
+  bulkEnd,
+  parseBulkEnd,
+  parseCalibration,
+  setCalibratedOutput,
+  getCalibration,
+  setCalibration,
+  execAt,
+  cancelScheduled,
+  parseExecuted,
+  linkTest,
+  parseLinkResult,
+  setGenerator,
+  clearGenerators,
+  sync,
+  getCaps,
+  setFrameFormat,
+  setAdaptiveRate,
+  getRate,
   streamingEnable,
   setLedMask,
   getDip,
@@ -9,8 +9,9 @@
  * @param {Object} parsedData - Datos parseados de la trama
  * @param {number} relativeTime - Timestamp relativo en milisegundos
  * @param {Object} config - Configuración con IDs base
+ * @param {RollupWriter} rollups - Agregados por intervalo a actualizar (opcional)
  */
-async function insertFrameData(db, parsedData, relativeTime, config) {
+async function insertFrameData(db, parsedData, relativeTime, config, rollups = null) {
   const adcBaseId = parseInt(config.adcBaseId) || 10;
   const dinBaseId = parseInt(config.dinBaseId) || 18;
   
@@ -38,7 +39,9 @@ async function insertFrameData(db, parsedData, relativeTime, config) {
 
   // Insertar en batch (transacción) para mejor rendimiento
   try {
-    const insertedCount = await db.insertBatch(dataToInsert);
+    const atMs = Date.now();   // Misma fecha/hora en las filas y en los agregados
+    const insertedCount = await db.insertBatch(dataToInsert, atMs);
+    if (insertedCount === 12 && rollups) rollups.addBatch(dataToInsert, atMs);
     return insertedCount === 12; // Éxito si se insertaron las 12 variables
   } catch (error) {
     console.error('[DataInserter] Error al insertar datos:', error.message);
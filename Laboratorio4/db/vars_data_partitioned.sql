@@ -0,0 +1,168 @@
+--
+-- Revisión de int_proceso_vars_data para tablas de cientos de millones de filas
+--
+--   * Particionada por día (RANGE COLUMNS sobre `fecha`): la retención borra
+--     particiones completas en lugar de filas, y las consultas con rango de fecha
+--     (histórico crudo de IntProcesoData.getVarsHistory) solo abren esos días.
+--   * PRIMARY KEY (`id`, `fecha`): MySQL/MariaDB exigen la columna de partición en
+--     toda clave única; `id` sigue siendo AUTO_INCREMENT y el orden de inserción.
+--   * Índices compuestos según las consultas existentes:
+--       (`int_proceso_vars_id`, `id`)           -> "var IN (...) AND id > ?" y
+--                                                 "var = ? ORDER BY id DESC LIMIT 1"
+--       (`int_proceso_vars_id`, `fecha`, `hora`) -> histórico por rango de tiempo
+--     Sustituyen a int_proceso_vars_data_FKIndex1 (solo var).
+--   * Las tablas particionadas no admiten claves foráneas: se pierde
+--     int_proceso_vars_data_ibfk_1. Los escritores (dbConnection.js, IntProcesoDataDAO)
+--     solo usan los ids de int_proceso_vars, así que no cambia su comportamiento.
+--
+-- Se eligió particionar la tabla estrecha (una fila por variable) y no una fila
+-- ancha por trama para no cambiar las consultas de la API Java, el polling del
+-- WebSocket ni las páginas web.
+--
+-- Migración (sin detener la adquisición más que durante el RENAME final):
+--   1. Ejecutar este archivo: crea int_proceso_vars_data_p y los procedimientos.
+--   2. CALL vars_data_copy_to_partitioned(100000);  -- copia por bloques de id
+--   3. Detener la adquisición, repetir el paso 2 (copia solo lo nuevo) y
+--      RENAME TABLE int_proceso_vars_data TO int_proceso_vars_data_old,
+--                   int_proceso_vars_data_p TO int_proceso_vars_data;
+--   4. Programar la retención (evento al final del archivo).
+-- Medición de inserción y consultas antes/después: schemaBench.js (npm run bench:schema).
+--
+
+CREATE TABLE IF NOT EXISTS `int_proceso_vars_data_p` (
+  `id` int(10) UNSIGNED NOT NULL AUTO_INCREMENT,
+  `int_proceso_vars_id` int(10) UNSIGNED NOT NULL,
+  `valor` int(11) NOT NULL,
+  `tiempo` int(11) NOT NULL,
+  `fecha` date NOT NULL,
+  `hora` time NOT NULL,
+  PRIMARY KEY (`id`, `fecha`),
+  KEY `vars_data_var_id` (`int_proceso_vars_id`, `id`),
+  KEY `vars_data_var_fecha` (`int_proceso_vars_id`, `fecha`, `hora`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8 COLLATE=utf8_unicode_ci
+PARTITION BY RANGE COLUMNS (`fecha`) (
+  PARTITION `p_inicial` VALUES LESS THAN ('2025-01-01'),
+  PARTITION `p_futuro` VALUES LESS THAN (MAXVALUE)
+);
+
+--
+-- Copia por bloques de `id` las filas de int_proceso_vars_data que aún no están en
+-- int_proceso_vars_data_p (conserva los id). Se puede repetir: continúa desde el
+-- mayor id copiado. Crea antes las particiones diarias que cubren los datos.
+--
+
+DROP PROCEDURE IF EXISTS `vars_data_copy_to_partitioned`;
+
+DELIMITER $$
+CREATE PROCEDURE `vars_data_copy_to_partitioned` (IN `bloque` INT UNSIGNED)
+BEGIN
+  DECLARE desde INT UNSIGNED;
+  DECLARE hasta INT UNSIGNED;
+  DECLARE dias INT;
+
+  SELECT COALESCE(MAX(`id`), 0) INTO desde FROM `int_proceso_vars_data_p`;
+  SELECT COALESCE(MAX(`id`), 0) INTO hasta FROM `int_proceso_vars_data`;
+  SELECT COALESCE(DATEDIFF(CURDATE(), MIN(`fecha`)), 0) INTO dias
+    FROM `int_proceso_vars_data` WHERE `id` > desde;
+  CALL vars_data_rotate_partitions(NULL, dias, 7);
+
+  WHILE desde < hasta DO
+    INSERT INTO `int_proceso_vars_data_p`
+      (`id`, `int_proceso_vars_id`, `valor`, `tiempo`, `fecha`, `hora`)
+    SELECT `id`, `int_proceso_vars_id`, `valor`, `tiempo`, `fecha`, `hora`
+    FROM `int_proceso_vars_data`
+    WHERE `id` > desde AND `id` <= desde + bloque;
+    COMMIT;
+    SET desde = desde + bloque;
+  END WHILE;
+END$$
+DELIMITER ;
+
+--
+-- Particiones diarias de `tabla` (NULL = int_proceso_vars_data_p): crea `pYYYYMMDD`
+-- desde hace `dias_atras` días hasta `dias_adelante` días en el futuro, partiendo
+-- `p_futuro` (vacía en régimen normal, así que partirla es barato). No crea días
+-- anteriores a la última partición diaria existente.
+--
+
+DROP PROCEDURE IF EXISTS `vars_data_rotate_partitions`;
+
+DELIMITER $$
+CREATE PROCEDURE `vars_data_rotate_partitions` (IN `tabla` VARCHAR(64), IN `dias_atras` INT, IN `dias_adelante` INT)
+BEGIN
+  DECLARE t VARCHAR(64) DEFAULT COALESCE(tabla, 'int_proceso_vars_data_p');
+  DECLARE dia DATE DEFAULT DATE_SUB(CURDATE(), INTERVAL dias_atras DAY);
+  DECLARE fin DATE DEFAULT DATE_ADD(CURDATE(), INTERVAL dias_adelante DAY);
+  DECLARE nombre VARCHAR(16);
+
+  WHILE dia <= fin DO
+    SET nombre = CONCAT('p', DATE_FORMAT(dia, '%Y%m%d'));
+    IF NOT EXISTS (SELECT 1 FROM information_schema.PARTITIONS
+                   WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = t
+                     AND PARTITION_NAME = nombre)
+       AND dia >= (SELECT COALESCE(MAX(STR_TO_DATE(SUBSTRING(PARTITION_NAME, 2), '%Y%m%d')), '2025-01-01')
+                   FROM information_schema.PARTITIONS
+                   WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = t
+                     AND PARTITION_NAME REGEXP '^p[0-9]{8}$') THEN
+      SET @ddl = CONCAT('ALTER TABLE `', t, '` REORGANIZE PARTITION `p_futuro` INTO (',
+                        'PARTITION `', nombre, '` VALUES LESS THAN (''', DATE_ADD(dia, INTERVAL 1 DAY), '''), ',
+                        'PARTITION `p_futuro` VALUES LESS THAN (MAXVALUE))');
+      PREPARE stmt FROM @ddl;
+      EXECUTE stmt;
+      DEALLOCATE PREPARE stmt;
+    END IF;
+    SET dia = DATE_ADD(dia, INTERVAL 1 DAY);
+  END WHILE;
+END$$
+DELIMITER ;
+
+--
+-- Retención de `tabla` (NULL = int_proceso_vars_data): borra con DROP PARTITION,
+-- sin DELETE fila a fila, las particiones de días anteriores a hoy - dias_retencion.
+--
+
+DROP PROCEDURE IF EXISTS `vars_data_apply_retention`;
+
+DELIMITER $$
+CREATE PROCEDURE `vars_data_apply_retention` (IN `tabla` VARCHAR(64), IN `dias_retencion` INT)
+BEGIN
+  DECLARE t VARCHAR(64) DEFAULT COALESCE(tabla, 'int_proceso_vars_data');
+  DECLARE nombre VARCHAR(64);
+  DECLARE fin INT DEFAULT 0;
+  DECLARE viejas CURSOR FOR
+    SELECT PARTITION_NAME FROM information_schema.PARTITIONS
+    WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = t
+      AND (PARTITION_NAME = 'p_inicial'
+           OR (PARTITION_NAME REGEXP '^p[0-9]{8}$'
+               AND STR_TO_DATE(SUBSTRING(PARTITION_NAME, 2), '%Y%m%d')
+                   < DATE_SUB(CURDATE(), INTERVAL dias_retencion DAY)));
+  DECLARE CONTINUE HANDLER FOR NOT FOUND SET fin = 1;
+
+  OPEN viejas;
+  borrar: LOOP
+    FETCH viejas INTO nombre;
+    IF fin = 1 THEN LEAVE borrar; END IF;
+    -- p_inicial se vacía pero se conserva: RANGE exige una primera partición
+    IF nombre = 'p_inicial' THEN
+      SET @ddl = CONCAT('ALTER TABLE `', t, '` TRUNCATE PARTITION `p_inicial`');
+    ELSE
+      SET @ddl = CONCAT('ALTER TABLE `', t, '` DROP PARTITION `', nombre, '`');
+    END IF;
+    PREPARE stmt FROM @ddl;
+    EXECUTE stmt;
+    DEALLOCATE PREPARE stmt;
+  END LOOP;
+  CLOSE viejas;
+END$$
+DELIMITER ;
+
+--
+-- Rotación diaria tras el RENAME (requiere SET GLOBAL event_scheduler = ON):
+-- particiones para la próxima semana y retención de 30 días.
+--
+-- CREATE EVENT IF NOT EXISTS `vars_data_mantenimiento`
+--   ON SCHEDULE EVERY 1 DAY STARTS (CURDATE() + INTERVAL 1 DAY + INTERVAL 5 MINUTE)
+--   DO BEGIN
+--     CALL vars_data_rotate_partitions('int_proceso_vars_data', 0, 7);
+--     CALL vars_data_apply_retention('int_proceso_vars_data', 30);
+--   END;
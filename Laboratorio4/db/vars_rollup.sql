@@ -0,0 +1,84 @@
+--
+-- Agregados por intervalo de int_proceso_vars_data para las gráficas históricas
+--
+-- Una fila por variable, resolución (1 s, 60 s, 3600 s) e intervalo, con mínimo,
+-- máximo, suma y número de muestras. Los escribe incrementalmente rollupWriter.js
+-- (index.js) con INSERT ... ON DUPLICATE KEY UPDATE; las muestras que insertan
+-- otros clientes (aplicación Java) se incorporan con rollup_vars_data_backfill.
+-- `bucket` es el inicio del intervalo en segundos desde 1970-01-01 00:00:00 de
+-- `fecha` + `hora` tal como están guardadas (hora local, sin conversión de zona),
+-- el mismo origen en rollupWriter.js y en rollup_vars_data_backfill.
+--
+
+CREATE TABLE IF NOT EXISTS `int_proceso_vars_rollup` (
+  `int_proceso_vars_id` int(10) UNSIGNED NOT NULL,
+  `resolucion` int(10) UNSIGNED NOT NULL,
+  `bucket` int(10) UNSIGNED NOT NULL,
+  `vmin` int(11) NOT NULL,
+  `vmax` int(11) NOT NULL,
+  `vsum` bigint(20) NOT NULL,
+  `muestras` int(10) UNSIGNED NOT NULL,
+  PRIMARY KEY (`int_proceso_vars_id`, `resolucion`, `bucket`),
+  KEY `rollup_resolucion_bucket` (`resolucion`, `bucket`),
+  CONSTRAINT `int_proceso_vars_rollup_ibfk_1` FOREIGN KEY (`int_proceso_vars_id`) REFERENCES `int_proceso_vars` (`id`) ON UPDATE NO ACTION
+) ENGINE=InnoDB DEFAULT CHARSET=utf8 COLLATE=utf8_unicode_ci;
+
+--
+-- Marca de relleno: último id de int_proceso_vars_data ya incorporado por
+-- rollup_vars_data_backfill. Se crea con el id máximo actual: el histórico previo
+-- a la instalación se incorpora poniendo `hasta_id` = 0 antes del primer relleno
+-- (antes de arrancar index.js con la tabla, para no sumar dos veces lo suyo).
+--
+
+CREATE TABLE IF NOT EXISTS `int_proceso_vars_rollup_marca` (
+  `id` tinyint(3) UNSIGNED NOT NULL,
+  `hasta_id` int(10) UNSIGNED NOT NULL,
+  PRIMARY KEY (`id`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8 COLLATE=utf8_unicode_ci;
+
+INSERT IGNORE INTO `int_proceso_vars_rollup_marca` (`id`, `hasta_id`)
+SELECT 1, COALESCE(MAX(`id`), 0) FROM `int_proceso_vars_data`;
+
+--
+-- Agrega las filas crudas con id posterior a la marca (o a desde_id, si es mayor)
+-- hasta el id máximo actual y avanza la marca en la misma transacción: repetir la
+-- llamada no vuelve a sumar las mismas filas. Pensado para datos que no pasaron
+-- por rollupWriter.js (aplicación Java con index.js detenido); las filas que
+-- index.js inserta mientras tanto ya están agregadas y se sumarían dos veces.
+--
+
+DROP PROCEDURE IF EXISTS `rollup_vars_data_backfill`;
+
+DELIMITER $$
+CREATE PROCEDURE `rollup_vars_data_backfill` (IN `desde_id` INT UNSIGNED)
+BEGIN
+  DECLARE marca INT UNSIGNED;
+  DECLARE hasta INT UNSIGNED;
+
+  START TRANSACTION;
+  -- Bloquea la marca: dos llamadas simultáneas se serializan
+  SELECT `hasta_id` INTO marca FROM `int_proceso_vars_rollup_marca` WHERE `id` = 1 FOR UPDATE;
+  SET marca = GREATEST(COALESCE(marca, 0), desde_id);
+  SELECT COALESCE(MAX(`id`), 0) INTO hasta FROM `int_proceso_vars_data`;
+
+  IF hasta > marca THEN
+    INSERT INTO `int_proceso_vars_rollup`
+      (`int_proceso_vars_id`, `resolucion`, `bucket`, `vmin`, `vmax`, `vsum`, `muestras`)
+    SELECT d.`int_proceso_vars_id`, r.`resolucion`,
+           TIMESTAMPDIFF(SECOND, '1970-01-01 00:00:00', TIMESTAMP(d.`fecha`, d.`hora`)) DIV r.`resolucion` * r.`resolucion` AS b,
+           MIN(d.`valor`), MAX(d.`valor`), SUM(d.`valor`), COUNT(*)
+    FROM `int_proceso_vars_data` d
+    CROSS JOIN (SELECT 1 AS `resolucion` UNION ALL SELECT 60 UNION ALL SELECT 3600) r
+    WHERE d.`id` > marca AND d.`id` <= hasta
+    GROUP BY d.`int_proceso_vars_id`, r.`resolucion`, b
+    ON DUPLICATE KEY UPDATE
+      `vmin` = LEAST(`vmin`, VALUES(`vmin`)),
+      `vmax` = GREATEST(`vmax`, VALUES(`vmax`)),
+      `vsum` = `vsum` + VALUES(`vsum`),
+      `muestras` = `muestras` + VALUES(`muestras`);
+
+    UPDATE `int_proceso_vars_rollup_marca` SET `hasta_id` = hasta WHERE `id` = 1;
+  END IF;
+  COMMIT;
+END$$
+DELIMITER ;
@@ -1,5 +1,6 @@
 const mysql = require('mysql2/promise');
 const EventEmitter = require('events');
+const { toFechaHora } = require('./wallClock');
 
 /**
  * Gestor de conexiones a base de datos MySQL
@@ -97,9 +98,10 @@ class DatabaseConnection extends EventEmitter {
   /**
    * Ejecuta múltiples inserciones en batch
    * @param {Array<{varId, valor, tiempo}>} dataArray
+   * @param {number} atMs - Instante de fecha/hora (el mismo que recibe RollupWriter.addBatch)
    * @returns {Promise<number>} Número de inserciones exitosas
    */
-  async insertBatch(dataArray) {
+  async insertBatch(dataArray, atMs = Date.now()) {
     if (!this.pool) {
       console.error('[DB] Pool no inicializado');
       return 0;
@@ -114,11 +116,12 @@ class DatabaseConnection extends EventEmitter {
       const query = `
         INSERT INTO int_proceso_vars_data 
         (int_proceso_vars_id, valor, tiempo, fecha, hora)
-        VALUES (?, ?, ?, CURDATE(), CURTIME())
+        VALUES (?, ?, ?, ?, ?)
       `;
+      const { fecha, hora } = toFechaHora(atMs);
 
       for (const data of dataArray) {
-        await connection.execute(query, [data.varId, data.valor, data.tiempo]);
+        await connection.execute(query, [data.varId, data.valor, data.tiempo, fecha, hora]);
         successCount++;
       }
 
@@ -138,6 +141,27 @@ class DatabaseConnection extends EventEmitter {
     }
   }
 
+  /**
+   * Suma agregados por intervalo a int_proceso_vars_rollup en un solo INSERT
+   * @param {Array<Array<number>>} rows - [varId, resolucion, bucket, min, max, suma, muestras]
+   * @returns {Promise<void>} Lanza el error de MySQL (p. ej. ER_NO_SUCH_TABLE)
+   */
+  async upsertRollups(rows) {
+    if (!this.pool || rows.length === 0) return;
+
+    const query = `
+      INSERT INTO int_proceso_vars_rollup
+      (int_proceso_vars_id, resolucion, bucket, vmin, vmax, vsum, muestras)
+      VALUES ?
+      ON DUPLICATE KEY UPDATE
+        vmin = LEAST(vmin, VALUES(vmin)),
+        vmax = GREATEST(vmax, VALUES(vmax)),
+        vsum = vsum + VALUES(vsum),
+        muestras = muestras + VALUES(muestras)
+    `;
+    await this.pool.query(query, [rows]);
+  }
+
   /**
    * Cierra el pool de conexiones
    */
@@ -0,0 +1,276 @@
+const fs = require('fs');
+const { PerformanceObserver } = require('perf_hooks');
+const {
+  findFrames, parseFrame, SplitFrameMerger, FRAME_FORMATS, CALIBRATED_FRAMES,
+  DIGITAL_FRAME
+} = require('./frameParser');
+const {
+  findResponse, COMMANDS, STATUS, CMD_HEADER_1, RESP_HEADER_2
+} = require('./commandProtocol');
+const { FrameDecoder } = require('./frameDecoder');
+const { UniformResampler } = require('./resampler');
+
+/**
+ * Comparación del decodificador por lotes (frameDecoder.js) con el camino anterior
+ * del listener (Buffer.concat + findFrames + parseFrame) sobre capturas grabadas
+ * Uso: node decoderBench.js [captura.bin ...] [--chunk=64] [--channels=4] [--repeat=5] [--resample=1]
+ *   Sin archivos se generan capturas sintéticas de cada formato.
+ *   Las capturas se graban con SERIAL_CAPTURE=archivo al ejecutar index.js.
+ */
+
+const options = { chunk: 64, channels: 4, repeat: 5, resample: 1 };
+const files = [];
+for (const arg of process.argv.slice(2)) {
+  const m = /^--(\w+)=(\d+)$/.exec(arg);
+  if (m && m[1] in options) options[m[1]] = parseInt(m[2]);
+  else files.push(arg);
+}
+
+const SYNTHETIC_FRAMES = 100000;
+const RATE_EVENT_EVERY = 5000;  // Un evento Rate intercalado cada N tramas
+const SYNTHETIC_PERIOD_MS = 10; // Paso del tick en las capturas sintéticas
+
+/**
+ * Empaqueta valores de 10 bits LSB primero (inverso de unpackAdc10)
+ */
+function packAdc10(values) {
+  const out = Buffer.alloc(Math.ceil((values.length * 10) / 8));
+  let acc = 0;
+  let bits = 0;
+  let pos = 0;
+  for (const v of values) {
+    acc |= (v & 0x3FF) << bits;
+    bits += 10;
+    while (bits >= 8) {
+      out[pos++] = acc & 0xFF;
+      acc >>>= 8;
+      bits -= 8;
+    }
+  }
+  if (bits > 0) out[pos] = acc & 0xFF;
+  return out;
+}
+
+/**
+ * Evento del micro: [0x55 0xAB][STATUS OK][CMD][LEN][PAYLOAD][CHK]
+ */
+function buildEvent(cmd, payload) {
+  const event = Buffer.alloc(6 + payload.length);
+  event[0] = CMD_HEADER_1;
+  event[1] = RESP_HEADER_2;
+  event[2] = STATUS.OK;
+  event[3] = cmd;
+  event[4] = payload.length;
+  payload.copy(event, 5);
+  let chk = 0;
+  for (let i = 2; i < event.length - 1; i++) chk ^= event[i];
+  event[event.length - 1] = chk;
+  return event;
+}
+
+/**
+ * Genera una captura con el formato indicado, como la enviaría el firmware
+ * @param {string} kind - 'legacy' | 'compact' | 'split' | 'calibrated'
+ * @returns {Buffer}
+ */
+function synthesize(kind) {
+  const n = options.channels;
+  const parts = [];
+  const event = buildEvent(COMMANDS.RATE, Buffer.from([10, 0, 10, 0, 1, 1, 0, 0]));
+
+  for (let i = 0; i < SYNTHETIC_FRAMES; i++) {
+    const tick = (i * SYNTHETIC_PERIOD_MS) & 0xFFFF;
+    const digital = (i >> 4) & 0xFF;
+    const values = [];
+    for (let ch = 0; ch < n; ch++) values.push((i * 7 + ch * 131) & 0x3FF);
+    const tickBytes = Buffer.from([tick & 0xFF, tick >> 8]);
+
+    if (kind === 'legacy') {
+      const frame = Buffer.alloc(FRAME_FORMATS.LEGACY.size);
+      frame[0] = 0x7A;
+      frame[1] = FRAME_FORMATS.LEGACY.header2;
+      frame[2] = digital;
+      for (let ch = 0; ch < 8; ch++) frame.writeUInt16LE(ch < 4 ? values[ch] : values[ch - 4] >> 1, 3 + ch * 2);
+      frame[19] = 0x7C;
+      parts.push(frame);
+    } else if (kind === 'compact') {
+      parts.push(Buffer.from([0x7A, FRAME_FORMATS.COMPACT.header2]), tickBytes,
+        Buffer.from([digital]), packAdc10(values), Buffer.from([0x7C]));
+    } else if (kind === 'calibrated') {
+      const cal = Buffer.alloc(n * 2);
+      values.forEach((v, ch) => cal.writeInt16LE(v * 5 - 2000, ch * 2));
+      parts.push(Buffer.from([0x7A, CALIBRATED_FRAMES.COMPACT.header2]), tickBytes,
+        Buffer.from([digital]), cal, Buffer.from([0x7C]));
+    } else {
+      parts.push(Buffer.from([0x7A, FRAME_FORMATS.SPLIT.header2]), tickBytes,
+        packAdc10(values), Buffer.from([0x7C]));
+      if (i % 4 === 0) parts.push(Buffer.from([0x7A, DIGITAL_FRAME.header2, digital, (i >> 2) & 0xFF, 0x7C]));
+    }
+    if (i % RATE_EVENT_EVERY === 0) parts.push(event);
+  }
+  return Buffer.concat(parts);
+}
+
+/**
+ * Camino anterior de SerialListener.handleData, sin E/S
+ */
+function runLegacyPath(capture, chunk, sink) {
+  let buffer = Buffer.alloc(0);
+  const merger = new SplitFrameMerger();
+  let responses = 0;
+  for (let off = 0; off < capture.length; off += chunk) {
+    buffer = Buffer.concat([buffer, capture.subarray(off, off + chunk)]);
+    let from = 0;
+    let found;
+    while ((found = findResponse(buffer, from)) !== null) {
+      buffer = Buffer.concat([buffer.slice(0, found.start), buffer.slice(found.end)]);
+      from = found.start;
+      responses++;
+    }
+    const { frames, remainder } = findFrames(buffer, options.channels);
+    buffer = remainder;
+    for (const frameBuffer of frames) {
+      let parsed = parseFrame(frameBuffer, options.channels);
+      if (parsed.kind === 'inputs' || parsed.kind === 'address') continue;   // Entradas medidas (0x1C): no son muestras
+      if (parsed.kind !== 'full') {
+        parsed = merger.merge(parsed);
+        if (!parsed) continue;
+      }
+      sink(parsed.digital, parsed.channels);
+    }
+    if (buffer.length > 1000) buffer = Buffer.alloc(0);
+  }
+  return responses;
+}
+
+/**
+ * Decodificador por lotes; con objects=true materializa además cada trama (evento 'frame')
+ */
+function runBatchPath(capture, chunk, sink, objects) {
+  const decoder = new FrameDecoder({ channels: options.channels });
+  let responses = 0;
+  const onResponse = () => {
+    responses++;
+    return false;
+  };
+  for (let off = 0; off < capture.length; off += chunk) {
+    const batch = decoder.push(capture.subarray(off, off + chunk), onResponse);
+    for (let i = 0; i < batch.count; i++) {
+      if (objects) {
+        const frame = batch.toFrame(i);
+        sink(frame.digital, frame.channels);
+      } else {
+        const base = i * batch.stride;
+        const width = batch.format[i] === FRAME_FORMATS.LEGACY.header2 ? 4 : batch.width[i];
+        sink(batch.digital[i], batch.values.subarray(base, base + width));
+      }
+    }
+  }
+  return responses;
+}
+
+/**
+ * true si la captura trae tramas con tick (todas menos la legacy)
+ */
+function hasTicks(capture) {
+  const batch = new FrameDecoder({ channels: options.channels }).push(capture.subarray(0, 4096));
+  for (let i = 0; i < batch.count; i++) if (batch.tick[i] >= 0) return true;
+  return false;
+}
+
+/**
+ * Lotes + UniformResampler a la rejilla del firmware (10 ms); el tick se desenrolla
+ * aquí como haría stampTick, sin ancla al reloj del host
+ */
+function runResamplePath(capture, chunk, sink) {
+  const decoder = new FrameDecoder({ channels: options.channels });
+  const resampler = new UniformResampler(SYNTHETIC_PERIOD_MS);
+  let lastTick = -1;
+  let unwrapped = 0;
+  for (let off = 0; off < capture.length; off += chunk) {
+    const batch = decoder.push(capture.subarray(off, off + chunk));
+    for (let i = 0; i < batch.count; i++) {
+      const tick = batch.tick[i];
+      if (tick < 0) continue; // El remuestreador ignora estas filas
+      unwrapped += lastTick < 0 ? 0 : (tick - lastTick) & 0xFFFF;
+      lastTick = tick;
+      batch.timestamp[i] = unwrapped;
+    }
+    const out = resampler.push(batch);
+    for (let i = 0; i < out.count; i++) {
+      const base = i * out.stride;
+      sink(out.digital[i], out.values.subarray(base, base + out.width));
+    }
+  }
+  return 0;
+}
+
+/**
+ * Ejecuta una variante varias veces y devuelve la mejor tasa y las recolecciones de basura
+ */
+async function measure(label, run, capture) {
+  let frames = 0;
+  let checksum = 0;
+  const sink = (digital, channels) => {
+    frames++;
+    checksum = (checksum + digital) | 0;
+    for (let i = 0; i < channels.length; i++) checksum = (checksum * 31 + channels[i]) | 0;
+  };
+  let gcCount = 0;
+  let gcMs = 0;
+  const observer = new PerformanceObserver((list) => {
+    for (const entry of list.getEntries()) {
+      gcCount++;
+      gcMs += entry.duration;
+    }
+  });
+  observer.observe({ entryTypes: ['gc'] });
+
+  let best = Infinity;
+  let responses = 0;
+  for (let r = 0; r < options.repeat; r++) {
+    frames = 0;
+    checksum = 0;
+    const t0 = process.hrtime.bigint();
+    responses = run(capture, options.chunk, sink);
+    const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+    best = Math.min(best, ms);
+  }
+  await new Promise((resolve) => setTimeout(resolve, 50)); // Las entradas 'gc' llegan diferidas
+  observer.disconnect();
+
+  const mbs = (capture.length / 1e6) / (best / 1000);
+  console.log(`  ${label.padEnd(18)} ${best.toFixed(1).padStart(8)} ms  ${mbs.toFixed(1).padStart(7)} MB/s  ` +
+    `${((frames / best) * 1000 / 1e6).toFixed(2)} Mtramas/s  GC ${gcCount} (${gcMs.toFixed(1)} ms)`);
+  return { frames, checksum, responses };
+}
+
+async function benchCapture(name, capture) {
+  console.log(`\n${name}: ${capture.length} bytes, bloques de ${options.chunk} bytes, ${options.repeat} repeticiones`);
+  const legacy = await measure('concat+parseFrame', runLegacyPath, capture);
+  const objects = await measure('lotes + objetos', (c, k, s) => runBatchPath(c, k, s, true), capture);
+  const columns = await measure('lotes columnares', (c, k, s) => runBatchPath(c, k, s, false), capture);
+  const same = [objects, columns].every((r) =>
+    r.frames === legacy.frames && r.checksum === legacy.checksum && r.responses === legacy.responses);
+  console.log(`  ${legacy.frames} tramas, ${legacy.responses} respuestas/eventos; ` +
+    (same ? 'resultados idénticos' : 'RESULTADOS DISTINTOS'));
+  // Fuera de la comparación: produce puntos de rejilla, no tramas
+  if (options.resample && hasTicks(capture)) await measure('lotes + remuestreo', runResamplePath, capture);
+  return same;
+}
+
+async function main() {
+  const captures = files.length
+    ? files.map((f) => [f, fs.readFileSync(f)])
+    : ['legacy', 'compact', 'split', 'calibrated'].map((k) => [`sintética ${k}`, synthesize(k)]);
+  let ok = true;
+  for (const [name, capture] of captures) {
+    ok = (await benchCapture(name, capture)) && ok;
+  }
+  if (!ok) process.exit(1);
+}
+
+main().catch((error) => {
+  console.error('[Bench] Error:', error.message);
+  process.exit(1);
+});
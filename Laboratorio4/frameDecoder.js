@@ -0,0 +1,370 @@
+/**
+ * Decodificador incremental del flujo serial: tramas de datos + respuestas/eventos
+ * Sustituye en el listener el camino Buffer.concat + findFrames + parseFrame:
+ *   - Los bytes se copian a un buffer de tamaño fijo que solo se compacta cuando
+ *     se llena (lo pendiente es como mucho una trama o respuesta incompleta)
+ *   - Las muestras se devuelven por lotes en columnas de arrays tipados que se
+ *     reutilizan entre llamadas, sin un objeto por trama
+ *   - Las respuestas 55 AB (y 55 AD del bus multipunto) se entregan aparte por
+ *     callback, en el orden del flujo, de modo que un marcador Sync puede descartar
+ *     exactamente lo anterior
+ *   - En el bus cada muestra lleva la dirección de la última marca 0x76 recibida
+ *   - Los canales de las tramas empaquetadas son del decodificador (setChannels),
+ *     no del proceso: cada placa conectada tiene el suyo, y en el bus cada dirección
+ *     (la marca 0x76 cambia también los tamaños de las tramas que siguen)
+ * Admite los mismos formatos que frameParser.js; el formato dividido se combina
+ * aquí con la misma semántica que SplitFrameMerger.
+ */
+
+const {
+  HEADER_1, TAIL, FRAME_FORMATS, CALIBRATED_FRAMES, DIGITAL_FRAME, INPUT_FRAME, ADDRESS_MARK,
+  DEFAULT_CHANNELS, MAX_CHANNELS, validChannels, formatsForChannels, decodeDigital, decodeInputs,
+  deriveAdc
+} = require('./frameParser');
+const {
+  parseResponse, CMD_HEADER_1, RESP_HEADER_2, ADDR_RESP_HEADER_2
+} = require('./commandProtocol');
+
+const DEFAULT_CAPACITY = 4096;  // Bytes; una respuesta ocupa como mucho 261
+const MAX_VALUES = MAX_CHANNELS; // Valores por muestra: máximo de canales / 8 de legacy
+const INITIAL_ROWS = 256;
+
+/**
+ * Lote de muestras en columnas. Cada muestra es una trama completa (en el formato
+ * dividido, la combinación de las dos mitades).
+ * Válido hasta la siguiente llamada a FrameDecoder.push(): copiar lo que se guarde.
+ */
+class SampleBatch {
+  constructor(rows = INITIAL_ROWS) {
+    this.count = 0;
+    this.stride = MAX_VALUES;    // Separación entre muestras en values
+    this.receivedAt = 0;         // Date.now() del bloque recibido
+    this.allocate(rows);
+  }
+
+  allocate(rows) {
+    const grow = (Type, old, width = 1) => {
+      const next = new Type(rows * width);
+      if (old) next.set(old.subarray(0, this.count * width));
+      return next;
+    };
+    this.format = grow(Uint8Array, this.format);        // Segundo byte de cabecera de la trama
+    this.digital = grow(Uint8Array, this.digital);      // DIP (nibble alto) + LEDs (nibble bajo)
+    this.tick = grow(Int32Array, this.tick);            // Tick de 16 bits del micro; -1 sin tick
+    this.seq = grow(Int16Array, this.seq);              // SEQ de la trama digital dividida; -1 si no hay
+    this.address = grow(Int16Array, this.address);      // Placa del bus (marca 0x76); -1 sin dirección
+    this.width = grow(Uint8Array, this.width);          // Valores válidos de la muestra en values
+    this.calibrated = grow(Uint8Array, this.calibrated);
+    this.timestamp = grow(Float64Array, this.timestamp); // Lo rellena el listener (stampTick)
+    this.values = grow(Int32Array, this.values, MAX_VALUES);
+    this.capacity = rows;
+  }
+
+  /**
+   * Reserva la siguiente fila
+   * @returns {number} Índice de la muestra
+   */
+  add() {
+    if (this.count === this.capacity) this.allocate(this.capacity * 2);
+    return this.count++;
+  }
+
+  /**
+   * Construye el mismo objeto que parseFrame/SplitFrameMerger para la muestra i
+   * (consumidores que trabajan por trama)
+   * @param {number} i - Índice de la muestra
+   * @returns {Object} Trama con kind 'full'
+   */
+  toFrame(i) {
+    const base = i * this.stride;
+    const width = this.width[i];
+    const values = new Array(width);
+    for (let k = 0; k < width; k++) values[k] = this.values[base + k];
+    const legacy = this.format[i] === FRAME_FORMATS.LEGACY.header2;
+    const { digital, dipMask, ledMask, din } = decodeDigital(this.digital[i]);
+    const frame = {
+      kind: 'full',
+      digital,
+      dipMask,
+      ledMask,
+      din,
+      adc: legacy ? values : deriveAdc(values),
+      channels: legacy ? values.slice(0, 4) : values,
+      calibrated: this.calibrated[i] === 1,
+      tick: this.tick[i] < 0 ? null : this.tick[i],
+      timestamp: this.timestamp[i]
+    };
+    if (this.seq[i] >= 0) frame.seq = this.seq[i];
+    if (this.address[i] >= 0) frame.address = this.address[i];
+    return frame;
+  }
+}
+
+class FrameDecoder {
+  /**
+   * @param {{capacity?: number, channels?: number}} options - channels: canales de la
+   *   placa (0x0C); se puede cambiar después con setChannels()
+   */
+  constructor({ capacity = DEFAULT_CAPACITY, channels = DEFAULT_CHANNELS } = {}) {
+    this.buf = Buffer.alloc(capacity);
+    this.start = 0;               // Primer byte sin consumir
+    this.end = 0;                 // Fin de los datos válidos
+    this.batch = new SampleBatch();
+    this.inputReports = [];       // Tramas de entradas (0x77) del último push, una por Ts DIP
+    this.currentAddress = -1;     // Última marca de dirección (bus multipunto)
+    this.splitValues = new Int32Array(MAX_VALUES);
+    this.baseChannels = DEFAULT_CHANNELS;  // Sin marca de dirección o dirección sin configurar
+    this.boardChannels = new Map();        // Dirección -> canales (bus multipunto)
+    this.channels = DEFAULT_CHANNELS;      // Vigentes para las tramas que siguen
+    this.formats = formatsForChannels(DEFAULT_CHANNELS);
+    this.setChannels(channels);
+    this.resetMerge();
+  }
+
+  /**
+   * Canales de las tramas empaquetadas de una placa (0x0C byte 2 / 0x11)
+   * @param {number} n - Se ignora si no es válido (ver validChannels)
+   * @param {number|null} address - Placa del bus; null = enlace punto a punto y
+   *   direcciones sin valor propio
+   */
+  setChannels(n, address = null) {
+    if (!validChannels(n)) return;
+    if (address === null) this.baseChannels = n;
+    else this.boardChannels.set(address, n);
+    this.selectBoard();
+  }
+
+  /**
+   * Toma los canales de la placa de la última marca de dirección
+   */
+  selectBoard() {
+    const n = this.boardChannels.get(this.currentAddress) ?? this.baseChannels;
+    if (n === this.channels) return;
+    this.channels = n;
+    this.formats = formatsForChannels(n);
+  }
+
+  /**
+   * Descarta los bytes pendientes (reapertura del puerto)
+   */
+  clear() {
+    this.start = 0;
+    this.end = 0;
+    this.currentAddress = -1;
+    this.selectBoard();
+    this.resetMerge();
+  }
+
+  /**
+   * Olvida el estado del formato dividido (reconexión, Sync o reinicio del micro)
+   */
+  resetMerge() {
+    this.splitDigital = -1;
+    this.splitSeq = -1;
+    this.splitWidth = 0;
+    this.splitCalibrated = 0;
+    this.splitTick = -1;          // Tick de la última analógica
+    this.lostDigital = 0;         // Tramas digitales perdidas según SEQ
+  }
+
+  /**
+   * Procesa un bloque recibido del puerto
+   * @param {Buffer} data - Bytes recibidos
+   * @param {Function} onResponse - Recibe cada respuesta/evento válido; si devuelve
+   *   true se descartan las muestras decodificadas hasta ese punto (marcador Sync)
+   * @returns {SampleBatch} Muestras completas del bloque
+   */
+  push(data, onResponse = null) {
+    const batch = this.batch;
+    batch.count = 0;
+    batch.receivedAt = Date.now();
+    this.inputReports.length = 0;
+    let offset = 0;
+    while (offset < data.length) {
+      offset += this.fill(data, offset);
+      this.scan(onResponse);
+    }
+    return batch;
+  }
+
+  /**
+   * Copia lo que quepa de data al buffer, compactando si hace falta
+   * @returns {number} Bytes copiados
+   */
+  fill(data, offset) {
+    const buf = this.buf;
+    if (this.end + (data.length - offset) > buf.length && this.start > 0) {
+      buf.copyWithin(0, this.start, this.end);
+      this.end -= this.start;
+      this.start = 0;
+    }
+    if (this.end === buf.length) {
+      // Sin avance posible (no ocurre con los tamaños del protocolo): descartar
+      this.start = 0;
+      this.end = 0;
+    }
+    const n = Math.min(data.length - offset, buf.length - this.end);
+    data.copy(buf, this.end, offset, offset + n);
+    this.end += n;
+    return n;
+  }
+
+  /**
+   * Recorre los bytes pendientes una sola vez; se detiene ante una trama o
+   * respuesta incompleta y la retoma con el siguiente bloque
+   */
+  scan(onResponse) {
+    const buf = this.buf;
+    const end = this.end;
+    let pos = this.start;
+
+    while (pos < end) {
+      const b = buf[pos];
+      if (b === HEADER_1) {
+        if (pos + 1 >= end) break;
+        const fmt = this.formats.get(buf[pos + 1]);
+        if (fmt) {
+          if (pos + fmt.size > end) break;
+          if (buf[pos + fmt.size - 1] === TAIL) {
+            this.decodeFrame(fmt, pos);
+            pos += fmt.size;
+            continue;
+          }
+        }
+      } else if (b === CMD_HEADER_1) {
+        if (pos + 1 >= end) break;
+        const h2 = buf[pos + 1];
+        if (h2 === RESP_HEADER_2 || h2 === ADDR_RESP_HEADER_2) {
+          const head = h2 === ADDR_RESP_HEADER_2 ? 6 : 5;   // Hasta LEN inclusive
+          if (pos + head > end) break;
+          const len = buf[pos + head - 1];
+          const size = head + 1 + len;
+          if (pos + size > end) break;
+          let chk = 0;
+          for (let k = pos + 2; k < pos + head + len; k++) chk ^= buf[k];
+          if (chk === buf[pos + head + len]) {
+            // Copia propia: el payload sobrevive a la compactación del buffer
+            const response = parseResponse(Buffer.from(buf.subarray(pos, pos + size)));
+            pos += size;
+            if (onResponse && onResponse(response)) {
+              this.batch.count = 0;
+              this.inputReports.length = 0;
+              this.resetMerge();
+            }
+            continue;
+          }
+        }
+      }
+      pos++; // Byte suelto o cabecera falsa
+    }
+
+    if (pos >= end) {
+      this.start = 0;
+      this.end = 0;
+    } else {
+      this.start = pos;
+    }
+  }
+
+  /**
+   * Lee los canales de una trama empaquetada (10 bits) o calibrada (int16 LE)
+   */
+  readChannels(calibrated, offset, target, base) {
+    const buf = this.buf;
+    const n = this.channels;
+    if (calibrated) {
+      for (let i = 0; i < n; i++) target[base + i] = buf.readInt16LE(offset + i * 2);
+      return n;
+    }
+    let acc = 0;
+    let bits = 0;
+    let pos = offset;
+    for (let i = 0; i < n; i++) {
+      while (bits < 10) {
+        acc |= buf[pos++] << bits;
+        bits += 8;
+      }
+      target[base + i] = acc & 0x3FF;
+      acc >>>= 10;
+      bits -= 10;
+    }
+    return n;
+  }
+
+  decodeFrame(fmt, pos) {
+    const buf = this.buf;
+    const batch = this.batch;
+
+    if (fmt === ADDRESS_MARK) {
+      this.currentAddress = buf[pos + 2];
+      this.selectBoard();
+      return;
+    }
+    if (fmt === INPUT_FRAME) {
+      const report = decodeInputs(buf, pos);
+      if (this.currentAddress >= 0) report.address = this.currentAddress;
+      this.inputReports.push(report);
+      return;
+    }
+    if (fmt === DIGITAL_FRAME) {
+      const seq = buf[pos + 3];
+      if (this.splitSeq >= 0) this.lostDigital += (seq - this.splitSeq - 1) & 0xFF;
+      this.splitSeq = seq;
+      this.splitDigital = buf[pos + 2];
+      this.emitSplit();
+      return;
+    }
+    const h2 = fmt.header2;
+    if (h2 === FRAME_FORMATS.SPLIT.header2 || h2 === CALIBRATED_FRAMES.ANALOG.header2) {
+      const calibrated = fmt.calibrated === true;
+      this.splitWidth = this.readChannels(calibrated, pos + 4, this.splitValues, 0);
+      this.splitCalibrated = calibrated ? 1 : 0;
+      this.splitTick = buf[pos + 2] | (buf[pos + 3] << 8);
+      this.emitSplit();
+      return;
+    }
+
+    const row = batch.add();
+    const base = row * batch.stride;
+    batch.format[row] = fmt.header2;
+    batch.seq[row] = -1;
+    batch.address[row] = this.currentAddress;
+    if (h2 === FRAME_FORMATS.LEGACY.header2) {
+      batch.digital[row] = buf[pos + 2];
+      batch.tick[row] = -1;
+      batch.calibrated[row] = 0;
+      for (let i = 0; i < 8; i++) {
+        batch.values[base + i] = buf[pos + 3 + i * 2] | (buf[pos + 4 + i * 2] << 8);
+      }
+      batch.width[row] = 8;
+      return;
+    }
+    // Compacta (cruda o calibrada)
+    const calibrated = fmt.calibrated === true;
+    batch.digital[row] = buf[pos + 4];
+    batch.tick[row] = buf[pos + 2] | (buf[pos + 3] << 8);
+    batch.calibrated[row] = calibrated ? 1 : 0;
+    batch.width[row] = this.readChannels(calibrated, pos + 5, batch.values, base);
+  }
+
+  /**
+   * Formato dividido: emite una muestra cuando se conocen ambas mitades, con el
+   * tick de la última analógica (una digital no lleva el suyo y no debe volver
+   * a la hora de llegada, que iría detrás de las filas con tick)
+   */
+  emitSplit() {
+    if (this.splitDigital < 0 || this.splitWidth === 0) return;
+    const batch = this.batch;
+    const row = batch.add();
+    batch.format[row] = FRAME_FORMATS.SPLIT.header2;
+    batch.digital[row] = this.splitDigital;
+    batch.tick[row] = this.splitTick;
+    batch.seq[row] = this.splitSeq;
+    batch.address[row] = this.currentAddress;
+    batch.calibrated[row] = this.splitCalibrated;
+    batch.width[row] = this.splitWidth;
+    batch.values.set(this.splitValues.subarray(0, this.splitWidth), row * batch.stride);
+  }
+}
+
+module.exports = { FrameDecoder, SampleBatch };
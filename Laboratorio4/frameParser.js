@@ -1,45 +1,192 @@
 /**
  * Módulo de parseo de protocolo binario de comunicación
- * Procesa tramas de 20 bytes con datos digitales y analógicos
- * Protocolo: [Header][Digital][8xADC][Tail]
+ * Procesa tramas con datos digitales y analógicos en los formatos del firmware:
+ *   0 legacy   (20 bytes): [0x7A 0x7B][Digital][8xADC LE][0x7C]
+ *   1 compacta (11 bytes): [0x7A 0x7D][Tick LE][Digital][Nx ADC 10 bits][0x7C]
+ *   2 dividida: analógica (10 bytes) [0x7A 0x7E][Tick LE][Nx ADC 10 bits][0x7C]
+ *               digital   (5 bytes)  [0x7A 0x7F][Digital][Seq][0x7C]
+ * Con salida calibrada (0x12) la compacta y la analógica llevan cada canal como
+ * int16 LE en la unidad de su tabla (0x13):
+ *   compacta calibrada  (14 bytes): [0x7A 0x79][Tick LE][Digital][Nx int16][0x7C]
+ *   analógica calibrada (13 bytes): [0x7A 0x78][Tick LE][Nx int16][0x7C]
+ * Con alguna entrada DIP en modo contador/período (0x1C) llega además, una por Ts DIP:
+ *   entradas (22 bytes): [0x7A 0x77][Tick LE][Modos][4x uint32 LE][0x7C]
+ * Con cabeceras direccionadas (bus multipunto, 0x21) las tramas de cada placa van
+ * precedidas de su marca de dirección, válida hasta la siguiente marca:
+ *   dirección (4 bytes): [0x7A 0x76][Addr][0x7C]
+ * Los tamaños indicados son para N = 4 canales; con más canales (0x0C/0x11) las
+ * tramas empaquetadas crecen. N es de cada placa: cada decodificador o llamada lleva
+ * el suyo y toma los tamaños de formatsForChannels(N).
  */
 
-const FRAME_SIZE = 20;
+const FRAME_SIZE = 20; // Tamaño de la trama legacy
 const HEADER_1 = 0x7A;
-const HEADER_2 = 0x7B;
 const TAIL = 0x7C;
 
+// Formatos de trama soportados por este host (id = número de formato del firmware);
+// tamaños para DEFAULT_CHANNELS, los de otro N salen de formatsForChannels()
+const FRAME_FORMATS = {
+  LEGACY: { id: 0, header2: 0x7B, size: 20 },
+  COMPACT: { id: 1, header2: 0x7D, size: 11, overhead: 6 },
+  SPLIT: { id: 2, header2: 0x7E, size: 10, overhead: 5 }   // Trama analógica del formato dividido
+};
+
+// Variantes calibradas (no son formatos propios: 0x12 las activa sobre 1 y 2)
+const CALIBRATED_FRAMES = {
+  COMPACT: { header2: 0x79, size: 14, overhead: 6, calibrated: true },
+  ANALOG: { header2: 0x78, size: 13, overhead: 5, calibrated: true }
+};
+
+// Canales analógicos en las tramas empaquetadas (el firmware por defecto envía 4)
+const DEFAULT_CHANNELS = 4;
+const MAX_CHANNELS = 16;
+
+// Trama digital del formato dividido
+const DIGITAL_FRAME = { header2: 0x7F, size: 5 };
+
+// Trama de entradas medidas (0x1C): no es una muestra, va aparte de los lotes
+const INPUT_FRAME = { header2: 0x77, size: 22 };
+const INPUT_MODES = { LEVEL: 0, COUNT: 1, PERIOD: 2 };
+
+// Marca de dirección del bus multipunto: no es una muestra, fija la placa de las siguientes
+const ADDRESS_MARK = { header2: 0x76, size: 4 };
+
+// Orden de preferencia: la compacta (una trama coherente con tick) primero; el
+// dividido ahorra bytes con DIP lentos pero combina mitades, se pide a mano con 0x0D
+const FORMAT_PREFERENCE = [FRAME_FORMATS.COMPACT, FRAME_FORMATS.SPLIT, FRAME_FORMATS.LEGACY];
+
+/**
+ * @param {number} n - Canales anunciados en 0x0C (byte 2) / 0x11
+ * @returns {boolean} true si las tramas empaquetadas admiten n canales
+ */
+function validChannels(n) {
+  return Number.isInteger(n) && n >= DEFAULT_CHANNELS && n <= MAX_CHANNELS;
+}
+
+// Tablas por número de canales: se arman una vez y se comparten (solo lectura)
+const formatsByChannels = new Map();
+
+/**
+ * Búsqueda por segundo byte de cabecera con los tamaños de n canales. Las tramas
+ * empaquetadas y calibradas son copias de FRAME_FORMATS/CALIBRATED_FRAMES con su
+ * size; las que no dependen de n son los mismos objetos
+ * @param {number} n - Canales de la placa (validChannels)
+ * @returns {Map<number, Object>} header2 -> descriptor
+ */
+function formatsForChannels(n) {
+  let formats = formatsByChannels.get(n);
+  if (formats) return formats;
+  const packed = (fmt) => (fmt.overhead === undefined ? fmt
+    : { ...fmt, size: fmt.overhead + Math.ceil((n * 10) / 8) });
+  const calibrated = (fmt) => ({ ...fmt, size: fmt.overhead + 2 * n });
+  formats = new Map(
+    [...Object.values(FRAME_FORMATS).map(packed), ...Object.values(CALIBRATED_FRAMES).map(calibrated),
+      DIGITAL_FRAME, INPUT_FRAME, ADDRESS_MARK]
+      .map((f) => [f.header2, f])
+  );
+  formatsByChannels.set(n, formats);
+  return formats;
+}
+
+// Búsqueda rápida por segundo byte de cabecera (DEFAULT_CHANNELS)
+const FORMAT_BY_HEADER = formatsForChannels(DEFAULT_CHANNELS);
+
+/**
+ * @param {Object} fmt - Descriptor de FRAME_FORMATS, CALIBRATED_FRAMES u otra trama
+ * @param {number} n - Canales de la placa
+ * @returns {number} Bytes de la trama con n canales
+ */
+function frameSize(fmt, n = DEFAULT_CHANNELS) {
+  return formatsForChannels(n).get(fmt.header2).size;
+}
+
+/**
+ * Elige el formato más compacto soportado por firmware y host
+ * @param {number} formatsMask - Bit n = formato n soportado por el firmware
+ * @returns {Object} Descriptor de FRAME_FORMATS
+ */
+function chooseFrameFormat(formatsMask) {
+  for (const fmt of FORMAT_PREFERENCE) {
+    if (formatsMask & (1 << fmt.id)) return fmt;
+  }
+  return FRAME_FORMATS.LEGACY;
+}
+
 /**
  * Valida que una trama tenga la estructura correcta
- * @param {Buffer} frame - Buffer de 20 bytes
+ * @param {Buffer} frame - Buffer con una trama completa de cualquier formato conocido
+ * @param {number} channels - Canales de la placa que la envió
  * @returns {boolean}
  */
-function validateFrame(frame) {
-  if (!Buffer.isBuffer(frame) || frame.length !== FRAME_SIZE) {
+function validateFrame(frame, channels = DEFAULT_CHANNELS) {
+  if (!Buffer.isBuffer(frame) || frame.length < 2 || frame[0] !== HEADER_1) {
     return false;
   }
 
-  // Verificar header y tail
-  if (frame[0] !== HEADER_1 || frame[1] !== HEADER_2 || frame[19] !== TAIL) {
+  const fmt = formatsForChannels(channels).get(frame[1]);
+  if (!fmt || frame.length !== fmt.size) {
     return false;
   }
 
-  return true;
+  // Verificar tail
+  return frame[fmt.size - 1] === TAIL;
 }
 
 /**
- * Parsea una trama válida y extrae los datos
- * @param {Buffer} frame - Buffer de 20 bytes válido
- * @returns {Object} Objeto con digital y array de 8 valores ADC
+ * Desempaqueta n valores de 10 bits (LSB primero)
+ * @param {Buffer} buf - Buffer origen
+ * @param {number} offset - Offset del primer byte empaquetado
+ * @param {number} n - Cantidad de valores
+ * @returns {Array<number>}
  */
-function parseFrame(frame) {
-  if (!validateFrame(frame)) {
-    throw new Error('Trama inválida');
+function unpackAdc10(buf, offset, n) {
+  const values = [];
+  let acc = 0;
+  let bits = 0;
+  let pos = offset;
+  for (let i = 0; i < n; i++) {
+    while (bits < 10) {
+      acc |= buf[pos++] << bits;
+      bits += 8;
+    }
+    values.push(acc & 0x3FF);
+    acc >>>= 10;
+    bits -= 10;
   }
+  return values;
+}
 
-  // Byte digital (posición 2)
-  const digital = frame[2];
+/**
+ * Lee n valores int16 Little Endian consecutivos (canales calibrados)
+ * @param {Buffer} buf - Buffer origen
+ * @param {number} offset - Offset del primer valor
+ * @param {number} n - Cantidad de valores
+ * @returns {Array<number>}
+ */
+function readCalibrated(buf, offset, n) {
+  const values = [];
+  for (let i = 0; i < n; i++) {
+    values.push(buf.readInt16LE(offset + i * 2));
+  }
+  return values;
+}
+
+/**
+ * Arma AN0..AN7 a partir de los canales 0..3 (AN4..AN7 = ANi/2, como el firmware)
+ * @param {Array<number>} channels - Lecturas en orden de trama (cuentas o calibradas)
+ * @returns {Array<number>}
+ */
+function deriveAdc(channels) {
+  const phys = channels.slice(0, 4);
+  return [...phys, ...phys.map((v) => Math.trunc(v / 2))];
+}
 
+/**
+ * Decodifica el byte digital común a todos los formatos
+ * @param {number} digital - Nibble alto = DIP, nibble bajo = LEDs
+ * @returns {{digital: number, dipMask: number, ledMask: number, din: Array<number>}}
+ */
+function decodeDigital(digital) {
   // Extraer DIP (nibble alto) y LEDs (nibble bajo)
   const dipMask = (digital >> 4) & 0x0F;  // Bits 7-4: DIP3..DIP0
   const ledMask = digital & 0x0F;          // Bits 3-0: LED3..LED0
@@ -52,37 +199,183 @@ function parseFrame(frame) {
     (dipMask & 0x08) ? 1 : 0   // DIN3 = bit 3
   ];
 
-  // Parsear 8 valores ADC (16 bits Little Endian cada uno)
-  const adc = [];
-  for (let i = 0; i < 8; i++) {
-    const lowByte = frame[3 + i * 2];
-    const highByte = frame[4 + i * 2];
-    // Little Endian: byte bajo primero
-    const value = lowByte | (highByte << 8);
-    adc.push(value);
+  return { digital, dipMask, ledMask, din };
+}
+
+/**
+ * Decodifica la trama de entradas medidas (0x77)
+ * @param {Buffer} buf - Buffer que contiene la trama
+ * @param {number} offset - Posición del 0x7A
+ * @returns {{tick: number, inputs: Array<{mode: number, level?: number, count?: number,
+ *   periodUs?: number, frequencyHz?: number}>}} periodUs/frequencyHz = 0 si en el
+ *   intervalo no se completó ningún período
+ */
+function decodeInputs(buf, offset) {
+  const modes = buf[offset + 4];
+  const inputs = [];
+  for (let i = 0; i < 4; i++) {
+    const mode = (modes >> (2 * i)) & 0x03;
+    const value = buf.readUInt32LE(offset + 5 + 4 * i);
+    if (mode === INPUT_MODES.COUNT) inputs.push({ mode, count: value });
+    else if (mode === INPUT_MODES.PERIOD) inputs.push({ mode, periodUs: value, frequencyHz: value ? 1e6 / value : 0 });
+    else inputs.push({ mode, level: value });
+  }
+  return { tick: buf[offset + 2] | (buf[offset + 3] << 8), inputs };
+}
+
+/**
+ * Parsea una trama válida y extrae los datos
+ * @param {Buffer} frame - Trama completa válida (legacy, compacta o parte de la dividida)
+ * @param {number} channelCount - Canales de la placa que la envió
+ * @returns {Object} Objeto con digital y array de 8 valores ADC. En el formato
+ *   dividido devuelve solo la parte presente (kind 'analog' o 'digital');
+ *   SplitFrameMerger la combina en una trama completa. La marca de dirección
+ *   devuelve kind 'address'
+ */
+function parseFrame(frame, channelCount = DEFAULT_CHANNELS) {
+  if (!validateFrame(frame, channelCount)) {
+    throw new Error('Trama inválida');
+  }
+
+  const timestamp = Date.now();
+  if (frame[1] === DIGITAL_FRAME.header2) {
+    return { kind: 'digital', ...decodeDigital(frame[2]), seq: frame[3], adc: null, tick: null, timestamp };
+  }
+  if (frame[1] === INPUT_FRAME.header2) {
+    return { kind: 'inputs', ...decodeInputs(frame, 0), timestamp };
+  }
+  if (frame[1] === ADDRESS_MARK.header2) {
+    return { kind: 'address', address: frame[2], timestamp };
+  }
+  const calibrated = FORMAT_BY_HEADER.get(frame[1]).calibrated === true;
+  if (frame[1] === FRAME_FORMATS.SPLIT.header2 || frame[1] === CALIBRATED_FRAMES.ANALOG.header2) {
+    const channels = calibrated
+      ? readCalibrated(frame, 4, channelCount)
+      : unpackAdc10(frame, 4, channelCount);
+    return {
+      kind: 'analog',
+      adc: deriveAdc(channels),
+      channels,
+      calibrated,
+      tick: frame[2] | (frame[3] << 8),
+      timestamp
+    };
+  }
+
+  const compact = calibrated || frame[1] === FRAME_FORMATS.COMPACT.header2;
+
+  // Byte digital (posición 2 en legacy, 4 en compacta)
+  const { digital, dipMask, ledMask, din } = decodeDigital(compact ? frame[4] : frame[2]);
+
+  let adc;
+  let channels;
+  let tick = null;
+  if (compact) {
+    // Canales a 10 bits (o int16 calibrados); AN4..AN7 se derivan como en el firmware (ANi/2)
+    tick = frame[2] | (frame[3] << 8);
+    channels = calibrated
+      ? readCalibrated(frame, 5, channelCount)
+      : unpackAdc10(frame, 5, channelCount);
+    adc = deriveAdc(channels);
+  } else {
+    // Parsear 8 valores ADC (16 bits Little Endian cada uno)
+    adc = [];
+    for (let i = 0; i < 8; i++) {
+      const lowByte = frame[3 + i * 2];
+      const highByte = frame[4 + i * 2];
+      // Little Endian: byte bajo primero
+      const value = lowByte | (highByte << 8);
+      adc.push(value);
+    }
+    channels = adc.slice(0, 4);
   }
 
   return {
+    kind: 'full',
     digital,      // Byte completo
     dipMask,      // Nibble alto (DIP switches)
     ledMask,      // Nibble bajo (LEDs)
     din,          // Array de 4 bits individuales [DIN0, DIN1, DIN2, DIN3]
-    adc,          // Array de 8 valores uint16 [AN0-AN7]
-    timestamp: Date.now()
+    adc,          // Array de 8 valores [AN0-AN7] (cuentas, o unidades de 0x13 si calibrated)
+    channels,     // Todos los canales en orden de trama (0x11)
+    calibrated,   // true = valores en la unidad de la tabla de cada canal (0x12)
+    tick,         // ms del muestreo en el micro (16 bits) o null en legacy
+    timestamp
   };
 }
 
+/**
+ * Combina las tramas analógica y digital del formato dividido en el mismo objeto
+ * que parseFrame devuelve para legacy/compacta. Cada parte actualiza su mitad del
+ * estado; no se emite nada hasta conocer ambas.
+ */
+class SplitFrameMerger {
+  constructor() {
+    this.reset();
+  }
+
+  /**
+   * Olvida el estado (reconexión, Sync o reinicio del micro)
+   */
+  reset() {
+    this.digitalState = null;
+    this.adc = null;
+    this.channels = null;
+    this.calibrated = false;
+    this.seq = null;
+    this.tick = null;       // Tick de la última analógica
+    this.lostDigital = 0;   // Tramas digitales perdidas según SEQ
+  }
+
+  /**
+   * @param {Object} part - Resultado de parseFrame con kind 'analog' o 'digital'
+   * @returns {Object|null} Trama completa (kind 'full') o null si falta una mitad
+   */
+  merge(part) {
+    if (part.kind === 'digital') {
+      if (this.seq !== null) {
+        this.lostDigital += (part.seq - this.seq - 1) & 0xFF;
+      }
+      this.seq = part.seq;
+      this.digitalState = part;
+    } else {
+      this.adc = part.adc;
+      this.channels = part.channels;
+      this.calibrated = part.calibrated;
+      this.tick = part.tick;
+    }
+    if (!this.digitalState || !this.adc) return null;
+
+    const { digital, dipMask, ledMask, din } = this.digitalState;
+    return {
+      kind: 'full',
+      digital,
+      dipMask,
+      ledMask,
+      din,
+      adc: this.adc.slice(),
+      channels: this.channels.slice(),
+      calibrated: this.calibrated,
+      tick: this.tick,          // Solo la analógica lleva tick: la digital hereda el último
+      seq: this.seq,
+      timestamp: part.timestamp
+    };
+  }
+}
+
 /**
  * Busca y extrae tramas completas de un buffer acumulativo
  * @param {Buffer} buffer - Buffer acumulativo con datos seriales
+ * @param {number} channels - Canales de la placa (tamaño de las tramas empaquetadas)
  * @returns {Array<{frame: Buffer, remainder: Buffer}>}
  */
-function findFrames(buffer) {
+function findFrames(buffer, channels = DEFAULT_CHANNELS) {
+  const formats = formatsForChannels(channels);
   const frames = [];
   let offset = 0;
 
   while (offset < buffer.length) {
-    // Buscar inicio de trama (0x7A 0x7B)
+    // Buscar inicio de trama (0x7A + byte de formato)
     const headerIndex = buffer.indexOf(HEADER_1, offset);
     
     if (headerIndex === -1 || headerIndex + 1 >= buffer.length) {
@@ -90,26 +383,24 @@ function findFrames(buffer) {
       break;
     }
 
-    // Verificar segundo byte del header
-    if (buffer[headerIndex + 1] !== HEADER_2) {
+    // Verificar segundo byte del header (identifica el formato)
+    const fmt = formats.get(buffer[headerIndex + 1]);
+    if (!fmt) {
       offset = headerIndex + 1;
       continue;
     }
 
     // Verificar que haya suficientes bytes para una trama completa
-    if (headerIndex + FRAME_SIZE > buffer.length) {
+    if (headerIndex + fmt.size > buffer.length) {
       // Trama incompleta, guardar desde el header
       offset = headerIndex;
       break;
     }
 
-    // Extraer posible trama
-    const possibleFrame = buffer.slice(headerIndex, headerIndex + FRAME_SIZE);
-
     // Validar tail
-    if (possibleFrame[19] === TAIL) {
-      frames.push(possibleFrame);
-      offset = headerIndex + FRAME_SIZE;
+    if (buffer[headerIndex + fmt.size - 1] === TAIL) {
+      frames.push(buffer.slice(headerIndex, headerIndex + fmt.size));
+      offset = headerIndex + fmt.size;
     } else {
       // Header falso, continuar buscando
       offset = headerIndex + 1;
@@ -124,6 +415,26 @@ function findFrames(buffer) {
 
 module.exports = {
   FRAME_SIZE,
+  HEADER_1,
+  TAIL,
+  FRAME_FORMATS,
+  DIGITAL_FRAME,
+  INPUT_FRAME,
+  INPUT_MODES,
+  ADDRESS_MARK,
+  CALIBRATED_FRAMES,
+  FORMAT_BY_HEADER,
+  DEFAULT_CHANNELS,
+  MAX_CHANNELS,
+  SplitFrameMerger,
+  validChannels,
+  formatsForChannels,
+  frameSize,
+  chooseFrameFormat,
+  unpackAdc10,
+  decodeDigital,
+  decodeInputs,
+  deriveAdc,
   validateFrame,
   parseFrame,
   findFrames
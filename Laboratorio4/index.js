@@ -2,6 +2,8 @@ require('dotenv').config();
 const SerialListener = require('./serialListener');
 const DatabaseConnection = require('./dbConnection');
 const { insertFrameData, formatDataForLog } = require('./dataInserter');
+const { RollupWriter } = require('./rollupWriter');
+const { LatencyTracer, now } = require('./latencyTracer');
 const { createWebSocketServer } = require('./wsServer');
 const IntProcesoData = require('./api/IntProcesoData');
 const IntProcesoRefs = require('./api/IntProcesoRefs');
@@ -17,7 +19,11 @@ const config = {
   serial: {
     port: process.env.SERIAL_PORT || 'COM2',
     baudRate: parseInt(process.env.SERIAL_BAUDRATE) || 115200,
-    reconnectDelay: parseInt(process.env.SERIAL_RECONNECT_DELAY) || 3000
+    reconnectDelay: parseInt(process.env.SERIAL_RECONNECT_DELAY) || 3000,
+    calibratedOutput: process.env.SERIAL_CALIBRATED === '1',
+    // Modo de DIP0..DIP3 (0x1C): 0 = nivel, 1 = contador, 2 = período; vacío = no tocar
+    inputModes: process.env.DIP_INPUT_MODES ? process.env.DIP_INPUT_MODES.split(',').map((m) => parseInt(m) || 0) : null,
+    captureFile: process.env.SERIAL_CAPTURE || null   // Bytes crudos para decoderBench.js
   },
   database: {
     host: process.env.DB_HOST || 'localhost',
@@ -48,10 +54,15 @@ let lastDoutValues = { 0: -1, 1: -1, 2: -1, 3: -1 }; // Últimos valores conocid
 const serialListener = new SerialListener(
   config.serial.port,
   config.serial.baudRate,
-  config.serial.reconnectDelay
+  config.serial.reconnectDelay,
+  config.serial.calibratedOutput
 );
 
 const db = new DatabaseConnection(config.database);
+const rollups = new RollupWriter(db, parseInt(process.env.ROLLUP_FLUSH_MS) || 1000);
+const tracer = process.env.LATENCY_TRACE === '0' ? null : new LatencyTracer();
+serialListener.tracer = tracer;
+serialListener.inputModes = config.serial.inputModes;
 
 /**
  * Obtiene el tiempo relativo desde el inicio del sistema
@@ -113,11 +124,15 @@ async function handleFrame(parsedData) {
   // Calcular tiempo relativo en milisegundos
   const relativeTime = getRelativeTime();
 
+  // Canal en vivo a los clientes WS antes de la BD: la persistencia sigue en paralelo
+  if (wsServer) wsServer.publishFrame(parsedData, relativeTime);
+
   // Insertar datos en la base de datos
-  const success = await insertFrameData(db, parsedData, relativeTime, config.variables);
+  const success = await insertFrameData(db, parsedData, relativeTime, config.variables, rollups);
 
   if (success) {
     frameCount++;
+    if (tracer && parsedData.decodedAt) tracer.record('decode_db', now() - parsedData.decodedAt);
     
     // Log cada 50 tramas
     if (frameCount % 50 === 0) {
@@ -151,7 +166,7 @@ async function initialize() {
 
   // Iniciar servidor WebSocket (solo WS, los estáticos los sirve Apache)
   console.log('[App] Iniciando servidor WebSocket...');
-  wsServer = createWebSocketServer(config.websocket.port, getRelativeTime);
+  wsServer = createWebSocketServer(config.websocket.port, getRelativeTime, tracer);
   if (wsServer.events) {
     wsServer.events.on('listening', ({ port }) => {
       console.log(`[WS] Servidor WebSocket escuchando en ws://localhost:${port}`);
@@ -162,6 +177,7 @@ async function initialize() {
   // Conectar a la base de datos
   console.log('[App] Conectando a la base de datos...');
   await db.connect();
+  rollups.start();
 
   // Eventos del serial listener
   serialListener.on('connected', () => {
@@ -169,6 +185,9 @@ async function initialize() {
   });
 
   serialListener.on('frame', handleFrame);
+  serialListener.on('inputs', (report) => {
+    if (wsServer) wsServer.publishInputs(report);
+  });
 
   // Confirmar cuando el streaming esté activo
   setTimeout(() => {
@@ -190,6 +209,10 @@ async function initialize() {
     console.error('[App] Error en base de datos:', error.message);
   });
 
+  if (config.serial.captureFile) {
+    serialListener.startCapture(config.serial.captureFile);
+  }
+
   // Abrir puerto serial
   console.log('[App] Abriendo puerto serial...');
   await serialListener.open();
@@ -204,6 +227,7 @@ async function initialize() {
     if (frameCount > 0 || errorCount > 0) {
       const successRate = ((frameCount / (frameCount + errorCount)) * 100).toFixed(2);
       console.log(`[Stats] Tramas: ${frameCount} | Errores: ${errorCount} | Tasa de éxito: ${successRate}%`);
+      if (tracer) tracer.format().forEach((line) => console.log(`[Latencia] ${line}`));
     }
   }, 30000);
 }
@@ -233,6 +257,7 @@ async function shutdown() {
   }
   
   await serialListener.close();
+  await rollups.stop();
   await db.close();
   if (wsServer) {
     await wsServer.stopServer();
@@ -0,0 +1,146 @@
+const { performance } = require('perf_hooks');
+
+/**
+ * Latencia por etapa de una muestra, desde el tick del micro hasta que el
+ * navegador la dibuja
+ * Cada etapa acumula un histograma de buckets fijos (sin guardar muestras), así
+ * que registrar cuesta lo mismo a cualquier tasa. Etapas:
+ *   tick_rx        llegada al host - hora de muestreo (tick); sobre el menor retardo
+ *                  observado, que es el ancla de stampTick
+ *   rx_decode      decodificación del bloque recibido (FrameDecoder.push)
+ *   decode_ws      envío por el canal en vivo - fin de la decodificación
+ *   decode_db      commit en la BD - fin de la decodificación
+ *   ws_browser     recepción en el navegador - envío WS (relojes sincronizados con ping/pong)
+ *   browser_render dibujo en el navegador - recepción
+ *   tick_render    dibujo en el navegador - hora de muestreo (extremo a extremo)
+ */
+
+// Límites superiores de los buckets en ms; el último bucket no tiene límite
+const BUCKET_BOUNDS_MS = [0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000];
+const STAGES = ['tick_rx', 'rx_decode', 'decode_ws', 'decode_db', 'ws_browser', 'browser_render', 'tick_render'];
+const SENT_SLOTS = 256;   // Envíos recordados para emparejar los reportes del navegador
+
+/**
+ * Hora del host en ms (época Unix) con resolución de microsegundos
+ */
+function now() {
+  return performance.timeOrigin + performance.now();
+}
+
+class LatencyHistogram {
+  constructor() {
+    this.reset();
+  }
+
+  reset() {
+    this.buckets = new Uint32Array(BUCKET_BOUNDS_MS.length + 1);
+    this.count = 0;
+    this.sum = 0;
+    this.max = 0;
+  }
+
+  record(ms) {
+    if (!(ms >= 0)) ms = 0;   // Relojes sincronizados: pequeñas diferencias negativas
+    let i = 0;
+    while (i < BUCKET_BOUNDS_MS.length && ms > BUCKET_BOUNDS_MS[i]) i++;
+    this.buckets[i]++;
+    this.count++;
+    this.sum += ms;
+    if (ms > this.max) this.max = ms;
+  }
+
+  /**
+   * Percentil aproximado: límite superior del bucket que lo contiene
+   * @param {number} p - Entre 0 y 1
+   */
+  percentile(p) {
+    if (this.count === 0) return 0;
+    const target = Math.ceil(this.count * p);
+    let seen = 0;
+    for (let i = 0; i < this.buckets.length; i++) {
+      seen += this.buckets[i];
+      if (seen >= target) return i < BUCKET_BOUNDS_MS.length ? Math.min(BUCKET_BOUNDS_MS[i], this.max) : this.max;
+    }
+    return this.max;
+  }
+
+  snapshot() {
+    return {
+      count: this.count,
+      avg: this.count ? this.sum / this.count : 0,
+      p50: this.percentile(0.5),
+      p99: this.percentile(0.99),
+      max: this.max,
+      buckets: Array.from(this.buckets)
+    };
+  }
+}
+
+class LatencyTracer {
+  constructor() {
+    this.stages = new Map(STAGES.map((s) => [s, new LatencyHistogram()]));
+    // Envíos del canal en vivo por SEQ: [seq, hora de envío, hora de muestreo]
+    this.sentSeq = new Int32Array(SENT_SLOTS).fill(-1);
+    this.sentAt = new Float64Array(SENT_SLOTS);
+    this.sampledAt = new Float64Array(SENT_SLOTS);
+  }
+
+  record(stage, ms) {
+    const hist = this.stages.get(stage);
+    if (hist) hist.record(ms);
+  }
+
+  /**
+   * Registra un envío del canal en vivo para emparejarlo con el reporte del navegador
+   */
+  noteSend(seq, sentAt, sampledAt) {
+    const slot = seq % SENT_SLOTS;
+    this.sentSeq[slot] = seq | 0;
+    this.sentAt[slot] = sentAt;
+    this.sampledAt[slot] = sampledAt;
+  }
+
+  /**
+   * Reporte del navegador: { seq, rxAt, renderAt } ya en el reloj del host
+   * @returns {boolean} false si el SEQ no corresponde a un envío reciente
+   */
+  onBrowserReport({ seq, rxAt, renderAt }) {
+    if (typeof seq !== 'number' || typeof rxAt !== 'number' || typeof renderAt !== 'number') return false;
+    const slot = seq % SENT_SLOTS;
+    if (this.sentSeq[slot] !== (seq | 0)) return false;
+    this.record('ws_browser', rxAt - this.sentAt[slot]);
+    this.record('browser_render', renderAt - rxAt);
+    if (this.sampledAt[slot] > 0) this.record('tick_render', renderAt - this.sampledAt[slot]);
+    this.sentSeq[slot] = -1;
+    return true;
+  }
+
+  /**
+   * @returns {Object} Etapa -> { count, avg, p50, p99, max, buckets }
+   */
+  snapshot() {
+    const stages = {};
+    for (const [name, hist] of this.stages) stages[name] = hist.snapshot();
+    return { bucketBoundsMs: BUCKET_BOUNDS_MS, stages };
+  }
+
+  /**
+   * Resumen de una línea por etapa con datos, para el log de estadísticas
+   */
+  format() {
+    const lines = [];
+    for (const [name, hist] of this.stages) {
+      if (hist.count === 0) continue;
+      const s = hist.snapshot();
+      lines.push(`${name.padEnd(14)} n=${s.count} prom=${s.avg.toFixed(2)}ms p50<=${+s.p50.toFixed(2)}ms ` +
+        `p99<=${+s.p99.toFixed(2)}ms máx=${s.max.toFixed(1)}ms`);
+    }
+    return lines;
+  }
+
+  reset() {
+    for (const hist of this.stages.values()) hist.reset();
+  }
+}
+
+module.exports = { LatencyTracer, LatencyHistogram, STAGES, now };
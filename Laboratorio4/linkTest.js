@@ -0,0 +1,220 @@
+require('dotenv').config();
+const { SerialPort } = require('serialport');
+const crypto = require('crypto');
+const {
+  streamingEnable, sync, linkTest, parseLinkResult, findResponse, COMMANDS
+} = require('./commandProtocol');
+
+/**
+ * Prueba de capacidad y errores del enlace serial (BERT) contra el firmware (0x18/0x19)
+ * Uso: node linkTest.js [puerto] [baudios] [bytes]
+ *   MCU -> PC: el micro envía N bytes PRBS-15 a tasa de línea; el host los verifica
+ *   PC -> MCU: el host envía N bytes PRBS-15; el micro los verifica y reporta
+ * Con ambos resultados se distingue si las pérdidas vienen del cable/puente USB,
+ * de la tasa de baudios o del propio host.
+ */
+
+const READY_WAIT_MS = 2500;   // El UNO se resetea al abrir el puerto
+const RESULT_MARGIN_MS = 3000;
+
+const config = {
+  port: process.argv[2] || process.env.SERIAL_PORT || 'COM2',
+  baudRate: parseInt(process.argv[3]) || parseInt(process.env.SERIAL_BAUDRATE) || 115200,
+  bytes: parseInt(process.argv[4]) || 20000
+};
+
+/**
+ * Generador PRBS-15 (x^15 + x^14 + 1), bits MSB primero, igual que el firmware
+ * @param {number} count - Bytes a generar
+ * @returns {Buffer}
+ */
+function prbs15(count) {
+  const out = Buffer.alloc(count);
+  let s = 0x7FFF;
+  for (let i = 0; i < count; i++) {
+    let v = 0;
+    for (let k = 0; k < 8; k++) {
+      const b = ((s >> 14) ^ (s >> 13)) & 1;
+      s = ((s << 1) | b) & 0x7FFF;
+      v = (v << 1) | b;
+    }
+    out[i] = v;
+  }
+  return out;
+}
+
+/**
+ * Verificador autosincronizante: predice cada bit con los 15 anteriores recibidos
+ * @param {Buffer} data - Bytes recibidos
+ * @returns {number} Bytes con al menos un bit distinto del predicho
+ */
+function prbs15Errors(data) {
+  let reg = 0;
+  let fill = 0;
+  let errors = 0;
+  for (const v of data) {
+    let err = false;
+    for (let i = 7; i >= 0; i--) {
+      const b = (v >> i) & 1;
+      if (fill >= 15) {
+        if ((((reg >> 14) ^ (reg >> 13)) & 1) !== b) err = true;
+      } else {
+        fill++;
+      }
+      reg = ((reg << 1) | b) & 0x7FFF;
+    }
+    if (err) errors++;
+  }
+  return errors;
+}
+
+/**
+ * Lector acumulativo sobre el puerto: permite esperar respuestas o N bytes crudos
+ */
+class PortReader {
+  constructor(port) {
+    this.buffer = Buffer.alloc(0);
+    this.waiter = null;
+    this.firstAt = null;   // hrtime del primer byte tras el último reset()
+    this.lastAt = null;
+    port.on('data', (data) => {
+      const now = process.hrtime.bigint();
+      if (this.firstAt === null) this.firstAt = now;
+      this.lastAt = now;
+      this.buffer = Buffer.concat([this.buffer, data]);
+      if (this.waiter) this.waiter();
+    });
+  }
+
+  reset() {
+    this.buffer = Buffer.alloc(0);
+    this.firstAt = null;
+    this.lastAt = null;
+  }
+
+  /**
+   * Espera hasta que check() devuelva algo distinto de null
+   * @param {Function} check - Se evalúa con cada bloque recibido
+   * @param {number} timeout - ms
+   * @returns {Promise<*>} Valor de check() o null si venció el timeout
+   */
+  waitFor(check, timeout) {
+    return new Promise((resolve) => {
+      const done = (value) => {
+        clearTimeout(timer);
+        this.waiter = null;
+        resolve(value);
+      };
+      const timer = setTimeout(() => done(null), timeout);
+      this.waiter = () => {
+        const value = check();
+        if (value !== null) done(value);
+      };
+      this.waiter();
+    });
+  }
+
+  /**
+   * Espera la respuesta con el CMD indicado y consume el buffer hasta su final
+   * @returns {Promise<Object|null>} Respuesta parseada
+   */
+  async waitResponse(cmd, timeout, match = null) {
+    const found = await this.waitFor(() => {
+      let from = 0;
+      let f;
+      while ((f = findResponse(this.buffer, from)) !== null) {
+        if (f.response.cmd === cmd && (!match || match(f.response))) return f;
+        from = f.start + 1;
+      }
+      return null;
+    }, timeout);
+    if (!found) return null;
+    this.buffer = this.buffer.slice(found.end);
+    return found.response;
+  }
+}
+
+/**
+ * Escribe y espera a que el sistema operativo entregue los bytes al puerto
+ */
+function writeAll(port, data) {
+  return new Promise((resolve, reject) => {
+    port.write(data, (err) => {
+      if (err) return reject(err);
+      port.drain((e) => (e ? reject(e) : resolve()));
+    });
+  });
+}
+
+/**
+ * Tiempo esperado para transmitir n bytes a la tasa configurada (8N1), en ms
+ */
+function lineTimeMs(n) {
+  return (n * 10 * 1000) / config.baudRate;
+}
+
+/**
+ * Imprime una línea de resultados con tasa lograda y porcentaje de la capacidad
+ */
+function report(label, bytes, errors, missing, elapsedUs) {
+  const capacity = config.baudRate / 10;   // bytes/s con 8N1
+  const rate = elapsedUs > 0 ? (Math.max(bytes - 1, 0) * 1e6) / elapsedUs : 0;
+  const errRate = bytes > 0 ? errors / bytes : 0;
+  console.log(`[Link] ${label}: ${bytes} bytes, ${errors} con error (${errRate.toExponential(2)}), ` +
+    `${missing} perdidos, ${rate.toFixed(0)} B/s (${((rate / capacity) * 100).toFixed(1)}% de ${capacity} B/s)`);
+}
+
+async function run() {
+  const port = new SerialPort({ path: config.port, baudRate: config.baudRate, autoOpen: false });
+  await new Promise((resolve, reject) => port.open((err) => (err ? reject(err) : resolve())));
+  const reader = new PortReader(port);
+  console.log(`[Link] ${config.port} @ ${config.baudRate} baud, ${config.bytes} bytes por sentido`);
+
+  // Esperar el arranque (Ready) y dejar el flujo limpio con streaming apagado + Sync
+  await reader.waitResponse(COMMANDS.READY, READY_WAIT_MS);
+  await writeAll(port, streamingEnable(false));
+  const token = crypto.randomBytes(4);
+  await writeAll(port, sync(token));
+  const synced = await reader.waitResponse(COMMANDS.SYNC, 1000,
+    (r) => r.payload.slice(0, token.length).equals(token));
+  if (!synced) throw new Error('El micro no respondió a Sync');
+
+  // MCU -> PC
+  reader.reset();
+  await writeAll(port, linkTest(0, config.bytes));
+  const ack = await reader.waitResponse(COMMANDS.LINK_TEST, 1000);
+  if (!ack || !ack.isOk) throw new Error('El firmware no soporta 0x18 Link test');
+  const timeout = lineTimeMs(config.bytes) + RESULT_MARGIN_MS;
+  reader.firstAt = reader.buffer.length ? reader.lastAt : null;
+  await reader.waitFor(
+    () => (reader.buffer.length >= config.bytes ? true : null), timeout);
+  const pattern = reader.buffer.slice(0, config.bytes);
+  const hostUs = reader.firstAt !== null && reader.lastAt !== null
+    ? Number(reader.lastAt - reader.firstAt) / 1000 : 0;
+  reader.buffer = reader.buffer.slice(pattern.length);
+  const txResult = parseLinkResult((await reader.waitResponse(COMMANDS.LINK_RESULT, 2000) || {}).payload);
+  report('MCU -> PC (host)', pattern.length, prbs15Errors(pattern),
+    config.bytes - pattern.length, hostUs);
+  if (txResult) report('MCU -> PC (micro)', txResult.bytes, 0, 0, txResult.elapsedUs);
+
+  // PC -> MCU
+  await writeAll(port, linkTest(1, config.bytes));
+  const ackRx = await reader.waitResponse(COMMANDS.LINK_TEST, 1000);
+  if (!ackRx || !ackRx.isOk) throw new Error('El micro rechazó la prueba PC -> MCU');
+  await writeAll(port, prbs15(config.bytes));
+  const rxResult = parseLinkResult((await reader.waitResponse(COMMANDS.LINK_RESULT,
+    lineTimeMs(config.bytes) + RESULT_MARGIN_MS) || {}).payload);
+  if (!rxResult) throw new Error('Sin resultado de la prueba PC -> MCU');
+  report('PC -> MCU (micro)', rxResult.bytes, rxResult.errors, rxResult.missing, rxResult.elapsedUs);
+
+  await new Promise((resolve) => port.close(() => resolve()));
+}
+
+if (require.main === module) {
+  run().catch((error) => {
+    console.error('[Link] Error:', error.message);
+    process.exit(1);
+  });
+}
+
+module.exports = { prbs15, prbs15Errors };
@@ -0,0 +1,161 @@
+/**
+ * Remuestreo a una rejilla uniforme a partir de las marcas del tick del micro
+ * El loop() del firmware planifica con millis() y las tramas llegan con la latencia
+ * del USB, así que las muestras no quedan equiespaciadas. UniformResampler recibe
+ * los lotes de FrameDecoder (timestamp derivado del tick) y entrega, por canal,
+ * muestras en t = k·periodo exactos:
+ *   - analógicos: interpolación lineal entre las dos muestras que rodean t
+ *   - digital: retención de orden cero (último valor con t_muestra <= t)
+ *   - formato dividido: la fila de cada mitad digital lleva el tick de la última
+ *     analógica (FrameDecoder), queda en el t de esa analógica y no agrega puntos
+ *     propios; su valor digital llega combinado en la siguiente fila analógica
+ *   - filas sin tick (trama legacy) se ignoran en cuanto hay filas con tick: su hora
+ *     es la de llegada y no la del muestreo
+ *   - huecos: si entre dos muestras pasan más de gapFactor periodos no se interpola;
+ *     la rejilla continúa en la siguiente muestra y ese punto lleva gap = 1 y en
+ *     missing los puntos de rejilla omitidos
+ * La memoria es fija: una última muestra y un lote de salida de capacidad acotada
+ * que se reutiliza entre llamadas (crece solo si un lote de entrada lo exige).
+ */
+
+const MAX_CHANNELS = 16;        // Igual que MAX_VALUES de frameDecoder.js
+const DEFAULT_GAP_FACTOR = 2.5;
+const INITIAL_ROWS = 256;
+
+/**
+ * Lote de salida en columnas; válido hasta la siguiente llamada a push()
+ */
+class ResampledBatch {
+  constructor(rows = INITIAL_ROWS) {
+    this.count = 0;
+    this.stride = MAX_CHANNELS;
+    this.width = 0;               // Canales válidos por punto
+    this.allocate(rows);
+  }
+
+  allocate(rows) {
+    this.t = new Float64Array(rows);                   // ms, múltiplo exacto del periodo
+    this.values = new Float64Array(rows * MAX_CHANNELS);
+    this.digital = new Uint8Array(rows);
+    this.gap = new Uint8Array(rows);                   // 1 = primer punto tras un hueco
+    this.missing = new Uint32Array(rows);              // Puntos de rejilla omitidos antes de éste
+    this.capacity = rows;
+  }
+}
+
+class UniformResampler {
+  /**
+   * @param {number} periodMs - Paso de la rejilla en ms
+   * @param {number} gapFactor - Periodos sin muestras a partir de los que hay hueco
+   */
+  constructor(periodMs, gapFactor = DEFAULT_GAP_FACTOR) {
+    this.out = new ResampledBatch();
+    this.prevValues = new Float64Array(MAX_CHANNELS);
+    this.setPeriod(periodMs);
+    this.gapFactor = gapFactor;
+  }
+
+  /**
+   * Cambia el paso de la rejilla (p. ej. tras un evento Rate); reinicia el estado
+   */
+  setPeriod(periodMs) {
+    if (!(periodMs > 0)) throw new Error('Periodo de remuestreo inválido');
+    this.periodMs = periodMs;
+    this.reset();
+  }
+
+  /**
+   * Olvida la última muestra (Sync, reinicio del micro o cambio de periodo)
+   */
+  reset() {
+    this.prevT = NaN;
+    this.prevDigital = 0;
+    this.prevWidth = 0;
+    this.ticked = false;          // Ya hubo filas con tick: ignorar las que no lo traen
+    this.nextK = 0;               // Índice de la próxima posición de rejilla
+    this.pendingGap = 0;
+    this.pendingMissing = 0;
+  }
+
+  /**
+   * Remuestrea un lote de FrameDecoder
+   * @param {SampleBatch} batch - Con timestamp ya asignado por el listener
+   * @returns {ResampledBatch}
+   */
+  push(batch) {
+    const out = this.out;
+    out.count = 0;
+    const period = this.periodMs;
+    const gapMs = period * this.gapFactor;
+
+    // Cota de puntos: sin huecos no hay más que (lapso / periodo) + 1 por muestra
+    if (batch.count > 0) {
+      const span = batch.timestamp[batch.count - 1] - (Number.isNaN(this.prevT) ? batch.timestamp[0] : this.prevT);
+      const bound = Math.min(Math.ceil(Math.max(0, span) / period) + batch.count + 1,
+        batch.count * Math.ceil(this.gapFactor + 1) + 1);
+      if (bound > out.capacity) out.allocate(bound);
+    }
+
+    for (let i = 0; i < batch.count; i++) {
+      if (batch.tick[i] >= 0) this.ticked = true;
+      else if (this.ticked) continue;
+      const t = batch.timestamp[i];
+      const width = batch.width[i];
+      const base = i * batch.stride;
+      out.width = width;
+
+      if (Number.isNaN(this.prevT) || t - this.prevT > gapMs || width !== this.prevWidth) {
+        // Primera muestra o hueco: la rejilla arranca en el primer punto >= t
+        if (!Number.isNaN(this.prevT)) {
+          this.pendingGap = 1;
+          this.pendingMissing = Math.max(0, Math.ceil(t / period) - this.nextK);
+        }
+        this.nextK = Math.ceil(t / period);
+      } else if (t <= this.prevT) {
+        continue; // Duplicada o fuera de orden: no aporta a la rejilla
+      } else {
+        // Puntos de rejilla en (prevT, t]: interpolar entre la muestra previa y ésta
+        const span = t - this.prevT;
+        let tk = this.nextK * period;
+        while (tk <= t) {
+          const a = (tk - this.prevT) / span;
+          const row = out.count++;
+          const obase = row * out.stride;
+          out.t[row] = tk;
+          for (let ch = 0; ch < width; ch++) {
+            const v0 = this.prevValues[ch];
+            out.values[obase + ch] = v0 + (batch.values[base + ch] - v0) * a;
+          }
+          out.digital[row] = tk < t ? this.prevDigital : batch.digital[i];
+          out.gap[row] = this.pendingGap;
+          out.missing[row] = this.pendingMissing;
+          this.pendingGap = 0;
+          this.pendingMissing = 0;
+          tk = ++this.nextK * period;
+        }
+      }
+
+      // Punto de rejilla exactamente en la muestra (arranque o tras hueco)
+      if (this.nextK * period === t) {
+        const row = out.count++;
+        const obase = row * out.stride;
+        out.t[row] = t;
+        for (let ch = 0; ch < width; ch++) out.values[obase + ch] = batch.values[base + ch];
+        out.digital[row] = batch.digital[i];
+        out.gap[row] = this.pendingGap;
+        out.missing[row] = this.pendingMissing;
+        this.pendingGap = 0;
+        this.pendingMissing = 0;
+        this.nextK++;
+      }
+
+      this.prevT = t;
+      this.prevDigital = batch.digital[i];
+      this.prevWidth = width;
+      for (let ch = 0; ch < width; ch++) this.prevValues[ch] = batch.values[base + ch];
+    }
+    return out;
+  }
+}
+
+module.exports = { UniformResampler, ResampledBatch };
@@ -0,0 +1,110 @@
+/**
+ * Agregados por intervalo (int_proceso_vars_rollup) mantenidos al insertar
+ * Acumula en memoria mínimo/máximo/suma/muestras por variable e intervalo de
+ * 1 s, 1 min y 1 h, y los vuelca periódicamente con un solo INSERT ... ON
+ * DUPLICATE KEY UPDATE: unas decenas de filas por segundo en lugar de repetir
+ * agregaciones sobre las filas crudas al consultar el histórico.
+ */
+
+const { wallClockSeconds } = require('./wallClock');
+
+const ROLLUP_RESOLUTIONS = [1, 60, 3600];   // Segundos; debe coincidir con db/vars_rollup.sql
+const DEFAULT_FLUSH_MS = 1000;
+
+class RollupWriter {
+  /**
+   * @param {Object} db - Instancia de DatabaseConnection
+   * @param {number} flushMs - Intervalo de volcado a la BD
+   */
+  constructor(db, flushMs = DEFAULT_FLUSH_MS) {
+    this.db = db;
+    this.flushMs = flushMs;
+    this.pending = new Map();   // 'varId:res:bucket' -> [varId, res, bucket, min, max, sum, n]
+    this.timer = null;
+    this.flushing = false;
+    this.disabled = false;      // Tabla ausente: no reintentar en cada volcado
+  }
+
+  start() {
+    if (!this.timer) this.timer = setInterval(() => this.flush(), this.flushMs);
+  }
+
+  /**
+   * Acumula las muestras de una trama
+   * @param {Array<{varId, valor}>} dataArray - Registros ya insertados
+   * @param {number} atMs - Instante con el que insertBatch escribió fecha/hora
+   */
+  addBatch(dataArray, atMs) {
+    if (this.disabled) return;
+    const sec = wallClockSeconds(atMs);
+    for (const res of ROLLUP_RESOLUTIONS) {
+      const bucket = sec - (sec % res);
+      for (const { varId, valor } of dataArray) {
+        const key = `${varId}:${res}:${bucket}`;
+        const acc = this.pending.get(key);
+        if (acc) {
+          if (valor < acc[3]) acc[3] = valor;
+          if (valor > acc[4]) acc[4] = valor;
+          acc[5] += valor;
+          acc[6]++;
+        } else {
+          this.pending.set(key, [varId, res, bucket, valor, valor, valor, 1]);
+        }
+      }
+    }
+  }
+
+  /**
+   * Vuelca lo acumulado; los intervalos abiertos se completan en volcados siguientes
+   */
+  async flush() {
+    if (this.flushing || this.pending.size === 0) return;
+    const rows = [...this.pending.values()];
+    this.pending.clear();
+    this.flushing = true;
+    try {
+      await this.db.upsertRollups(rows);
+    } catch (error) {
+      if (error.code === 'ER_NO_SUCH_TABLE') {
+        console.warn('[Rollup] Tabla int_proceso_vars_rollup ausente (db/vars_rollup.sql); agregados desactivados');
+        this.disabled = true;
+      } else {
+        // Las filas crudas ya están guardadas: se reintenta en el próximo volcado
+        console.error('[Rollup] Error al volcar agregados (se reintenta):', error.message);
+        this.restore(rows);
+      }
+    } finally {
+      this.flushing = false;
+    }
+  }
+
+  /**
+   * Devuelve a pending las filas de un volcado fallido, combinadas con lo que
+   * llegó mientras tanto (mínimo, máximo, suma y muestras)
+   * @param {Array<Array<number>>} rows - [varId, res, bucket, min, max, sum, n]
+   */
+  restore(rows) {
+    for (const row of rows) {
+      const key = `${row[0]}:${row[1]}:${row[2]}`;
+      const acc = this.pending.get(key);
+      if (acc) {
+        if (row[3] < acc[3]) acc[3] = row[3];
+        if (row[4] > acc[4]) acc[4] = row[4];
+        acc[5] += row[5];
+        acc[6] += row[6];
+      } else {
+        this.pending.set(key, row);
+      }
+    }
+  }
+
+  async stop() {
+    if (this.timer) {
+      clearInterval(this.timer);
+      this.timer = null;
+    }
+    await this.flush();
+  }
+}
+
+module.exports = { RollupWriter, ROLLUP_RESOLUTIONS };
@@ -0,0 +1,169 @@
+require('dotenv').config();
+const mysql = require('mysql2/promise');
+
+/**
+ * Inserción y consultas sobre int_proceso_vars_data con el esquema actual y con el
+ * particionado de db/vars_data_partitioned.sql, a volúmenes de 10^8 filas
+ * Uso: node schemaBench.js [--schema=plain|partitioned] [--rows=100000000]
+ *        [--batch=2400] [--days=10] [--repeat=20] [--retention] [--keep]
+ *   Crea una tabla aparte (vars_data_bench) con la estructura elegida, la llena con
+ *   filas sintéticas (12 variables por trama, repartidas en --days días) y mide:
+ *     - filas/s por cada 10^7 filas insertadas (degradación al crecer los índices)
+ *     - las consultas de la aplicación: polling por id, último valor de una variable
+ *       e histórico crudo de una hora
+ *     - con --retention, el borrado del día más antiguo (DROP PARTITION vs DELETE)
+ *   --schema=partitioned requiere haber ejecutado db/vars_data_partitioned.sql.
+ *   La tabla se borra al final salvo con --keep.
+ */
+
+const options = { schema: 'plain', rows: 100000000, batch: 2400, days: 10, repeat: 20 };
+const flags = new Set();
+for (const arg of process.argv.slice(2)) {
+  const m = /^--(\w+)=(\w+)$/.exec(arg);
+  if (m && m[1] in options) options[m[1]] = m[1] === 'schema' ? m[2] : parseInt(m[2]);
+  else if (arg.startsWith('--')) flags.add(arg.slice(2));
+}
+
+const BENCH_TABLE = 'vars_data_bench';
+const SOURCE_TABLE = { plain: 'int_proceso_vars_data', partitioned: 'int_proceso_vars_data_p' };
+const VAR_IDS = Array.from({ length: 12 }, (_, i) => 10 + i);   // ADC0-7 + DIN0-3
+const REPORT_EVERY = 10000000;
+
+const pool = mysql.createPool({
+  host: process.env.DB_HOST || 'localhost',
+  port: parseInt(process.env.DB_PORT, 10) || 3306,
+  user: process.env.DB_USER || 'root',
+  password: process.env.DB_PASSWORD || '1234',
+  database: process.env.DB_NAME || 'laboratorio_virtual',
+  connectionLimit: 2
+});
+// Las fechas sintéticas están en UTC; FROM_UNIXTIME y CURDATE deben usar la misma zona
+pool.on('connection', (connection) => connection.query("SET time_zone = '+00:00'"));
+
+const pad = (n) => String(n).padStart(2, '0');
+const sqlDate = (d) => `${d.getUTCFullYear()}-${pad(d.getUTCMonth() + 1)}-${pad(d.getUTCDate())}`;
+const sqlTime = (d) => `${pad(d.getUTCHours())}:${pad(d.getUTCMinutes())}:${pad(d.getUTCSeconds())}`;
+
+async function createTable() {
+  const source = SOURCE_TABLE[options.schema];
+  if (!source) throw new Error(`--schema desconocido: ${options.schema}`);
+  await pool.query(`DROP TABLE IF EXISTS ${BENCH_TABLE}`);
+  // LIKE copia índices y particiones, no las claves foráneas
+  await pool.query(`CREATE TABLE ${BENCH_TABLE} LIKE ${source}`);
+  if (options.schema === 'partitioned') {
+    await pool.query('CALL vars_data_rotate_partitions(?, ?, ?)', [BENCH_TABLE, options.days, 1]);
+  }
+}
+
+/**
+ * Llena la tabla con tramas sintéticas: el reloj (UTC) avanza de forma uniforme
+ * desde hace --days días hasta ahora
+ */
+async function fill() {
+  const frames = Math.ceil(options.rows / VAR_IDS.length);
+  const framesPerBatch = Math.max(1, Math.floor(options.batch / VAR_IDS.length));
+  const startMs = Date.now() - options.days * 86400000;
+  const stepMs = (options.days * 86400000) / frames;
+
+  let inserted = 0;
+  let windowStart = process.hrtime.bigint();
+  let windowRows = 0;
+  const t0 = process.hrtime.bigint();
+  console.log(`Insertando ${frames * VAR_IDS.length} filas en ${BENCH_TABLE} (${options.schema}), lotes de ${framesPerBatch * VAR_IDS.length}`);
+
+  for (let f = 0; f < frames; f += framesPerBatch) {
+    const rows = [];
+    for (let k = f; k < Math.min(frames, f + framesPerBatch); k++) {
+      const at = new Date(startMs + k * stepMs);
+      const fecha = sqlDate(at);
+      const hora = sqlTime(at);
+      for (const varId of VAR_IDS) rows.push([varId, (k * 7 + varId * 131) & 0x3FF, k % 1000000, fecha, hora]);
+    }
+    await pool.query(
+      `INSERT INTO ${BENCH_TABLE} (int_proceso_vars_id, valor, tiempo, fecha, hora) VALUES ?`, [rows]);
+    inserted += rows.length;
+    windowRows += rows.length;
+    if (windowRows >= REPORT_EVERY || inserted >= options.rows) {
+      const now = process.hrtime.bigint();
+      const s = Number(now - windowStart) / 1e9;
+      console.log(`  ${String(inserted).padStart(11)} filas  ${Math.round(windowRows / s).toString().padStart(8)} filas/s`);
+      windowStart = now;
+      windowRows = 0;
+    }
+  }
+  const total = Number(process.hrtime.bigint() - t0) / 1e9;
+  console.log(`  total ${total.toFixed(1)} s, ${Math.round(inserted / total)} filas/s`);
+  return { startMs };
+}
+
+/**
+ * Tiempo mediano de una consulta sobre --repeat ejecuciones
+ */
+async function timeQuery(label, sql, params) {
+  const times = [];
+  let rows = 0;
+  for (let r = 0; r < options.repeat; r++) {
+    const t0 = process.hrtime.bigint();
+    const [result] = await pool.query(sql, params);
+    times.push(Number(process.hrtime.bigint() - t0) / 1e6);
+    rows = result.length;
+  }
+  times.sort((a, b) => a - b);
+  console.log(`  ${label.padEnd(26)} mediana ${times[times.length >> 1].toFixed(2).padStart(9)} ms  ` +
+    `p95 ${times[Math.floor(times.length * 0.95)].toFixed(2).padStart(9)} ms  (${rows} filas)`);
+}
+
+async function queries(startMs) {
+  console.log('\nConsultas');
+  const [[{ maxId }]] = await pool.query(`SELECT MAX(id) AS maxId FROM ${BENCH_TABLE}`);
+  const placeholders = VAR_IDS.map(() => '?').join(', ');
+
+  // IntProcesoData.getVarsDataAfterId: polling del WebSocket (~100 tramas nuevas)
+  await timeQuery('polling id > ? (vars)',
+    `SELECT id, int_proceso_vars_id, valor, tiempo, fecha, hora FROM ${BENCH_TABLE}
+     WHERE int_proceso_vars_id IN (${placeholders}) AND id > ? ORDER BY id ASC LIMIT 2000`,
+    [...VAR_IDS, maxId - 1200]);
+
+  // IntProcesoDataDAO.getLatestAdcData: gráfica de la aplicación Java
+  await timeQuery('último valor de una var',
+    `SELECT valor, tiempo FROM ${BENCH_TABLE} WHERE int_proceso_vars_id = ? ORDER BY id DESC LIMIT 1`,
+    [VAR_IDS[0]]);
+
+  // IntProcesoData.getVarsHistory (sin agregados): una hora a mitad del rango
+  const from = Math.floor((startMs + options.days * 43200000) / 1000);
+  await timeQuery('histórico crudo 1 h (1 var)',
+    `SELECT int_proceso_vars_id, valor, fecha, hora FROM ${BENCH_TABLE}
+     WHERE int_proceso_vars_id = ?
+       AND fecha BETWEEN DATE(FROM_UNIXTIME(?)) AND DATE(FROM_UNIXTIME(?))
+       AND TIMESTAMP(fecha, hora) >= FROM_UNIXTIME(?) AND TIMESTAMP(fecha, hora) < FROM_UNIXTIME(?)
+     LIMIT 5000`,
+    [VAR_IDS[0], from, from + 3600, from, from + 3600]);
+}
+
+async function retention() {
+  console.log('\nRetención del día más antiguo');
+  const t0 = process.hrtime.bigint();
+  if (options.schema === 'partitioned') {
+    await pool.query('CALL vars_data_apply_retention(?, ?)', [BENCH_TABLE, options.days - 1]);
+  } else {
+    await pool.query(`DELETE FROM ${BENCH_TABLE} WHERE fecha < DATE_SUB(CURDATE(), INTERVAL ? DAY)`,
+      [options.days - 1]);
+  }
+  const s = Number(process.hrtime.bigint() - t0) / 1e9;
+  console.log(`  ${options.schema === 'partitioned' ? 'DROP PARTITION' : 'DELETE'}: ${s.toFixed(2)} s`);
+}
+
+async function main() {
+  await createTable();
+  const { startMs } = await fill();
+  await queries(startMs);
+  if (flags.has('retention')) await retention();
+  if (!flags.has('keep')) await pool.query(`DROP TABLE ${BENCH_TABLE}`);
+  await pool.end();
+}
+
+main().catch(async (error) => {
+  console.error('[Bench] Error:', error.message);
+  await pool.end();
+  process.exit(1);
+});
@@ -1,27 +1,56 @@
 const { SerialPort } = require('serialport');
 const EventEmitter = require('events');
-const { findFrames, parseFrame } = require('./frameParser');
-const { streamingEnable, parseResponse } = require('./commandProtocol');
+const { chooseFrameFormat, frameSize, FRAME_FORMATS, DEFAULT_CHANNELS } = require('./frameParser');
+const { FrameDecoder } = require('./frameDecoder');
+const { now } = require('./latencyTracer');
+const { UniformResampler } = require('./resampler');
+const crypto = require('crypto');
+const fs = require('fs');
+const {
+  streamingEnable, parseReady, parseCaps, parseRate, parseChannels, sync, getCaps,
+  getChannels, setFrameFormat, setAdaptiveRate, setCalibratedOutput, getCalibration,
+  parseCalibration, execAt, parseExecuted, setInputMode, parseInputModes, COMMANDS, DEVICE_CAPS
+} = require('./commandProtocol');
+
+// Espera máxima del evento Ready (0x0A) tras abrir el puerto (reset por DTR + bootloader)
+const READY_TIMEOUT_MS = 2500;
 
 /**
  * Gestor de comunicación serial con microcontrolador
- * Implementa buffer acumulativo, detección de tramas y reconexión automática
+ * Decodifica el flujo por lotes (FrameDecoder), enruta respuestas y reconecta automáticamente
  */
 class SerialListener extends EventEmitter {
-  constructor(portPath, baudRate, reconnectDelay = 3000) {
+  constructor(portPath, baudRate, reconnectDelay = 3000, calibratedOutput = false) {
     super();
     this.portPath = portPath;
     this.baudRate = baudRate;
     this.reconnectDelay = reconnectDelay;
+    this.calibratedOutput = calibratedOutput; // Pedir tramas calibradas (0x12) si el MCU las soporta
     this.port = null;
-    this.buffer = Buffer.alloc(0);
+    this.decoder = new FrameDecoder(); // Tramas en lotes columnares + respuestas en orden
     this.isConnecting = false;
     this.shouldRun = false;
     this.frameCount = 0;
     this.streamingEnabled = false;
-    this.commandResponseBuffer = Buffer.alloc(0);
     this.pendingCommandResolve = null; // Para esperar respuestas de comandos
+    this.pendingCommandMatch = null;   // Predicado que identifica la respuesta esperada
+    this.pendingDiscardBefore = false; // Sync: descartar todo lo previo al marcador
     this.commandTimeout = null;
+    this.awaitingReady = false;
+    this.readyTimer = null;
+    this.deviceInfo = null;            // Último Ready recibido {protocolVersion, caps, bootCount}
+    this.deviceCaps = null;            // Descriptor de 0x0C (null si el firmware no lo soporta)
+    this.frameFormat = FRAME_FORMATS.LEGACY;
+    this.channels = null;              // Descriptores de 0x11 [{kind, index, name}] en orden de trama
+    this.linkRate = null;              // Última tasa efectiva anunciada (evento 0x10)
+    this.calibration = null;           // Tablas de 0x13 por canal si la salida es calibrada
+    this.capture = null;               // Stream donde se graban los bytes crudos (startCapture)
+    this.tracer = null;                // LatencyTracer opcional: etapas tick_rx y rx_decode
+    this.resamplePeriodMs = null;      // Rejilla de 'resampled'; null = periodo del evento Rate
+    this.resampler = null;
+    this.inputModes = null;            // Modo de las entradas DIP (0x1C), p. ej. [1, 0, 2, 0]; null = no tocar
+    this.bulk = null;                  // Transferencia en bloques en curso (bulkTransfer.js)
+    this.resetTickClock();
   }
 
   /**
@@ -45,15 +74,15 @@ class SerialListener extends EventEmitter {
       this.port.on('open', () => {
         console.log(`[Serial] Puerto abierto: ${this.portPath} @ ${this.baudRate} baud`);
         this.isConnecting = false;
-        this.buffer = Buffer.alloc(0);
+        this.decoder.clear();
         this.emit('connected');
         
-        // Esperar a que el microcontrolador se resetee y esté listo
-        // Arduino se resetea al abrir puerto serial (DTR)
-        console.log('[Serial] Esperando reseteo del microcontrolador...');
-        setTimeout(() => {
-          this.enableStreaming();
-        }, 2000); // 2 segundos para asegurar que el bootloader termine
+        // Arduino se resetea al abrir puerto serial (DTR): esperar su evento Ready
+        // en lugar de un retardo fijo; si no llega, sondear con Sync
+        console.log('[Serial] Esperando Ready del microcontrolador...');
+        this.awaitingReady = true;
+        clearTimeout(this.readyTimer);
+        this.readyTimer = setTimeout(() => this.handleReadyTimeout(), READY_TIMEOUT_MS);
       });
 
       this.port.on('data', (data) => {
@@ -85,66 +114,397 @@ class SerialListener extends EventEmitter {
 
   /**
    * Maneja datos recibidos del puerto
+   * Emite 'batch' con el lote columnar (SampleBatch, válido solo durante el evento)
+   * y, si hay oyentes, 'frame' con un objeto por trama como parseFrame.
+   * Las tramas de entradas medidas (0x1C) salen aparte como 'inputs'.
    * @param {Buffer} data - Datos recibidos
    */
   handleData(data) {
-    // Acumular datos en el buffer
-    this.buffer = Buffer.concat([this.buffer, data]);
-
-    // Si estamos esperando una respuesta de comando, intentar parsearla primero
-    if (this.pendingCommandResolve) {
-      this.commandResponseBuffer = Buffer.concat([this.commandResponseBuffer, data]);
-      const response = parseResponse(this.commandResponseBuffer);
-      
-      if (response) {
-        // Respuesta válida recibida
-        clearTimeout(this.commandTimeout);
-        this.commandResponseBuffer = Buffer.alloc(0);
-        const resolve = this.pendingCommandResolve;
-        this.pendingCommandResolve = null;
-        resolve(response);
-        return; // No procesar como trama de datos
+    if (this.capture) this.capture.write(data);
+    const tracer = this.tracer;
+    const decodeStart = tracer ? now() : 0;
+    const batch = this.decoder.push(data, (response) => this.handleResponse(response));
+    for (const report of this.decoder.inputReports) {
+      report.timestamp = this.tickToHost(report.tick, batch.receivedAt);
+      this.emit('inputs', report);
+    }
+    if (batch.count === 0) return;
+
+    // Hora de muestreo a partir del tick (las tramas legacy conservan la de llegada)
+    for (let i = 0; i < batch.count; i++) {
+      batch.timestamp[i] = batch.tick[i] < 0
+        ? batch.receivedAt
+        : this.stampTick(batch.tick[i], batch.receivedAt);
+    }
+    batch.decodedAt = tracer ? now() : 0;
+    if (tracer) {
+      tracer.record('rx_decode', batch.decodedAt - decodeStart);
+      for (let i = 0; i < batch.count; i++) {
+        if (batch.tick[i] >= 0) tracer.record('tick_rx', batch.receivedAt - batch.timestamp[i]);
       }
-      
-      // Si el buffer de respuesta es muy grande, algo salió mal
-      if (this.commandResponseBuffer.length > 100) {
-        console.warn('[Serial] Buffer de respuesta muy grande, limpiando...');
-        this.commandResponseBuffer = Buffer.alloc(0);
+    }
+
+    const previous = this.frameCount;
+    this.frameCount += batch.count;
+    this.emit('batch', batch);
+    if (this.listenerCount('resampled') > 0) this.emitResampled(batch);
+
+    if (this.listenerCount('frame') > 0) {
+      const units = this.calibration ? this.calibration.map(c => c && c.unitName) : null;
+      for (let i = 0; i < batch.count; i++) {
+        const parsedData = batch.toFrame(i);
+        if (parsedData.calibrated && units) parsedData.units = units;
+        if (tracer) parsedData.decodedAt = batch.decodedAt;
+        this.emit('frame', parsedData);
       }
     }
 
-    // Buscar tramas completas en el buffer
-    const { frames, remainder } = findFrames(this.buffer);
+    // Log cada 100 tramas
+    if (Math.floor(this.frameCount / 100) !== Math.floor(previous / 100)) {
+      const lost = this.decoder.lostDigital;
+      console.log(`[Serial] ${this.frameCount - (this.frameCount % 100)} tramas procesadas` +
+        (lost ? ` (${lost} tramas digitales perdidas)` : ''));
+    }
+  }
 
-    // Actualizar buffer con datos no procesados
-    this.buffer = remainder;
+  /**
+   * Emite 'resampled' con el lote en una rejilla uniforme según los ticks
+   * (ResampledBatch, válido solo durante el evento). Sin periodo configurado
+   * usa el efectivo del último evento Rate; sin ninguno no emite.
+   * @param {SampleBatch} batch - Lote con timestamp ya asignado
+   */
+  emitResampled(batch) {
+    const period = this.resamplePeriodMs || (this.linkRate && this.linkRate.effectivePeriodMs);
+    if (!period) return;
+    if (!this.resampler) this.resampler = new UniformResampler(period);
+    else if (this.resampler.periodMs !== period) this.resampler.setPeriod(period);
+    const out = this.resampler.push(batch);
+    if (out.count > 0) this.emit('resampled', out);
+  }
 
-    // Procesar cada trama encontrada
-    frames.forEach(frameBuffer => {
-      try {
-        const parsedData = parseFrame(frameBuffer);
-        this.frameCount++;
-        
-        // Emitir evento con datos parseados
-        this.emit('frame', parsedData);
-        
-        // Log cada 100 tramas
-        if (this.frameCount % 100 === 0) {
-          console.log(`[Serial] ${this.frameCount} tramas procesadas`);
+  /**
+   * Enruta una respuesta del flujo: transferencia en bloques en curso, eventos no
+   * solicitados (Ready 0x0A, Rate 0x10, Executed 0x16) o la respuesta del comando pendiente
+   * @param {Object} response - Respuesta parseada
+   * @returns {boolean} true si es un marcador Sync: descartar lo recibido antes
+   */
+  handleResponse(response) {
+    const { cmd, payload } = response;
+    if (this.bulk && this.bulk.handleResponse(response)) return false;
+    if (cmd === COMMANDS.RATE) {
+      this.onRate(parseRate(payload));
+      return false;
+    }
+    if (cmd === COMMANDS.EXECUTED) {
+      const executed = parseExecuted(payload);
+      if (executed) this.emit('executed', executed);
+      return false;
+    }
+    if (cmd === COMMANDS.READY) {
+      const info = parseReady(payload);
+      if (!this.awaitingReady) {
+        if (info && info.warmRestart) {
+          // Reset del watchdog: el MCU restauró su estado y sigue transmitiendo;
+          // el reloj del tick continúa, así que el hueco queda en las marcas de tiempo
+          console.warn(`[Serial] El microcontrolador se reinició en caliente (arranque #${info.bootCount}), streaming retomado`);
+          this.deviceInfo = info;
+          this.emit('ready', info);
+          return false;
         }
-      } catch (error) {
-        console.error('[Serial] Error al parsear trama:', error.message);
-        this.emit('parseError', error);
+        // El MCU se reinició sin cerrar el puerto: vuelve con streaming apagado
+        console.warn('[Serial] Ready inesperado: el microcontrolador se reinició');
       }
-    });
+      this.onReady(info);
+      return false;
+    }
+
+    if (!this.pendingCommandResolve ||
+        (this.pendingCommandMatch && !this.pendingCommandMatch(response))) {
+      return false;
+    }
+    clearTimeout(this.commandTimeout);
+    const discard = this.pendingDiscardBefore;
+    const resolve = this.pendingCommandResolve;
+    this.pendingCommandResolve = null;
+    this.pendingCommandMatch = null;
+    this.pendingDiscardBefore = false;
+    // Marcador Sync: lo anterior es obsoleto, solo se conserva lo posterior
+    if (discard) this.resetTickClock();
+    resolve(response);
+    return discard;
+  }
+
+  /**
+   * El MCU anunció una nueva tasa efectiva (control adaptativo)
+   * @param {Object|null} rate - Datos del evento Rate
+   */
+  onRate(rate) {
+    if (!rate) return;
+    this.linkRate = rate;
+    const fmt = Object.values(FRAME_FORMATS).find(f => f.id === rate.format);
+    if (fmt) this.frameFormat = fmt;
+    console.log(`[Serial] Tasa efectiva: ${rate.effectivePeriodMs} ms (formato ${rate.format}, ` +
+      `1 de cada ${rate.decimation}, ${rate.skipped} ranuras omitidas)`);
+    this.emit('rate', rate);
+  }
+
+  /**
+   * Reinicia la correspondencia entre el tick del MCU y el reloj del host
+   * y el estado combinado del formato dividido
+   */
+  resetTickClock() {
+    if (this.decoder) this.decoder.resetMerge();
+    if (this.resampler) this.resampler.reset();
+    this.lastTick = null;
+    this.tickBase = 0;
+    this.tickOffset = null;
+  }
+
+  /**
+   * Hora de muestreo de una fila con tick, en el reloj del host.
+   * El tick de 16 bits se desenrolla y se ancla al reloj del host con el menor
+   * retardo observado; el ancla sube lentamente para seguir la deriva del cristal.
+   * Las omisiones o el diezmado del MCU no alteran las marcas de las tramas recibidas.
+   * @param {number} tick - Tick de 16 bits de la trama
+   * @param {number} receivedAt - Hora de llegada (ms)
+   * @returns {number} Hora de muestreo en el reloj del host (ms)
+   */
+  stampTick(tick, receivedAt) {
+    if (this.lastTick === null) {
+      this.tickBase = tick;
+    } else {
+      this.tickBase += (tick - this.lastTick) & 0xFFFF;
+    }
+    this.lastTick = tick;
+    const offset = receivedAt - this.tickBase;
+    if (this.tickOffset === null || offset < this.tickOffset) {
+      this.tickOffset = offset;
+    } else {
+      this.tickOffset += (offset - this.tickOffset) / 1000;
+    }
+    return Math.round(this.tickBase + this.tickOffset);
+  }
+
+  /**
+   * Convierte un tick con el ancla actual de stampTick sin modificarla: las tramas
+   * de entradas llevan la hora del informe, que puede ir por detrás del último
+   * tick de muestra y desenrollaría el contador hacia adelante
+   * @param {number} tick - Tick de 16 bits
+   * @param {number} receivedAt - Hora de llegada (ms), si aún no hay ancla
+   * @returns {number} Hora en el reloj del host (ms)
+   */
+  tickToHost(tick, receivedAt) {
+    if (this.lastTick === null) return receivedAt;
+    const delta = ((tick - this.lastTick + 0x8000) & 0xFFFF) - 0x8000;
+    return Math.round(this.tickBase + delta + this.tickOffset);
+  }
+
+  /**
+   * El microcontrolador anunció que está listo: habilitar streaming sin esperas fijas
+   * @param {Object|null} info - Datos del Ready
+   */
+  onReady(info) {
+    this.awaitingReady = false;
+    clearTimeout(this.readyTimer);
+    this.readyTimer = null;
+    this.deviceInfo = info;
+    this.resetTickClock();
+    if (info) {
+      console.log(`[Serial] Ready recibido: protocolo v${info.protocolVersion}, arranque #${info.bootCount}`);
+    }
+    this.emit('ready', info);
+    this.startStreaming();
+  }
 
-    // Si el buffer crece demasiado, limpiarlo (posible basura)
-    if (this.buffer.length > 1000) {
-      console.warn('[Serial] Buffer demasiado grande, limpiando...');
-      this.buffer = Buffer.alloc(0);
+  /**
+   * No llegó Ready (placa sin auto-reset o firmware previo): sondear con Sync
+   */
+  async handleReadyTimeout() {
+    if (!this.awaitingReady) return;
+    this.awaitingReady = false;
+    this.readyTimer = null;
+    console.warn('[Serial] Ready no recibido, sondeando con Sync...');
+    const ok = await this.syncStream();
+    if (!ok) {
+      console.warn('[Serial] Sync sin respuesta, se intenta habilitar streaming igualmente');
+    }
+    this.emit('ready', this.deviceInfo);
+    this.startStreaming();
+  }
+
+  /**
+   * Negocia el formato de trama y habilita el streaming
+   */
+  async startStreaming() {
+    await this.negotiateFrameFormat();
+    await this.enableCalibratedOutput();
+    await this.enableAdaptiveRate();
+    await this.configureInputs();
+    await this.enableStreaming();
+  }
+
+  /**
+   * Aplica inputModes con 0x1C: las entradas en modo contador o período llegan
+   * como evento 'inputs' una vez por Ts DIP. Un firmware sin 0x1C responde 0x03.
+   */
+  async configureInputs() {
+    if (!Array.isArray(this.inputModes)) return;
+    try {
+      let modes = null;
+      for (let i = 0; i < 4; i++) {
+        const response = await this.sendCommand(setInputMode(i, this.inputModes[i] || 0), true, 500);
+        if (!response || !response.isOk) {
+          console.warn('[Serial] El firmware no admite modos de entrada (0x1C)');
+          return;
+        }
+        modes = parseInputModes(response.payload);
+      }
+      console.log(`[Serial] Modos de entrada DIP: ${modes.join(', ')}`);
+    } catch (error) {
+      console.warn('[Serial] No se pudieron configurar las entradas:', error.message);
     }
   }
 
+  /**
+   * Activa el control de tasa adaptativo (0x0F) si el firmware lo anuncia en Ready:
+   * el MCU deja de bloquearse con el buffer TX lleno y reduce la tasa o pasa a la
+   * trama compacta, notificándolo con el evento Rate (0x10)
+   */
+  async enableAdaptiveRate() {
+    this.linkRate = null;
+    if (!this.deviceInfo || !(this.deviceInfo.caps & DEVICE_CAPS.ADAPTIVE_RATE)) return;
+    try {
+      const ack = await this.sendCommand(setAdaptiveRate(true), true, 500);
+      if (ack && ack.isOk) {
+        console.log('[Serial] Control de tasa adaptativo habilitado');
+      }
+    } catch (error) {
+      console.warn('[Serial] No se pudo habilitar el control de tasa adaptativo:', error.message);
+    }
+  }
+
+  /**
+   * Pide las tramas calibradas (0x12) si se configuró así y el firmware lo anuncia:
+   * el MCU convierte cada canal con su tabla (0x13) y el host ya no convierte cuentas.
+   * Solo aplica a las tramas compacta y analógica; legacy sigue en cuentas.
+   */
+  async enableCalibratedOutput() {
+    this.calibration = null;
+    if (!this.calibratedOutput || !this.deviceInfo ||
+        !(this.deviceInfo.caps & DEVICE_CAPS.CALIBRATION)) return;
+    try {
+      const ack = await this.sendCommand(setCalibratedOutput(true), true, 500);
+      if (!ack || !ack.isOk) return;
+      const count = this.deviceCaps ? this.deviceCaps.adcChannels : 4;
+      const tables = [];
+      for (let ch = 0; ch < count; ch++) {
+        const response = await this.sendCommand(getCalibration(ch), true, 500);
+        tables.push(response && response.isOk ? parseCalibration(response.payload) : null);
+      }
+      this.calibration = tables;
+      console.log(`[Serial] Salida calibrada: ${tables.map(t => (t ? t.unitName : '?')).join(', ')}`);
+    } catch (error) {
+      console.warn('[Serial] No se pudo habilitar la salida calibrada:', error.message);
+    }
+  }
+
+  /**
+   * Consulta las capacidades del firmware (0x0C) y selecciona el formato de trama
+   * más compacto soportado por ambos lados. Sin respuesta se mantiene legacy.
+   */
+  async negotiateFrameFormat() {
+    this.frameFormat = FRAME_FORMATS.LEGACY;
+    this.decoder.setChannels(DEFAULT_CHANNELS);
+    try {
+      const response = await this.sendCommand(getCaps(), true, 500);
+      const caps = response && response.isOk ? parseCaps(response.payload) : null;
+      this.deviceCaps = caps;
+      if (!caps) {
+        console.warn('[Serial] Firmware sin descriptor de capacidades, se usa trama legacy');
+        return;
+      }
+      this.decoder.setChannels(caps.adcChannels);
+      await this.discoverChannels();
+      const fmt = chooseFrameFormat(caps.formats);
+      if (fmt.id !== FRAME_FORMATS.LEGACY.id) {
+        const ack = await this.sendCommand(setFrameFormat(fmt.id), true, 500);
+        if (!ack || !ack.isOk) return;
+      }
+      this.frameFormat = fmt;
+      console.log(`[Serial] Formato de trama: ${fmt.id} (${frameSize(fmt, this.decoder.channels)} bytes), ${caps.adcChannels} canales ADC de ${caps.adcBits} bits`);
+    } catch (error) {
+      console.warn('[Serial] Sin respuesta a Get caps, se usa trama legacy:', error.message);
+    }
+  }
+
+  /**
+   * Consulta la lista de canales (0x11) si el firmware la anuncia en Ready
+   */
+  async discoverChannels() {
+    this.channels = null;
+    if (!this.deviceInfo || !(this.deviceInfo.caps & DEVICE_CAPS.CHANNELS)) return;
+    try {
+      const response = await this.sendCommand(getChannels(), true, 500);
+      this.channels = response && response.isOk ? parseChannels(response.payload) : null;
+      if (this.channels) {
+        console.log(`[Serial] Canales: ${this.channels.map(c => c.name).join(', ')}`);
+      }
+    } catch (error) {
+      console.warn('[Serial] Sin respuesta a Get channels:', error.message);
+    }
+  }
+
+  /**
+   * Descarta de forma determinista los bytes pendientes: envía Sync con un token
+   * único y elimina todo lo recibido hasta la respuesta que lo contiene.
+   * @param {number} timeout - Timeout en ms
+   * @returns {Promise<boolean>} true si se recibió el marcador
+   */
+  async syncStream(timeout = 500) {
+    const token = crypto.randomBytes(4);
+    const match = (resp) => resp.cmd === COMMANDS.SYNC && resp.isOk &&
+      resp.payload.length >= token.length && resp.payload.slice(0, token.length).equals(token);
+    try {
+      await this.sendCommand(sync(token), true, timeout, match, true);
+      return true;
+    } catch (error) {
+      return false;
+    }
+  }
+
+  /**
+   * Lee el reloj del micro (millis()) con un Sync que no descarta el flujo
+   * @param {number} timeout - Timeout en ms
+   * @returns {Promise<number|null>} Tick uint32 o null sin respuesta
+   */
+  async readDeviceTick(timeout = 500) {
+    const token = crypto.randomBytes(4);
+    const match = (resp) => resp.cmd === COMMANDS.SYNC && resp.isOk &&
+      resp.payload.length >= token.length + 4 && resp.payload.slice(0, token.length).equals(token);
+    try {
+      const response = await this.sendCommand(sync(token), true, timeout, match);
+      return response.payload.readUInt32LE(token.length);
+    } catch (error) {
+      return null;
+    }
+  }
+
+  /**
+   * Programa un comando para que el micro lo ejecute en su tick T (0x15).
+   * El resultado real llega como evento 'executed' {id, cmd, tick}.
+   * @param {Buffer} command - Comando construido (payload máx. 8 bytes)
+   * @param {number} tick - millis() del micro; ver readDeviceTick() o el tick de las tramas
+   * @returns {Promise<{id: number, queued: number}|null>} null si el micro lo rechazó
+   */
+  async scheduleCommand(command, tick) {
+    if (!this.deviceInfo || !(this.deviceInfo.caps & DEVICE_CAPS.EXEC_AT)) {
+      throw new Error('El firmware no soporta comandos programados');
+    }
+    const response = await this.sendCommand(execAt(tick, command), true, 500);
+    if (!response || !response.isOk || response.payload.length < 2) return null;
+    return { id: response.payload[0], queued: response.payload[1] };
+  }
+
   /**
    * Programa un intento de reconexión
    */
@@ -157,11 +517,50 @@ class SerialListener extends EventEmitter {
     }, this.reconnectDelay);
   }
 
+  /**
+   * Ejecuta una transferencia en bloques (BulkDownload/BulkUpload) sobre el puerto
+   * abierto; sus comandos salen por este puerto. El micro suspende el streaming
+   * mientras dura y lo restablece al cerrarla.
+   * @param {BulkTransfer} transfer - Creada con write = null
+   * @returns {Promise<Object>} Resultado de transfer.run()
+   */
+  async bulkTransfer(transfer) {
+    if (!this.isOpen()) throw new Error('Puerto no abierto');
+    if (this.bulk) throw new Error('Ya hay una transferencia en bloques en curso');
+    transfer.write = (command) => this.port.write(command);
+    this.bulk = transfer;
+    try {
+      return await transfer.run();
+    } finally {
+      this.bulk = null;
+    }
+  }
+
+  /**
+   * Graba en un archivo todos los bytes recibidos del puerto, tal cual llegan.
+   * La captura sirve para reproducir el flujo (node decoderBench.js captura.bin).
+   * @param {string} filePath - Archivo de salida (se sobrescribe)
+   */
+  startCapture(filePath) {
+    this.capture = fs.createWriteStream(filePath);
+    this.capture.on('error', (error) => {
+      console.error('[Serial] Error al grabar la captura:', error.message);
+      this.capture = null;
+    });
+    console.log(`[Serial] Grabando bytes recibidos en ${filePath}`);
+  }
+
   /**
    * Cierra el puerto serial
    */
   async close() {
     this.shouldRun = false;
+    if (this.capture) {
+      this.capture.end();
+      this.capture = null;
+    }
+    this.awaitingReady = false;
+    clearTimeout(this.readyTimer);
     if (this.port && this.port.isOpen) {
       return new Promise((resolve) => {
         this.port.close((err) => {
@@ -186,9 +585,11 @@ class SerialListener extends EventEmitter {
    * @param {Buffer} command - Comando a enviar
    * @param {boolean} waitResponse - Si debe esperar respuesta
    * @param {number} timeout - Timeout en ms para esperar respuesta
+   * @param {Function} match - Predicado opcional sobre la respuesta (por defecto: mismo CMD)
+   * @param {boolean} discardBefore - Descartar del buffer todo lo previo a la respuesta (Sync)
    * @returns {Promise<Object|void>}
    */
-  sendCommand(command, waitResponse = false, timeout = 2000) {
+  sendCommand(command, waitResponse = false, timeout = 2000, match = null, discardBefore = false) {
     return new Promise((resolve, reject) => {
       if (!this.port || !this.port.isOpen) {
         console.warn('[Serial] Puerto no abierto, no se puede enviar comando');
@@ -206,13 +607,16 @@ class SerialListener extends EventEmitter {
         }
 
         // Configurar espera de respuesta
-        this.commandResponseBuffer = Buffer.alloc(0);
+        const cmd = command[2];
+        this.pendingCommandMatch = match || ((resp) => resp.cmd === cmd);
+        this.pendingDiscardBefore = discardBefore;
         this.pendingCommandResolve = resolve;
 
         // Configurar timeout
         this.commandTimeout = setTimeout(() => {
           this.pendingCommandResolve = null;
-          this.commandResponseBuffer = Buffer.alloc(0);
+          this.pendingCommandMatch = null;
+          this.pendingDiscardBefore = false;
           reject(new Error('Timeout esperando respuesta del microcontrolador'));
         }, timeout);
       });
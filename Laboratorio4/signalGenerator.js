@@ -0,0 +1,81 @@
+/**
+ * Modelo de referencia del generador de señales del firmware (0x1A)
+ * Reproduce muestra a muestra los mismos valores enteros que el micro, para comparar
+ * cada etapa del pipeline (serial, BD, vistas web) contra el valor esperado.
+ */
+
+const { GENERATOR_WAVES } = require('./commandProtocol');
+
+// sin(i * 90° / 64) * 255, i = 0..64 (misma tabla que SINE_QUARTER en el firmware)
+const SINE_QUARTER = Array.from({ length: 65 }, (_, i) => Math.round(255 * Math.sin((i * Math.PI) / 128)));
+
+class GeneratorModel {
+  /**
+   * @param {number} wave - Código de GENERATOR_WAVES
+   * @param {{period?: number, amplitude?: number, offset?: number}} params - Los mismos que setGenerator()
+   * @param {number} max - 1023 para canales ADC, 15 para el DIP
+   */
+  constructor(wave, { period = 1, amplitude = 0, offset = 0 } = {}, max = 1023) {
+    this.wave = wave;
+    this.period = period;
+    this.amplitude = amplitude;
+    this.offset = offset;
+    this.max = max;
+    this.phase = 0;
+    this.prbs = 0x7FFF;
+  }
+
+  /**
+   * Valor de la siguiente muestra (avanza una fase, como genStep() en el micro)
+   * @returns {number}
+   */
+  next() {
+    let v = this.offset;
+    switch (this.wave) {
+      case GENERATOR_WAVES.RAMP:
+        v += Math.floor((this.amplitude * this.phase) / this.period);
+        break;
+      case GENERATOR_WAVES.SINE: {
+        const idx = Math.floor((this.phase * 256) / this.period) & 0xFF;
+        const k = idx & 0x3F;
+        const q = idx >> 6;
+        let sn = SINE_QUARTER[(q & 1) ? 64 - k : k];
+        if (q & 2) sn = -sn;
+        v += Math.trunc((this.amplitude * sn) / 255);
+        break;
+      }
+      case GENERATOR_WAVES.STEP:
+        if (this.phase >= Math.floor(this.period / 2)) v += this.amplitude;
+        break;
+      case GENERATOR_WAVES.PRBS: {
+        const b = ((this.prbs >> 14) ^ (this.prbs >> 13)) & 1;
+        this.prbs = ((this.prbs << 1) | b) & 0x7FFF;
+        if (b) v += this.amplitude;
+        break;
+      }
+      case GENERATOR_WAVES.COUNTER:
+        v += this.phase;
+        break;
+      default:
+        break;
+    }
+    if (++this.phase >= this.period) this.phase = 0;
+    return Math.max(0, Math.min(this.max, v));
+  }
+}
+
+/**
+ * Cuenta muestras perdidas entre dos valores consecutivos de un canal en modo contador
+ * @param {number} prev - Valor anterior recibido
+ * @param {number} curr - Valor actual recibido
+ * @param {number} period - Período del contador (vuelta)
+ * @returns {number} Muestras que faltan entre ambas (0 si son consecutivas)
+ */
+function counterGap(prev, curr, period) {
+  return (((curr - prev - 1) % period) + period) % period;
+}
+
+module.exports = {
+  GeneratorModel,
+  counterGap
+};
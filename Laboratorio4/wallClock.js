@@ -0,0 +1,36 @@
+/**
+ * Hora local de pared para int_proceso_vars_data y sus agregados
+ * fecha/hora se guardan en hora local sin zona; los intervalos de
+ * int_proceso_vars_rollup cuentan segundos de esa misma fecha/hora desde
+ * 1970-01-01 00:00:00 (db/vars_rollup.sql). dbConnection.js y rollupWriter.js
+ * derivan ambas cosas de aquí a partir del mismo instante.
+ */
+
+/**
+ * Segundos desde 1970-01-01 00:00:00 de la hora local de atMs, sin zona: el
+ * mismo valor que TIMESTAMPDIFF(SECOND, '1970-01-01', TIMESTAMP(fecha, hora))
+ * en rollup_vars_data_backfill para la fecha/hora que escribe insertBatch
+ * @param {number} atMs - Instante en ms UNIX
+ * @returns {number}
+ */
+function wallClockSeconds(atMs) {
+  const d = new Date(atMs);
+  return Math.floor(Date.UTC(d.getFullYear(), d.getMonth(), d.getDate(),
+    d.getHours(), d.getMinutes(), d.getSeconds()) / 1000);
+}
+
+/**
+ * fecha ('YYYY-MM-DD') y hora ('HH:MM:SS') locales de atMs para int_proceso_vars_data
+ * @param {number} atMs - Instante en ms UNIX
+ * @returns {{fecha: string, hora: string}}
+ */
+function toFechaHora(atMs) {
+  const d = new Date(atMs);
+  const p = (n) => String(n).padStart(2, '0');
+  return {
+    fecha: `${d.getFullYear()}-${p(d.getMonth() + 1)}-${p(d.getDate())}`,
+    hora: `${p(d.getHours())}:${p(d.getMinutes())}:${p(d.getSeconds())}`
+  };
+}
+
+module.exports = { wallClockSeconds, toFechaHora };
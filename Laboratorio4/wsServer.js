@@ -3,17 +3,28 @@ const { EventEmitter } = require('events');
 const WebSocket = require('ws');
 const IntProcesoData = require('./api/IntProcesoData');
 const IntProcesoRefs = require('./api/IntProcesoRefs');
+const { now } = require('./latencyTracer');
 
 // Configuracion base del WS y de las variables a consultar
 const DEFAULT_WS_PORT = parseInt(process.env.WS_PORT, 10) || 8090;              // Puerto WS (o HTTP host)
 const POLL_INTERVAL_MS = parseInt(process.env.WS_POLL_INTERVAL_MS, 10) || 500; // Intervalo de polling a BD
 
+// Canal en vivo: tramas decodificadas directo a los clientes suscritos, sin pasar por la BD
+// Mensaje binario (LE): [0x01][DIGITAL][MASK u16][SEQ u32][TIEMPO u32][VAL int16 x bits de MASK]
+const LIVE_MSG_SAMPLE = 0x01;
+const LIVE_HEADER_SIZE = 12;
+const LIVE_MAX_CHANNELS = 16;
+const LIVE_MAX_BUFFERED = parseInt(process.env.WS_LIVE_MAX_BUFFERED, 10) || 64 * 1024; // bytes en cola por cliente
+// Un suscriptor que recibió una muestra en vivo en este lapso no necesita vars_data
+const LIVE_STALE_MS = 2000;
+
 /**
  * Crea un servidor WebSocket con manejo de DB (polling) y helpers de cierre.
  * @param {number|import('http').Server} portOrServer Puerto o servidor HTTP ya creado.
  * @param {Function} getRelativeTime Función opcional para obtener tiempo relativo
+ * @param {LatencyTracer} tracer Trazado de latencias opcional (etapas WS y navegador)
  */
-function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime = null) {
+function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime = null, tracer = null) {
   let listenPort = null;
   let options = null;
 
@@ -33,6 +44,11 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
   let pollTimer = null;
   let pollInFlight = false;
   let lastBroadcastId = 0;
+  let pollPaused = false;   // se salteó la consulta: al volver, desde el id actual
+
+  // Suscripciones al canal en vivo: socket -> { mask, decim, count, dropped, lastSentAt }
+  const liveClients = new Map();
+  let liveSeq = 0;
 
   // Eventos del servidor
   // Emite 'listening' tanto si arranca solo como si cuelga de un server HTTP
@@ -76,6 +92,27 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
         if (msg && msg.type === 'get_latest_dout') {
           handleGetLatestDout(msg, socket);
         }
+
+        // Histórico para gráficas: agregados por intervalo según la resolución pedida
+        if (msg && msg.type === 'get_history') {
+          handleGetHistory(msg, socket);
+        }
+
+        // Canal en vivo: suscripción por canales con diezmado
+        if (msg && msg.type === 'live_subscribe') {
+          handleLiveSubscribe(msg, socket);
+        }
+        if (msg && msg.type === 'live_unsubscribe') {
+          liveClients.delete(socket);
+        }
+
+        // Trazado de latencias: reporte de recepción/dibujo del navegador y consulta
+        if (msg && msg.type === 'trace_report' && tracer) {
+          tracer.onBrowserReport(msg);
+        }
+        if (msg && msg.type === 'get_latency') {
+          socket.send(JSON.stringify({ type: 'latency_stats', ...(tracer ? tracer.snapshot() : {}) }));
+        }
       } catch (err) {
         console.error('[WS] Error parsing message:', err.message);
       }
@@ -85,6 +122,7 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
   });
 
   function handleClose(socket) {
+    liveClients.delete(socket);
     if (clients.delete(socket)) {
       wsEvents.emit('disconnect', { size: clients.size });
     }
@@ -143,6 +181,41 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
     }
   }
 
+  /**
+   * Handle history request: { varIds, from, to, maxPoints } (epoch ms)
+   */
+  async function handleGetHistory(msg, socket) {
+    try {
+      const { varIds, from, to, maxPoints } = msg;
+
+      if (typeof from !== 'number' || typeof to !== 'number' || to <= from) {
+        socket.send(JSON.stringify({
+          type: 'error',
+          message: 'Invalid range for get_history'
+        }));
+        return;
+      }
+
+      const history = await IntProcesoData.getVarsHistory(varIds, from, to, maxPoints);
+
+      socket.send(JSON.stringify({
+        type: 'history_response',
+        from,
+        to,
+        ...history
+      }));
+
+      wsEvents.emit('history_requested', { resolution: history.resolution, points: history.points.length });
+    } catch (error) {
+      console.error('[WS] Error getting history:', error.message);
+      socket.send(JSON.stringify({
+        type: 'error',
+        message: 'Failed to get history'
+      }));
+      wsEvents.emit('history_error', { error });
+    }
+  }
+
   /**
    * Handle get latest DOUT value request from client
    */
@@ -180,6 +253,94 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
     }
   }
 
+  /**
+   * Registra (o actualiza) la suscripción de un cliente al canal en vivo.
+   * msg: { channels: [índices AN0..], decim: 1 de cada N tramas }
+   */
+  function handleLiveSubscribe(msg, socket) {
+    const channels = Array.isArray(msg.channels) ? msg.channels : [];
+    let mask = 0;
+    for (const ch of channels) {
+      if (Number.isInteger(ch) && ch >= 0 && ch < LIVE_MAX_CHANNELS) mask |= 1 << ch;
+    }
+    const decim = Math.max(1, Math.min(1000, parseInt(msg.decim, 10) || 1));
+    if (!mask) {
+      socket.send(JSON.stringify({ type: 'error', message: 'Invalid channels for live_subscribe' }));
+      return;
+    }
+    liveClients.set(socket, { mask, decim, count: 0, dropped: 0, lastSentAt: 0 });
+    socket.send(JSON.stringify({ type: 'live_subscribed', mask, decim }));
+    wsEvents.emit('live_subscribe', { mask, decim, size: liveClients.size });
+  }
+
+  /**
+   * Codifica una trama para el canal en vivo con los canales de la máscara.
+   */
+  function encodeLiveSample(frame, tiempo, mask) {
+    const values = [];
+    for (let ch = 0; ch < LIVE_MAX_CHANNELS; ch++) {
+      if (mask & (1 << ch)) values.push(ch < frame.adc.length ? frame.adc[ch] : 0);
+    }
+    const buf = Buffer.alloc(LIVE_HEADER_SIZE + values.length * 2);
+    buf[0] = LIVE_MSG_SAMPLE;
+    buf[1] = frame.digital & 0xFF;
+    buf.writeUInt16LE(mask, 2);
+    buf.writeUInt32LE(liveSeq >>> 0, 4);
+    buf.writeUInt32LE(Math.max(0, Math.round(tiempo)) >>> 0, 8);
+    values.forEach((v, i) => buf.writeInt16LE(Math.max(-32768, Math.min(32767, v)), LIVE_HEADER_SIZE + i * 2));
+    return buf;
+  }
+
+  /**
+   * Publica una trama decodificada a los suscriptores del canal en vivo.
+   * Cada cliente recibe 1 de cada decim tramas; si su cola de envío supera
+   * LIVE_MAX_BUFFERED la muestra se saltea para ese cliente (SEQ delata el hueco),
+   * sin desconectarlo: recibe de nuevo en cuanto su cola baja.
+   * El mensaje se codifica una sola vez por máscara distinta.
+   * @param {Object} frame - Trama de serialListener (digital, adc)
+   * @param {number} tiempo - Tiempo relativo en ms (el mismo que se guarda en la BD)
+   * @returns {number} Clientes a los que se envió
+   */
+  function publishFrame(frame, tiempo) {
+    liveSeq = (liveSeq + 1) >>> 0;
+    if (liveClients.size === 0) return 0;
+    const encoded = new Map();
+    let delivered = 0;
+    const sentAt = Date.now();
+    for (const [socket, sub] of liveClients) {
+      if (socket.readyState !== WebSocket.OPEN) continue;
+      if (++sub.count < sub.decim) continue;
+      sub.count = 0;
+      if (socket.bufferedAmount > LIVE_MAX_BUFFERED) {
+        sub.dropped++;
+        continue;
+      }
+      let buf = encoded.get(sub.mask);
+      if (!buf) {
+        buf = encodeLiveSample(frame, tiempo, sub.mask);
+        encoded.set(sub.mask, buf);
+      }
+      socket.send(buf, { binary: true });
+      sub.lastSentAt = sentAt;
+      delivered++;
+    }
+    if (tracer && delivered > 0) {
+      const tracedAt = now();
+      if (frame.decodedAt) tracer.record('decode_ws', tracedAt - frame.decodedAt);
+      tracer.noteSend(liveSeq, tracedAt, frame.timestamp || 0);
+    }
+    return delivered;
+  }
+
+  /**
+   * Difunde un informe de entradas medidas (evento 'inputs' del listener, una vez por Ts DIP)
+   * @param {Object} report - {tick, timestamp, inputs}
+   * @returns {number} Clientes a los que se envió
+   */
+  function publishInputs(report) {
+    return broadcast({ type: 'inputs', tick: report.tick, timestamp: report.timestamp, inputs: report.inputs });
+  }
+
   /**
    * Difunde un mensaje a todos los clientes.
    */
@@ -199,16 +360,36 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
   }
 
   /**
-   * Envía filas de int_proceso_vars_data a los clientes.
+   * Clientes que dependen del polling: los que no recibieron una muestra en vivo
+   * en los últimos LIVE_STALE_MS (sin suscripción o con el canal en vivo parado).
    */
-  function broadcastVarsData(rows) {
-    if (!Array.isArray(rows) || rows.length === 0) return 0;
-    return broadcast({ type: 'vars_data', data: rows });
+  function pollingClients() {
+    const since = Date.now() - LIVE_STALE_MS;
+    const result = [];
+    for (const socket of clients) {
+      if (socket.readyState !== WebSocket.OPEN) continue;
+      const sub = liveClients.get(socket);
+      if (!sub || sub.lastSentAt < since) result.push(socket);
+    }
+    return result;
+  }
+
+  /**
+   * Envía filas de int_proceso_vars_data a los clientes que dependen del polling.
+   */
+  function broadcastVarsData(rows, targets) {
+    if (!Array.isArray(rows) || rows.length === 0 || targets.length === 0) return 0;
+    const payload = JSON.stringify({ type: 'vars_data', data: rows });
+    for (const socket of targets) socket.send(payload);
+    wsEvents.emit('broadcast', { delivered: targets.length });
+    return targets.length;
   }
 
   /**
    * Inicia un polling periodico a la BD y publica nuevas filas.
    * Se ejecuta cada intervalMs y solo emite si detecta IDs mayores a lastBroadcastId.
+   * Si ningún cliente depende del polling (todos reciben el canal en vivo, o no hay
+   * clientes) no consulta la BD; al volver a hacer falta sigue desde el id actual.
    */
   async function startVarsDataPolling(intervalMs = POLL_INTERVAL_MS) {
     if (pollTimer) return pollTimer;
@@ -218,13 +399,25 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
       pollInFlight = true;
 
       try {
+        const targets = pollingClients();
+        if (targets.length === 0) {
+          pollPaused = true;
+          return;
+        }
+        if (pollPaused) {
+          // Las filas del lapso salteado ya llegaron por el canal en vivo (o nadie las veía)
+          pollPaused = false;
+          lastBroadcastId = await IntProcesoData.getLatestVarsDataId();
+          return;
+        }
+
         // Traer todas las filas nuevas (id > lastBroadcastId) para los vars solicitados
         const rows = await IntProcesoData.getVarsDataAfterId(lastBroadcastId);
 
         if (rows.length > 0) {
           const maxId = rows[rows.length - 1].id;
           lastBroadcastId = maxId;
-          broadcastVarsData(rows);
+          broadcastVarsData(rows, targets);
         }
       } catch (err) {
         wsEvents.emit('polling_error', { error: err });
@@ -249,6 +442,7 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
     }
 
     pollInFlight = false;
+    pollPaused = false;
     lastBroadcastId = 0;
 
     await IntProcesoData.close().catch((err) =>
@@ -285,6 +479,7 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
     }
 
     clients.clear();
+    liveClients.clear();
 
     await new Promise((resolve) => wss.close(() => resolve()));
   }
@@ -293,7 +488,9 @@ function createWebSocketServer(portOrServer = DEFAULT_WS_PORT, getRelativeTime =
     server: wss,
     events: wsEvents,
     startServer,
-    stopServer
+    stopServer,
+    publishFrame,
+    publishInputs
   };
 }
 
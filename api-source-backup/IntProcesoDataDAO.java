@@ -266,6 +266,87 @@ public class IntProcesoDataDAO {
         }
     }
 
+    /**
+     * Inserta varias muestras (8 analógicas + 4 digitales cada una) con un único
+     * INSERT de múltiples filas dentro de una transacción. Pensado para escritores
+     * que agrupan muestras por ventana de tiempo en lugar de insertar una por trama.
+     * 
+     * @param tMs    Tiempos relativos en milisegundos, uno por muestra
+     * @param epochMs Hora del host de cada muestra (ms desde la época): de ella salen
+     *               fecha y hora de sus filas, no del momento del volcado
+     * @param adc    Valores analógicos consecutivos, 8 por muestra (count * 8)
+     * @param dig    Valores digitales consecutivos, 4 por muestra (count * 4)
+     * @param count  Cantidad de muestras a insertar
+     * @throws SQLException Si hay error en la operación de base de datos
+     */
+    public void insertVarsDataBatch(long[] tMs, long[] epochMs, int[] adc, int[] dig, int count)
+            throws SQLException {
+        if (count <= 0) return;
+        if (tMs == null || tMs.length < count || epochMs == null || epochMs.length < count
+                || adc == null || adc.length < count * 8
+                || dig == null || dig.length < count * 4) {
+            LOG.log(Level.WARNING, "Datos inválidos para inserción por lotes");
+            return;
+        }
+        if (currentProcesoId == null || adcVarIds == null || dinVarIds == null) {
+            setProcesoActivo(3);
+        }
+
+        // Filas por muestra con ID de variable conocido
+        int perSample = 0;
+        for (int id : adcVarIds) if (id != 0) perSample++;
+        for (int id : dinVarIds) if (id != 0) perSample++;
+        if (perSample == 0) return;
+
+        StringBuilder sql = new StringBuilder(
+                "INSERT INTO int_proceso_vars_data (int_proceso_vars_id, valor, tiempo, fecha, hora) VALUES ");
+        int rows = perSample * count;
+        for (int r = 0; r < rows; r++) {
+            sql.append(r == 0 ? "(?, ?, ?, ?, ?)" : ", (?, ?, ?, ?, ?)");
+        }
+
+        try (Connection conn = dbConnection.getConnection();
+             PreparedStatement ps = conn.prepareStatement(sql.toString())) {
+
+            conn.setAutoCommit(false);
+
+            try {
+                int p = 1;
+                for (int s = 0; s < count; s++) {
+                    int tiempoMs = (int) tMs[s];
+                    Date fecha = new Date(epochMs[s]);
+                    Time hora = new Time(epochMs[s]);
+                    for (int i = 0; i < 8; i++) {
+                        if (adcVarIds[i] == 0) continue;
+                        ps.setInt(p++, adcVarIds[i]);
+                        ps.setInt(p++, adc[s * 8 + i]);
+                        ps.setInt(p++, tiempoMs);
+                        ps.setDate(p++, fecha);
+                        ps.setTime(p++, hora);
+                    }
+                    for (int i = 0; i < 4; i++) {
+                        if (dinVarIds[i] == 0) continue;
+                        ps.setInt(p++, dinVarIds[i]);
+                        ps.setInt(p++, dig[s * 4 + i]);
+                        ps.setInt(p++, tiempoMs);
+                        ps.setDate(p++, fecha);
+                        ps.setTime(p++, hora);
+                    }
+                }
+                ps.executeUpdate();
+                conn.commit();
+                LOG.log(Level.FINE, "Insertadas {0} muestras ({1} filas) para proceso {2}",
+                        new Object[]{count, rows, currentProcesoId});
+
+            } catch (SQLException e) {
+                conn.rollback();
+                throw e;
+            } finally {
+                conn.setAutoCommit(true);
+            }
+        }
+    }
+
     /**
      * Obtiene un registro de datos de variable por su ID.
      * 
@@ -0,0 +1,151 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+Tabla de canales analógicos resuelta en compilación.
+
+Cada canal es un tipo con:
+  - read():        una conversión de 10 bits.
+  - REFS:          bits REFS1:0 de ADMUX con que convierte (AVcc o 1.1 V interna).
+  - DESCRIPTOR:    byte que lo identifica ante el host (0x11 Get channels):
+                   nibble alto = tipo (CH_KIND_*), nibble bajo = índice.
+
+ChannelTable<Ch...> expande el pack en un inicializador de arreglo, así que la
+lectura del conjunto completo es una secuencia fija de llamadas a read(), sin
+bucle ni switch: cada canal agregado cuesta solo su propia conversión.
+
+Cambio de referencia: el UNO tiene 100 nF en AREF, y pasar de AVcc (5 V) a 1.1 V
+o volver exige cargar o descargar ese capacitor. Eso lleva milisegundos, no los
+µs de un cambio de MUX, y una conversión descartada no alcanza. adcSelectRef()
+espera ADC_REF_SETTLE_MS solo cuando REFS cambia de verdad. readAll() lee primero
+los canales de la referencia que ya está puesta y después los de la otra, así que
+en un barrido la referencia cambia como mucho una vez: con el canal de
+temperatura (uno_ext), un barrido cuesta ~10 ms más y el Ts ADC efectivo no baja
+de eso. ADC_REF_SETTLE_MS no está medido en banco: es una estimación conservadora
+(unos 7 τ para 10 bits) que conviene verificar con un osciloscopio en AREF.
+*/
+
+static const uint8_t CH_KIND_PIN     = 0x0; // entrada analógica An (índice = n)
+static const uint8_t CH_KIND_TEMP    = 0x1; // sensor de temperatura interno (ref. 1.1 V)
+static const uint8_t CH_KIND_BANDGAP = 0x2; // bandgap 1.1 V medido contra AVcc
+
+// Espera tras cambiar solo el MUX a una fuente interna (arranque del bandgap/sensor)
+static const uint16_t ADC_INTERNAL_SETTLE_US = 250;
+// Espera tras cambiar REFS: carga/descarga de los 100 nF de AREF (ver arriba)
+static const uint8_t ADC_REF_SETTLE_MS = 10;
+static const uint8_t ADC_REFS_MASK = _BV(REFS1) | _BV(REFS0);
+static const uint8_t ADC_REFS_AVCC = _BV(REFS0);                // analogReference(DEFAULT)
+static const uint8_t ADC_REFS_INTERNAL = _BV(REFS1) | _BV(REFS0); // 1.1 V
+
+/**
+ * @brief Inicia una conversión y espera el resultado.
+ */
+static inline uint16_t adcConvert() {
+  ADCSRA |= _BV(ADSC);
+  while (bit_is_set(ADCSRA, ADSC)) {}
+  return ADCW;
+}
+
+/**
+ * @brief Deja puesta la referencia refs; si cambia, espera a que AREF se asiente
+ * y descarta una conversión. Sin cambio no cuesta nada.
+ * @param refs Bits REFS1:0 (ADC_REFS_*).
+ */
+static inline void adcSelectRef(uint8_t refs) {
+  if ((ADMUX & ADC_REFS_MASK) == refs) return;
+  ADMUX = (uint8_t)((ADMUX & ~ADC_REFS_MASK) | refs);
+  delay(ADC_REF_SETTLE_MS);
+  adcConvert();
+}
+
+/**
+ * @brief Convierte una fuente seleccionada a mano en ADMUX (canales internos).
+ * La referencia se asienta con adcSelectRef(); tras el cambio de MUX la primera
+ * conversión se descarta. analogRead() vuelve a escribir ADMUX completo, así que
+ * no hace falta restaurarlo.
+ * @param admux Valor de ADMUX (referencia + MUX).
+ * @return Lectura de 10 bits.
+ */
+static inline uint16_t adcConvertMux(uint8_t admux) {
+  adcSelectRef(admux & ADC_REFS_MASK);
+  ADMUX = admux;
+  delayMicroseconds(ADC_INTERNAL_SETTLE_US);
+  adcConvert();
+  return adcConvert();
+}
+
+/**
+ * @brief Entrada analógica An (A0..A5 en el UNO).
+ */
+template <uint8_t N>
+struct PinChannel {
+  static const uint8_t DESCRIPTOR = (CH_KIND_PIN << 4) | N;
+  static const uint8_t REFS = ADC_REFS_AVCC;
+  static uint16_t read() {
+    adcSelectRef(REFS);
+    return (uint16_t)analogRead(A0 + N);
+  }
+};
+
+/**
+ * @brief Sensor de temperatura interno del ATmega328P (MUX=1000, ref. interna 1.1 V).
+ * Cuenta cruda; la conversión a °C depende de cada chip (≈1 mV/°C, offset a calibrar).
+ */
+struct TempChannel {
+  static const uint8_t DESCRIPTOR = (CH_KIND_TEMP << 4);
+  static const uint8_t REFS = ADC_REFS_INTERNAL;
+  static uint16_t read() { return adcConvertMux(REFS | _BV(MUX3)); }
+};
+
+/**
+ * @brief Bandgap interno de 1.1 V medido contra AVcc (MUX=1110).
+ * Permite estimar Vcc = 1.1 V * 1023 / lectura para corrección ratiométrica.
+ */
+struct BandgapChannel {
+  static const uint8_t DESCRIPTOR = (CH_KIND_BANDGAP << 4);
+  static const uint8_t REFS = ADC_REFS_AVCC;
+  static uint16_t read() {
+    return adcConvertMux(REFS | _BV(MUX3) | _BV(MUX2) | _BV(MUX1));
+  }
+};
+
+/**
+ * @brief Conjunto de canales fijado en compilación.
+ * @tparam Ch Tipos de canal, en el orden en que viajan en las tramas.
+ */
+template <typename... Ch>
+struct ChannelTable {
+  static const uint8_t COUNT = sizeof...(Ch);
+
+  /**
+   * @brief Lee todos los canales; cada lectura queda en su posición de trama.
+   * Primero los de la referencia puesta, después los de la otra: como mucho un
+   * cambio de referencia por barrido (el siguiente empieza por los últimos).
+   * @param out Destino de COUNT lecturas.
+   */
+  static void readAll(uint16_t* out) {
+    uint8_t refs = ADMUX & ADC_REFS_MASK;
+    readPass(out, refs, true);
+    readPass(out, refs, false);
+  }
+
+  /**
+   * @brief Lee los canales cuya referencia es (same) o no es (!same) refs.
+   */
+  static void readPass(uint16_t* out, uint8_t refs, bool same) {
+    uint8_t i = 0;
+    // El orden de evaluación de un inicializador entre llaves es de izquierda a derecha
+    const uint8_t expand[] = {0, (((Ch::REFS == refs) == same ? (void)(out[i] = Ch::read()) : (void)0),
+                                  ++i, (uint8_t)0)...};
+    (void)expand;
+  }
+
+  /**
+   * @brief Copia los descriptores de canal (un byte por canal).
+   * @param out Destino de COUNT bytes.
+   */
+  static void describe(uint8_t* out) {
+    const uint8_t d[] = {Ch::DESCRIPTOR...};
+    for (uint8_t i = 0; i < COUNT; ++i) out[i] = d[i];
+  }
+};
@@ -0,0 +1,124 @@
+"""
+Auditoría de memoria del firmware (extra_scripts de PlatformIO)
+
+- Tras enlazar cada build muestra la RAM estática (.data + .bss + .noinit) y la
+  flash (.text + .data). Si el entorno define custom_ram_budget /
+  custom_flash_budget en platformio.ini las compara y el build falla si alguna se
+  pasa; sin presupuesto solo informa. El workflow .github/workflows/firmware.yml
+  corre `pio run` en cada push y pull request.
+- `pio run -t memaudit` muestra además, ordenados por tamaño:
+    * símbolos en RAM y en flash (avr-nm)
+    * marco de pila de cada función (.su de -fstack-usage)
+  La pila real en ejecución se consulta con el comando 0x1B (Get mem).
+"""
+
+import glob
+import os
+import subprocess
+
+Import("env")  # noqa: F821 (lo inyecta PlatformIO)
+
+TOP_SYMBOLS = 25
+RAM_TYPES = "bBdDvV"        # .bss, .data y débiles en RAM
+FLASH_TYPES = "tTrRwW"
+
+
+def _avr_tool(name):
+    toolchain = env.PioPlatform().get_package_dir("toolchain-atmelavr")
+    return os.path.join(toolchain, "bin", name) if toolchain else name
+
+
+def _budget(option):
+    value = env.GetProjectOption(option, "")
+    return int(value, 0) if value else None
+
+
+def _section_sizes(elf):
+    """Tamaño por sección según avr-size -A"""
+    out = subprocess.check_output([_avr_tool("avr-size"), "-A", elf], text=True)
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def _usage(elf):
+    s = _section_sizes(elf)
+    ram = s.get(".data", 0) + s.get(".bss", 0) + s.get(".noinit", 0)
+    flash = s.get(".text", 0) + s.get(".data", 0)
+    return ram, flash
+
+
+def check_budget(target, source, env):
+    elf = str(target[0])
+    ram, flash = _usage(elf)
+    failed = False
+    for label, used, option in (("RAM estática", ram, "custom_ram_budget"),
+                                ("Flash", flash, "custom_flash_budget")):
+        budget = _budget(option)
+        if budget is None:
+            print("[mem] %-12s %6d bytes (sin presupuesto)" % (label, used))
+            continue
+        status = "OK" if used <= budget else "EXCEDIDO"
+        print("[mem] %-12s %6d / %6d bytes (margen %d)  %s"
+              % (label, used, budget, budget - used, status))
+        failed = failed or used > budget
+    return 1 if failed else 0
+
+
+def _symbols(elf):
+    out = subprocess.check_output([_avr_tool("avr-nm"), "-C", "-S", "--size-sort", elf], text=True)
+    ram, flash = [], []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4:
+            continue
+        size, kind, name = int(parts[1], 16), parts[2], parts[3]
+        if kind in RAM_TYPES:
+            ram.append((size, name))
+        elif kind in FLASH_TYPES:
+            flash.append((size, name))
+    return sorted(ram, reverse=True), sorted(flash, reverse=True)
+
+
+def _stack_frames(build_dir):
+    """Marcos de pila de las .su: (bytes, función, calificador)"""
+    frames = []
+    for su in glob.glob(os.path.join(build_dir, "**", "*.su"), recursive=True):
+        with open(su) as f:
+            for line in f:
+                parts = line.rstrip("\n").split("\t")
+                if len(parts) == 3:
+                    frames.append((int(parts[1]), parts[0].rsplit(":", 1)[-1], parts[2]))
+    return sorted(frames, reverse=True)
+
+
+def mem_audit(target, source, env):
+    elf = str(source[0])
+    ram, flash = _usage(elf)
+    ram_syms, flash_syms = _symbols(elf)
+    print("\nRAM estática: %d bytes, flash: %d bytes" % (ram, flash))
+    print("\nSímbolos en RAM")
+    for size, name in ram_syms[:TOP_SYMBOLS]:
+        print("  %6d  %s" % (size, name))
+    print("\nSímbolos en flash")
+    for size, name in flash_syms[:TOP_SYMBOLS]:
+        print("  %6d  %s" % (size, name))
+    frames = _stack_frames(env.subst("$BUILD_DIR"))
+    print("\nPila por función (-fstack-usage)")
+    if not frames:
+        print("  sin archivos .su: falta -fstack-usage en build_flags")
+    for size, func, qualifier in frames[:TOP_SYMBOLS]:
+        print("  %6d  %-40s %s" % (size, func, qualifier))
+    return check_budget([source[0]], source, env)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_budget)
+env.AddCustomTarget(
+    name="memaudit",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[mem_audit],
+    title="Memory audit",
+    description="RAM/flash por símbolo y pila por función")
@@ -1,4 +1,9 @@
 #include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include "channels.h"
 
 /*
 Resumen y protocolo:
@@ -6,7 +11,8 @@ Resumen y protocolo:
 - Pines (ajustables según tu hardware):
   - LEDs (salidas digitales): D8, D9, D10, D11
   - DIP-SWITCH (entradas digitales con pull-up): D2, D3, D4, D5 (activo en LOW -> bit '1')
-  - Analógicos: A0, A1, A2, A3
+  - Analógicos: A0, A1, A2, A3 (con LAB_EXTENDED_CHANNELS además A4, A5, temperatura
+    interna y bandgap 1.1 V; ver include/channels.h y 0x11)
 - Muestreo: no bloqueante con millis(), períodos configurables independientes (ms).
 - Trama de datos continua (#47):
   [0x7A][0x7B][DIGITAL(1B)][AN0_L][AN0_H]...[AN3_H][AN4_L][AN4_H]...[AN7_H][0x7C]
@@ -18,6 +24,10 @@ Resumen y protocolo:
   Respuesta: [0x55][0xAB][STATUS][CMD][LEN][PAYLOAD...][CHK]
   - CHK = XOR de todos los bytes desde CMD (en comando) o desde STATUS (en respuesta) hasta el final del PAYLOAD.
   - STATUS: 0x00=OK, 0x01=CHK inválido, 0x02=Parámetro inválido, 0x03=CMD desconocido
+  Direccionado (bus multipunto, ver "Bus multipunto"):
+  Comando: [0x55][0xAC][ADDR][CMD][LEN][PAYLOAD...][CHK]   (ADDR 0xFF = difusión)
+  Respuesta: [0x55][0xAD][ADDR][STATUS][CMD][LEN][PAYLOAD...][CHK]
+  - CHK incluye ADDR. Las tramas de datos van precedidas de [0x7A][0x76][ADDR][0x7C].
   CMDs:
     0x01 Set LED mask (LEN=1: mask 0..15). Resp payload: 1B mask aplicado.
     0x02 Get DIP (LEN=0). Resp payload: 1B DIP mask.
@@ -28,6 +38,35 @@ Resumen y protocolo:
     0x07 Get info (LEN=0). Resp payload: ASCII "LAB2 v1.0".
     0x08 Set Tsample ADC ms (LEN=2: uint16 LE). Resp payload: uint16 LE aplicado.
     0x09 Get Tsample ADC (LEN=0). Resp payload: uint16 LE actual.
+    0x0A Ready (MCU->PC, no solicitado). Se emite en setup() al levantar la UART.
+         Payload: [PROTO_VER][CAPS][BOOT_L][BOOT_H][RESET].
+    0x0B Sync (LEN=1..4: token). Resp payload: token + tick ms (uint32 LE).
+    0x0C Get caps (LEN=0). Resp payload: descriptor binario (ver detalle).
+    0x0D Set frame format (LEN=1: 0=legacy 20B, 1=compacta 11B, 2=dividida). Resp payload: 1B formato aplicado.
+    0x0E Get frame format (LEN=0). Resp payload: 1B formato actual.
+    0x0F Set adaptive rate (LEN=1: 0=off,!=0=on). Resp payload: 1B estado.
+    0x10 Get rate (LEN=0) / evento Rate (MCU->PC, no solicitado al cambiar la tasa).
+         Payload: [FMT][DECIM][TEFF_L][TEFF_H][SKIP_L][SKIP_H].
+    0x11 Get channels (LEN=0). Resp payload: [N][DESC0..DESCN-1].
+    0x12 Set calibrated output (LEN=1: 0=crudo,!=0=calibrado). Resp payload: 1B estado.
+    0x13 Get calibration (LEN=1: canal). Resp payload: tabla del canal (ver detalle).
+    0x14 Set calibration (LEN=3+4n: canal, unidad, n, pares). Resp payload: tabla aplicada.
+    0x15 Exec at (LEN=5..13: tick uint32 LE, CMD, payload). Resp payload: [ID][EN_COLA].
+    0x16 Executed (MCU->PC, no solicitado al ejecutar un 0x15). Payload: [ID][CMD][TICK uint32 LE].
+    0x17 Cancel scheduled (LEN=0). Resp payload: 1B comandos descartados.
+    0x18 Link test (LEN=5: modo, bytes uint32 LE). Resp payload: eco del pedido.
+    0x19 Link result (MCU->PC, no solicitado al terminar 0x18). Ver detalle.
+    0x1A Set generator (LEN=8: destino, onda, período, amplitud, offset; LEN=0 apaga todo).
+         Resp payload: eco de lo aplicado.
+    0x1B Get mem (LEN=0). Resp payload: [FREE][STACK_LIBRE][ESTATICA][RAM] (uint16 LE c/u).
+    0x1C Set input mode (LEN=2: entrada DIP, modo; LEN=0 consulta). Resp payload: [MODOS].
+    0x1D Bulk open (LEN=6: dirección, objeto, offset, longitud). Resp payload: eco + [BLOQUE][VENTANA].
+    0x1E Bulk data (bloque con offset y CRC-16; MCU->PC en descargas, PC->MCU en cargas).
+    0x1F Bulk ack (LEN=3: offset siguiente, reenvíos). Sin respuesta.
+    0x20 Bulk end (LEN=0; también evento MCU->PC al terminar una descarga). Ver detalle.
+    0x21 Set address (LEN=3: dirección, ranuras, ms por ranura; LEN=0 consulta).
+         Resp payload: [ADDR][RANURAS][MS].
+    0x22 Bus sync (LEN=4: tick uint32 LE). Sin respuesta.
 */
 
 /*
@@ -51,33 +90,639 @@ Comandos (PC->MCU): 55 AA CMD LEN PAYLOAD CHK
 - 0x07 Get info (LEN=0).
 - 0x08 Set Ts ADC (LEN=2, uint16 LE).
 - 0x09 Get Ts ADC (LEN=0).
+- 0x0A Ready (no solicitado): 55 AB 00 0A 05 [PROTO_VER][CAPS][BOOT_L][BOOT_H][RESET] CHK.
+  BOOT = contador de arranques persistido en EEPROM (uint16 LE).
+  RESET: bits 0..3 = causa del reset (MCUSR: 0x01 encendido, 0x02 externo/DTR,
+  0x04 brown-out, 0x08 watchdog; 0 si el bootloader no la conserva),
+  bit 7 = reinicio en caliente (estado restaurado, ver "Watchdog").
+- 0x0B Sync (LEN=1..4, token). Resp: [token...][TICK0..TICK3].
+
+- 0x0C Get caps (LEN=0). Resp (little endian):
+  [0]=PROTO_VER, [1]=FORMATOS (bit n = formato n soportado), [2]=N canales ADC en trama,
+  [3]=bits ADC, [4]=N DIP, [5]=N LED, [6..9]=Ts mínimo (us), [10..13]=Ts máximo (us),
+  [14..15]=buffer RX UART, [16..17]=buffer TX UART, [18]=payload máx. de comando,
+  [19]=N baudios, [20..]=baudios soportados (uint32 c/u).
+- 0x11 Get channels (LEN=0). Resp: [N][DESC...], un byte por canal en el orden de
+  las tramas: nibble alto = tipo (0 = pin An, 1 = temperatura interna, 2 = bandgap
+  1.1 V contra AVcc), nibble bajo = índice (n de An).
+- 0x0D Set frame format (LEN=1). 0x0E Get frame format (LEN=0).
+  Con modo adaptativo activo, 0x0E devuelve el formato efectivo (puede ser compacta
+  aunque el host pidiera legacy).
+- 0x0F Set adaptive rate (LEN=1, 0/1).
+- 0x10 Get rate (LEN=0). Resp y evento: [FMT][DECIM][TEFF ms uint16][SKIP uint16].
+  FMT = formato efectivo, DECIM = 1 de cada N períodos se transmite,
+  TEFF = período efectivo de envío, SKIP = ranuras omitidas por buffer TX lleno
+  (acumulado, da la vuelta en 65535).
+- 0x12 Set calibrated output (LEN=1, 0/1). Con 1, las tramas compacta y analógica
+  pasan a sus variantes calibradas (ver formatos); la legacy no cambia.
+- 0x13 Get calibration (LEN=1: [CH]). Resp: [CH][SRC][UNIT][N][RAW0 uint16][VAL0 int16]...
+  SRC: 0 = tabla por defecto (PROGMEM), 1 = EEPROM. UNIT: 0 = cuentas, 1 = mV,
+  2 = centésimas de °C.
+- 0x14 Set calibration (LEN=3+4N: [CH][UNIT][N][RAW0][VAL0]...). N = 2..4 puntos con
+  RAW estrictamente creciente (<= 1023); se guarda en EEPROM. N = 0 borra la tabla
+  del canal y vuelve a la de por defecto. Resp: igual que 0x13.
+- 0x15 Exec at (LEN=5+L: [T0..T3][CMD][PAYLOAD(L)], L <= 8). Encola CMD para ejecutarlo
+  cuando millis() alcance T (mismo reloj que el tick de 0x0B). Resp inmediata:
+  [ID][EN_COLA]; cola llena, CMD = 0x15/0x17 o L > 8 -> 0x02. T ya pasado -> se
+  ejecuta en la siguiente pasada del bucle.
+- 0x16 Executed (no solicitado): [ID][CMD][TICK uint32 LE] con el millis() real de la
+  ejecución. Sale justo después de la respuesta normal del CMD ejecutado.
+- 0x17 Cancel scheduled (LEN=0). Vacía la cola. Resp: [DESCARTADOS].
+- 0x18 Link test (LEN=5: [MODO][COUNT uint32 LE], COUNT > 0). Resp: [MODO][COUNT].
+  MODO 0 = MCU->PC: tras la respuesta el micro envía COUNT bytes PRBS-15 a tasa de línea.
+  MODO 1 = PC->MCU: el micro verifica los COUNT bytes PRBS-15 que envíe el host
+  (termina al recibirlos o tras LINK_IDLE_MS sin datos).
+- 0x19 Link result (no solicitado): [MODO][BYTES u32][ERR u32][FALTAN u32][T_US u32].
+  BYTES = enviados (modo 0) o recibidos (modo 1), ERR = bytes con algún bit distinto
+  del predicho, FALTAN = COUNT - BYTES (desbordes/pérdidas en recepción),
+  T_US = µs entre el primer y el último byte (modo 0: hasta vaciar el buffer TX).
+- 0x1A Set generator (LEN=8: [DEST][ONDA][PER u16][AMP u16][OFS u16], LE).
+  DEST = canal 0..N-1 o 0xFF = DIP. ONDA: 0 = entrada real, 1 = rampa, 2 = seno,
+  3 = escalón (cuadrada), 4 = PRBS, 5 = contador. PER en muestras (>= 1 salvo ONDA 0).
+  LEN=0 devuelve todas las entradas a su lectura real. Resp: eco de los 8 bytes.
+- 0x1B Get mem (LEN=0). Resp: [FREE u16][STACK_LIBRE u16][ESTATICA u16][RAM u16].
+  FREE = bytes entre el final de la RAM estática y el puntero de pila actual,
+  STACK_LIBRE = bytes de ese hueco que la pila nunca tocó desde el arranque (marca
+  de agua del pintado), ESTATICA = .data + .bss + .noinit, RAM = SRAM total.
+  No tiene bit en CAPS (el byte está completo): un firmware previo responde 0x03.
+- 0x1C Set input mode (LEN=2: [ENTRADA 0..3][MODO]). MODO: 0 = nivel, 1 = contador
+  de flancos (totalizador), 2 = período/frecuencia. Cambiar el modo reinicia la
+  cuenta de esa entrada. LEN=0 solo consulta. Resp: [MODOS], 2 bits por entrada
+  (entrada i en los bits 2i..2i+1). Sin bit en CAPS, igual que 0x1B.
+- 0x1D Bulk open (LEN=6: [DIR][OBJ][OFS u16][LEN u16]). DIR: 0 = descarga (MCU->PC),
+  1 = carga (PC->MCU). OBJ: 0 = EEPROM (1 KB, lectura/escritura), 1 = flash (32 KB,
+  solo descarga). OFS + LEN dentro del objeto, LEN > 0. Resp: [DIR][OBJ][OFS][LEN]
+  [BLOQUE][VENTANA] con los datos por bloque y los bloques en vuelo de esa dirección.
+  Un 0x1D con otra transferencia abierta la reemplaza (sin evento 0x20).
+- 0x1E Bulk data: [OFS u16][DATOS (BLOQUE, el último puede ser menor)][CRC u16],
+  CRC-16 (0xA001 reflejado, inicio 0xFFFF, como el bloque retenido) de OFS + DATOS.
+  Descarga: sale como respuesta no solicitada 55 AB 00 1E. Carga: comando del host;
+  Resp: [OFS] con 0x00 (escrito) o 0x01 (CRC del bloque inválido: reenviar ese OFS).
+- 0x1F Bulk ack (LEN=3: [SIGUIENTE u16][REENVIO]) durante una descarga. SIGUIENTE =
+  offset del primer bloque aún no recibido (todo lo anterior llegó), REENVIO bit i =
+  volver a enviar el bloque SIGUIENTE + i*BLOQUE. No tiene respuesta: la
+  confirmación es el propio flujo de bloques (0x02 si no hay descarga abierta).
+- 0x20 Bulk end (LEN=0). Cierra la transferencia: en una carga la da por terminada
+  (recarga las tablas de calibración), en una descarga la cancela. Resp y evento
+  (descarga terminada o abortada): [RESULTADO][DIR][OBJ][BYTES u16][REENVIOS u16].
+  RESULTADO: 0 = completa, 1 = incompleta (cancelada o faltan bloques), 2 = abortada
+  por timeout. BYTES = bytes confirmados (descarga) o escritos (carga).
+- 0x21 Set address (LEN=3: [ADDR][RANURAS][MS]). ADDR 0..254 (0 = sin asignar),
+  RANURAS = placas del bus (0 o 1 = enlace punto a punto, sin turnos; 2..BUS_SLOTS_MAX
+  = bus multipunto con 1 <= ADDR <= RANURAS), MS = duración de cada ranura (>=
+  BUS_SLOT_MIN_MS). Se guarda en EEPROM. Rechazado (0x02) si llega por difusión o,
+  para pasar al bus, con formato dividido, prueba de enlace o transferencia en bloques
+  activas. La respuesta sale todavía con la dirección anterior. LEN=0 solo consulta.
+  Sin bit en CAPS: un firmware previo responde 0x03 (y no reconoce 55 AC).
+- 0x22 Bus sync (LEN=4: [TICK u32]). Pone millis() en TICK y reinicia las fases de
+  muestreo y de envío en ese instante; por difusión alinea el reloj de todas las
+  placas (mismo TICK en las tramas, mismos instantes de muestreo y de turno). Nunca
+  se responde.
+
+Formatos de trama de datos
+- 0 (legacy, 20 bytes): descrito arriba. Formato por defecto al arrancar.
+- 1 (compacta, 6 + ceil(N*10/8) bytes; 11 con los 4 canales por defecto):
+  [0]=0x7A, [1]=0x7D, [2..3]=TICK (ms del muestreo ADC, uint16 LE), [4]=DIGITAL,
+  [5..]=canales 0..N-1 empaquetados a 10 bits (LSB primero: canal 0 = bits 0..9,
+  canal 1 = 10..19, ...), [último]=0x7C. AN4..AN7 (/2) no se envían: el host los
+  deriva como ANi/2 de los canales 0..3. N sale de 0x0C [2] y 0x11.
+  La trama legacy lleva siempre solo los canales 0..3.
+- 2 (dividida): dos tramas independientes, cada una con su propio período.
+  Analógica (5 + ceil(N*10/8) bytes; 10 por defecto, cada Ts ADC):
+    [0]=0x7A, [1]=0x7E, [2..3]=TICK, [4..]=canales 0..N-1 a 10 bits, [último]=0x7C.
+  Digital (5 bytes, cada Ts DIP y de inmediato al cambiar los LEDs):
+    [0]=0x7A, [1]=0x7F, [2]=DIGITAL, [3]=SEQ (contador de tramas digitales, uint8),
+    [4]=0x7C. El host combina la última digital con la última analógica (la fila
+  lleva el TICK de esa analógica); SEQ permite detectar pérdidas.
+- Variantes calibradas (0x12 = 1): mismos campos, con cada canal como int16 LE en la
+  unidad de su tabla (0x13) en lugar de 10 bits empaquetados.
+    Compacta calibrada (6 + 2N bytes): [0]=0x7A, [1]=0x79, [2..3]=TICK, [4]=DIGITAL,
+      [5..]=canales 0..N-1 (int16 LE), [último]=0x7C.
+    Analógica calibrada (5 + 2N bytes): [0]=0x7A, [1]=0x78, [2..3]=TICK,
+      [4..]=canales 0..N-1 (int16 LE), [último]=0x7C.
+- Trama de entradas (22 bytes, con streaming y alguna entrada en modo 1 o 2, una
+  por Ts DIP y en cualquier formato): [0]=0x7A, [1]=0x77, [2..3]=TICK (ms del
+  informe), [4]=MODOS (como en 0x1C), [5..20]=VAL0..VAL3 (uint32 LE), [21]=0x7C.
+  VAL según el modo de la entrada: nivel 0/1, flancos acumulados (da la vuelta en
+  2^32) o período medio en µs de los flancos desde el informe anterior (0 si en
+  ese intervalo no se completó ningún período; frecuencia = 10^6 / VAL Hz).
+
+Medición de frecuencia/período (0x1C)
+- Las entradas en modo 1/2 activan su interrupción de cambio de pin (PCINT2, puerto
+  D: el DIP está en D2..D5). La ISR solo cuenta los flancos de activación (bajada,
+  el DIP es activo en LOW) y guarda el micros() del último; el bucle calcula el
+  período medio al armar la trama, así una señal de kHz cuesta un valor por Ts DIP.
+- Resolución de micros(): 4 µs a 16 MHz. Tasa máxima del orden de decenas de kHz
+  (la ISR compite con la del Timer0 y la UART).
+- El byte DIGITAL de las tramas de datos sigue llevando el nivel de las 4 entradas.
+
+Calibración (0x12..0x14)
+- Cada canal tiene una tabla lineal por tramos de 2..4 puntos (RAW -> VAL, enteros);
+  fuera del rango se extrapola con el tramo extremo y el resultado se satura a int16.
+- Por defecto (PROGMEM) según el tipo de canal: pin An 0..1023 -> 0..5000 mV, sensor
+  de temperatura con la curva típica de la hoja de datos (centésimas de °C) y
+  bandgap -> Vcc en mV. Una tabla escrita con 0x14 en EEPROM tiene prioridad.
+- Las tablas se copian a RAM al arrancar y la conversión se hace al armar la trama,
+  sobre la misma muestra coherente: el host ya no convierte cuentas.
+
+Control de tasa adaptativo (0x0F)
+- Sin modo adaptativo el envío es el original: Serial.write() bloquea si el buffer TX
+  está lleno y los períodos se alargan sin aviso.
+- Con modo adaptativo nunca se bloquea: si en la ranura de envío no cabe una trama
+  completa en el buffer TX (availableForWrite) la muestra va a la cola de muestras
+  (ver "Memoria"); con la cola llena la ranura se omite y se cuenta.
+- Presupuesto: al cambiar Ts o formato se calcula el menor DECIM (potencia de 2, máx. 64)
+  cuya tasa en bytes/s cabe en el 75% del enlace; si con legacy hace falta diezmar,
+  se pasa primero a la trama compacta. En formato dividido solo se diezman las
+  tramas analógicas (período base = Ts ADC); las digitales no se omiten.
+- Realimentación por ventanas de 16 ranuras: una ventana con omisiones pasa a compacta
+  o duplica DECIM; 4 ventanas seguidas con ocupación media baja deshacen un paso
+  (DECIM/2 y, por último, el formato pedido por el host).
+- Cada cambio se anuncia con el evento 0x10. La trama compacta lleva el tick del
+  muestreo, así que las marcas de tiempo del host siguen siendo correctas.
+
+Muestra consistente (seqlock)
+- La adquisición publica DIP/LED, AN0..AN3 y el tick ADC en un único registro
+  (sampleRec) protegido por un contador de secuencia: impar = escritura en curso.
+- Cada escritor hace su copia corta con interrupciones deshabilitadas (pocos ciclos),
+  así puede moverse a una ISR sin cambiar nada más.
+- La transmisión copia el registro sin deshabilitar interrupciones y repite la copia
+  si la secuencia cambió entre el inicio y el fin: cada trama sale de una sola
+  muestra coherente.
+
+Comandos programados (0x15)
+- Cola de EXEC_QUEUE_LEN comandos ordenada por tick. El bucle la atiende al inicio de
+  cada pasada, antes de los muestreos: un comando programado para T se aplica antes
+  de la muestra tomada en T, con la precisión de una pasada del bucle (<1 ms) en
+  lugar del jitter USB/host.
+- El host obtiene el reloj del micro con 0x0B (o con el TICK de las tramas) y elige
+  T alineado a una muestra: T = tick de trama + k * Ts.
+
+Prueba de enlace (0x18)
+- Patrón PRBS-15 (x^15 + x^14 + 1), bits MSB primero. El verificador es
+  autosincronizante: predice cada bit con los 15 anteriores recibidos, así que no
+  necesita semilla y se recupera solo tras un byte perdido (cuenta una ráfaga de error).
+- Durante la prueba el streaming se suspende y se restablece al terminar. En modo 0
+  el bucle queda ocupado en el envío (no hay muestreos) hasta terminar.
+
+Generador de señales (0x1A)
+- Sustituye el resultado de la lectura (analogRead/digitalRead) de un canal o del DIP
+  por una señal determinista función del número de muestra n (fase = n mod PER):
+    rampa    OFS + AMP * fase / PER
+    seno     OFS + AMP * sin(2π fase / PER)   (tabla de cuarto de onda en PROGMEM)
+    escalón  OFS durante la primera mitad del período, OFS + AMP en la segunda
+    PRBS     OFS u OFS + AMP según un PRBS-15 (un bit por muestra)
+    contador (OFS + fase), da la vuelta en PER
+  El resultado se satura a 0..1023 (0..15 en el DIP). La conversión real se sigue
+  haciendo, así la carga del micro y los tiempos son los de una adquisición normal.
+- La tasa es la de muestreo configurada (0x03/0x08): la señal avanza un paso por
+  muestra, así que cada etapa del host puede compararse contra el valor esperado.
+
+Transferencia en bloques (0x1D..0x20)
+- Para volcar o restaurar objetos más grandes que un comando (EEPROM con las tablas
+  de calibración y el contador de arranques, imagen de la flash para verificarla):
+  bloques con offset y CRC-16 propio, ventana deslizante y reenvío selectivo.
+- Descarga: el micro envía hasta BULK_TX_WINDOW bloques sin confirmar, releyendo
+  cada bloque de su origen (no hay copia en RAM), así un reenvío no cuesta memoria.
+  El host confirma con 0x1F en cuanto recibe cada bloque y pide en REENVIO los que
+  faltan o llegaron con CRC inválido; con la ventana mayor que la latencia USB el
+  enlace no se detiene (~76% de la línea con bloques de 32 bytes; BULK_TX_CHUNK pasa
+  a 64, ~86%, si SERIAL_TX_BUFFER_SIZE lo admite). Sin 0x1F durante
+  BULK_TIMEOUT_MS se reenvía toda la ventana; tras BULK_MAX_TIMEOUTS seguidos se
+  aborta.
+- Carga: el host mantiene hasta BULK_RX_WINDOW bloques en vuelo: es lo que cabe en
+  el buffer RX de la UART mientras el micro escribe un bloque en EEPROM (~3.4 ms por
+  byte que cambia). Cada bloque se escribe en cuanto llega (eeprom_update, escritura
+  idempotente: un duplicado no hace daño) y se confirma por su OFS. Sin bloques
+  durante BULK_IDLE_MS la carga se aborta.
+- El streaming se suspende mientras hay una transferencia abierta y se restablece al
+  cerrarla.
+
+Bus multipunto (0x21, 0x22, cabeceras 55 AC / 55 AD)
+- Varias placas en un bus RS-485 de 4 hilos: el host transmite por su par y todas lo
+  escuchan; las placas comparten el par de retorno, con un transceptor de dirección
+  automática (el firmware no maneja DE). Solo las transmisiones de las placas
+  pueden chocar entre sí.
+- Cada placa atiende los comandos 55 AC con su ADDR o con 0xFF (difusión). Fuera del
+  bus (RANURAS <= 1) acepta además la cabecera 55 AA y responde con la cabecera del
+  comando recibido; una difusión se ejecuta sin respuesta.
+- En el bus (RANURAS > 1) se ignora 55 AA, los comandos ajenos y los que llegan con
+  CHK inválido (sin respuesta 0x01: la dirección tampoco es confiable). Toda la
+  transmisión se hace por turnos (TDMA): ciclo = RANURAS * MS, la placa ADDR
+  transmite solo al comienzo de la ranura ADDR - 1 (hasta BUS_TURN_LATE_MS tarde),
+  una vez por ciclo. En su turno ejecuta el comando pendiente (uno: el host espera
+  su respuesta antes de enviar otro a la misma placa) y envía su respuesta, Ready
+  tras el arranque y las tramas de streaming. Las respuestas a una difusión llegan
+  así ordenadas por dirección y sin colisiones.
+- MS debe cubrir la ráfaga más larga de un turno (respuesta + marca + trama, a ~11.5
+  bytes por ms) más 1 ms de guarda; el período de envío se redondea a múltiplos del
+  ciclo. Sin formato dividido, prueba de enlace ni transferencias en bloques. Los
+  comandos programados (0x15) se ejecutan en su tick sin respuesta ni evento 0x16:
+  "todas empiezan en T" es 0x22 por difusión seguido de 0x15 (T, 0x05 1) por difusión.
+- Las tramas de datos de una placa direccionada van precedidas, una vez por pasada
+  del bucle, de la marca [0x7A][0x76][ADDR][0x7C]: el host atribuye a ADDR todas las
+  tramas hasta la siguiente marca.
+
+Watchdog y reinicio en caliente
+- El watchdog (WDT_TIMEOUT_MS) se alimenta una vez por pasada del bucle y dentro de
+  las esperas largas (0x18 modo 0). Un cuelgue reinicia el micro sin intervención
+  del host.
+- El estado de la adquisición (Ts DIP/ADC, streaming, formato pedido, adaptativo,
+  salida calibrada, máscara de LEDs, SEQ digital y el último millis()) se guarda en
+  un bloque .noinit con valor mágico y CRC-16; el arranque del C no lo borra.
+- Si la causa del reset es solo WDRF (ni encendido, ni externo/DTR, ni brown-out) y
+  el bloque es válido, setup() lo restaura: el streaming sigue en milisegundos con la misma
+  configuración y Ready lleva el bit 7 de RESET. El reloj (millis(), el TICK de las
+  tramas y el de 0x0B) continúa desde el último guardado más la caída estimada
+  (timeout del watchdog + arranque), y SEQ avanza las tramas digitales que no
+  salieron: el hueco en el host mide la caída. millis() se guarda en cada pasada
+  del bucle (a lo sumo una vez por ms), no solo tras muestrear: con Ts de 5 s la
+  caída no se subestima.
+- No se conservan la cola de 0x15, la prueba de enlace, el generador (0x1A) ni una
+  transferencia en bloques abierta. La dirección y los turnos del bus (0x21) están
+  en EEPROM; el reloj alineado con 0x22 queda corrido en el error de la caída
+  estimada (el host repite 0x22 al ver Ready).
+  El contador de arranques de EEPROM avanza igualmente.
+- La causa sale de MCUSR o, si llega en 0, de r2, donde la deja optiboot >= 6
+  (versión en la última palabra de la flash). Funciona en un UNO con optiboot 6..8
+  (p. ej. el de MiniCore, grabado por ISP) y en una placa grabada por ISP sin
+  bootloader (pio run -t program). El optiboot 4.4 de fábrica del UNO limpia
+  MCUSR y no deja la causa en r2 (lo que haya en r2 es basura del firmware
+  anterior): con él la causa se lee 0 y todo arranque es frío (el watchdog sigue
+  recuperando los cuelgues, sin conservar el estado).
+
+Memoria (0x1B)
+- En .init1, antes de que nada use la pila, el hueco entre el final de la RAM
+  estática y RAMEND se pinta con STACK_PAINT; 0x1B cuenta los bytes que siguen
+  pintados. No hay heap (sin malloc/String).
+- Constantes (pines, tabla del seno, calibración por defecto, texto de 0x07) en
+  PROGMEM. RX_PAYLOAD_MAX es el del comando más largo (0x14) y no 64.
+- Lo recuperado se destina a la cola de muestras (sampleQueue, SAMPLE_QUEUE_BYTES):
+  en modo adaptativo, si la trama no cabe en el buffer TX la muestra espera en la
+  cola (registro crudo, 11 bytes con 4 canales) y sale en cuanto hay lugar; la ranura
+  solo se omite con la cola llena. La trama conserva el TICK del muestreo (salvo la
+  legacy, que no lo lleva). El buffer TX de la UART queda en los 64 bytes del core.
+- Uso tras cada build, informe por símbolo y por función (pila) y presupuestos
+  opcionales por entorno: scripts/mem_audit.py.
+
+Arranque y sincronización
+- Abrir el puerto resetea el UNO (DTR). En lugar de esperar un tiempo fijo, el host
+  espera la respuesta 0x0A (Ready) con timeout; si no llega (placa sin auto-reset),
+  sondea con 0x0B.
+- Para descartar bytes viejos el host envía 0x0B con un token propio y descarta todo
+  lo recibido hasta la respuesta que lo contiene (marcador único en el flujo).
 
 Notas prácticas
-- Si usas AVR con Vref=5V y 10 bits, V≈raw*4.887mV.
+- Si usas AVR con Vref=5V y 10 bits, V≈raw*4.887mV (es la tabla por defecto de los
+  pines; con salida calibrada el micro envía directamente mV).
 - El envío continuo usa el período más corto entre Ts DIP y Ts ADC.
 - AN4..AN7 son derivados (división entera por 2) de AN0..AN3.
 */
 
 static const uint32_t SERIAL_BAUD = 115200;
 
+// Versión del protocolo y capacidades anunciadas en Ready (0x0A)
+static const uint8_t PROTOCOL_VERSION = 2;
+static const uint8_t CAP_SYNC = 0x01;      // soporta 0x0B Sync
+static const uint8_t CAP_CAPS = 0x02;      // soporta 0x0C Get caps y formatos de trama
+static const uint8_t CAP_ADAPTIVE = 0x04;  // soporta 0x0F/0x10 control de tasa adaptativo
+static const uint8_t CAP_CHANNELS = 0x08;  // soporta 0x11 y tramas de N canales
+static const uint8_t CAP_CAL = 0x10;       // soporta 0x12..0x14 calibración en el micro
+static const uint8_t CAP_EXEC_AT = 0x20;   // soporta 0x15..0x17 comandos programados
+static const uint8_t CAP_LINK_TEST = 0x40; // soporta 0x18/0x19 prueba de enlace PRBS
+static const uint8_t CAP_GENERATOR = 0x80; // soporta 0x1A generador de señales sintéticas
+static const uint8_t DEVICE_CAPS = CAP_SYNC | CAP_CAPS | CAP_ADAPTIVE | CAP_CHANNELS |
+                                   CAP_CAL | CAP_EXEC_AT | CAP_LINK_TEST | CAP_GENERATOR;
+
+// Códigos de comando/evento
+static const uint8_t CMD_READY = 0x0A;
+static const uint8_t CMD_SYNC  = 0x0B;
+static const uint8_t CMD_GET_CAPS = 0x0C;
+static const uint8_t CMD_SET_FRAME_FORMAT = 0x0D;
+static const uint8_t CMD_GET_FRAME_FORMAT = 0x0E;
+static const uint8_t CMD_SET_ADAPTIVE = 0x0F;
+static const uint8_t CMD_RATE = 0x10;
+static const uint8_t CMD_GET_CHANNELS = 0x11;
+static const uint8_t CMD_SET_CAL_OUTPUT = 0x12;
+static const uint8_t CMD_GET_CAL = 0x13;
+static const uint8_t CMD_SET_CAL = 0x14;
+static const uint8_t CMD_EXEC_AT = 0x15;
+static const uint8_t CMD_EXECUTED = 0x16;
+static const uint8_t CMD_EXEC_CANCEL = 0x17;
+static const uint8_t CMD_LINK_TEST = 0x18;
+static const uint8_t CMD_LINK_RESULT = 0x19;
+static const uint8_t CMD_SET_GENERATOR = 0x1A;
+static const uint8_t CMD_GET_MEM = 0x1B;
+static const uint8_t CMD_SET_INPUT_MODE = 0x1C;
+static const uint8_t CMD_BULK_OPEN = 0x1D;
+static const uint8_t CMD_BULK_DATA = 0x1E;
+static const uint8_t CMD_BULK_ACK = 0x1F;
+static const uint8_t CMD_BULK_END = 0x20;
+static const uint8_t CMD_SET_ADDRESS = 0x21;
+static const uint8_t CMD_BUS_SYNC = 0x22;
+static const uint8_t SYNC_TOKEN_MAX = 4;
+
+// Formatos de trama de datos
+static const uint8_t FRAME_FMT_LEGACY  = 0; // 0x7A 0x7B, 20 bytes
+static const uint8_t FRAME_FMT_COMPACT = 1; // 0x7A 0x7D, 11 bytes (10 bits + tick)
+static const uint8_t FRAME_FMT_SPLIT   = 2; // 0x7A 0x7E analógica 10 B + 0x7A 0x7F digital 5 B
+static const uint8_t FRAME_FORMATS_MASK =
+    (1u << FRAME_FMT_LEGACY) | (1u << FRAME_FMT_COMPACT) | (1u << FRAME_FMT_SPLIT);
+static const uint8_t DIGITAL_FRAME_SIZE = 5;    // 0x7A 0x7F DIGITAL SEQ 0x7C
+static const uint8_t INPUT_FRAME_SIZE = 22;     // 0x7A 0x77 TICK(2) MODOS VAL(4x4) 7C
+static const uint8_t ADDR_MARK_SIZE = 4;        // 0x7A 0x76 ADDR 0x7C
+static const uint8_t ADC_BITS = 10;
+
+// Conjunto de canales analógicos (orden = orden en las tramas)
+#ifdef LAB_EXTENDED_CHANNELS
+typedef ChannelTable<PinChannel<0>, PinChannel<1>, PinChannel<2>, PinChannel<3>,
+                     PinChannel<4>, PinChannel<5>, TempChannel, BandgapChannel> AdcChannels;
+#else
+typedef ChannelTable<PinChannel<0>, PinChannel<1>, PinChannel<2>, PinChannel<3>> AdcChannels;
+#endif
+static const uint8_t ADC_CHANNELS = AdcChannels::COUNT;
+static_assert(ADC_CHANNELS >= 4, "La trama legacy requiere los canales 0..3");
+static_assert(ADC_CHANNELS <= 16, "El índice de canal ocupa un nibble");
+static const uint8_t ADC_PACKED_BYTES = (ADC_CHANNELS * ADC_BITS + 7) / 8;
+static const uint8_t COMPACT_FRAME_SIZE = 6 + ADC_PACKED_BYTES; // 7A 7D TICK(2) DIG ... 7C
+static const uint8_t ANALOG_FRAME_SIZE = 5 + ADC_PACKED_BYTES;  // 7A 7E TICK(2) ... 7C
+static const uint8_t COMPACT_CAL_FRAME_SIZE = 6 + 2 * ADC_CHANNELS; // 7A 79 TICK(2) DIG int16... 7C
+static const uint8_t ANALOG_CAL_FRAME_SIZE = 5 + 2 * ADC_CHANNELS;  // 7A 78 TICK(2) int16... 7C
+
+// Calibración por canal (ver "Calibración")
+static const uint8_t CAL_POINTS = 4;
+static const uint8_t CAL_UNIT_COUNTS = 0;  // cuentas del ADC
+static const uint8_t CAL_UNIT_MV = 1;      // milivoltios
+static const uint8_t CAL_UNIT_CENTI_C = 2; // centésimas de °C
+static const uint8_t CAL_SRC_DEFAULT = 0;
+static const uint8_t CAL_SRC_EEPROM = 1;
+struct CalTable {
+  uint8_t n;                 // puntos válidos (2..CAL_POINTS); EEPROM borrada = 0xFF
+  uint8_t unit;              // CAL_UNIT_*
+  uint16_t raw[CAL_POINTS];  // estrictamente creciente
+  int16_t val[CAL_POINTS];
+};
+static const CalTable CAL_DEFAULT_PIN PROGMEM = {
+  2, CAL_UNIT_MV, {0, 1023, 0, 0}, {0, 5000, 0, 0}};
+static const CalTable CAL_DEFAULT_TEMP PROGMEM = {  // ~1 mV/°C, 314 cuentas ≈ 25 °C
+  3, CAL_UNIT_CENTI_C, {242, 314, 380, 0}, {-4500, 2500, 8500, 0}};
+static const CalTable CAL_DEFAULT_BANDGAP PROGMEM = {  // Vcc = 1.1 V * 1023 / raw
+  4, CAL_UNIT_MV, {225, 250, 281, 341}, {5000, 4501, 4004, 3300}};
+
+// Control de tasa adaptativo
+static const uint32_t LINK_BUDGET_BPS = SERIAL_BAUD / 10 * 3 / 4; // 75% del enlace (8N1)
+static const uint8_t RATE_DECIM_MAX = 64;
+static const uint8_t RATE_WINDOW = 16;       // ranuras por ventana de evaluación
+static const uint8_t RATE_CALM_WINDOWS = 4;  // ventanas tranquilas antes de subir la tasa
+static const uint8_t TX_LOW_WATER = SERIAL_TX_BUFFER_SIZE / 8;
+
+// Contador de arranques persistido (EEPROM borrada = 0xFFFF -> se toma como 0)
+static uint16_t EEMEM eeBootCount;
+static uint16_t bootCount = 0;
+
+// Watchdog y estado retenido en RAM entre resets (ver "Watchdog y reinicio en caliente")
+static const uint8_t WDT_TIMEOUT = WDTO_250MS;
+static const uint16_t WDT_TIMEOUT_MS = 250;
+static const uint16_t WARM_MAGIC = 0x5752;  // "WR"
+static const uint8_t WARM_STREAMING = 0x01;
+static const uint8_t WARM_ADAPTIVE = 0x02;
+static const uint8_t WARM_CALIBRATED = 0x04;
+static const uint8_t READY_RESET_MASK = 0x0F; // PORF, EXTRF, BORF, WDRF
+static const uint8_t READY_WARM = 0x80;
+// optiboot >= 6 deja MCUSR en r2; su versión está en la última palabra de la flash
+static const uint16_t OPTIBOOT_MAJOR_ADDR = FLASHEND;
+static const uint8_t OPTIBOOT_R2_MAJOR = 6;
+struct WarmState {
+  uint16_t magic;
+  uint16_t periodDipMs;
+  uint16_t periodAdcMs;
+  uint32_t tick;       // millis() del último guardado
+  uint8_t flags;       // WARM_*
+  uint8_t hostFormat;
+  uint8_t ledMask;
+  uint8_t digitalSeq;
+  uint8_t inputModes;
+  uint16_t crc;        // CRC-16 de los campos anteriores
+};
+// .noinit: ni __do_copy_data ni __do_clear_bss la tocan al arrancar
+static WarmState warmState __attribute__((section(".noinit")));
+static uint8_t resetFlags __attribute__((section(".noinit")));  // causa de este arranque
+extern "C" {
+uint8_t bootR2 __attribute__((section(".noinit"), used));  // r2 al arrancar (optiboot >= 6)
+}
+static bool warmRestart = false;
+static bool warmDirty = false;   // hay cambios que guardar al final de la pasada
+extern volatile unsigned long timer0_millis;  // reloj de millis() (wiring.c)
+
+// Tablas de calibración: EEPROM (0x14) con prioridad sobre PROGMEM; copia en RAM
+static CalTable EEMEM eeCal[ADC_CHANNELS];
+static CalTable calTable[ADC_CHANNELS];
+static uint16_t calFromEeprom = 0;  // bit i = tabla del canal i leída de EEPROM
+static bool calibratedOutput = false;
+
 // Ajusta estos pines a tu placa
-static const uint8_t LED_PINS[4] = {8, 9, 10, 11};      // LED0..LED3
-static const uint8_t DIP_PINS[4] = {2, 3, 4, 5};        // DIP0..DIP3 (INPUT_PULLUP)
-static const uint8_t ADC_PINS[4] = {A0, A1, A2, A3};    // AN0..AN3
+static const uint8_t LED_PINS[4] PROGMEM = {8, 9, 10, 11};  // LED0..LED3
+static const uint8_t DIP_PINS[4] PROGMEM = {2, 3, 4, 5};    // DIP0..DIP3 (INPUT_PULLUP)
+static const char INFO_TEXT[] PROGMEM = "LAB2 v1.0";        // respuesta de 0x07
 
 // Estado
 static volatile uint8_t ledMask = 0x00; // bits 0..3
-static uint8_t lastDipMask = 0x00;      // bits 0..3
-static uint16_t lastAdc[8] = {0, 0, 0, 0, 0, 0, 0, 0}; // 0-3: originales, 4-7: divididas /2
+
+// Última muestra publicada por la adquisición (ver "Muestra consistente")
+struct SampleRecord {
+  uint16_t adcTick;  // millis() (16 bits bajos) del último muestreo ADC
+  uint16_t adc[ADC_CHANNELS]; // canales de AdcChannels; AN4..AN7 (/2) se derivan al armar la trama
+  uint8_t digital;   // nibble alto = DIP, nibble bajo = LEDs
+};
+static SampleRecord sampleRec = {};
+static volatile uint8_t sampleSeq = 0;  // impar = escritura en curso
+// Cola de muestras del modo adaptativo (ver "Memoria"): FIFO circular
+static const uint8_t SAMPLE_QUEUE_BYTES = 96;
+static const uint8_t SAMPLE_QUEUE_LEN = SAMPLE_QUEUE_BYTES / sizeof(SampleRecord);
+static SampleRecord sampleQueue[SAMPLE_QUEUE_LEN];
+static uint8_t sampleQueueHead = 0;
+static uint8_t sampleQueueCount = 0;
+static uint8_t frameFormat = FRAME_FMT_LEGACY;     // formato efectivo en el enlace
+static uint8_t hostFrameFormat = FRAME_FMT_LEGACY; // formato pedido con 0x0D
 
 static uint16_t samplePeriodDipMs = 4000; // tiempo de muestreo DIP
 static uint16_t samplePeriodAdcMs = 2000;  // tiempo de muestreo ADC
 static const uint16_t SAMPLE_MIN_MS = 10;
 static const uint16_t SAMPLE_MAX_MS = 5000;
+static const uint8_t BULK_RX_CHUNK = 16;   // datos por bloque PC -> MCU (0x1E)
+// LEN máximo aceptado: el mayor entre 0x14 y un bloque de carga
+static const uint8_t RX_PAYLOAD_MAX = 3 + 4 * CAL_POINTS > 4 + BULK_RX_CHUNK
+                                      ? 3 + 4 * CAL_POINTS : 4 + BULK_RX_CHUNK;
 static bool streamingEnabled = false;
+static bool adaptiveEnabled = false;
+
+// Estado del control de tasa
+static uint8_t txDecim = 1;        // se transmite 1 de cada txDecim períodos
+static uint16_t txSkipped = 0;     // ranuras omitidas con buffer TX y cola llenos
+static uint8_t rateWinSlots = 0;
+static uint8_t rateWinSkips = 0;
+static uint16_t rateWinUsed = 0;
+static uint8_t rateCalmWindows = 0;
 
 static uint32_t lastSampleDipMillis = 0;
 static uint32_t lastSampleAdcMillis = 0;
+static uint32_t lastTxMillis = 0;    // último envío continuo (0x22 lo reinicia)
+
+// Formato dividido: cada trama sale con su propio período
+static uint8_t digitalSeq = 0;       // SEQ de la próxima trama digital
+static bool digitalPending = false;  // muestreo DIP o cambio de LEDs sin enviar
+static bool analogFresh = false;     // muestreo ADC sin enviar
+static uint8_t analogDecimCount = 0;
+
+// Entradas DIP como contador o medidor de período (0x1C)
+static const uint8_t INPUT_LEVEL = 0;
+static const uint8_t INPUT_COUNT = 1;
+static const uint8_t INPUT_PERIOD = 2;
+struct EdgeCount {
+  uint32_t count;    // flancos de activación desde el último cambio de modo
+  uint32_t lastUs;   // micros() del último flanco
+};
+static volatile EdgeCount edgeCount[4];   // escritos por la ISR de PCINT2
+static volatile uint8_t edgeMask = 0;     // bits de PIND vigilados
+static volatile uint8_t edgePinsLast = 0;
+static uint8_t edgeBit[4];                // bit de PIND de cada entrada
+static EdgeCount edgeReported[4];         // estado en el informe anterior (modo período)
+static uint8_t inputModes = 0;            // 2 bits por entrada
+static bool inputReportDue = false;       // muestreo DIP con entradas medidas sin informar
+
+// Comandos programados (0x15), ordenados por tick de ejecución
+static const uint8_t EXEC_QUEUE_LEN = 4;
+static const uint8_t EXEC_PAYLOAD_MAX = 8;
+struct TimedCommand {
+  uint32_t at;       // millis() de ejecución
+  uint8_t id;
+  uint8_t cmd;
+  uint8_t len;
+  uint8_t pl[EXEC_PAYLOAD_MAX];
+};
+static_assert(5 + EXEC_PAYLOAD_MAX <= RX_PAYLOAD_MAX, "0x15 no cabe en rxPayload");
+static TimedCommand execQueue[EXEC_QUEUE_LEN];
+static uint8_t execCount = 0;
+static uint8_t execNextId = 0;
+
+// Prueba de enlace (0x18)
+static const uint8_t LINK_MODE_TX = 0;          // MCU -> PC
+static const uint8_t LINK_MODE_RX = 1;          // PC -> MCU
+static const uint16_t LINK_IDLE_MS = 1000;      // fin de la recepción sin datos
+static const uint8_t LINK_TX_CHUNK = 16;
+struct LinkRx {
+  bool active;
+  bool streamingWas;   // estado del streaming a restaurar
+  uint32_t expected;
+  uint32_t received;
+  uint32_t errors;     // bytes con algún bit distinto del predicho
+  uint32_t firstUs;
+  uint32_t lastUs;
+  uint32_t lastMs;     // para el timeout por inactividad
+  uint16_t reg;        // últimos 15 bits recibidos
+  uint8_t fill;        // bits cargados en reg (hasta 15)
+};
+static LinkRx linkRx = {};
+
+// Transferencia en bloques (0x1D..0x20)
+static const uint8_t BULK_DOWNLOAD = 0;         // MCU -> PC
+static const uint8_t BULK_UPLOAD = 1;           // PC -> MCU
+static const uint8_t BULK_OBJ_EEPROM = 0;
+static const uint8_t BULK_OBJ_FLASH = 1;
+static const uint8_t BULK_RESULT_OK = 0;
+static const uint8_t BULK_RESULT_INCOMPLETE = 1;
+static const uint8_t BULK_RESULT_TIMEOUT = 2;
+// Un bloque de descarga completo (cabecera 5 + OFS + datos + CRC + CHK) debe caber en el buffer TX
+static const uint8_t BULK_TX_CHUNK = SERIAL_TX_BUFFER_SIZE - 1 >= 10 + 64 ? 64 : 32;
+static const uint8_t BULK_TX_FRAME = 10 + BULK_TX_CHUNK;
+static const uint8_t BULK_TX_WINDOW = 8;        // bits de BulkXfer::resend
+static const uint8_t BULK_RX_WINDOW = 2;        // 2 comandos 0x1E de 25 B en el buffer RX
+static const uint16_t BULK_TIMEOUT_MS = 300;    // sin 0x1F: reenviar la ventana
+static const uint8_t BULK_MAX_TIMEOUTS = 8;
+static const uint16_t BULK_IDLE_MS = 2000;      // carga sin bloques: abortar
+static const uint8_t BULK_RX_MAP = (E2END + 1) / BULK_RX_CHUNK / 8;
+static_assert(BULK_TX_FRAME < SERIAL_TX_BUFFER_SIZE, "Un bloque 0x1E no cabe en el buffer TX");
+struct BulkXfer {
+  bool active;
+  bool streamingWas;   // estado del streaming a restaurar
+  uint8_t dir;         // BULK_DOWNLOAD / BULK_UPLOAD
+  uint8_t obj;         // BULK_OBJ_*
+  uint16_t start;      // offset del primer byte en el objeto
+  uint16_t length;
+  uint16_t chunks;     // bloques de la transferencia
+  uint16_t base;       // descarga: primer bloque sin confirmar
+  uint16_t next;       // descarga: siguiente bloque nuevo a enviar
+  uint8_t resend;      // descarga: bit i = reenviar el bloque base + i
+  uint8_t timeouts;    // timeouts seguidos sin 0x1F
+  uint16_t done;       // bytes confirmados (descarga) o escritos (carga)
+  uint16_t retx;       // bloques reenviados o recibidos repetidos
+  uint32_t lastMs;     // último 0x1F (descarga) o 0x1E (carga)
+  uint8_t rxMap[BULK_RX_MAP];  // carga: bit = bloque ya escrito
+};
+static BulkXfer bulk = {};
+
+// Bus multipunto (ver "Bus multipunto")
+static const uint8_t BUS_BROADCAST = 0xFF;
+static const uint8_t BUS_SLOTS_MAX = 32;
+static const uint8_t BUS_TURN_LATE_MS = 1;      // millis() salta 2 ms cada ~42 ms
+static const uint8_t BUS_SLOT_MIN_MS = 3;       // ráfaga + BUS_TURN_LATE_MS + guarda
+static const uint8_t BUS_SLOT_DEFAULT_MS = 10;
+struct BusConfig {
+  uint8_t addr;      // 0 = sin asignar; EEPROM borrada = 0xFF
+  uint8_t slots;     // <= 1: enlace punto a punto, sin turnos
+  uint8_t slotMs;
+};
+static BusConfig EEMEM eeBus;
+static BusConfig bus = {0, 0, BUS_SLOT_DEFAULT_MS};
+struct BusCommand {  // recibido en el bus, se ejecuta en el turno propio
+  bool valid;
+  bool broadcast;
+  uint8_t cmd;
+  uint8_t len;
+  uint8_t pl[RX_PAYLOAD_MAX];
+};
+static BusCommand busPending = {};
+static uint32_t busTurnStart = 0xFFFFFFFFUL;  // millis() del comienzo del último turno usado
+static bool busReadyPending = false;          // Ready espera al primer turno
+static bool txAddressed = false;   // cabecera 55 AD y marca de dirección en lo enviado
+static bool txMuted = false;       // difusión fuera del bus, programados en el bus
+static bool addrMarkSent = false;  // marca 0x76 ya enviada en esta pasada del bucle
+static bool cmdBroadcast = false;  // el comando en curso llegó por difusión
+
+/**
+ * @brief true si la placa está en un bus multipunto (transmite por turnos).
+ */
+static inline bool busMode() {
+  return bus.slots > 1;
+}
+
+// Generador de señales sintéticas (0x1A)
+static const uint8_t GEN_OFF = 0;      // entrada real
+static const uint8_t GEN_RAMP = 1;
+static const uint8_t GEN_SINE = 2;
+static const uint8_t GEN_STEP = 3;
+static const uint8_t GEN_PRBS = 4;
+static const uint8_t GEN_COUNTER = 5;
+static const uint8_t GEN_DEST_DIP = 0xFF;
+struct SignalGen {
+  uint8_t wave;      // GEN_*
+  uint16_t period;   // en muestras
+  uint16_t amp;
+  uint16_t offset;
+  uint16_t phase;    // muestra actual dentro del período
+  uint16_t prbs;     // estado PRBS-15
+  uint16_t value;    // último valor generado
+};
+static SignalGen adcGen[ADC_CHANNELS] = {};
+static SignalGen dipGen = {};
+// sin(i * 90° / 64) * 255, i = 0..64
+static const uint8_t SINE_QUARTER[65] PROGMEM = {
+  0, 6, 13, 19, 25, 31, 37, 44, 50, 56, 62, 68, 74,
+  80, 86, 92, 98, 103, 109, 115, 120, 126, 131, 136, 142, 147,
+  152, 157, 162, 167, 171, 176, 180, 185, 189, 193, 197, 201, 205,
+  208, 212, 215, 219, 222, 225, 228, 231, 233, 236, 238, 240, 242,
+  244, 246, 247, 249, 250, 251, 252, 253, 254, 254, 255, 255, 255,
+};
 
 // Utilidades
 /**
@@ -92,6 +737,105 @@ static inline uint8_t xorChecksum(const uint8_t* data, size_t len) {
   return x;
 }
 
+/**
+ * @brief Escribe un uint32 en little endian.
+ */
+static inline void putU32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)(v & 0xFF);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+// Barrera de compilador: impide mover accesos a sampleRec a través de la secuencia
+#define SAMPLE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/**
+ * @brief Publica un nibble del byte digital de la muestra.
+ * @param dip true = nibble alto (DIP), false = nibble bajo (LEDs).
+ * @param v   Valor de 4 bits.
+ */
+static void publishDigital(bool dip, uint8_t v) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ++sampleSeq;
+    SAMPLE_BARRIER();
+    sampleRec.digital = dip ? (uint8_t)((sampleRec.digital & 0x0F) | (v << 4))
+                            : (uint8_t)((sampleRec.digital & 0xF0) | (v & 0x0F));
+    SAMPLE_BARRIER();
+    ++sampleSeq;
+  }
+}
+
+/**
+ * @brief Publica las lecturas de todos los canales y su tick de muestreo.
+ * @param raw  ADC_CHANNELS lecturas originales.
+ * @param tick millis() (16 bits bajos) del muestreo.
+ */
+static void publishAdc(const uint16_t raw[ADC_CHANNELS], uint16_t tick) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ++sampleSeq;
+    SAMPLE_BARRIER();
+    for (uint8_t i = 0; i < ADC_CHANNELS; ++i) sampleRec.adc[i] = raw[i];
+    sampleRec.adcTick = tick;
+    SAMPLE_BARRIER();
+    ++sampleSeq;
+  }
+}
+
+/**
+ * @brief Copia la última muestra publicada sin deshabilitar interrupciones.
+ * Repite la copia si un escritor intervino mientras tanto.
+ * @param out Destino de la copia coherente.
+ */
+static void snapshotSample(SampleRecord& out) {
+  uint8_t seq;
+  do {
+    seq = sampleSeq;
+    SAMPLE_BARRIER();
+    out = sampleRec;
+    SAMPLE_BARRIER();
+  } while ((seq & 1) || seq != sampleSeq);
+}
+
+/**
+ * @brief Calcula el valor del generador para la fase actual y avanza una muestra.
+ * @param g   Generador activo (wave != GEN_OFF).
+ * @param max Valor máximo representable (1023 en ADC, 15 en DIP).
+ * @return Valor generado, saturado a 0..max.
+ */
+static uint16_t genStep(SignalGen& g, uint16_t max) {
+  int32_t v = g.offset;
+  switch (g.wave) {
+    case GEN_RAMP:
+      v += (int32_t)((uint32_t)g.amp * g.phase / g.period);
+      break;
+    case GEN_SINE: {
+      uint8_t idx = (uint8_t)(((uint32_t)g.phase << 8) / g.period);  // 256 pasos por ciclo
+      uint8_t k = idx & 0x3F;
+      uint8_t q = idx >> 6;
+      int16_t sn = pgm_read_byte(&SINE_QUARTER[(q & 1) ? 64 - k : k]);
+      if (q & 2) sn = -sn;
+      v += (int32_t)g.amp * sn / 255;
+    } break;
+    case GEN_STEP:
+      if (g.phase >= g.period / 2) v += g.amp;
+      break;
+    case GEN_PRBS: {
+      uint8_t b = (uint8_t)(((g.prbs >> 14) ^ (g.prbs >> 13)) & 1);
+      g.prbs = (uint16_t)(((g.prbs << 1) | b) & 0x7FFF);
+      if (b) v += g.amp;
+    } break;
+    case GEN_COUNTER:
+      v += g.phase;
+      break;
+  }
+  if (++g.phase >= g.period) g.phase = 0;
+  if (v < 0) v = 0;
+  if (v > max) v = max;
+  g.value = (uint16_t)v;
+  return g.value;
+}
+
 /**
  * @brief Aplica la máscara de LEDs a las 4 salidas digitales.
  * @param mask Bits [3:0] corresponden a LED3..LED0 (1=ON, 0=OFF).
@@ -99,8 +843,10 @@ static inline uint8_t xorChecksum(const uint8_t* data, size_t len) {
 static void applyLedMask(uint8_t mask) {
   ledMask = (mask & 0x0F);
   for (uint8_t i = 0; i < 4; ++i) {
-    digitalWrite(LED_PINS[i], (ledMask & (1u << i)) ? HIGH : LOW);
+    digitalWrite(pgm_read_byte(&LED_PINS[i]), (ledMask & (1u << i)) ? HIGH : LOW);
   }
+  publishDigital(false, ledMask);
+  digitalPending = true;
 }
 
 /**
@@ -111,78 +857,951 @@ static uint8_t readDipMask() {
   // Nota: tratar el pin LOW como switch activo (1).
   uint8_t m = 0;
   for (uint8_t i = 0; i < 4; ++i) {
-    int v = digitalRead(DIP_PINS[i]);
+    int v = digitalRead(pgm_read_byte(&DIP_PINS[i]));
     if (v == LOW) m |= (1u << i);
   }
-  lastDipMask = m;
+  if (dipGen.wave != GEN_OFF) m = (uint8_t)dipGen.value;  // avanza solo en el muestreo periódico
+  publishDigital(true, m);
   return m;
 }
 
 /**
- * @brief Lee las 4 entradas analógicas y deriva 4 señales adicionales divididas por 2.
- * @param out Arreglo de 8 valores: [0..3]=originales, [4..7]=originales/2.
+ * @brief Lee todos los canales de AdcChannels y publica la muestra con su tick.
+ * AN4..AN7 (originales/2) se derivan al armar cada trama.
+ */
+static void readAdcAll() {
+  uint16_t raw[ADC_CHANNELS];
+  AdcChannels::readAll(raw);
+  for (uint8_t i = 0; i < ADC_CHANNELS; ++i) {
+    if (adcGen[i].wave != GEN_OFF) raw[i] = genStep(adcGen[i], 1023);
+  }
+  publishAdc(raw, (uint16_t)millis());
+}
+
+/**
+ * @brief Empaqueta valores ADC a 10 bits, LSB primero.
+ * @param v   Valores (se usan los 10 bits bajos).
+ * @param n   Cantidad de valores.
+ * @param out Destino; requiere ceil(n*10/8) bytes.
+ * @return Bytes escritos.
+ */
+static uint8_t packAdc10(const uint16_t* v, uint8_t n, uint8_t* out) {
+  uint32_t acc = 0;
+  uint8_t bits = 0;
+  uint8_t o = 0;
+  for (uint8_t i = 0; i < n; ++i) {
+    acc |= (uint32_t)(v[i] & 0x03FF) << bits;
+    bits += 10;
+    while (bits >= 8) {
+      out[o++] = (uint8_t)(acc & 0xFF);
+      acc >>= 8;
+      bits -= 8;
+    }
+  }
+  if (bits) out[o++] = (uint8_t)(acc & 0xFF);
+  return o;
+}
+
+/**
+ * @brief Valida una tabla de calibración (EEPROM o recibida por 0x14).
+ * @return true si tiene 2..CAL_POINTS puntos con RAW estrictamente creciente.
+ */
+static bool calValid(const CalTable& t) {
+  if (t.n < 2 || t.n > CAL_POINTS || t.unit > CAL_UNIT_CENTI_C) return false;
+  for (uint8_t i = 0; i < t.n; ++i) {
+    if (t.raw[i] > 1023) return false;
+    if (i && t.raw[i] <= t.raw[i - 1]) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Carga en RAM la tabla de un canal: EEPROM si es válida, si no la de su tipo.
+ * @param ch Índice de canal (orden de AdcChannels).
+ */
+static void loadCalibration(uint8_t ch) {
+  CalTable t;
+  eeprom_read_block(&t, &eeCal[ch], sizeof(t));
+  if (calValid(t)) {
+    calTable[ch] = t;
+    calFromEeprom |= (uint16_t)(1u << ch);
+    return;
+  }
+  calFromEeprom &= (uint16_t)~(1u << ch);
+  uint8_t desc[ADC_CHANNELS];
+  AdcChannels::describe(desc);
+  const CalTable* def = &CAL_DEFAULT_PIN;
+  if ((desc[ch] >> 4) == CH_KIND_TEMP) def = &CAL_DEFAULT_TEMP;
+  else if ((desc[ch] >> 4) == CH_KIND_BANDGAP) def = &CAL_DEFAULT_BANDGAP;
+  memcpy_P(&calTable[ch], def, sizeof(CalTable));
+}
+
+/**
+ * @brief Convierte una lectura con la tabla del canal (lineal por tramos, entera).
+ * Fuera del rango de la tabla extrapola con el tramo extremo.
+ * @param ch  Índice de canal.
+ * @param raw Lectura de 10 bits.
+ * @return Valor en la unidad de la tabla, saturado a int16.
+ */
+static int16_t calApply(uint8_t ch, uint16_t raw) {
+  const CalTable& t = calTable[ch];
+  uint8_t s = 1;
+  while (s < t.n - 1 && raw > t.raw[s]) ++s;
+  int32_t r0 = t.raw[s - 1];
+  int32_t v0 = t.val[s - 1];
+  int32_t v = v0 + ((int32_t)raw - r0) * ((int32_t)t.val[s] - v0) / ((int32_t)t.raw[s] - r0);
+  if (v > INT16_MAX) v = INT16_MAX;
+  if (v < INT16_MIN) v = INT16_MIN;
+  return (int16_t)v;
+}
+
+/**
+ * @brief Escribe una trama de datos en la UART.
+ * Con salida direccionada la precede la marca [0x7A][0x76][ADDR][0x7C], una vez por
+ * pasada del bucle; sin salida (txMuted) no escribe nada.
  */
-static void readAdcAll(uint16_t out[8]) {
-  // Leer las 4 originales y calcular las 4 divididas /2
+static void writeFrame(const uint8_t* frame, uint8_t len) {
+  if (txMuted) return;
+  if (txAddressed && !addrMarkSent) {
+    uint8_t mark[ADDR_MARK_SIZE] = {0x7A, 0x76, bus.addr, 0x7C};
+    Serial.write(mark, sizeof(mark));
+    addrMarkSent = true;
+  }
+  Serial.write(frame, len);
+}
+
+/**
+ * @brief Bytes extra de la próxima trama por la marca de dirección.
+ */
+static inline uint8_t addrMarkPending() {
+  return txAddressed && !addrMarkSent ? ADDR_MARK_SIZE : 0;
+}
+
+/**
+ * @brief Envía una trama compacta: tick, digitales y todos los canales a 10 bits.
+ * Estructura: 0x7A, 0x7D, TICK_L, TICK_H, DIGITAL, ADC_PACKED_BYTES, 0x7C.
+ * @param r Muestra coherente (snapshotSample).
+ */
+static void sendCompactFrame(const SampleRecord& r) {
+  uint8_t frame[COMPACT_FRAME_SIZE];
+  frame[0] = 0x7A;
+  frame[1] = 0x7D;
+  frame[2] = (uint8_t)(r.adcTick & 0xFF);
+  frame[3] = (uint8_t)(r.adcTick >> 8);
+  frame[4] = r.digital;
+  packAdc10(r.adc, ADC_CHANNELS, &frame[5]);
+  frame[COMPACT_FRAME_SIZE - 1] = 0x7C;
+  writeFrame(frame, sizeof(frame));
+}
+
+/**
+ * @brief Envía la trama analógica del formato dividido.
+ * Estructura: 0x7A, 0x7E, TICK_L, TICK_H, ADC_PACKED_BYTES, 0x7C.
+ * @param r Muestra coherente (snapshotSample).
+ */
+static void sendAnalogFrame(const SampleRecord& r) {
+  uint8_t frame[ANALOG_FRAME_SIZE];
+  frame[0] = 0x7A;
+  frame[1] = 0x7E;
+  frame[2] = (uint8_t)(r.adcTick & 0xFF);
+  frame[3] = (uint8_t)(r.adcTick >> 8);
+  packAdc10(r.adc, ADC_CHANNELS, &frame[4]);
+  frame[ANALOG_FRAME_SIZE - 1] = 0x7C;
+  writeFrame(frame, sizeof(frame));
+}
+
+/**
+ * @brief Envía la variante calibrada de la trama compacta o de la analógica.
+ * Estructura: 0x7A, 0x79|0x78, TICK_L, TICK_H, [DIGITAL], N x int16 LE, 0x7C.
+ * @param r     Muestra coherente (snapshotSample).
+ * @param split true = analógica del formato dividido (sin byte digital).
+ */
+static void sendCalibratedFrame(const SampleRecord& r, bool split) {
+  uint8_t frame[COMPACT_CAL_FRAME_SIZE];
+  uint8_t o = 0;
+  frame[o++] = 0x7A;
+  frame[o++] = split ? 0x78 : 0x79;
+  frame[o++] = (uint8_t)(r.adcTick & 0xFF);
+  frame[o++] = (uint8_t)(r.adcTick >> 8);
+  if (!split) frame[o++] = r.digital;
+  for (uint8_t i = 0; i < ADC_CHANNELS; ++i) {
+    uint16_t v = (uint16_t)calApply(i, r.adc[i]);
+    frame[o++] = (uint8_t)(v & 0xFF);
+    frame[o++] = (uint8_t)(v >> 8);
+  }
+  frame[o++] = 0x7C;
+  writeFrame(frame, o);
+}
+
+/**
+ * @brief Envía la trama digital del formato dividido (5 bytes).
+ * Estructura: 0x7A, 0x7F, DIGITAL, SEQ, 0x7C.
+ */
+static void sendDigitalFrame() {
+  SampleRecord r;
+  snapshotSample(r);
+  uint8_t frame[DIGITAL_FRAME_SIZE];
+  frame[0] = 0x7A;
+  frame[1] = 0x7F;
+  frame[2] = r.digital;
+  frame[3] = digitalSeq++;
+  frame[4] = 0x7C;
+  writeFrame(frame, sizeof(frame));
+}
+
+/**
+ * @brief Cuenta los flancos de activación de las entradas medidas (0x1C).
+ * Solo acumula: el período medio se calcula fuera, al armar la trama.
+ */
+ISR(PCINT2_vect) {
+  uint32_t now = micros();
+  uint8_t pins = PIND;
+  uint8_t fell = (uint8_t)(edgePinsLast & ~pins & edgeMask);  // activo en LOW
+  edgePinsLast = pins;
+  if (!fell) return;
   for (uint8_t i = 0; i < 4; ++i) {
-    uint16_t raw = (uint16_t)analogRead(ADC_PINS[i]);
-    out[i] = raw;           // AN0..AN3: originales
-    out[i + 4] = raw / 2;   // AN4..AN7: divididas /2
-    lastAdc[i] = out[i];
-    lastAdc[i + 4] = out[i + 4];
+    if (fell & edgeBit[i]) {
+      edgeCount[i].count = edgeCount[i].count + 1;
+      edgeCount[i].lastUs = now;
+    }
   }
 }
 
+/**
+ * @brief Configura una entrada DIP como nivel, contador o medidor de período.
+ * Reinicia su cuenta y habilita PCINT2 mientras haya alguna entrada medida.
+ * @param input Entrada 0..3.
+ * @param mode  INPUT_LEVEL, INPUT_COUNT o INPUT_PERIOD.
+ */
+static void setInputMode(uint8_t input, uint8_t mode) {
+  edgeBit[input] = digitalPinToBitMask(pgm_read_byte(&DIP_PINS[input]));
+  inputModes = (uint8_t)((inputModes & ~(0x03 << (2 * input))) | (mode << (2 * input)));
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if ((inputModes >> (2 * i)) & 0x03) mask |= edgeBit[i];
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    edgeCount[input].count = 0;
+    edgeCount[input].lastUs = 0;
+    edgePinsLast = PIND;
+    edgeMask = mask;
+    PCMSK2 = mask;
+    if (mask) PCICR |= _BV(PCIE2);
+    else PCICR &= (uint8_t)~_BV(PCIE2);
+  }
+  edgeReported[input].count = 0;
+  edgeReported[input].lastUs = 0;
+}
+
+/**
+ * @brief Valor de una entrada para la trama 0x77 según su modo.
+ * @param i   Entrada 0..3.
+ * @param dip Nivel actual del DIP (nibble).
+ */
+static uint32_t inputValue(uint8_t i, uint8_t dip) {
+  uint8_t mode = (inputModes >> (2 * i)) & 0x03;
+  if (mode == INPUT_LEVEL) return (dip >> i) & 0x01;
+  EdgeCount c;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    c.count = edgeCount[i].count;
+    c.lastUs = edgeCount[i].lastUs;
+  }
+  if (mode == INPUT_COUNT) return c.count;
+
+  // Período medio entre el último flanco informado y el último flanco actual
+  EdgeCount& prev = edgeReported[i];
+  uint32_t periods = c.count - prev.count;
+  if (periods == 0) return 0;                // ningún flanco nuevo: se sigue esperando
+  uint32_t v = prev.count ? (c.lastUs - prev.lastUs) / periods : 0;
+  prev = c;
+  return v;
+}
+
+/**
+ * @brief Envía la trama de entradas medidas (22 bytes).
+ * Estructura: 0x7A, 0x77, TICK, MODOS, VAL0..VAL3 (uint32 LE), 0x7C.
+ */
+static void sendInputFrame() {
+  SampleRecord r;
+  snapshotSample(r);
+  uint16_t tick = (uint16_t)millis();
+  uint8_t frame[INPUT_FRAME_SIZE];
+  frame[0] = 0x7A;
+  frame[1] = 0x77;
+  frame[2] = (uint8_t)(tick & 0xFF);
+  frame[3] = (uint8_t)(tick >> 8);
+  frame[4] = inputModes;
+  for (uint8_t i = 0; i < 4; ++i) putU32(&frame[5 + 4 * i], inputValue(i, r.digital >> 4));
+  frame[21] = 0x7C;
+  writeFrame(frame, sizeof(frame));
+}
+
 /**
  * @brief Envía una trama binaria de datos (20 bytes) con digitales y 8 analógicos.
  * Estructura: 0x7A, 0x7B, DIGITAL, AN0..AN7 (LSB,MSB), 0x7C.
+ * Si el host negoció otro formato (0x0D), delega en sendCompactFrame() o, en el
+ * dividido, en sendAnalogFrame() (la digital sale por su cuenta); con salida
+ * calibrada (0x12) ambas pasan a sendCalibratedFrame().
+ * @param r Muestra coherente (snapshotSample o cola de muestras).
  */
-static void sendDataFrame() {
-  // [0x7A][0x7B][DIGITAL][AN0_L][AN0_H]...[AN7_H][0x7C]
-  uint8_t digitalByte = ((lastDipMask & 0x0F) << 4) | (ledMask & 0x0F);
+static void sendSampleFrame(const SampleRecord& r) {
+  if (frameFormat != FRAME_FMT_LEGACY && calibratedOutput) {
+    sendCalibratedFrame(r, frameFormat == FRAME_FMT_SPLIT);
+    return;
+  }
+  if (frameFormat == FRAME_FMT_COMPACT) { sendCompactFrame(r); return; }
+  if (frameFormat == FRAME_FMT_SPLIT) { sendAnalogFrame(r); return; }
 
+  // [0x7A][0x7B][DIGITAL][AN0_L][AN0_H]...[AN7_H][0x7C]
   uint8_t frame[20]; // 2 cabecera + 1 digital + 16 analógicos (8*2) + 1 fin
   frame[0] = 0x7A;
   frame[1] = 0x7B;
-  frame[2] = digitalByte;
+  frame[2] = r.digital;
   
-  // AN0..AN7 en LE (Little Endian)
+  // AN0..AN3 originales y AN4..AN7 = ANi/2, en LE (Little Endian)
   for (uint8_t i = 0; i < 8; ++i) {
-    frame[3 + i*2] = (uint8_t)(lastAdc[i] & 0xFF);      // byte bajo
-    frame[3 + i*2 + 1] = (uint8_t)(lastAdc[i] >> 8);    // byte alto
+    uint16_t v = (i < 4) ? r.adc[i] : (uint16_t)(r.adc[i - 4] / 2);
+    frame[3 + i*2] = (uint8_t)(v & 0xFF);      // byte bajo
+    frame[3 + i*2 + 1] = (uint8_t)(v >> 8);    // byte alto
   }
   
   frame[19] = 0x7C;
 
-  Serial.write(frame, sizeof(frame));
+  writeFrame(frame, sizeof(frame));
+}
+
+/**
+ * @brief Envía la trama de datos de la última muestra publicada.
+ */
+static void sendDataFrame() {
+  // Una sola copia coherente por trama, sin bloquear a la adquisición
+  SampleRecord r;
+  snapshotSample(r);
+  sendSampleFrame(r);
 }
 
 // Envío de respuesta del protocolo
 /**
- * @brief Envía una respuesta del protocolo 0x55 0xAB.
+ * @brief Envía una respuesta del protocolo 0x55 0xAB (0x55 0xAD ADDR si es direccionada).
  * @param status Código de estado (0=OK, 1=CHK inválido, 2=Parámetro inválido, 3=CMD desconocido).
  * @param cmd    Eco del comando recibido.
  * @param payload Datos a incluir (puede ser nullptr si len=0).
  * @param len    Longitud del payload en bytes.
  */
 static void sendResponse(uint8_t status, uint8_t cmd, const uint8_t* payload, uint8_t len) {
+  if (txMuted) return;
+  uint8_t x = 0;
   Serial.write(0x55);
-  Serial.write(0xAB);
+  if (txAddressed) {
+    Serial.write(0xAD);
+    Serial.write(bus.addr);
+    x = bus.addr;
+  } else {
+    Serial.write(0xAB);
+  }
   Serial.write(status);
   Serial.write(cmd);
   Serial.write(len);
   if (len && payload) Serial.write(payload, len);
 
-  // CHK = XOR de [STATUS, CMD, LEN, PAYLOAD...]
+  // CHK = XOR de [ADDR, STATUS, CMD, LEN, PAYLOAD...]
   uint8_t bufChk[3];
   bufChk[0] = status;
   bufChk[1] = cmd;
   bufChk[2] = len;
-  uint8_t x = xorChecksum(bufChk, 3);
+  x ^= xorChecksum(bufChk, 3);
   if (len && payload) x ^= xorChecksum(payload, len);
   Serial.write(x);
 }
 
+/**
+ * @brief Responde a 0x0C con el descriptor binario de capacidades.
+ * Ver "Formatos de trama de datos" y 0x0C en la cabecera para el layout.
+ */
+static void sendCaps() {
+  uint8_t d[24];
+  d[0] = PROTOCOL_VERSION;
+  d[1] = FRAME_FORMATS_MASK;
+  d[2] = ADC_CHANNELS;      // canales en trama (AN4..AN7 derivados no cuentan)
+  d[3] = ADC_BITS;
+  d[4] = 4;                 // DIP0..DIP3
+  d[5] = 4;                 // LED0..LED3
+  putU32(&d[6], (uint32_t)SAMPLE_MIN_MS * 1000UL);
+  putU32(&d[10], (uint32_t)SAMPLE_MAX_MS * 1000UL);
+  d[14] = (uint8_t)(SERIAL_RX_BUFFER_SIZE & 0xFF);
+  d[15] = (uint8_t)(SERIAL_RX_BUFFER_SIZE >> 8);
+  d[16] = (uint8_t)(SERIAL_TX_BUFFER_SIZE & 0xFF);
+  d[17] = (uint8_t)(SERIAL_TX_BUFFER_SIZE >> 8);
+  d[18] = RX_PAYLOAD_MAX;
+  d[19] = 1;                // baudios soportados
+  putU32(&d[20], SERIAL_BAUD);
+  sendResponse(0x00, CMD_GET_CAPS, d, sizeof(d));
+}
+
+/**
+ * @brief Tamaño en bytes de una trama del formato indicado (según 0x12).
+ */
+static inline uint8_t frameSize(uint8_t fmt) {
+  if (fmt == FRAME_FMT_SPLIT) return calibratedOutput ? ANALOG_CAL_FRAME_SIZE : ANALOG_FRAME_SIZE;
+  if (fmt == FRAME_FMT_COMPACT) return calibratedOutput ? COMPACT_CAL_FRAME_SIZE : COMPACT_FRAME_SIZE;
+  return 20;
+}
+
+/**
+ * @brief Responde a 0x13/0x14 con la tabla vigente de un canal.
+ * Payload: [CH][SRC][UNIT][N][RAW uint16 LE][VAL int16 LE] x N.
+ */
+static void sendCalibration(uint8_t cmd, uint8_t ch) {
+  const CalTable& t = calTable[ch];
+  uint8_t resp[4 + 4 * CAL_POINTS];
+  uint8_t o = 0;
+  resp[o++] = ch;
+  resp[o++] = (calFromEeprom & (1u << ch)) ? CAL_SRC_EEPROM : CAL_SRC_DEFAULT;
+  resp[o++] = t.unit;
+  resp[o++] = t.n;
+  for (uint8_t i = 0; i < t.n; ++i) {
+    resp[o++] = (uint8_t)(t.raw[i] & 0xFF);
+    resp[o++] = (uint8_t)(t.raw[i] >> 8);
+    resp[o++] = (uint8_t)((uint16_t)t.val[i] & 0xFF);
+    resp[o++] = (uint8_t)((uint16_t)t.val[i] >> 8);
+  }
+  sendResponse(0x00, cmd, resp, o);
+}
+
+/**
+ * @brief Período base de transmisión: el más corto entre Ts DIP y Ts ADC.
+ * En formato dividido es el de las tramas analógicas (Ts ADC).
+ */
+static inline uint16_t txBasePeriod() {
+  if (frameFormat == FRAME_FMT_SPLIT) return samplePeriodAdcMs;
+  return min(samplePeriodDipMs, samplePeriodAdcMs);
+}
+
+/**
+ * @brief Menor diezmado (potencia de 2) cuya tasa cabe en el presupuesto del enlace.
+ * @param periodMs Período base de transmisión.
+ * @param size     Tamaño de trama en bytes.
+ */
+static uint8_t budgetDecim(uint16_t periodMs, uint8_t size) {
+  uint32_t need = (uint32_t)size * 1000UL;        // bytes*ms/s por trama
+  uint32_t room = LINK_BUDGET_BPS * periodMs;     // idem por período base
+  uint8_t d = 1;
+  while (need > room * d && d < RATE_DECIM_MAX) d <<= 1;
+  return d;
+}
+
+/**
+ * @brief Responde/anuncia la tasa efectiva (0x10).
+ * Payload: [FMT][DECIM][TEFF_L][TEFF_H][SKIP_L][SKIP_H].
+ */
+static void sendRate() {
+  uint32_t eff = (uint32_t)txBasePeriod() * txDecim;
+  if (eff > 0xFFFF) eff = 0xFFFF;
+  uint8_t pl[6] = {frameFormat, txDecim,
+                   (uint8_t)(eff & 0xFF), (uint8_t)(eff >> 8),
+                   (uint8_t)(txSkipped & 0xFF), (uint8_t)(txSkipped >> 8)};
+  sendResponse(0x00, CMD_RATE, pl, sizeof(pl));
+}
+
+/**
+ * @brief Reinicia la ventana de evaluación del control de tasa.
+ */
+static void resetRateWindow() {
+  rateWinSlots = 0;
+  rateWinSkips = 0;
+  rateWinUsed = 0;
+  rateCalmWindows = 0;
+}
+
+/**
+ * @brief Recalcula formato y diezmado tras cambiar Ts, formato o el modo adaptativo.
+ * Anuncia el evento 0x10 si la tasa efectiva cambió.
+ */
+static void retuneRate() {
+  uint8_t prevFmt = frameFormat;
+  uint8_t prevDecim = txDecim;
+  frameFormat = hostFrameFormat;
+  txDecim = 1;
+  if (adaptiveEnabled) {
+    uint16_t base = txBasePeriod();
+    txDecim = budgetDecim(base, frameSize(frameFormat));
+    if (txDecim > 1 && frameFormat == FRAME_FMT_LEGACY) {
+      frameFormat = FRAME_FMT_COMPACT;
+      txDecim = budgetDecim(base, frameSize(frameFormat));
+    }
+  }
+  resetRateWindow();
+  if (adaptiveEnabled && (prevFmt != frameFormat || prevDecim != txDecim)) sendRate();
+}
+
+/**
+ * @brief Envía las muestras encoladas, en orden, mientras quepan en el buffer TX.
+ */
+static void drainSampleQueue() {
+  while (sampleQueueCount &&
+         Serial.availableForWrite() >= (int)(frameSize(frameFormat) + addrMarkPending())) {
+    sendSampleFrame(sampleQueue[sampleQueueHead]);
+    sampleQueueHead = (uint8_t)((sampleQueueHead + 1) % SAMPLE_QUEUE_LEN);
+    --sampleQueueCount;
+  }
+}
+
+/**
+ * @brief Ranura de envío en modo adaptativo: nunca bloquea en Serial.write().
+ * Si la trama no cabe en el buffer TX encola la muestra; con la cola llena omite
+ * la ranura y, cada RATE_WINDOW ranuras, ajusta formato/diezmado según las
+ * omisiones y la ocupación media observadas.
+ */
+static void streamAdaptive() {
+  drainSampleQueue();
+  int room = Serial.availableForWrite();
+  rateWinUsed += (uint16_t)((SERIAL_TX_BUFFER_SIZE - 1) - room);
+  if (sampleQueueCount == 0 && room >= (int)(frameSize(frameFormat) + addrMarkPending())) {
+    sendDataFrame();
+  } else if (sampleQueueCount < SAMPLE_QUEUE_LEN) {
+    uint8_t tail = (uint8_t)((sampleQueueHead + sampleQueueCount) % SAMPLE_QUEUE_LEN);
+    snapshotSample(sampleQueue[tail]);
+    ++sampleQueueCount;
+  } else {
+    ++txSkipped;
+    ++rateWinSkips;
+  }
+  if (++rateWinSlots < RATE_WINDOW) return;
+
+  bool changed = false;
+  if (rateWinSkips) {
+    // Congestión: primero la trama más corta, luego menos tramas
+    if (frameFormat == FRAME_FMT_LEGACY) { frameFormat = FRAME_FMT_COMPACT; changed = true; }
+    else if (txDecim < RATE_DECIM_MAX) { txDecim <<= 1; changed = true; }
+    rateCalmWindows = 0;
+  } else if (sampleQueueCount == 0 && rateWinUsed / RATE_WINDOW < TX_LOW_WATER) {
+    if (++rateCalmWindows >= RATE_CALM_WINDOWS) {
+      uint16_t base = txBasePeriod();
+      if (txDecim > budgetDecim(base, frameSize(frameFormat))) {
+        txDecim >>= 1; changed = true;
+      } else if (frameFormat != hostFrameFormat &&
+                 budgetDecim(base, frameSize(hostFrameFormat)) <= txDecim) {
+        frameFormat = hostFrameFormat; changed = true;
+      }
+      rateCalmWindows = 0;
+    }
+  } else {
+    rateCalmWindows = 0;
+  }
+  rateWinSlots = 0;
+  rateWinSkips = 0;
+  rateWinUsed = 0;
+  if (changed) sendRate();
+}
+
+/**
+ * @brief Envío en formato dividido: la trama digital sale en cuanto hay un muestreo
+ * DIP o un cambio de LEDs; la analógica tras cada muestreo ADC (diezmada si el
+ * control de tasa lo pide).
+ */
+static void streamSplit() {
+  if (digitalPending &&
+      (!adaptiveEnabled || Serial.availableForWrite() >= DIGITAL_FRAME_SIZE)) {
+    digitalPending = false;
+    sendDigitalFrame();
+  }
+  if (!analogFresh) return;
+  analogFresh = false;
+  if (++analogDecimCount < txDecim) return;
+  analogDecimCount = 0;
+  if (adaptiveEnabled) streamAdaptive();
+  else sendDataFrame();
+}
+
+/**
+ * @brief Encola un comando para ejecutarlo en el tick indicado (0x15).
+ * La cola se mantiene ordenada; a igual tick se respeta el orden de llegada.
+ * @return ID asignado.
+ */
+static uint8_t scheduleCommand(uint32_t at, uint8_t cmd, const uint8_t* pl, uint8_t len) {
+  uint8_t pos = execCount;
+  while (pos > 0 && (int32_t)(execQueue[pos - 1].at - at) > 0) {
+    execQueue[pos] = execQueue[pos - 1];
+    --pos;
+  }
+  TimedCommand& c = execQueue[pos];
+  c.at = at;
+  c.id = execNextId++;
+  c.cmd = cmd;
+  c.len = len;
+  memcpy(c.pl, pl, len);
+  ++execCount;
+  return c.id;
+}
+
+/**
+ * @brief Siguiente byte del PRBS-15 (x^15 + x^14 + 1), MSB primero.
+ * @param s Estado del LFSR (15 bits, distinto de cero).
+ */
+static uint8_t prbsNextByte(uint16_t& s) {
+  uint8_t out = 0;
+  for (uint8_t i = 0; i < 8; ++i) {
+    uint8_t b = (uint8_t)(((s >> 14) ^ (s >> 13)) & 1);
+    s = (uint16_t)(((s << 1) | b) & 0x7FFF);
+    out = (uint8_t)((out << 1) | b);
+  }
+  return out;
+}
+
+/**
+ * @brief Verifica un byte recibido contra la predicción autosincronizante del PRBS-15.
+ * @return true si algún bit no coincide (los primeros 15 bits solo cargan el registro).
+ */
+static bool prbsCheckByte(uint16_t& reg, uint8_t& fill, uint8_t v) {
+  bool err = false;
+  for (int8_t i = 7; i >= 0; --i) {
+    uint8_t b = (uint8_t)((v >> i) & 1);
+    if (fill >= 15) {
+      if ((((reg >> 14) ^ (reg >> 13)) & 1) != b) err = true;
+    } else {
+      ++fill;
+    }
+    reg = (uint16_t)(((reg << 1) | b) & 0x7FFF);
+  }
+  return err;
+}
+
+/**
+ * @brief Anuncia el resultado de una prueba de enlace (evento 0x19).
+ * Payload: [MODO][BYTES u32][ERR u32][FALTAN u32][T_US u32].
+ */
+static void sendLinkResult(uint8_t mode, uint32_t bytes, uint32_t errors,
+                           uint32_t missing, uint32_t elapsedUs) {
+  uint8_t pl[17];
+  pl[0] = mode;
+  putU32(&pl[1], bytes);
+  putU32(&pl[5], errors);
+  putU32(&pl[9], missing);
+  putU32(&pl[13], elapsedUs);
+  sendResponse(0x00, CMD_LINK_RESULT, pl, sizeof(pl));
+}
+
+/**
+ * @brief Modo 0: envía COUNT bytes PRBS-15 a tasa de línea y reporta el tiempo.
+ * Bloquea el bucle mientras dura (Serial.write espera si el buffer TX está lleno).
+ */
+static void runLinkTx(uint32_t count) {
+  uint16_t s = 0x7FFF;
+  uint8_t chunk[LINK_TX_CHUNK];
+  Serial.flush();                // la respuesta a 0x18 no cuenta en el tiempo
+  uint32_t t0 = micros();
+  uint32_t left = count;
+  while (left) {
+    uint8_t n = left < LINK_TX_CHUNK ? (uint8_t)left : LINK_TX_CHUNK;
+    for (uint8_t i = 0; i < n; ++i) chunk[i] = prbsNextByte(s);
+    Serial.write(chunk, n);
+    left -= n;
+    wdt_reset();                 // la prueba puede durar más que el watchdog
+  }
+  Serial.flush();
+  sendLinkResult(LINK_MODE_TX, count, 0, 0, micros() - t0);
+}
+
+/**
+ * @brief Modo 1: consume un byte recibido durante la prueba de enlace.
+ */
+static void linkRxByte(uint8_t b) {
+  uint32_t us = micros();
+  if (linkRx.received == 0) linkRx.firstUs = us;
+  linkRx.lastUs = us;
+  linkRx.lastMs = millis();
+  ++linkRx.received;
+  if (prbsCheckByte(linkRx.reg, linkRx.fill, b)) ++linkRx.errors;
+}
+
+/**
+ * @brief Cierra la prueba en modo 1 si llegaron todos los bytes o venció el timeout.
+ */
+static void serviceLinkRx(uint32_t now) {
+  if (!linkRx.active) return;
+  if (linkRx.received < linkRx.expected && (uint32_t)(now - linkRx.lastMs) < LINK_IDLE_MS) return;
+  linkRx.active = false;
+  sendLinkResult(LINK_MODE_RX, linkRx.received, linkRx.errors,
+                 linkRx.expected - linkRx.received, linkRx.lastUs - linkRx.firstUs);
+  streamingEnabled = linkRx.streamingWas;
+}
+
+/**
+ * @brief Tamaño en bytes de un objeto de 0x1D (0 si no existe).
+ */
+static uint32_t bulkObjectSize(uint8_t obj) {
+  if (obj == BULK_OBJ_EEPROM) return (uint32_t)E2END + 1;
+  if (obj == BULK_OBJ_FLASH) return (uint32_t)FLASHEND + 1;
+  return 0;
+}
+
+/**
+ * @brief CRC-16 de un bloque 0x1E: OFS (LE) seguido de los datos.
+ */
+static uint16_t bulkCrc(const uint8_t* p, uint8_t len) {
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < len; ++i) crc = _crc16_update(crc, p[i]);
+  return crc;
+}
+
+/**
+ * @brief Envía el bloque idx de la descarga, releído de su objeto de origen.
+ */
+static void sendBulkChunk(uint16_t idx) {
+  uint8_t pl[4 + BULK_TX_CHUNK];
+  uint16_t rel = idx * BULK_TX_CHUNK;
+  uint16_t ofs = bulk.start + rel;
+  uint8_t n = bulk.length - rel < BULK_TX_CHUNK ? (uint8_t)(bulk.length - rel) : BULK_TX_CHUNK;
+  pl[0] = (uint8_t)(ofs & 0xFF);
+  pl[1] = (uint8_t)(ofs >> 8);
+  if (bulk.obj == BULK_OBJ_EEPROM) eeprom_read_block(&pl[2], (const void*)(uintptr_t)ofs, n);
+  else memcpy_P(&pl[2], (const void*)(uintptr_t)ofs, n);
+  uint16_t crc = bulkCrc(pl, (uint8_t)(2 + n));
+  pl[2 + n] = (uint8_t)(crc & 0xFF);
+  pl[3 + n] = (uint8_t)(crc >> 8);
+  sendResponse(0x00, CMD_BULK_DATA, pl, (uint8_t)(4 + n));
+}
+
+/**
+ * @brief Cierra la transferencia, restablece el streaming y responde o anuncia 0x20.
+ * Payload: [RESULTADO][DIR][OBJ][BYTES u16][REENVIOS u16].
+ */
+static void endBulk(uint8_t result) {
+  uint8_t pl[7] = {result, bulk.dir, bulk.obj,
+                   (uint8_t)(bulk.done & 0xFF), (uint8_t)(bulk.done >> 8),
+                   (uint8_t)(bulk.retx & 0xFF), (uint8_t)(bulk.retx >> 8)};
+  // Una carga puede haber reescrito las tablas de calibración
+  if (bulk.dir == BULK_UPLOAD && bulk.done) {
+    for (uint8_t i = 0; i < ADC_CHANNELS; ++i) loadCalibration(i);
+  }
+  bulk.active = false;
+  streamingEnabled = bulk.streamingWas;
+  sendResponse(0x00, CMD_BULK_END, pl, sizeof(pl));
+}
+
+/**
+ * @brief Abre una transferencia (0x1D); suspende el streaming mientras dure.
+ * @return false si los parámetros no son válidos.
+ */
+static bool openBulk(const uint8_t* pl) {
+  uint16_t ofs = (uint16_t)pl[2] | ((uint16_t)pl[3] << 8);
+  uint16_t len = (uint16_t)pl[4] | ((uint16_t)pl[5] << 8);
+  uint32_t size = bulkObjectSize(pl[1]);
+  if (pl[0] > BULK_UPLOAD || size == 0 || len == 0 || (uint32_t)ofs + len > size ||
+      (pl[0] == BULK_UPLOAD && pl[1] != BULK_OBJ_EEPROM) || linkRx.active) {
+    return false;
+  }
+  bool streaming = bulk.active ? bulk.streamingWas : streamingEnabled;
+  uint8_t chunk = pl[0] == BULK_DOWNLOAD ? BULK_TX_CHUNK : BULK_RX_CHUNK;
+  bulk = BulkXfer();
+  bulk.active = true;
+  bulk.streamingWas = streaming;
+  bulk.dir = pl[0];
+  bulk.obj = pl[1];
+  bulk.start = ofs;
+  bulk.length = len;
+  bulk.chunks = (uint16_t)((len + chunk - 1) / chunk);
+  bulk.lastMs = millis();
+  streamingEnabled = false;
+  return true;
+}
+
+/**
+ * @brief Confirmación del host durante una descarga (0x1F).
+ * Avanza la ventana hasta SIGUIENTE y agrega los reenvíos pedidos.
+ * @return false si no hay descarga abierta o SIGUIENTE no es válido.
+ */
+static bool bulkAck(const uint8_t* pl) {
+  if (!bulk.active || bulk.dir != BULK_DOWNLOAD) return false;
+  uint16_t ofs = (uint16_t)pl[0] | ((uint16_t)pl[1] << 8);
+  uint16_t rel = ofs - bulk.start;
+  if (ofs < bulk.start || rel > bulk.length || (rel % BULK_TX_CHUNK && rel != bulk.length)) {
+    return false;
+  }
+  uint16_t idx = (uint16_t)((rel + BULK_TX_CHUNK - 1) / BULK_TX_CHUNK);
+  if (idx < bulk.base || idx > bulk.next) return true;  // confirmación vieja o adelantada
+  uint16_t shift = idx - bulk.base;
+  bulk.resend = shift >= 8 ? 0 : (uint8_t)(bulk.resend >> shift);
+  bulk.base = idx;
+  // Solo bloques ya enviados: los nuevos saldrán igualmente
+  uint16_t outstanding = bulk.next - bulk.base;
+  uint8_t inFlight = outstanding >= 8 ? 0xFF : (uint8_t)((1u << outstanding) - 1);
+  bulk.resend |= pl[2] & inFlight;
+  bulk.done = bulk.base == bulk.chunks ? bulk.length : bulk.base * BULK_TX_CHUNK;
+  // Una confirmación repetida sin avance ni pedidos no detiene el timeout
+  if (shift || (pl[2] & inFlight)) {
+    bulk.timeouts = 0;
+    bulk.lastMs = millis();
+  }
+  if (bulk.base == bulk.chunks) endBulk(BULK_RESULT_OK);
+  return true;
+}
+
+/**
+ * @brief Bloque de una carga (0x1E): verifica su CRC, lo escribe y lo confirma.
+ * @return false si el bloque no corresponde a la carga abierta.
+ */
+static bool bulkUploadChunk(const uint8_t* pl, uint8_t len) {
+  if (!bulk.active || bulk.dir != BULK_UPLOAD || len < 5) return false;
+  uint16_t ofs = (uint16_t)pl[0] | ((uint16_t)pl[1] << 8);
+  uint16_t rel = ofs - bulk.start;
+  uint8_t n = (uint8_t)(len - 4);
+  if (ofs < bulk.start || rel >= bulk.length || rel % BULK_RX_CHUNK ||
+      n != (bulk.length - rel < BULK_RX_CHUNK ? bulk.length - rel : BULK_RX_CHUNK)) {
+    return false;
+  }
+  bulk.lastMs = millis();
+  uint16_t crc = (uint16_t)pl[len - 2] | ((uint16_t)pl[len - 1] << 8);
+  if (crc != bulkCrc(pl, (uint8_t)(len - 2))) {
+    sendResponse(0x01, CMD_BULK_DATA, pl, 2);  // reenviar este OFS
+    return true;
+  }
+  uint16_t idx = rel / BULK_RX_CHUNK;
+  uint8_t bit = (uint8_t)(1u << (idx & 7));
+  if (bulk.rxMap[idx >> 3] & bit) {
+    ++bulk.retx;                   // duplicado: la confirmación anterior se perdió
+  } else {
+    eeprom_update_block(&pl[2], (void*)(uintptr_t)ofs, n);
+    bulk.rxMap[idx >> 3] |= bit;
+    bulk.done += n;
+  }
+  sendResponse(0x00, CMD_BULK_DATA, pl, 2);
+  return true;
+}
+
+/**
+ * @brief Avance de la transferencia en bloques en cada pasada del bucle.
+ * Descarga: reenvíos pedidos primero, luego bloques nuevos dentro de la ventana,
+ * siempre que quepan enteros en el buffer TX (nunca bloquea).
+ * @param now millis() de esta pasada del bucle.
+ */
+static void serviceBulk(uint32_t now) {
+  if (!bulk.active) return;
+  if (bulk.dir == BULK_UPLOAD) {
+    if ((uint32_t)(now - bulk.lastMs) >= BULK_IDLE_MS) endBulk(BULK_RESULT_TIMEOUT);
+    return;
+  }
+  if (bulk.next != bulk.base && (uint32_t)(now - bulk.lastMs) >= BULK_TIMEOUT_MS) {
+    // Ni confirmaciones ni pedidos: se perdió el final de la ventana o el 0x1F
+    if (++bulk.timeouts > BULK_MAX_TIMEOUTS) { endBulk(BULK_RESULT_TIMEOUT); return; }
+    uint16_t outstanding = bulk.next - bulk.base;
+    bulk.resend = outstanding >= 8 ? 0xFF : (uint8_t)((1u << outstanding) - 1);
+    bulk.lastMs = now;
+  }
+  while (Serial.availableForWrite() >= BULK_TX_FRAME) {
+    if (bulk.resend) {
+      uint8_t i = 0;
+      while (!(bulk.resend & (1u << i))) ++i;
+      bulk.resend &= (uint8_t)~(1u << i);
+      ++bulk.retx;
+      sendBulkChunk(bulk.base + i);
+    } else if (bulk.next < bulk.chunks && bulk.next - bulk.base < BULK_TX_WINDOW) {
+      if (bulk.next == bulk.base) bulk.lastMs = now;  // ventana vacía: el timeout empieza aquí
+      sendBulkChunk(bulk.next++);
+    } else {
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Valida una configuración de bus (EEPROM o recibida por 0x21).
+ */
+static bool busConfigValid(const BusConfig& c) {
+  if (c.addr == BUS_BROADCAST) return false;
+  if (c.slots <= 1) return true;
+  return c.slots <= BUS_SLOTS_MAX && c.addr >= 1 && c.addr <= c.slots &&
+         c.slotMs >= BUS_SLOT_MIN_MS;
+}
+
+/**
+ * @brief Carga de EEPROM la dirección y los turnos; borrada o inválida = sin bus.
+ */
+static void loadBusConfig() {
+  BusConfig c;
+  eeprom_read_block(&c, &eeBus, sizeof(c));
+  if (busConfigValid(c)) bus = c;
+  txAddressed = busMode();
+}
+
+/**
+ * @brief Alinea el reloj con el resto del bus (0x22): millis() = tick y las fases de
+ * muestreo y de envío arrancan en ese instante.
+ */
+static void busSync(uint32_t tick) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { timer0_millis = tick; }
+  lastSampleDipMillis = tick;
+  lastSampleAdcMillis = tick;
+  lastTxMillis = tick;
+}
+
+/**
+ * @brief true al comienzo del turno propio (una vez por ciclo).
+ * Ciclo = bus.slots * bus.slotMs; la ranura de ADDR es la ADDR - 1.
+ * @param now millis() de esta pasada del bucle.
+ */
+static bool busTurn(uint32_t now) {
+  uint16_t cycle = (uint16_t)bus.slots * bus.slotMs;
+  uint32_t start = now - now % cycle + (uint16_t)(bus.addr - 1) * bus.slotMs;
+  if ((uint32_t)(now - start) > BUS_TURN_LATE_MS || start == busTurnStart) return false;
+  busTurnStart = start;
+  return true;
+}
+
+// Memoria: símbolos del enlazador (avr5.x) y pintado de la pila (ver "Memoria")
+static const uint8_t STACK_PAINT = 0xC5;
+extern "C" uint8_t __data_start;  // inicio de la RAM estática (RAMSTART)
+extern "C" uint8_t __heap_start;  // final de .data + .bss + .noinit
+
+/**
+ * @brief Pinta con STACK_PAINT desde __heap_start hasta RAMEND (.init1).
+ * Corre antes de inicializar r1 y la pila del C, por eso en ensamblador y sin
+ * usar registros que el arranque espera conservados.
+ */
+extern "C" void paintStack() __attribute__((naked, used, section(".init1")));
+void paintStack() {
+  __asm__ __volatile__(
+    "    ldi r30, lo8(__heap_start)\n"
+    "    ldi r31, hi8(__heap_start)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(%1)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(%1)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M"(STACK_PAINT), "i"(RAMEND));
+}
+
+/**
+ * @brief Bytes del hueco pila/RAM estática que la pila nunca alcanzó.
+ */
+static uint16_t stackUnused() {
+  const uint8_t* p = &__heap_start;
+  while (p <= (const uint8_t*)RAMEND && *p == STACK_PAINT) ++p;
+  return (uint16_t)(p - &__heap_start);
+}
+
+/**
+ * @brief Responde a 0x1B con el estado de la RAM.
+ * Payload: [FREE][STACK_LIBRE][ESTATICA][RAM], uint16 LE.
+ */
+static void sendMemReport() {
+  uint16_t values[4] = {
+    (uint16_t)(SP - (uintptr_t)&__heap_start),
+    stackUnused(),
+    (uint16_t)(&__heap_start - &__data_start),
+    (uint16_t)(RAMEND + 1 - (uintptr_t)&__data_start)
+  };
+  uint8_t pl[8];
+  for (uint8_t i = 0; i < 4; ++i) {
+    pl[2 * i] = (uint8_t)(values[i] & 0xFF);
+    pl[2 * i + 1] = (uint8_t)(values[i] >> 8);
+  }
+  sendResponse(0x00, CMD_GET_MEM, pl, sizeof(pl));
+}
+
 // Manejador de comandos
 /**
  * @brief Maneja los comandos del protocolo según su código CMD.
@@ -191,6 +1810,7 @@ static void sendResponse(uint8_t status, uint8_t cmd, const uint8_t* payload, ui
  * @param len Longitud del payload.
  */
 static void handleCommand(uint8_t cmd, const uint8_t* pl, uint8_t len) {
+  warmDirty = true;  // cualquier comando puede cambiar el estado retenido
   switch (cmd) {
     case 0x01: { // Set LED mask
       if (len != 1) { sendResponse(0x02, cmd, nullptr, 0); return; }
@@ -213,6 +1833,7 @@ static void handleCommand(uint8_t cmd, const uint8_t* pl, uint8_t len) {
       samplePeriodDipMs = ms;
       uint8_t resp[2] = {(uint8_t)(ms & 0xFF), (uint8_t)(ms >> 8)};
       sendResponse(0x00, cmd, resp, 2);
+      retuneRate();
     } break;
 
     case 0x04: { // Get sample period DIP
@@ -225,6 +1846,7 @@ static void handleCommand(uint8_t cmd, const uint8_t* pl, uint8_t len) {
     case 0x05: { // Streaming enable (0/1)
       if (len != 1) { sendResponse(0x02, cmd, nullptr, 0); return; }
       streamingEnabled = (pl[0] != 0);
+      sampleQueueCount = 0;
       uint8_t resp = streamingEnabled ? 1 : 0;
       sendResponse(0x00, cmd, &resp, 1);
     } break;
@@ -232,13 +1854,16 @@ static void handleCommand(uint8_t cmd, const uint8_t* pl, uint8_t len) {
     case 0x06: { // Snapshot: enviar 1 trama
       if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
       sendResponse(0x00, cmd, nullptr, 0);
+      if (frameFormat == FRAME_FMT_SPLIT) sendDigitalFrame();
       sendDataFrame();
+      if (inputModes) sendInputFrame();
     } break;
 
     case 0x07: { // Get info
       if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
-      const char* s = "LAB2 v1.0";
-      sendResponse(0x00, cmd, (const uint8_t*)s, (uint8_t)strlen(s));
+      uint8_t info[sizeof(INFO_TEXT) - 1];
+      memcpy_P(info, INFO_TEXT, sizeof(info));
+      sendResponse(0x00, cmd, info, sizeof(info));
     } break;
 
     case 0x08: { // Set sample period ADC (ms), uint16 LE
@@ -249,6 +1874,7 @@ static void handleCommand(uint8_t cmd, const uint8_t* pl, uint8_t len) {
       samplePeriodAdcMs = ms;
       uint8_t resp[2] = {(uint8_t)(ms & 0xFF), (uint8_t)(ms >> 8)};
       sendResponse(0x00, cmd, resp, 2);
+      retuneRate();
     } break;
 
     case 0x09: { // Get sample period ADC
@@ -258,35 +1884,434 @@ static void handleCommand(uint8_t cmd, const uint8_t* pl, uint8_t len) {
       sendResponse(0x00, cmd, resp, 2);
     } break;
 
+    case CMD_SYNC: { // Sync: eco del token + tick actual
+      if (len < 1 || len > SYNC_TOKEN_MAX) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      uint8_t resp[SYNC_TOKEN_MAX + 4];
+      memcpy(resp, pl, len);
+      uint32_t tick = millis();
+      resp[len + 0] = (uint8_t)(tick & 0xFF);
+      resp[len + 1] = (uint8_t)(tick >> 8);
+      resp[len + 2] = (uint8_t)(tick >> 16);
+      resp[len + 3] = (uint8_t)(tick >> 24);
+      sendResponse(0x00, cmd, resp, (uint8_t)(len + 4));
+    } break;
+
+    case CMD_GET_CAPS: { // Descriptor binario de capacidades
+      if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      sendCaps();
+    } break;
+
+    case CMD_SET_FRAME_FORMAT: { // Formato de trama de streaming
+      if (len != 1 || pl[0] > 7 || !(FRAME_FORMATS_MASK & (1u << pl[0])) ||
+          (busMode() && pl[0] == FRAME_FMT_SPLIT)) {  // el dividido no respeta los turnos
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      hostFrameFormat = pl[0];
+      uint8_t out = hostFrameFormat;
+      sendResponse(0x00, cmd, &out, 1);
+      retuneRate();
+    } break;
+
+    case CMD_GET_FRAME_FORMAT: {
+      if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      uint8_t out = frameFormat;
+      sendResponse(0x00, cmd, &out, 1);
+    } break;
+
+    case CMD_SET_ADAPTIVE: { // Control de tasa adaptativo (0/1)
+      if (len != 1) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      adaptiveEnabled = (pl[0] != 0);
+      uint8_t resp = adaptiveEnabled ? 1 : 0;
+      sendResponse(0x00, cmd, &resp, 1);
+      retuneRate();
+    } break;
+
+    case CMD_RATE: { // Tasa efectiva actual
+      if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      sendRate();
+    } break;
+
+    case CMD_GET_CHANNELS: { // Descriptores de canal en orden de trama
+      if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      uint8_t resp[1 + ADC_CHANNELS];
+      resp[0] = ADC_CHANNELS;
+      AdcChannels::describe(&resp[1]);
+      sendResponse(0x00, cmd, resp, sizeof(resp));
+    } break;
+
+    case CMD_SET_CAL_OUTPUT: { // Tramas compacta/analógica calibradas (0/1)
+      if (len != 1) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      calibratedOutput = (pl[0] != 0);
+      uint8_t resp = calibratedOutput ? 1 : 0;
+      sendResponse(0x00, cmd, &resp, 1);
+      retuneRate();  // cambia el tamaño de trama
+    } break;
+
+    case CMD_GET_CAL: { // Tabla de calibración de un canal
+      if (len != 1 || pl[0] >= ADC_CHANNELS) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      sendCalibration(cmd, pl[0]);
+    } break;
+
+    case CMD_SET_CAL: { // Escribe (o borra con N=0) la tabla de un canal en EEPROM
+      if (len < 3 || pl[0] >= ADC_CHANNELS || len != 3 + 4 * pl[2]) {
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      uint8_t ch = pl[0];
+      CalTable t;
+      memset(&t, 0xFF, sizeof(t));
+      if (pl[2] != 0) {
+        t.unit = pl[1];
+        t.n = pl[2];
+        if (t.n > CAL_POINTS) { sendResponse(0x02, cmd, nullptr, 0); return; }
+        for (uint8_t i = 0; i < t.n; ++i) {
+          const uint8_t* p = &pl[3 + 4 * i];
+          t.raw[i] = (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+          t.val[i] = (int16_t)((uint16_t)p[2] | ((uint16_t)p[3] << 8));
+        }
+        if (!calValid(t)) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      }
+      eeprom_update_block(&t, &eeCal[ch], sizeof(t));
+      loadCalibration(ch);
+      sendCalibration(cmd, ch);
+    } break;
+
+    case CMD_EXEC_AT: { // Ejecutar CMD cuando millis() alcance T
+      if (len < 5 || len - 5 > EXEC_PAYLOAD_MAX || execCount >= EXEC_QUEUE_LEN ||
+          pl[4] == CMD_EXEC_AT || pl[4] == CMD_EXEC_CANCEL) {
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      uint32_t at = (uint32_t)pl[0] | ((uint32_t)pl[1] << 8) |
+                    ((uint32_t)pl[2] << 16) | ((uint32_t)pl[3] << 24);
+      uint8_t id = scheduleCommand(at, pl[4], &pl[5], (uint8_t)(len - 5));
+      uint8_t resp[2] = {id, execCount};
+      sendResponse(0x00, cmd, resp, sizeof(resp));
+    } break;
+
+    case CMD_LINK_TEST: { // Prueba de enlace PRBS-15
+      if (len != 5 || pl[0] > LINK_MODE_RX || busMode()) {
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      uint32_t count = (uint32_t)pl[1] | ((uint32_t)pl[2] << 8) |
+                       ((uint32_t)pl[3] << 16) | ((uint32_t)pl[4] << 24);
+      if (count == 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      sendResponse(0x00, cmd, pl, len);
+      if (pl[0] == LINK_MODE_TX) {
+        runLinkTx(count);
+      } else {
+        linkRx = LinkRx();
+        linkRx.active = true;
+        linkRx.streamingWas = streamingEnabled;
+        linkRx.expected = count;
+        linkRx.lastMs = millis();
+        streamingEnabled = false;
+      }
+    } break;
+
+    case CMD_SET_GENERATOR: { // Señal sintética en lugar de la lectura real
+      if (len == 0) {
+        for (uint8_t i = 0; i < ADC_CHANNELS; ++i) adcGen[i].wave = GEN_OFF;
+        dipGen.wave = GEN_OFF;
+        sendResponse(0x00, cmd, nullptr, 0);
+        return;
+      }
+      uint16_t period = (uint16_t)pl[2] | ((uint16_t)pl[3] << 8);
+      if (len != 8 || pl[1] > GEN_COUNTER || (pl[1] != GEN_OFF && period == 0) ||
+          (pl[0] >= ADC_CHANNELS && pl[0] != GEN_DEST_DIP)) {
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      SignalGen& g = pl[0] == GEN_DEST_DIP ? dipGen : adcGen[pl[0]];
+      g = SignalGen();
+      g.wave = pl[1];
+      g.period = period;
+      g.amp = (uint16_t)pl[4] | ((uint16_t)pl[5] << 8);
+      g.offset = (uint16_t)pl[6] | ((uint16_t)pl[7] << 8);
+      g.prbs = 0x7FFF;
+      sendResponse(0x00, cmd, pl, len);
+    } break;
+
+    case CMD_GET_MEM: { // RAM libre y marca de agua de la pila
+      if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      sendMemReport();
+    } break;
+
+    case CMD_SET_INPUT_MODE: { // Entrada DIP como nivel, contador o período
+      if (len == 2 && pl[0] < 4 && pl[1] <= INPUT_PERIOD) {
+        setInputMode(pl[0], pl[1]);
+      } else if (len != 0) {
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      uint8_t modes = inputModes;
+      sendResponse(0x00, cmd, &modes, 1);
+    } break;
+
+    case CMD_BULK_OPEN: { // Abrir una descarga o carga en bloques
+      if (len != 6 || busMode() || !openBulk(pl)) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      uint8_t resp[8];
+      memcpy(resp, pl, 6);
+      resp[6] = bulk.dir == BULK_DOWNLOAD ? BULK_TX_CHUNK : BULK_RX_CHUNK;
+      resp[7] = bulk.dir == BULK_DOWNLOAD ? BULK_TX_WINDOW : BULK_RX_WINDOW;
+      sendResponse(0x00, cmd, resp, sizeof(resp));
+    } break;
+
+    case CMD_BULK_DATA: { // Bloque de una carga; la respuesta confirma su OFS
+      if (!bulkUploadChunk(pl, len)) { sendResponse(0x02, cmd, nullptr, 0); return; }
+    } break;
+
+    case CMD_BULK_ACK: { // Confirmación de descarga: sin respuesta si es válida
+      if (len != 3 || !bulkAck(pl)) { sendResponse(0x02, cmd, nullptr, 0); return; }
+    } break;
+
+    case CMD_BULK_END: { // Terminar la carga o cancelar la descarga
+      if (len != 0 || !bulk.active) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      bool complete = bulk.dir == BULK_UPLOAD ? bulk.done == bulk.length
+                                              : bulk.base == bulk.chunks;
+      endBulk(complete ? BULK_RESULT_OK : BULK_RESULT_INCOMPLETE);
+    } break;
+
+    case CMD_SET_ADDRESS: { // Dirección y turnos del bus multipunto
+      BusConfig c = bus;
+      if (len == 3) {
+        c.addr = pl[0];
+        c.slots = pl[1];
+        c.slotMs = pl[2];
+      }
+      if ((len != 0 && len != 3) || (len == 3 && cmdBroadcast) || !busConfigValid(c) ||
+          (c.slots > 1 && (hostFrameFormat == FRAME_FMT_SPLIT || bulk.active || linkRx.active))) {
+        sendResponse(0x02, cmd, nullptr, 0); return;
+      }
+      uint8_t resp[3] = {c.addr, c.slots, c.slotMs};
+      sendResponse(0x00, cmd, resp, sizeof(resp));  // con la dirección anterior
+      if (len == 3) {
+        bus = c;
+        eeprom_update_block(&bus, &eeBus, sizeof(bus));
+        if (busMode()) txAddressed = true;
+      }
+    } break;
+
+    case CMD_BUS_SYNC: { // Reloj común del bus; nunca se responde
+      if (len == 4) {
+        busSync((uint32_t)pl[0] | ((uint32_t)pl[1] << 8) |
+                ((uint32_t)pl[2] << 16) | ((uint32_t)pl[3] << 24));
+      }
+    } break;
+
+    case CMD_EXEC_CANCEL: { // Vaciar la cola de comandos programados
+      if (len != 0) { sendResponse(0x02, cmd, nullptr, 0); return; }
+      uint8_t dropped = execCount;
+      execCount = 0;
+      sendResponse(0x00, cmd, &dropped, 1);
+    } break;
+
     default:
       sendResponse(0x03, cmd, nullptr, 0);
       break;
   }
 }
 
+/**
+ * @brief Ejecuta los comandos programados cuyo tick ya llegó.
+ * Cada uno produce su respuesta normal seguida del evento 0x16 con el tick real;
+ * en el bus ambas se omiten (el tick no coincide con el turno propio).
+ * @param now millis() de esta pasada del bucle.
+ */
+static void serviceExecQueue(uint32_t now) {
+  while (execCount && (int32_t)(now - execQueue[0].at) >= 0) {
+    TimedCommand c = execQueue[0];
+    --execCount;
+    for (uint8_t i = 0; i < execCount; ++i) execQueue[i] = execQueue[i + 1];
+    uint32_t tick = millis();
+    txMuted = busMode();
+    handleCommand(c.cmd, c.pl, c.len);
+    uint8_t ev[6] = {c.id, c.cmd, 0, 0, 0, 0};
+    putU32(&ev[2], tick);
+    sendResponse(0x00, CMD_EXECUTED, ev, sizeof(ev));
+    txMuted = false;
+  }
+}
+
+/**
+ * @brief Guarda MCUSR y r2 y apaga el watchdog antes de inicializar la RAM (.init3).
+ * Tras un reset del watchdog éste sigue activo con el timeout mínimo; hay que
+ * apagarlo antes de que el arranque del C y setup() lo disparen otra vez.
+ * El arranque del C no toca r2; resolveResetFlags() decide si es de fiar.
+ */
+extern "C" void captureResetFlags() __attribute__((naked, used, section(".init3")));
+void captureResetFlags() {
+  asm volatile("sts bootR2, r2");
+  resetFlags = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+/**
+ * @brief Completa la causa del reset con la que optiboot >= 6 deja en r2.
+ * optiboot limpia MCUSR antes de saltar a la aplicación; desde la versión 6 pasa
+ * el valor original en r2. Con una versión anterior (4.4 de fábrica del UNO) r2
+ * no significa nada y la causa queda en 0: arranque frío. Flash borrada (0xFF) es
+ * una placa sin bootloader, donde MCUSR ya llegó intacto.
+ */
+static void resolveResetFlags() {
+  if (resetFlags != 0) return;
+  uint8_t major = pgm_read_byte(OPTIBOOT_MAJOR_ADDR);
+  if (major >= OPTIBOOT_R2_MAJOR && major != 0xFF) resetFlags = bootR2;
+}
+
+/**
+ * @brief CRC-16 de los campos del bloque retenido (sin el propio CRC).
+ */
+static uint16_t warmStateCrc(const WarmState& w) {
+  const uint8_t* p = (const uint8_t*)&w;
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < offsetof(WarmState, crc); ++i) crc = _crc16_update(crc, p[i]);
+  return crc;
+}
+
+/**
+ * @brief Copia el estado de la adquisición al bloque .noinit.
+ * @param now millis() de esta pasada del bucle.
+ */
+static void saveWarmState(uint32_t now) {
+  bool streaming = linkRx.active ? linkRx.streamingWas
+                 : bulk.active ? bulk.streamingWas : streamingEnabled;
+  warmState.magic = WARM_MAGIC;
+  warmState.periodDipMs = samplePeriodDipMs;
+  warmState.periodAdcMs = samplePeriodAdcMs;
+  warmState.tick = now;
+  warmState.flags = (streaming ? WARM_STREAMING : 0) | (adaptiveEnabled ? WARM_ADAPTIVE : 0) |
+                    (calibratedOutput ? WARM_CALIBRATED : 0);
+  warmState.hostFormat = hostFrameFormat;
+  warmState.ledMask = ledMask;
+  warmState.digitalSeq = digitalSeq;
+  warmState.inputModes = inputModes;
+  warmState.crc = warmStateCrc(warmState);
+  warmDirty = false;
+}
+
+/**
+ * @brief Restaura el estado retenido si la causa del reset es solo el watchdog.
+ * Una causa 0 o desconocida es un arranque frío: tras abrir el puerto (DTR) el
+ * optiboot del UNO sale por su propio watchdog y limpia MCUSR, y eso no debe
+ * confundirse con una caída del firmware.
+ * Adelanta millis() hasta el último guardado más la caída estimada y SEQ en las
+ * tramas digitales perdidas, así el hueco en el host refleja la caída.
+ * @return true si hubo reinicio en caliente.
+ */
+static bool restoreWarmState() {
+  const WarmState& w = warmState;
+  if ((resetFlags & READY_RESET_MASK) != _BV(WDRF)) return false;
+  if (w.magic != WARM_MAGIC || w.crc != warmStateCrc(w)) return false;
+  if (w.periodDipMs < SAMPLE_MIN_MS || w.periodDipMs > SAMPLE_MAX_MS ||
+      w.periodAdcMs < SAMPLE_MIN_MS || w.periodAdcMs > SAMPLE_MAX_MS ||
+      w.hostFormat > 7 || !(FRAME_FORMATS_MASK & (1u << w.hostFormat))) {
+    return false;
+  }
+  samplePeriodDipMs = w.periodDipMs;
+  samplePeriodAdcMs = w.periodAdcMs;
+  hostFrameFormat = w.hostFormat;
+  adaptiveEnabled = (w.flags & WARM_ADAPTIVE) != 0;
+  calibratedOutput = (w.flags & WARM_CALIBRATED) != 0;
+  streamingEnabled = (w.flags & WARM_STREAMING) != 0;
+  applyLedMask(w.ledMask);
+  for (uint8_t i = 0; i < 4; ++i) setInputMode(i, (w.inputModes >> (2 * i)) & 0x03);
+
+  // Caída = timeout del watchdog + lo que llevó el arranque hasta aquí
+  uint32_t outage = WDT_TIMEOUT_MS + millis();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { timer0_millis = w.tick + outage; }
+  digitalSeq = (uint8_t)(w.digitalSeq + outage / samplePeriodDipMs);
+  return true;
+}
+
+/**
+ * @brief Incrementa y persiste el contador de arranques en EEPROM.
+ * @return Valor del contador para este arranque.
+ */
+static uint16_t bumpBootCount() {
+  uint16_t n = eeprom_read_word(&eeBootCount);
+  if (n == 0xFFFF) n = 0;
+  ++n;
+  eeprom_update_word(&eeBootCount, n);
+  return n;
+}
+
+/**
+ * @brief Anuncia que el firmware está listo (respuesta no solicitada 0x0A).
+ * Payload: [PROTO_VER][CAPS][BOOT_L][BOOT_H][RESET].
+ */
+static void sendReady() {
+  uint8_t reset = (uint8_t)((resetFlags & READY_RESET_MASK) | (warmRestart ? READY_WARM : 0));
+  uint8_t pl[5] = {PROTOCOL_VERSION, DEVICE_CAPS,
+                   (uint8_t)(bootCount & 0xFF), (uint8_t)(bootCount >> 8), reset};
+  sendResponse(0x00, CMD_READY, pl, sizeof(pl));
+}
+
+/**
+ * @brief Turno propio en el bus: Ready pendiente y el comando recibido desde el
+ * turno anterior, con su respuesta.
+ */
+static void serviceBusTurn() {
+  if (busReadyPending) {
+    busReadyPending = false;
+    sendReady();
+  }
+  if (!busPending.valid) return;
+  busPending.valid = false;
+  cmdBroadcast = busPending.broadcast;
+  handleCommand(busPending.cmd, busPending.pl, busPending.len);
+  cmdBroadcast = false;
+}
+
 // Parser de comandos (state machine)
-enum class RxState : uint8_t { WAIT_H1, WAIT_H2, WAIT_CMD, WAIT_LEN, WAIT_PAYLOAD, WAIT_CHK };
+enum class RxState : uint8_t { WAIT_H1, WAIT_H2, WAIT_ADDR, WAIT_CMD, WAIT_LEN, WAIT_PAYLOAD, WAIT_CHK };
 static RxState rxState = RxState::WAIT_H1;
+static bool rxAddressed = false;   // cabecera 55 AC
+static uint8_t rxAddr = 0;
 static uint8_t rxCmd = 0;
 static uint8_t rxLen = 0;
-static uint8_t rxPayload[64];
+static uint8_t rxPayload[RX_PAYLOAD_MAX];
 static uint8_t rxIndex = 0;
 
+/**
+ * @brief true si el comando en curso va dirigido a esta placa (ver "Bus multipunto").
+ */
+static bool rxForMe() {
+  if (!rxAddressed) return !busMode();
+  return rxAddr == bus.addr || rxAddr == BUS_BROADCAST;
+}
+
+/**
+ * @brief true si un error de recepción (LEN o CHK) del comando en curso se responde:
+ * solo fuera del bus y si no es una difusión.
+ */
+static bool rxErrorReplies() {
+  if (busMode() || !rxForMe() || (rxAddressed && rxAddr == BUS_BROADCAST)) return false;
+  txAddressed = rxAddressed;
+  return true;
+}
+
 /**
  * @brief Parser no bloqueante de comandos por UART (máquina de estados).
- * Procesa bytes disponibles y, si el paquete es válido (checksum OK), llama a handleCommand().
+ * Procesa bytes disponibles y, si el paquete es válido (checksum OK) y para esta
+ * placa, llama a handleCommand(); en el bus lo deja pendiente para el turno propio.
  */
 static void processSerial() {
   while (Serial.available() > 0) {
     uint8_t b = (uint8_t)Serial.read();
+    // Prueba de enlace PC->MCU: los bytes son patrón, no comandos
+    if (linkRx.active && linkRx.received < linkRx.expected) { linkRxByte(b); continue; }
     switch (rxState) {
       case RxState::WAIT_H1:
         if (b == 0x55) rxState = RxState::WAIT_H2;
         break;
       case RxState::WAIT_H2:
+        rxAddressed = (b == 0xAC);
         if (b == 0xAA) rxState = RxState::WAIT_CMD;
+        else if (rxAddressed) rxState = RxState::WAIT_ADDR;
         else rxState = RxState::WAIT_H1;
         break;
+      case RxState::WAIT_ADDR:
+        rxAddr = b;
+        rxState = RxState::WAIT_CMD;
+        break;
       case RxState::WAIT_CMD:
         rxCmd = b;
         rxState = RxState::WAIT_LEN;
@@ -295,7 +2320,7 @@ static void processSerial() {
         rxLen = b;
         if (rxLen > sizeof(rxPayload)) {
           // Longitud inválida
-          sendResponse(0x02, rxCmd, nullptr, 0);
+          if (rxErrorReplies()) sendResponse(0x02, rxCmd, nullptr, 0);
           rxState = RxState::WAIT_H1;
         } else if (rxLen == 0) {
           rxState = RxState::WAIT_CHK;
@@ -311,16 +2336,35 @@ static void processSerial() {
         }
         break;
       case RxState::WAIT_CHK: {
-        // Verificar checksum: XOR de [CMD, LEN, PAYLOAD...]
+        // Verificar checksum: XOR de [ADDR, CMD, LEN, PAYLOAD...]
         uint8_t buf[2] = {rxCmd, rxLen};
         uint8_t x = xorChecksum(buf, 2);
+        if (rxAddressed) x ^= rxAddr;
         if (rxLen) x ^= xorChecksum(rxPayload, rxLen);
-        if (x == b) {
-          handleCommand(rxCmd, rxPayload, rxLen);
-        } else {
-          sendResponse(0x01, rxCmd, nullptr, 0);
-        }
         rxState = RxState::WAIT_H1;
+        if (x != b) {
+          if (rxErrorReplies()) sendResponse(0x01, rxCmd, nullptr, 0);
+          break;
+        }
+        if (!rxForMe()) break;
+        bool broadcast = rxAddressed && rxAddr == BUS_BROADCAST;
+        if (busMode() && rxCmd != CMD_BUS_SYNC) {
+          // Se responde en el turno propio; uno a la vez (el host espera la respuesta)
+          if (!busPending.valid) {
+            busPending.valid = true;
+            busPending.broadcast = broadcast;
+            busPending.cmd = rxCmd;
+            busPending.len = rxLen;
+            memcpy(busPending.pl, rxPayload, rxLen);
+          }
+          break;
+        }
+        txAddressed = busMode() || rxAddressed;
+        txMuted = broadcast && !busMode();  // varias placas responderían a la vez
+        cmdBroadcast = broadcast;
+        handleCommand(rxCmd, rxPayload, rxLen);
+        txMuted = false;
+        cmdBroadcast = false;
       } break;
     }
   }
@@ -332,19 +2376,33 @@ static void processSerial() {
 void setup() {
   // UART
   Serial.begin(SERIAL_BAUD);
+  bootCount = bumpBootCount();
+  for (uint8_t i = 0; i < ADC_CHANNELS; ++i) loadCalibration(i);
+  loadBusConfig();
   // Estructura base pins
   for (uint8_t i = 0; i < 4; ++i) {
-    pinMode(LED_PINS[i], OUTPUT);
-    digitalWrite(LED_PINS[i], LOW);
+    uint8_t pin = pgm_read_byte(&LED_PINS[i]);
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
   }
   for (uint8_t i = 0; i < 4; ++i) {
-    pinMode(DIP_PINS[i], INPUT_PULLUP);
+    pinMode(pgm_read_byte(&DIP_PINS[i]), INPUT_PULLUP);
   }
+  // Tras un reset del watchdog se retoma la configuración y el streaming anteriores
+  resolveResetFlags();
+  warmRestart = restoreWarmState();
   // Lecturas iniciales
   readDipMask();
-  readAdcAll(lastAdc);
+  readAdcAll();
   lastSampleDipMillis = millis();
   lastSampleAdcMillis = millis();
+  // Avisar al host en cuanto la UART y el estado inicial están listos (en el bus, en
+  // el primer turno: todas las placas arrancan a la vez al encender)
+  if (busMode()) busReadyPending = true;
+  else sendReady();
+  if (warmRestart) retuneRate();  // formato efectivo y diezmado del modo adaptativo
+  saveWarmState(millis());
+  wdt_enable(WDT_TIMEOUT);
 }
 
 /**
@@ -352,28 +2410,64 @@ void setup() {
  *        y transmite tramas si el streaming está habilitado.
  */
 void loop() {
+  wdt_reset();
+  addrMarkSent = false;
+
   // Procesar comandos entrantes por UART (#42, #48)
   processSerial();
 
   uint32_t now = millis();
 
+  // Comandos programados: antes de muestrear, para que la muestra de T ya los refleje
+  serviceExecQueue(now);
+  serviceLinkRx(now);
+  serviceBulk(now);
+
+  // Bus multipunto: toda la transmisión de esta pasada depende del turno propio
+  bool turn = !busMode() || busTurn(now);
+  if (busMode() && turn) serviceBusTurn();
+
   // Muestreo DIP (#44, #46)
   if ((uint32_t)(now - lastSampleDipMillis) >= samplePeriodDipMs) {
     lastSampleDipMillis = now;
+    if (dipGen.wave != GEN_OFF) genStep(dipGen, 0x0F);
     readDipMask();
+    digitalPending = true;
+    inputReportDue = inputModes != 0;
+    warmDirty = true;
   }
 
   // Muestreo ADC (#45, #46)
   if ((uint32_t)(now - lastSampleAdcMillis) >= samplePeriodAdcMs) {
     lastSampleAdcMillis = now;
-    readAdcAll(lastAdc);
+    readAdcAll();
+    analogFresh = true;
+    warmDirty = true;
   }
 
-  // Envío continuo de tramas (#47) - usa el período más corto para transmitir
-  static uint32_t lastTxMillis = 0;
-  uint16_t txPeriod = min(samplePeriodDipMs, samplePeriodAdcMs);
-  if (streamingEnabled && (uint32_t)(now - lastTxMillis) >= txPeriod) {
-    lastTxMillis = now;
-    sendDataFrame();
+  // Envío continuo de tramas (#47) - usa el período más corto para transmitir,
+  // diezmado por el control de tasa si el modo adaptativo está activo
+  // El formato dividido envía cada trama al ritmo de su propio muestreo
+  uint32_t txPeriod = (uint32_t)txBasePeriod() * txDecim;
+  if (streamingEnabled && turn && sampleQueueCount) drainSampleQueue();
+  if (streamingEnabled && frameFormat == FRAME_FMT_SPLIT) {
+    streamSplit();
+  } else if (streamingEnabled && turn && (uint32_t)(now - lastTxMillis) >= txPeriod) {
+    // En el bus, desde el comienzo del turno: el período no deriva con el retraso
+    lastTxMillis = busMode() ? busTurnStart : now;
+    if (adaptiveEnabled) streamAdaptive();
+    else sendDataFrame();
   }
+
+  // Entradas medidas (0x1C): una trama por Ts DIP; con el buffer TX lleno en modo
+  // adaptativo se espera, la cuenta y el período siguen acumulando
+  if (inputReportDue && streamingEnabled && turn &&
+      (!adaptiveEnabled || Serial.availableForWrite() >= INPUT_FRAME_SIZE + addrMarkPending())) {
+    inputReportDue = false;
+    sendInputFrame();
+  }
+
+  // Estado retenido para un reinicio en caliente: el tick en cada pasada (una vez por
+  // ms), así la caída se mide desde el último bucle vivo y no desde el último muestreo
+  if (warmDirty || now != warmState.tick) saveWarmState(now);
 }
\ No newline at end of file
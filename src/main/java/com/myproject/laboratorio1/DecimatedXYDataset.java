@@ -0,0 +1,202 @@
+package com.myproject.laboratorio1;
+
+import org.jfree.data.xy.AbstractXYDataset;
+import org.jfree.data.xy.XYSeries;
+
+/**
+ * Dataset XY de capacidad fija para las gráficas en tiempo real.
+ * <p>
+ * Las muestras se guardan en un anillo de arreglos primitivos (sin objetos por
+ * punto); al llenarse se sobrescriben las más antiguas. Lo que ve JFreeChart no
+ * es el anillo sino una vista diezmada por columnas de píxel: en cada columna se
+ * conservan el mínimo y el máximo, en su orden temporal, de modo que picos y
+ * flancos se siguen viendo. Así el costo de dibujar es O(ancho en píxeles) sin
+ * importar la tasa de muestreo ni la duración de la sesión.
+ * </p>
+ * <p>
+ * {@link #add(double, double)} solo escribe en el anillo; la vista se reconstruye
+ * en {@link #refresh(int)}, que {@link LineGraph} llama a la tasa de refresco de
+ * pantalla. Tanto {@code refresh} como la lectura de la vista ocurren en el EDT.
+ * </p>
+ */
+public class DecimatedXYDataset extends AbstractXYDataset {
+
+    private final Comparable<?> key;
+    private final int capacity;
+
+    // Anillo de muestras crudas (acceso bajo 'this')
+    private final double[] ringX;
+    private final double[] ringY;
+    private int head = 0;          // índice de la próxima escritura
+    private int count = 0;
+    private boolean dirty = false;
+
+    // Vista diezmada (solo EDT): como mucho 2 puntos por columna
+    private double[] viewX = new double[0];
+    private double[] viewY = new double[0];
+    private int viewCount = 0;
+
+    /**
+     * @param key      Nombre de la serie.
+     * @param capacity Muestras retenidas como máximo.
+     */
+    public DecimatedXYDataset(Comparable<?> key, int capacity) {
+        this.key = key;
+        this.capacity = Math.max(1, capacity);
+        this.ringX = new double[this.capacity];
+        this.ringY = new double[this.capacity];
+    }
+
+    /**
+     * Agrega una muestra al anillo (sin notificar al gráfico).
+     * Se espera X creciente (tiempo); si se llena, se pisa la más antigua.
+     */
+    public synchronized void add(double x, double y) {
+        ringX[head] = x;
+        ringY[head] = y;
+        head = (head + 1) % capacity;
+        if (count < capacity) count++;
+        dirty = true;
+    }
+
+    /** Vacía el anillo; la vista se limpia en el próximo refresco. */
+    public synchronized void clear() {
+        head = 0;
+        count = 0;
+        dirty = true;
+    }
+
+    /** Muestras retenidas en el anillo. */
+    public synchronized int getSampleCount() {
+        return count;
+    }
+
+    /**
+     * Copia las muestras retenidas, a resolución completa, en una XYSeries
+     * (exportación a Excel/CSV).
+     */
+    public synchronized XYSeries toXYSeries() {
+        XYSeries series = new XYSeries(key.toString(), false, true);
+        int first = (head - count + capacity) % capacity;
+        for (int i = 0; i < count; i++) {
+            int idx = (first + i) % capacity;
+            series.add(ringX[idx], ringY[idx], false);
+        }
+        return series;
+    }
+
+    /**
+     * Reconstruye la vista diezmada si llegaron muestras desde el último refresco
+     * y, en ese caso, notifica al gráfico. Debe llamarse en el EDT.
+     *
+     * @param columns Columnas de píxel disponibles para el trazo.
+     * @return true si la vista cambió.
+     */
+    public boolean refresh(int columns) {
+        synchronized (this) {
+            if (!dirty) return false;
+            dirty = false;
+            decimate(Math.max(1, columns));
+        }
+        fireDatasetChanged();
+        return true;
+    }
+
+    // Min/max por columna sobre el rango X retenido. Llamado con el lock tomado.
+    private void decimate(int columns) {
+        if (viewX.length < columns * 2) {
+            viewX = new double[columns * 2];
+            viewY = new double[columns * 2];
+        }
+        viewCount = 0;
+        if (count == 0) return;
+
+        int first = (head - count + capacity) % capacity;
+        // Pocas muestras: la vista es el anillo tal cual
+        if (count <= columns * 2) {
+            for (int i = 0; i < count; i++) {
+                int idx = (first + i) % capacity;
+                viewX[viewCount] = ringX[idx];
+                viewY[viewCount++] = ringY[idx];
+            }
+            return;
+        }
+
+        double x0 = ringX[first];
+        double span = ringX[(head - 1 + capacity) % capacity] - x0;
+        double scale = span > 0 ? columns / span : 0;
+        int column = -1;
+        int minIdx = -1;
+        int maxIdx = -1;
+        for (int i = 0; i < count; i++) {
+            int idx = (first + i) % capacity;
+            int c = Math.min(columns - 1, Math.max(0, (int) ((ringX[idx] - x0) * scale)));
+            if (c != column) {
+                emitColumn(minIdx, maxIdx);
+                column = c;
+                minIdx = idx;
+                maxIdx = idx;
+            } else if (ringY[idx] < ringY[minIdx]) {
+                minIdx = idx;
+            } else if (ringY[idx] > ringY[maxIdx]) {
+                maxIdx = idx;
+            }
+        }
+        emitColumn(minIdx, maxIdx);
+    }
+
+    // Emite el mínimo y el máximo de una columna en el orden en que llegaron
+    private void emitColumn(int minIdx, int maxIdx) {
+        if (minIdx < 0 || viewCount + 2 > viewX.length) return;
+        int firstIdx = minIdx;
+        int secondIdx = maxIdx;
+        int oldest = (head - count + capacity) % capacity;
+        if ((maxIdx - oldest + capacity) % capacity < (minIdx - oldest + capacity) % capacity) {
+            firstIdx = maxIdx;
+            secondIdx = minIdx;
+        }
+        viewX[viewCount] = ringX[firstIdx];
+        viewY[viewCount++] = ringY[firstIdx];
+        if (secondIdx != firstIdx) {
+            viewX[viewCount] = ringX[secondIdx];
+            viewY[viewCount++] = ringY[secondIdx];
+        }
+    }
+
+    // === XYDataset: expone la vista diezmada ===
+
+    @Override
+    public int getSeriesCount() {
+        return 1;
+    }
+
+    @Override
+    public Comparable getSeriesKey(int series) {
+        return key;
+    }
+
+    @Override
+    public int getItemCount(int series) {
+        return viewCount;
+    }
+
+    @Override
+    public Number getX(int series, int item) {
+        return viewX[item];
+    }
+
+    @Override
+    public Number getY(int series, int item) {
+        return viewY[item];
+    }
+
+    @Override
+    public double getXValue(int series, int item) {
+        return viewX[item];
+    }
+
+    @Override
+    public double getYValue(int series, int item) {
+        return viewY[item];
+    }
+}
@@ -5,27 +5,34 @@ import org.jfree.chart.JFreeChart;
 import org.jfree.chart.axis.NumberAxis;
 import org.jfree.chart.plot.XYPlot;
 import org.jfree.data.xy.XYSeries;
-import org.jfree.data.xy.XYSeriesCollection;
 import javax.swing.JPanel;
 
 import javax.swing.*;
 import java.awt.*;
 
 /**
+ * Gráfico de líneas en tiempo real sobre JFreeChart.
+ * <p>
+ * Los datos van a un {@link DecimatedXYDataset} de capacidad fija y el gráfico
+ * solo se redibuja cada {@value #REFRESH_MS} ms si llegaron datos, con una vista
+ * diezmada al ancho del panel.
+ * </p>
+ *
  * @author Arley
  */
 public class LineGraph {
     // === Atributos ===
-    /** Serie de datos que se graficará (pares X, Y). */
-    private XYSeries series;
-    /** Colección de series, necesaria para construir el dataset del gráfico. */
-    private XYSeriesCollection dataset;
+    /** Refresco de pantalla (~30 fps): agrupa todas las muestras llegadas entre cuadros. */
+    static final int REFRESH_MS = 33;
+    /** Anillo de datos (pares X, Y) con vista diezmada que se graficará. */
+    private DecimatedXYDataset dataset;
     /** Objeto que representa el gráfico en sí (XY Line Chart). */
     private JFreeChart chart;
     /** Panel gráfico que contiene el chart y permite mostrarlo en una interfaz Swing. */
     private ChartPanel chartPanel;
     
     private Timer timer;
+    private Timer refreshTimer;
     private double tiempo;
 
     // === Constructor ===
@@ -35,16 +42,12 @@ public class LineGraph {
      * @param titulo   Título principal del gráfico.
      * @param ejeX     Nombre (etiqueta) para el eje X.
      * @param ejeY     Nombre (etiqueta) para el eje Y.
-     * @param maxPuntos Cantidad máxima de puntos a mostrar en la serie. 
+     * @param maxPuntos Cantidad máxima de puntos retenidos. 
      *                  Si se excede, los más antiguos se eliminan automáticamente.
      */
     public LineGraph(String titulo, String ejeX, String ejeY, int maxPuntos) {
-        // Inicializar la serie de datos con un nombre genérico "Datos"
-        series = new XYSeries("Datos");
-        series.setMaximumItemCount(maxPuntos); // Limita la cantidad de puntos
-
-        // Asociar la serie a un dataset
-        dataset = new XYSeriesCollection(series);
+        // Anillo de datos con un nombre genérico "Datos"; limita la cantidad de puntos
+        dataset = new DecimatedXYDataset("Datos", maxPuntos);
 
         // Crear el gráfico XY de líneas
         chart = ChartFactory.createXYLineChart(
@@ -56,6 +59,18 @@ public class LineGraph {
 
         // Crear el panel que contendrá el gráfico para usar en Swing
         chartPanel = new ChartPanel(chart);
+
+        // Redibujar a tasa de pantalla solo si hubo datos nuevos
+        refreshTimer = new Timer(REFRESH_MS, e -> dataset.refresh(plotColumns()));
+        refreshTimer.setCoalesce(true);
+        refreshTimer.start();
+    }
+
+    /** Columnas de píxel del área de trazado (ancho del panel si aún no se dibujó). */
+    private int plotColumns() {
+        Rectangle area = chartPanel.getScreenDataArea().getBounds();
+        int width = area.width > 0 ? area.width : chartPanel.getWidth();
+        return width > 0 ? width : 800;
     }
 
     // === Métodos públicos ===
@@ -71,13 +86,14 @@ public class LineGraph {
     /**
      * Agrega un nuevo dato (x, y) a la serie.
      * Si la cantidad de puntos supera el máximo definido, 
-     * el más antiguo se elimina automáticamente.
+     * el más antiguo se elimina automáticamente. No redibuja: el gráfico se
+     * actualiza en el siguiente refresco.
      *
      * @param x Valor para el eje X.
      * @param y Valor para el eje Y.
      */
     public void addDato(double x, double y) {
-        series.add(x, y);
+        dataset.add(x, y);
     }
     
     /**
@@ -118,13 +134,14 @@ public class LineGraph {
         plot.getRangeAxis().setLabel(yLabel);
     }
 
+    // Copia de los datos retenidos a resolución completa (no la vista diezmada)
     public XYSeries getSeriexy(){
-        return series;
+        return dataset.toXYSeries();
     }
     
     // Metodo para limpiar los datos de la serie
     public void clearData(){
-        series.clear();
+        dataset.clear();
     }
     
     // Metodo para cambiar el titulo de la grafica
@@ -145,7 +162,7 @@ public class LineGraph {
         }
 
         // La serie actual se limpia para comenzar con una nueva graficación.
-        series.clear();
+        clearData();
 
         // El tiempo del eje X se reinicia a cero.
         tiempo = 0.0;
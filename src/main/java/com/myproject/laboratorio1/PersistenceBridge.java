@@ -1,5 +1,8 @@
 package com.myproject.laboratorio1;
 
+import java.lang.invoke.MethodHandle;
+import java.lang.invoke.MethodHandles;
+import java.lang.invoke.MethodType;
 import java.util.logging.Level;
 import java.util.logging.Logger;
 
@@ -32,10 +35,16 @@ import java.util.logging.Logger;
  * 
  * <p><b>Dirección Micro → BD (Persistencia):</b></p>
  * <ul>
- *   <li>Método {@link #persistSample(int, int[], int[])} recibe muestras del micro</li>
- *   <li>Inserta 8 valores analógicos en int_proceso_vars_data (ADC0-ADC7)</li>
- *   <li>Inserta 4 valores digitales en int_proceso_vars_data (DIN0-DIN3)</li>
- *   <li>Registra timestamp en milisegundos para cada muestra</li>
+ *   <li>Método {@link #persistSample(long, int[], int)} encola la muestra en una cola
+ *       acotada y vuelve de inmediato; si la cola está llena la muestra se descarta
+ *       y se cuenta ({@link #getDroppedSamples()})</li>
+ *   <li>El hilo escritor agrupa lo encolado por ventana de {@value #FLUSH_WINDOW_MS} ms
+ *       y lo inserta con un INSERT de múltiples filas ({@code insertVarsDataBatch});
+ *       con un DAO sin ese método inserta muestra a muestra</li>
+ *   <li>Los métodos del DAO se resuelven una sola vez como {@link MethodHandle}</li>
+ *   <li>Inserta 8 valores analógicos (ADC0-ADC7) y 4 digitales (DIN0-DIN3) por muestra
+ *       en int_proceso_vars_data con su timestamp en milisegundos; fecha y hora son
+ *       las del host al encolar cada muestra, no las del volcado</li>
  * </ul>
  * 
  * <p><b>Manejo robusto de errores:</b></p>
@@ -88,9 +97,37 @@ public final class PersistenceBridge {
     private volatile Integer lastSentTsDip = null;
     private volatile Integer lastSentLedMask = null;
 
+    // Escritor asíncrono de muestras: cola acotada de arreglos primitivos + hilo propio
+    private static final int QUEUE_CAPACITY = 4096;      // muestras (~40 s a 100 Hz)
+    private static final int MAX_BATCH_SAMPLES = 128;    // 12 filas por muestra en un INSERT
+    static final long FLUSH_WINDOW_MS = 200;
+    private final Object queueLock = new Object();
+    private final long[] queueT = new long[QUEUE_CAPACITY];
+    private final long[] queueEpoch = new long[QUEUE_CAPACITY];  // hora del host al encolar
+    private final int[] queueAdc = new int[QUEUE_CAPACITY * 8];
+    private final int[] queueDigital = new int[QUEUE_CAPACITY];
+    private int queueHead = 0;    // próxima muestra a escribir en BD
+    private int queueCount = 0;
+    private Thread writerThread;
+    // Métricas (solo lectura fuera del hilo escritor)
+    private volatile long droppedSamples = 0;
+    private volatile long writtenSamples = 0;
+    private volatile long failedSamples = 0;
+    private volatile long lastFlushMs = -1;
+    // Métodos del DAO resueltos una vez (receptor ya enlazado); null si no existen
+    private final MethodHandle insertBatchHandle;
+    private final MethodHandle insertSampleHandle;
+
     private PersistenceBridge() {
         this.procesoDataDAO = newInstanceSafe("IntProcesoDataDAO");
         this.procesoDAO = newInstanceSafe("IntProcesoDAO");
+        this.insertBatchHandle = resolveHandle(procesoDataDAO,
+                MethodType.methodType(void.class, long[].class, long[].class, int[].class, int[].class,
+                        int.class),
+                "insertVarsDataBatch");
+        this.insertSampleHandle = resolveHandle(procesoDataDAO,
+                MethodType.methodType(void.class, long.class, int[].class, int[].class),
+                "insertVarsData", "insert", "save");
         
         // Configurar proceso activo por defecto (Arduino Uno = ID 3)
         if (procesoDataDAO != null) {
@@ -212,10 +249,10 @@ public final class PersistenceBridge {
     }
 
     /**
-     * Persiste una muestra recibida (8 analógicas y 4 digitales).
+     * Encola una muestra recibida (8 analógicas y 4 digitales) para el escritor.
      * <p>
-     * Intenta métodos comunes en {@code IntProcesoDataDAO} mediante reflexión:
-     * {@code insertVarsData}. Si no se encuentran, intenta firmas alternativas.
+     * No accede a la BD ni bloquea: copia la muestra en la cola acotada y vuelve.
+     * Si la cola está llena (BD caída o lenta) la muestra se descarta y se cuenta.
      * </p>
      * <p>
      * <b>Nota:</b> Los pines digitales están codificados en el nibble alto (bits 4-7)
@@ -224,27 +261,116 @@ public final class PersistenceBridge {
      * </p>
      *
      * @param tMs        Tiempo relativo de la muestra en milisegundos.
-     * @param adc8       Arreglo de 8 valores analógicos (uint16).
+     * @param adc8       Arreglo de 8 valores analógicos (uint16); se copia.
      * @param digitalByte Byte con el estado de pines digitales (DIN0-DIN3 en bits 4-7).
      */
     public void persistSample(long tMs, int[] adc8, int digitalByte) {
         if (procesoDataDAO == null || adc8 == null || adc8.length < 8) return;
+        if (insertBatchHandle == null && insertSampleHandle == null) return;
+        synchronized (queueLock) {
+            if (queueCount == QUEUE_CAPACITY) {
+                droppedSamples++;
+                return;
+            }
+            int slot = (queueHead + queueCount) % QUEUE_CAPACITY;
+            queueT[slot] = tMs;
+            queueEpoch[slot] = System.currentTimeMillis();
+            System.arraycopy(adc8, 0, queueAdc, slot * 8, 8);
+            queueDigital[slot] = digitalByte;
+            queueCount++;
+            if (queueCount >= MAX_BATCH_SAMPLES) queueLock.notify();
+        }
+        ensureWriter();
+    }
+
+    /** Muestras en cola pendientes de escribir en BD. */
+    public int getQueueDepth() {
+        synchronized (queueLock) { return queueCount; }
+    }
+
+    /** Muestras descartadas por cola llena desde el arranque. */
+    public long getDroppedSamples() { return droppedSamples; }
+
+    /** Muestras escritas en BD desde el arranque. */
+    public long getWrittenSamples() { return writtenSamples; }
+
+    /** Muestras cuyo INSERT falló (BD no disponible) desde el arranque. */
+    public long getFailedSamples() { return failedSamples; }
+
+    /** Duración del último volcado a BD en ms, o -1 si aún no hubo ninguno. */
+    public long getLastFlushMs() { return lastFlushMs; }
+
+    // Arranca el hilo escritor la primera vez que llega una muestra
+    private void ensureWriter() {
+        if (writerThread != null) return;
+        synchronized (this) {
+            if (writerThread != null) return;
+            Thread t = new Thread(this::writerLoop, "PersistenceBridge-Writer");
+            t.setDaemon(true);
+            t.start();
+            writerThread = t;
+        }
+    }
+
+    /**
+     * Hilo escritor: espera una ventana de {@link #FLUSH_WINDOW_MS} (o hasta juntar
+     * {@link #MAX_BATCH_SAMPLES}), copia el bloque fuera del lock y lo inserta.
+     */
+    private void writerLoop() {
+        long[] t = new long[MAX_BATCH_SAMPLES];
+        long[] epoch = new long[MAX_BATCH_SAMPLES];
+        int[] adc = new int[MAX_BATCH_SAMPLES * 8];
+        int[] dig = new int[MAX_BATCH_SAMPLES * 4];
+        while (true) {
+            int n;
+            try {
+                synchronized (queueLock) {
+                    if (queueCount < MAX_BATCH_SAMPLES) queueLock.wait(FLUSH_WINDOW_MS);
+                    n = Math.min(queueCount, MAX_BATCH_SAMPLES);
+                    for (int i = 0; i < n; i++) {
+                        int slot = (queueHead + i) % QUEUE_CAPACITY;
+                        t[i] = queueT[slot];
+                        epoch[i] = queueEpoch[slot];
+                        System.arraycopy(queueAdc, slot * 8, adc, i * 8, 8);
+                        int nibble = (queueDigital[slot] >>> 4) & 0x0F;
+                        for (int k = 0; k < 4; k++) dig[i * 4 + k] = (nibble >>> k) & 0x1;
+                    }
+                    queueHead = (queueHead + n) % QUEUE_CAPACITY;
+                    queueCount -= n;
+                }
+            } catch (InterruptedException e) {
+                break;
+            }
+            if (n == 0) continue;
+            long start = System.currentTimeMillis();
+            if (writeBatch(t, epoch, adc, dig, n)) writtenSamples += n;
+            else failedSamples += n;
+            lastFlushMs = System.currentTimeMillis() - start;
+        }
+    }
+
+    // Inserta n muestras: un INSERT multifila si el DAO lo ofrece, si no una a una
+    private boolean writeBatch(long[] t, long[] epoch, int[] adc, int[] dig, int n) {
         try {
-            // Los pines digitales están en los bits 4-7 del byte (nibble alto)
-            // Hacer shift de 4 bits a la derecha para mover bits 4-7 a posiciones 0-3
-            int digitalNibble = (digitalByte >>> 4) & 0x0F;
-            
-            // Derivar 4 digitales de los bits 0-3 del nibble desplazado
+            if (insertBatchHandle != null) {
+                insertBatchHandle.invoke(t, epoch, adc, dig, n);
+                return true;
+            }
+            int[] adc8 = new int[8];
             int[] dig4 = new int[4];
-            for (int i = 0; i < 4; i++) dig4[i] = (digitalNibble >>> i) & 0x1;
-
-            // Intentar método insertVarsData de IntProcesoDataDAO
-            if (invokeIfExists(procesoDataDAO, "insertVarsData", new Class[]{ long.class, int[].class, int[].class }, new Object[]{ tMs, adc8, dig4 })) return;
-            
-            // Métodos alternativos por compatibilidad
-            if (invokeIfExists(procesoDataDAO, "insert", new Class[]{ long.class, int[].class, int[].class }, new Object[]{ tMs, adc8, dig4 })) return;
-            if (invokeIfExists(procesoDataDAO, "save", new Class[]{ long.class, int[].class, int[].class }, new Object[]{ tMs, adc8, dig4 })) return;
-        } catch (Throwable ignored) {}
+            for (int i = 0; i < n; i++) {
+                System.arraycopy(adc, i * 8, adc8, 0, 8);
+                System.arraycopy(dig, i * 4, dig4, 0, 4);
+                insertSampleHandle.invoke(t[i], adc8, dig4);
+            }
+            return true;
+        } catch (java.sql.SQLException e) {
+            LOG.log(Level.FINE, "SQLException al persistir " + n + " muestras: " + e.getMessage(), e);
+            return false;
+        } catch (Throwable e) {
+            LOG.log(Level.WARNING, "Error al persistir " + n + " muestras", e);
+            return false;
+        }
     }
 
     /**
@@ -340,6 +466,21 @@ public final class PersistenceBridge {
         return null;
     }
 
+    /**
+     * Resuelve el primer método público de {@code target} con alguno de los nombres
+     * y el tipo indicado, enlazado al objeto. Devuelve null si no hay ninguno.
+     */
+    private static MethodHandle resolveHandle(Object target, MethodType type, String... names) {
+        if (target == null) return null;
+        MethodHandles.Lookup lookup = MethodHandles.publicLookup();
+        for (String name : names) {
+            try {
+                return lookup.findVirtual(target.getClass(), name, type).bindTo(target);
+            } catch (NoSuchMethodException | IllegalAccessException ignored) {}
+        }
+        return null;
+    }
+
     /**
      * Invoca un método si existe (por nombre y tipos), devolviendo true si se
      * logró ejecutar. Maneja correctamente InvocationTargetException para evitar
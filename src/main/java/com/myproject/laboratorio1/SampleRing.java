@@ -0,0 +1,153 @@
+package com.myproject.laboratorio1;
+
+import java.lang.invoke.VarHandle;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.locks.LockSupport;
+
+/**
+ * Anillo de muestras sin bloqueos entre el hilo lector serie (único productor) y
+ * sus consumidores (accesores de la GUI, hilo de persistencia).
+ * <p>
+ * Cada muestra ocupa una ranura de arreglos primitivos preasignados; el productor
+ * la escribe y después publica su número de secuencia. Cada consumidor avanza con
+ * su propio {@link Cursor}, así que uno lento no frena al lector ni a los demás:
+ * si se queda atrás más de la capacidad salta a la muestra más antigua disponible
+ * y cuenta las perdidas. La copia de la ranura se valida después de leerla, como
+ * el seqlock de SampleRecord en el firmware.
+ * </p>
+ */
+public final class SampleRing {
+
+    /** Canales ADC por muestra (AN0..AN7). */
+    public static final int ADC_CHANNELS = 8;
+
+    private final int capacity;   // potencia de 2
+    private final int mask;
+    private final long[] tMs;
+    private final int[] digital;
+    private final int[] adc;
+    // Secuencia de la próxima muestra a escribir (= total publicado)
+    private final AtomicLong published = new AtomicLong();
+    // Consumidor estacionado en await(); el productor lo despierta al publicar
+    private volatile Thread waiter;
+
+    /**
+     * @param minCapacity muestras retenidas como mínimo (se redondea a potencia de 2)
+     */
+    public SampleRing(int minCapacity) {
+        int cap = Integer.highestOneBit(Math.max(2, minCapacity - 1)) << 1;
+        capacity = cap;
+        mask = cap - 1;
+        tMs = new long[cap];
+        digital = new int[cap];
+        adc = new int[cap * ADC_CHANNELS];
+    }
+
+    /**
+     * Publica una muestra. Solo debe llamarlo el hilo productor.
+     *
+     * @param t tiempo relativo en ms
+     * @param adc8 8 valores ADC (se copian)
+     * @param digitalByte byte de pines digitales
+     */
+    public void publish(long t, int[] adc8, int digitalByte) {
+        long seq = published.get();
+        int slot = (int) (seq & mask);
+        tMs[slot] = t;
+        digital[slot] = digitalByte;
+        System.arraycopy(adc8, 0, adc, slot * ADC_CHANNELS, ADC_CHANNELS);
+        // Escritura con semántica release: los datos de la ranura quedan visibles antes que la secuencia
+        published.lazySet(seq + 1);
+        Thread w = waiter;
+        if (w != null) LockSupport.unpark(w);
+    }
+
+    /**
+     * Crea un cursor que empieza en la próxima muestra que se publique.
+     * Cada cursor debe usarse desde un único hilo (o bajo su propio lock).
+     */
+    public Cursor cursor() {
+        return new Cursor(published.get());
+    }
+
+    /**
+     * Bloquea hasta que el cursor tenga una muestra disponible o venza el tiempo.
+     * Admite un solo consumidor en espera a la vez.
+     *
+     * @return true si hay datos; false por timeout o interrupción
+     */
+    public boolean await(Cursor c, long timeoutMs) {
+        if (c.next < published.get()) return true;
+        long deadline = System.nanoTime() + timeoutMs * 1_000_000L;
+        waiter = Thread.currentThread();
+        try {
+            while (c.next >= published.get()) {
+                long left = deadline - System.nanoTime();
+                if (left <= 0 || Thread.currentThread().isInterrupted()) return false;
+                LockSupport.parkNanos(this, left);
+            }
+            return true;
+        } finally {
+            waiter = null;
+        }
+    }
+
+    /** Muestra copiada desde el anillo; se reutiliza entre lecturas. */
+    public static final class Sample {
+        public long tMs;
+        public int digital;
+        public final int[] adc = new int[ADC_CHANNELS];
+    }
+
+    /** Posición de lectura de un consumidor. */
+    public final class Cursor {
+        private long next;
+        private long lost;
+
+        private Cursor(long start) {
+            this.next = start;
+        }
+
+        /**
+         * Copia la siguiente muestra en {@code out} y avanza.
+         *
+         * @return false si no hay muestras nuevas
+         */
+        public boolean poll(Sample out) {
+            while (true) {
+                long head = published.get();
+                if (next >= head) return false;
+                // Una ranura se sobrescribe mientras se publica la secuencia next + capacity
+                if (head - next >= capacity) {
+                    long oldest = head - capacity + 1;
+                    lost += oldest - next;
+                    next = oldest;
+                }
+                int slot = (int) (next & mask);
+                out.tMs = tMs[slot];
+                out.digital = digital[slot];
+                System.arraycopy(adc, slot * ADC_CHANNELS, out.adc, 0, ADC_CHANNELS);
+                VarHandle.acquireFence();
+                if (published.get() - next >= capacity) continue; // pisada durante la copia
+                next++;
+                return true;
+            }
+        }
+
+        /** Muestras publicadas que este cursor aún no leyó (acotado a la capacidad). */
+        public int pending() {
+            long n = published.get() - next;
+            return (int) Math.max(0, Math.min(n, capacity - 1));
+        }
+
+        /** Descarta lo pendiente: la próxima lectura será la próxima muestra publicada. */
+        public void skipAll() {
+            next = published.get();
+        }
+
+        /** Muestras que se perdieron por quedarse atrás más de la capacidad. */
+        public long lost() {
+            return lost;
+        }
+    }
+}
@@ -5,11 +5,23 @@ import com.fazecast.jSerialComm.SerialPort;
 import java.io.ByteArrayOutputStream;
 import java.io.IOException;
 import java.nio.charset.StandardCharsets;
+import java.security.SecureRandom;
 import java.util.Arrays;
 
 public class SerialIO implements AutoCloseable {
 
+    /** CMD del evento Ready que el firmware emite al terminar setup(). */
+    public static final int CMD_READY = 0x0A;
+    /** CMD del marcador de sincronización (eco de token). */
+    public static final int CMD_SYNC = 0x0B;
+    /** Espera máxima de una lectura bloqueante sin datos antes de volver con 0 bytes. */
+    public static final int READ_WAKEUP_MS = 50;
+
+    private static final SecureRandom RNG = new SecureRandom();
+
     private final SerialPort port;
+    // Bytes leídos después de un marcador/evento que aún no consumió nadie
+    private byte[] pushback = new byte[0];
 
     /**
      * @param portName  Ej: "COM3" (Windows), "/dev/ttyUSB0" o "/dev/ttyACM0" (Linux), "/dev/tty.usbmodemXXXX" (macOS)
@@ -21,8 +33,10 @@ public class SerialIO implements AutoCloseable {
         // Intento preventivo: asegurar que no quede una sesión previa abierta
         try { port.closePort(); } catch (Exception ignored) {}
         port.setComPortParameters(baudRate, 8, SerialPort.ONE_STOP_BIT, SerialPort.NO_PARITY);
-        // Lectura NO bloqueante
-        port.setComPortTimeouts(SerialPort.TIMEOUT_NONBLOCKING, 0, 0);
+        // Lectura semi-bloqueante: readBytes vuelve en cuanto llega al menos un byte
+        // (o tras READ_WAKEUP_MS sin datos). readAvailable() sigue sin bloquear porque
+        // solo lee lo que bytesAvailable() ya reporta.
+        port.setComPortTimeouts(SerialPort.TIMEOUT_READ_SEMI_BLOCKING, READ_WAKEUP_MS, 0);
 
         if (!port.openPort()) {
             throw new IOException("No se pudo abrir el puerto: " + portName);
@@ -81,6 +95,11 @@ public class SerialIO implements AutoCloseable {
      */
     public byte[] readAvailable() throws IOException {
         ensureOpen();
+        if (pushback.length > 0) {
+            byte[] pending = pushback;
+            pushback = new byte[0];
+            return pending;
+        }
         int available = port.bytesAvailable();
         if (available <= 0) return new byte[0];
 
@@ -92,6 +111,31 @@ public class SerialIO implements AutoCloseable {
         return Arrays.copyOf(buf, (int) read);
     }
 
+    /**
+     * RECEPCIÓN BLOQUEANTE: espera en el driver hasta que haya al menos un byte y
+     * copia lo disponible (máximo {@code len}). La latencia queda limitada por la
+     * línea y no por un intervalo de sondeo; sin datos vuelve tras READ_WAKEUP_MS.
+     *
+     * @param dst destino
+     * @param off posición inicial en {@code dst}
+     * @param len bytes máximos a copiar
+     * @return bytes copiados; 0 si no llegó nada en READ_WAKEUP_MS
+     * @throws IOException si ocurre un error de E/S con el puerto.
+     */
+    public int readBlocking(byte[] dst, int off, int len) throws IOException {
+        ensureOpen();
+        if (len <= 0) return 0;
+        if (pushback.length > 0) {
+            int n = Math.min(len, pushback.length);
+            System.arraycopy(pushback, 0, dst, off, n);
+            pushback = Arrays.copyOfRange(pushback, n, pushback.length);
+            return n;
+        }
+        long read = port.readBytes(dst, len, off);
+        if (read < 0) throw new IOException("Error al leer del puerto serie.");
+        return (int) read;
+    }
+
     /** Opcional: leer como String (UTF-8). */
     public String readAvailableString() throws IOException {
         byte[] data = readAvailable();
@@ -103,18 +147,13 @@ public class SerialIO implements AutoCloseable {
         ensureOpen();
         if (maxBytes <= 0) return new byte[0];
         long deadline = System.currentTimeMillis() + Math.max(0, timeoutMs);
-        ByteArrayOutputStream out = new ByteArrayOutputStream(Math.min(maxBytes, 256));
-        while (out.size() < maxBytes && System.currentTimeMillis() <= deadline) {
-            byte[] chunk = readAvailable();
-            if (chunk.length > 0) {
-                int remaining = maxBytes - out.size();
-                out.write(chunk, 0, Math.min(remaining, chunk.length));
-                if (out.size() >= maxBytes) break;
-            } else {
-                try { Thread.sleep(10); } catch (InterruptedException ignored) { break; }
-            }
+        byte[] out = new byte[maxBytes];
+        int got = 0;
+        while (got < maxBytes && System.currentTimeMillis() <= deadline) {
+            if (Thread.currentThread().isInterrupted()) break;
+            got += readBlocking(out, got, maxBytes - got);
         }
-        return out.toByteArray();
+        return got == maxBytes ? out : Arrays.copyOf(out, got);
     }
 
     /** Checksum XOR de todos los bytes del cuerpo. */
@@ -131,6 +170,81 @@ public class SerialIO implements AutoCloseable {
      * Devuelve los bytes de la respuesta (lee hasta maxRespBytes con timeoutMs).
      */
     public byte[] sendCommand(int cmd, byte[] payload, int maxRespBytes, long timeoutMs) throws IOException {
+        writeCommand(cmd, payload);
+        return readUpTo(Math.max(0, maxRespBytes), Math.max(0, timeoutMs));
+    }
+
+    /**
+     * Espera el evento Ready (55 AB 00 0A ...) del firmware, descartando lo previo.
+     *
+     * @param timeoutMs Tiempo máximo de espera.
+     * @return Payload del Ready ([PROTO_VER][CAPS][BOOT_L][BOOT_H]) o null si no llegó.
+     * @throws IOException si ocurre un error de E/S con el puerto.
+     */
+    public byte[] awaitReady(long timeoutMs) throws IOException {
+        return awaitResponse(CMD_READY, null, timeoutMs);
+    }
+
+    /**
+     * Descarta de forma determinista los bytes obsoletos: envía 0x0B con un token
+     * único y consume todo lo recibido hasta la respuesta que lo contiene. Lo que
+     * llegue después del marcador queda disponible para la siguiente lectura.
+     *
+     * @param timeoutMs Tiempo máximo de espera del marcador.
+     * @return true si se encontró el marcador; false si el firmware no respondió.
+     * @throws IOException si ocurre un error de E/S con el puerto.
+     */
+    public boolean syncInput(long timeoutMs) throws IOException {
+        byte[] token = new byte[4];
+        RNG.nextBytes(token);
+        writeCommand(CMD_SYNC, token);
+        return awaitResponse(CMD_SYNC, token, timeoutMs) != null;
+    }
+
+    /**
+     * Lee hasta encontrar una respuesta válida 55 AB con el CMD indicado (y payload
+     * que empiece por {@code prefix}, si se da). Descarta los bytes previos y guarda
+     * los posteriores para la siguiente lectura.
+     *
+     * @return Payload de la respuesta o null si no llegó dentro del timeout.
+     */
+    private byte[] awaitResponse(int cmd, byte[] prefix, long timeoutMs) throws IOException {
+        ensureOpen();
+        long deadline = System.currentTimeMillis() + Math.max(0, timeoutMs);
+        ByteArrayOutputStream acc = new ByteArrayOutputStream(256);
+        byte[] chunk = new byte[256];
+        int scanFrom = 0;
+        while (System.currentTimeMillis() <= deadline) {
+            if (Thread.currentThread().isInterrupted()) break;
+            int n = readBlocking(chunk, 0, chunk.length);
+            if (n == 0) continue;
+            acc.write(chunk, 0, n);
+            byte[] all = acc.toByteArray();
+            for (int i = scanFrom; i + 5 < all.length; i++) {
+                if (all[i] != 0x55 || all[i + 1] != (byte) 0xAB) continue;
+                int len = all[i + 4] & 0xFF;
+                int end = i + 6 + len;
+                if (end > all.length) break; // respuesta incompleta: esperar más bytes
+                if ((all[i + 3] & 0xFF) != cmd) continue;
+                int calc = 0;
+                for (int k = i + 2; k < i + 5 + len; k++) calc ^= all[k];
+                if ((calc & 0xFF) != (all[i + 5 + len] & 0xFF)) continue;
+                byte[] pl = Arrays.copyOfRange(all, i + 5, i + 5 + len);
+                if (prefix != null) {
+                    if (pl.length < prefix.length) continue;
+                    if (!Arrays.equals(Arrays.copyOf(pl, prefix.length), prefix)) continue;
+                }
+                if (end < all.length) pushback = Arrays.copyOfRange(all, end, all.length);
+                return pl;
+            }
+            // No re-escanear bytes que ya no pueden iniciar una respuesta completa
+            scanFrom = Math.max(0, all.length - 5 - 255 - 1);
+        }
+        return null;
+    }
+
+    /** Construye y envía un comando 55 AA CMD LEN PAYLOAD CHK sin leer respuesta. */
+    private void writeCommand(int cmd, byte[] payload) throws IOException {
         ensureOpen();
         if (cmd < 0 || cmd > 255) throw new IllegalArgumentException("CMD fuera de rango (0-255)");
         byte[] pl = (payload == null) ? new byte[0] : payload;
@@ -150,7 +264,6 @@ public class SerialIO implements AutoCloseable {
         packet[packet.length - 1] = chk;
 
         send(packet);
-        return readUpTo(Math.max(0, maxRespBytes), Math.max(0, timeoutMs));
     }
 
     /** Cierra el puerto. */
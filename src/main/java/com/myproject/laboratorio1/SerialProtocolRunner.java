@@ -1,10 +1,7 @@
 package com.myproject.laboratorio1;
 
-import java.io.ByteArrayOutputStream;
 import java.io.IOException;
-import java.util.ArrayDeque;
 import java.util.ArrayList;
-import java.util.Deque;
 import java.util.List;
 
 /**
@@ -20,7 +17,8 @@ import java.util.List;
  * {@link PersistenceBridge}:
  * </p>
  * <ul>
- *   <li>Al recibir una trama, se persiste la muestra (8 ADC + 4 digitales).</li>
+ *   <li>Al recibir una trama, la muestra (8 ADC + 4 digitales) se publica en un
+ *       {@link SampleRing} y un hilo aparte la persiste.</li>
  *   <li>Antes de enviar comandos de configuración, se consultan tiempos de
  *       muestreo y salidas digitales desde los DAOs.</li>
  * </ul>
@@ -33,10 +31,52 @@ public class SerialProtocolRunner {
     private final String port;
     private final int baud;
     private final long defaultTimeoutMs = 500;
+    // Espera máxima del evento Ready (0x0A) tras abrir el puerto (reset por DTR + bootloader)
+    private static final long READY_TIMEOUT_MS = 2500;
+    // El firmware soporta Sync (0x0B); se desactiva si no responde para no penalizar cada comando
+    private volatile boolean syncSupported = true;
+
+    // Formatos de trama (segundo byte de cabecera y tamaño); ver 0x0C/0x0D en el firmware
+    private static final int FRAME_FMT_LEGACY = 0;
+    private static final int FRAME_FMT_COMPACT = 1;
+    private static final int FRAME_FMT_SPLIT = 2;
+    private static final int HEADER_LEGACY = 0x7B;
+    private static final int HEADER_COMPACT = 0x7D;
+    private static final int HEADER_ANALOG = 0x7E;   // formato dividido: parte analógica
+    private static final int HEADER_DIGITAL = 0x7F;  // formato dividido: parte digital (sin cola)
+    // Variantes calibradas (0x12): cada canal como int16 LE en la unidad de su tabla (0x13)
+    private static final int HEADER_COMPACT_CAL = 0x79;
+    private static final int HEADER_ANALOG_CAL = 0x78;
+    private static final int SIZE_LEGACY = 20;
+    private static final int SIZE_DIGITAL = 4;
+    // Compacta y analógica crecen con los canales: cabecera/tick/cola + N x 10 bits
+    private static final int OVERHEAD_COMPACT = 6;
+    private static final int OVERHEAD_ANALOG = 5;
+    // Canales en las tramas empaquetadas (0x0C byte 2); 4 en el firmware por defecto
+    private volatile int adcChannels = 4;
+    // Preferencia del host: menos bytes por muestra primero
+    private static final int[] FORMAT_PREFERENCE = { FRAME_FMT_SPLIT, FRAME_FMT_COMPACT, FRAME_FMT_LEGACY };
+    private volatile int frameFormat = FRAME_FMT_LEGACY;
+
+    // Control de tasa adaptativo (0x0F) y su evento Rate (0x10)
+    private static final int CAP_ADAPTIVE = 0x04;
+    private static final int CMD_SET_ADAPTIVE = 0x0F;
+    private static final int CMD_RATE = 0x10;
+    private volatile boolean adaptiveSupported = false;
+    private volatile int effectivePeriodMs = -1;
+    // Tick de 16 bits de la trama compacta desenrollado y anclado a t0Ms
+    private long tickUnwrapped = -1L;
+    private int lastTick = -1;
+    private long tickOriginMs = 0L;
+    // Formato dividido: última mitad digital/analógica recibida (solo hilo lector)
+    private int splitDigital = -1;
+    private int[] splitAdc = null;
 
     private SerialIO serial;
     private volatile boolean reading;
     private Thread readerThread;
+    // Consumidor del anillo que persiste las muestras fuera del hilo lector
+    private Thread persistThread;
     private volatile boolean connecting;
     private Thread connectThread;
     // Reintentos de comandos (ACK) en segundo plano
@@ -45,10 +85,15 @@ public class SerialProtocolRunner {
     // Puente opcional a persistencia
     private final PersistenceBridge persistence = PersistenceBridge.get();
 
-    // Buffers FIFO separados (capacidad fija con recorte)
+    // Anillo de muestras decodificadas: lo llena el lector y cada consumidor lee con su cursor
     private static final int BUFFER_CAPACITY = 512;
-    private final Deque<AdcSample> adcBuffer = new ArrayDeque<>(BUFFER_CAPACITY);
-    private final Deque<DigitalSample> digitalBuffer = new ArrayDeque<>(BUFFER_CAPACITY);
+    private final SampleRing samples = new SampleRing(BUFFER_CAPACITY);
+    private final SampleRing.Cursor adcCursor = samples.cursor();
+    private final SampleRing.Sample adcSample = new SampleRing.Sample();
+    private final SampleRing.Cursor digitalCursor = samples.cursor();
+    private final SampleRing.Sample digitalSample = new SampleRing.Sample();
+    // Bytes acumulados por el lector (trama incompleta + lo recién leído)
+    private static final int READ_BUFFER_SIZE = 4096;
     // Marca de tiempo de inicio
     private volatile long t0Ms = -1L;
 
@@ -77,9 +122,32 @@ public class SerialProtocolRunner {
         if (serial == null) {
             try { SerialIO.forceClose(port); } catch (Exception ignored) {}
             serial = new SerialIO(port, baud);
-            // Dar tiempo al bootloader (Arduino UNO/Nano reinicia al abrir el puerto)
-            try { Thread.sleep(1200); } catch (InterruptedException ignored) {}
+            // El UNO/Nano reinicia al abrir el puerto: esperar su Ready en vez de un retardo fijo
+            byte[] ready = null;
+            try { ready = serial.awaitReady(READY_TIMEOUT_MS); } catch (IOException ignored) {}
+            if (ready != null && ready.length >= 4) {
+                syncSupported = (ready[1] & 0x01) != 0;
+                adaptiveSupported = (ready[1] & CAP_ADAPTIVE) != 0;
+                int boot = (ready[2] & 0xFF) | ((ready[3] & 0xFF) << 8);
+                System.out.println("Ready recibido en " + port + ": protocolo v" + (ready[0] & 0xFF) + ", arranque #" + boot);
+            } else {
+                // Placa sin auto-reset o firmware previo: sondear con Sync
+                try { syncSupported = serial.syncInput(defaultTimeoutMs); } catch (IOException ignored) { syncSupported = false; }
+            }
+        }
+    }
+
+    // Descarta bytes obsoletos antes de esperar un ACK: marcador Sync (0x0B) si el
+    // firmware lo soporta; si no, drenaje por periodo de silencio
+    private void discardStale() {
+        if (serial == null) return;
+        if (syncSupported) {
+            try {
+                if (serial.syncInput(Math.max(150L, defaultTimeoutMs / 2))) return;
+            } catch (Exception ignored) {}
+            syncSupported = false;
         }
+        try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
     }
 
     // Inicia transmisión en hilo: habilita streaming (CMD=0x05, 0x01) y arranca el lector que llena el buffer
@@ -109,8 +177,13 @@ public class SerialProtocolRunner {
         try {
         ensureOpen();
         // Asegurar que el canal esté desocupado antes de esperar el ACK
-        try { if (serial != null) serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+        discardStale();
+        negotiateFrameFormat();
+        enableAdaptiveRate();
         t0Ms = System.currentTimeMillis();
+        lastTick = -1;
+        splitDigital = -1;
+        splitAdc = null;
         // Dar mas margen para el ACK inicial (MCU puede estar arrancando)
         byte[] resp = serial.sendCommand(0x05, new byte[]{ 0x01 }, 64, Math.max(1500L, defaultTimeoutMs));
         if (!validateResponse(resp)) {
@@ -121,12 +194,119 @@ public class SerialProtocolRunner {
             readerThread = new Thread(this::readLoop, "Serial-FrameReader");
             readerThread.setDaemon(true);
             readerThread.start();
+            persistThread = new Thread(this::persistLoop, "Serial-Persist");
+            persistThread.setDaemon(true);
+            persistThread.start();
             // Enviar comandos pendientes encolados antes de iniciar
             flushPendingCommands();
         }
         } catch (Exception e) { try { resetForRetry(); } catch (Exception ignored) {} throw e; }
     }
 
+    /**
+     * Consulta el descriptor de capacidades (0x0C) y selecciona con 0x0D el formato
+     * de trama más compacto soportado por firmware y host. Si el firmware no
+     * responde (versión previa) se mantiene la trama legacy de 20 bytes.
+     */
+    private void negotiateFrameFormat() {
+        frameFormat = FRAME_FMT_LEGACY;
+        try {
+            byte[] resp = serial.sendCommand(0x0C, new byte[0], 64, defaultTimeoutMs);
+            byte[] caps = responsePayload(resp, 0x0C);
+            if (caps == null || caps.length < 20) return;
+            int formats = caps[1] & 0xFF;
+            int channels = caps[2] & 0xFF;
+            if (channels >= 4 && channels <= 16) adcChannels = channels;
+            for (int fmt : FORMAT_PREFERENCE) {
+                if ((formats & (1 << fmt)) == 0) continue;
+                if (fmt == FRAME_FMT_LEGACY) return;
+                discardStale();
+                byte[] ack = serial.sendCommand(0x0D, new byte[]{ (byte) fmt }, 64, defaultTimeoutMs);
+                byte[] applied = responsePayload(ack, 0x0D);
+                if (applied != null && applied.length == 1 && (applied[0] & 0xFF) == fmt) {
+                    frameFormat = fmt;
+                    System.out.println("Formato de trama negociado en " + port + ": " + fmt
+                            + " (" + adcChannels + " canales)");
+                }
+                return;
+            }
+        } catch (Exception ignored) {}
+    }
+
+    /**
+     * Activa el control de tasa adaptativo del firmware si lo anunció en Ready:
+     * en lugar de bloquearse con el buffer TX lleno, el MCU reduce la tasa o pasa a
+     * la trama compacta y lo notifica con el evento Rate (0x10).
+     */
+    private void enableAdaptiveRate() {
+        effectivePeriodMs = -1;
+        if (!adaptiveSupported) return;
+        try {
+            discardStale();
+            byte[] ack = serial.sendCommand(CMD_SET_ADAPTIVE, new byte[]{ 0x01 }, 64, defaultTimeoutMs);
+            byte[] applied = responsePayload(ack, CMD_SET_ADAPTIVE);
+            if (applied != null && applied.length == 1 && applied[0] == 1) {
+                System.out.println("Control de tasa adaptativo habilitado en " + port);
+            }
+            // La respuesta puede venir seguida del primer evento Rate
+            handleRateEvents(ack, ack == null ? 0 : ack.length);
+        } catch (Exception ignored) {}
+    }
+
+    /**
+     * Procesa los eventos Rate (55 AB 00 10 06 [FMT][DECIM][TEFF][SKIP] CHK) que haya
+     * entre las tramas: registra la tasa efectiva y el formato que usa el MCU.
+     *
+     * @param buf bytes recibidos
+     * @param end límite (exclusivo) de la búsqueda
+     */
+    private void handleRateEvents(byte[] buf, int end) {
+        if (buf == null) return;
+        int limit = Math.min(end, buf.length);
+        for (int i = 0; i + 12 <= limit; i++) {
+            if (buf[i] != 0x55 || buf[i + 1] != (byte) 0xAB) continue;
+            if (buf[i + 2] != 0x00 || (buf[i + 3] & 0xFF) != CMD_RATE || buf[i + 4] != 6) continue;
+            int calc = 0;
+            for (int k = i + 2; k < i + 11; k++) calc ^= buf[k];
+            if ((calc & 0xFF) != (buf[i + 11] & 0xFF)) continue;
+            int fmt = buf[i + 5] & 0xFF;
+            int decim = buf[i + 6] & 0xFF;
+            int teff = (buf[i + 7] & 0xFF) | ((buf[i + 8] & 0xFF) << 8);
+            int skipped = (buf[i + 9] & 0xFF) | ((buf[i + 10] & 0xFF) << 8);
+            frameFormat = fmt;
+            effectivePeriodMs = teff;
+            System.out.println("Tasa efectiva en " + port + ": " + teff + " ms (formato " + fmt
+                    + ", 1 de cada " + decim + ", " + skipped + " ranuras omitidas)");
+            i += 11;
+        }
+    }
+
+    /**
+     * Período efectivo de envío anunciado por el firmware en modo adaptativo.
+     * @return ms entre tramas, o -1 si el firmware no informó (modo fijo).
+     */
+    public int getEffectivePeriodMs() {
+        return effectivePeriodMs;
+    }
+
+    // Extrae el payload de una respuesta OK (55 AB 00 CMD LEN ... CHK) para el CMD indicado
+    private static byte[] responsePayload(byte[] resp, int cmd) {
+        if (resp == null) return null;
+        for (int i = 0; i + 5 < resp.length; i++) {
+            if (resp[i] != 0x55 || resp[i + 1] != (byte) 0xAB) continue;
+            if ((resp[i + 2] & 0xFF) != 0x00 || (resp[i + 3] & 0xFF) != cmd) continue;
+            int len = resp[i + 4] & 0xFF;
+            if (i + 6 + len > resp.length) return null;
+            int calc = 0;
+            for (int k = i + 2; k < i + 5 + len; k++) calc ^= resp[k];
+            if ((calc & 0xFF) != (resp[i + 5 + len] & 0xFF)) continue;
+            byte[] pl = new byte[len];
+            System.arraycopy(resp, i + 5, pl, 0, len);
+            return pl;
+        }
+        return null;
+    }
+
     // Detiene transmisión y mantiene el puerto abierto
     /**
      * Detiene la transmisión en streaming y mantiene el puerto abierto.
@@ -136,7 +316,7 @@ public class SerialProtocolRunner {
         try {
             if (serial != null) {
                 // Vaciar canal previo al ACK de stop para evitar mezclar streaming
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] resp = serial.sendCommand(0x05, new byte[]{ 0x00 }, 64, defaultTimeoutMs);
                 // Validación best-effort; no interrumpe parada si es inválido
                 validateResponse(resp);
@@ -184,7 +364,7 @@ public class SerialProtocolRunner {
                 if (led != null) {
                     didWork = true;
                     try {
-                        try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                        discardStale();
                         byte[] resp = serial.sendCommand(0x01, new byte[]{ (byte)(led & 0xFF) }, 64, defaultTimeoutMs);
                         boolean ok = validateResponse(resp);
                         if (ok) {
@@ -203,7 +383,7 @@ public class SerialProtocolRunner {
                     int v = tsDip;
                     byte lo = (byte) (v & 0xFF), hi = (byte)((v >>> 8) & 0xFF);
                     try {
-                        try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                        discardStale();
                         byte[] resp = serial.sendCommand(0x03, new byte[]{ lo, hi }, 64, defaultTimeoutMs);
                         boolean ok = validateResponse(resp);
                         if (ok) {
@@ -222,7 +402,7 @@ public class SerialProtocolRunner {
                     int v = tsAdc;
                     byte lo = (byte) (v & 0xFF), hi = (byte)((v >>> 8) & 0xFF);
                     try {
-                        try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                        discardStale();
                         byte[] resp = serial.sendCommand(0x08, new byte[]{ lo, hi }, 64, defaultTimeoutMs);
                         boolean ok = validateResponse(resp);
                         if (ok) {
@@ -254,6 +434,7 @@ public class SerialProtocolRunner {
         reading = false;
         connecting = false;
         try { if (readerThread != null) readerThread.interrupt(); } catch (Exception ignored) {}
+        try { if (persistThread != null) persistThread.interrupt(); } catch (Exception ignored) {}
         try { if (connectThread != null) connectThread.interrupt(); } catch (Exception ignored) {}
         try { if (commandRetryThread != null) commandRetryThread.interrupt(); } catch (Exception ignored) {}
         try { if (serial != null) serial.close(); } catch (Exception ignored) {}
@@ -278,10 +459,10 @@ public class SerialProtocolRunner {
      */
     public TimedValue getAdcValue(int index) {
         if (index < 0 || index >= 8) throw new IllegalArgumentException("Índice ADC inválido (0-7)");
-        AdcSample s;
-        synchronized (adcBuffer) { s = adcBuffer.pollFirst(); }
-        if (s == null) return new TimedValue(0, -1L);
-        return new TimedValue(s.adc[index], s.tMs);
+        synchronized (adcCursor) {
+            if (!adcCursor.poll(adcSample)) return new TimedValue(0, -1L);
+            return new TimedValue(adcSample.adc[index], adcSample.tMs);
+        }
     }
 
     // Devuelve (y consume) el byte de pines digitales (8 bits) + tiempo en ms desde start
@@ -291,59 +472,50 @@ public class SerialProtocolRunner {
      * @return TimedValue con el byte de pines (LSB=d0) y tiempo relativo en ms; si no hay datos, devuelve tMs=-1.
      */
     public TimedValue getDigitalPins() {
-        DigitalSample s;
-        synchronized (digitalBuffer) { s = digitalBuffer.pollFirst(); }
-        if (s == null) return new TimedValue(0, -1L);
-        return new TimedValue(s.digital & 0xFF, s.tMs);
+        synchronized (digitalCursor) {
+            if (!digitalCursor.poll(digitalSample)) return new TimedValue(0, -1L);
+            return new TimedValue(digitalSample.digital & 0xFF, digitalSample.tMs);
+        }
     }
 
-    // Bucle lector: acumula, extrae tramas 7A 7B ... 7C y actualiza estados
+    // Bucle lector: acumula, extrae tramas 7A 7B ... 7C y publica las muestras en el anillo
     /**
      * Bucle de lectura de frames desde el puerto serie.
      * <p>
-     * Extrae tramas válidas, actualiza los buffers de ADC y digitales y
-     * persiste la muestra vía {@link PersistenceBridge} si la API está disponible.
+     * Bloquea en el driver hasta que llegan bytes (sin sondeo con sleep), extrae las
+     * tramas válidas y publica cada muestra en {@link SampleRing}. La persistencia la
+     * hace {@link #persistLoop} en otro hilo, así que el acceso a BD no retrasa la lectura.
      * </p>
      */
     private void readLoop() {
-        ByteArrayOutputStream buf = new ByteArrayOutputStream();
+        byte[] acc = new byte[READ_BUFFER_SIZE];
+        int accLen = 0;
+        List<byte[]> frames = new ArrayList<>();
         while (reading) {
             try {
-                byte[] chunk = serial.readAvailable();
-                if (chunk.length > 0) {
-                    buf.write(chunk, 0, chunk.length);
-                    byte[] all = buf.toByteArray();
-                    List<byte[]> frames = findFrames(all);
-                    if (!frames.isEmpty()) {
-                        // Procesar TODAS las tramas encontradas, capturando y almacenando cada una
-                        for (byte[] f : frames) {
-                            Frame parsed = parseFrame(f);
-                            if (parsed != null) {
-                                long nowMs = System.currentTimeMillis();
-                                long tMs = (t0Ms >= 0) ? Math.max(0, nowMs - t0Ms) : 0;
-                                // Insertar en buffers separados
-                                synchronized (adcBuffer) {
-                                    if (adcBuffer.size() >= BUFFER_CAPACITY) adcBuffer.clear();
-                                    int[] adcCopy = new int[parsed.adc.length];
-                                    System.arraycopy(parsed.adc, 0, adcCopy, 0, parsed.adc.length);
-                                    adcBuffer.addLast(new AdcSample(tMs, adcCopy));
-                                }
-                                synchronized (digitalBuffer) {
-                                    if (digitalBuffer.size() >= BUFFER_CAPACITY) digitalBuffer.clear();
-                                    digitalBuffer.addLast(new DigitalSample(tMs, parsed.digital));
-                                }
-                                // Persistir muestra usando API/DAO si está disponible
-                                try { persistence.persistSample(tMs, parsed.adc, parsed.digital); } catch (Exception ignored) {}
-                            }
+                // Lleno sin ninguna trama reconocible: solo basura, descartar
+                if (accLen == acc.length) accLen = 0;
+                int n = serial.readBlocking(acc, accLen, acc.length - accLen);
+                if (n == 0) continue; // despertar periódico para revisar 'reading'
+                accLen += n;
+                frames.clear();
+                int lastEnd = findFrames(acc, accLen, frames, adcChannels);
+                if (!frames.isEmpty()) {
+                    // Eventos Rate intercalados en la zona ya consumida
+                    handleRateEvents(acc, lastEnd);
+                    // Procesar TODAS las tramas encontradas
+                    for (byte[] f : frames) {
+                        Frame parsed = mergeSplit(parseFrame(f, adcChannels));
+                        if (parsed != null) {
+                            long nowMs = System.currentTimeMillis();
+                            long tMs = (t0Ms >= 0) ? Math.max(0, nowMs - t0Ms) : 0;
+                            if (parsed.tick >= 0) tMs = deviceTimeMs(parsed.tick, tMs);
+                            samples.publish(tMs, parsed.adc, parsed.digital);
                         }
-                        // Mantener solo bytes después de la última trama completa
-                        byte[] last = frames.get(frames.size() - 1);
-                        int lastEnd = indexOf(all, last) + last.length;
-                        buf.reset();
-                        if (lastEnd < all.length) buf.write(all, lastEnd, all.length - lastEnd);
                     }
-                } else {
-                    try { Thread.sleep(10); } catch (InterruptedException ignored) { break; }
+                    // Mantener solo bytes después de la última trama completa
+                    System.arraycopy(acc, lastEnd, acc, 0, accLen - lastEnd);
+                    accLen -= lastEnd;
                 }
             } catch (IOException ioe) {
                 System.err.println("Puerto desconectado o error de E/S: " + ioe.getMessage());
@@ -356,6 +528,58 @@ public class SerialProtocolRunner {
         }
     }
 
+    /**
+     * Consumidor de persistencia: espera muestras en el anillo y las entrega a
+     * {@link PersistenceBridge}, que solo las encola; los INSERT por lotes los hace
+     * el hilo escritor del puente. Si aun así este consumidor se atrasa más que la
+     * capacidad del anillo, se pierden las más antiguas sin afectar al lector.
+     */
+    private void persistLoop() {
+        SampleRing.Cursor cursor = samples.cursor();
+        SampleRing.Sample s = new SampleRing.Sample();
+        while (reading) {
+            if (!samples.await(cursor, SerialIO.READ_WAKEUP_MS)) {
+                if (Thread.currentThread().isInterrupted()) break;
+                continue;
+            }
+            while (cursor.poll(s)) {
+                // Persistir muestra usando API/DAO si está disponible
+                try { persistence.persistSample(s.tMs, s.adc, s.digital); } catch (Exception ignored) {}
+            }
+        }
+        if (cursor.lost() > 0) {
+            System.err.println("Persistencia atrasada en " + port + ": " + cursor.lost() + " muestras descartadas");
+        }
+    }
+
+    /**
+     * Convierte el tick de 16 bits de la trama compacta en ms desde t0Ms. La primera
+     * trama fija el origen con su hora de llegada; las siguientes avanzan según el
+     * reloj del MCU, de modo que omisiones o diezmado no desplazan las marcas.
+     */
+    private long deviceTimeMs(int tick, long arrivalMs) {
+        if (lastTick < 0) {
+            tickUnwrapped = 0;
+            tickOriginMs = arrivalMs;
+        } else {
+            tickUnwrapped += (tick - lastTick) & 0xFFFF;
+        }
+        lastTick = tick;
+        return tickOriginMs + tickUnwrapped;
+    }
+
+    /**
+     * Combina las partes del formato dividido con la última mitad conocida. Las
+     * tramas completas pasan sin cambios; devuelve null hasta tener ambas mitades.
+     */
+    private Frame mergeSplit(Frame part) {
+        if (part == null || (part.digital >= 0 && part.adc != null)) return part;
+        if (part.digital >= 0) splitDigital = part.digital;
+        else splitAdc = part.adc;
+        if (splitDigital < 0 || splitAdc == null) return null;
+        return new Frame(splitDigital, splitAdc.clone(), part.tick);
+    }
+
     // Helpers mínimos para tramas
     private static int indexOf(byte[] haystack, byte[] needle) {
         outer: for (int i = 0; i <= haystack.length - needle.length; i++) {
@@ -367,66 +591,112 @@ public class SerialProtocolRunner {
         return -1;
     }
 
-    private static int indexOf(byte[] haystack, byte[] needle, int fromIndex) {
-        int start = Math.max(0, fromIndex);
-        outer: for (int i = start; i <= haystack.length - needle.length; i++) {
-            for (int j = 0; j < needle.length; j++) {
-                if (haystack[i + j] != needle[j]) continue outer;
-            }
-            return i;
+    // Tamaño de trama según el segundo byte de cabecera y los canales; -1 si no es un formato conocido
+    private static int frameSize(int header2, int channels) {
+        int packed = (channels * 10 + 7) / 8;
+        switch (header2) {
+            case HEADER_LEGACY: return SIZE_LEGACY;
+            case HEADER_COMPACT: return OVERHEAD_COMPACT + packed;
+            case HEADER_ANALOG: return OVERHEAD_ANALOG + packed;
+            case HEADER_DIGITAL: return SIZE_DIGITAL;
+            case HEADER_COMPACT_CAL: return OVERHEAD_COMPACT + 2 * channels;
+            case HEADER_ANALOG_CAL: return OVERHEAD_ANALOG + 2 * channels;
+            default: return -1;
         }
-        return -1;
     }
 
     /**
      * Busca todas las tramas completas en un buffer de bytes.
-     * Requiere encabezado 0x7A 0x7B y cola 0x7C con longitud fija 20.
+     * Requiere encabezado 0x7A + byte de formato (0x7B legacy, 0x7D compacta,
+     * 0x7E/0x7F dividida, 0x79/0x78 calibradas) y cola 0x7C en la posición que corresponde al tamaño del
+     * formato; la parte digital del dividido (4 bytes) no lleva cola.
+     *
+     * @param buf bytes acumulados
+     * @param length bytes válidos en {@code buf}
+     * @param out lista donde se agregan las tramas encontradas
+     * @param channels canales en las tramas empaquetadas
+     * @return índice siguiente al final de la última trama completa (0 si ninguna)
      */
-    private static List<byte[]> findFrames(byte[] buf) {
-        List<byte[]> frames = new ArrayList<>();
-        if (buf == null || buf.length == 0) return frames;
+    private static int findFrames(byte[] buf, int length, List<byte[]> out, int channels) {
+        int consumed = 0;
+        if (buf == null || length == 0) return consumed;
         int i = 0;
-        while (true) {
-            int start = indexOf(buf, new byte[]{0x7A, 0x7B}, i);
-            if (start < 0) break;
-            // Se requiere longitud completa y byte de cierre 0x7C al final (posición 19)
-            if (start + 20 > buf.length) {
+        while (i + 1 < length) {
+            if (buf[i] != 0x7A) { i++; continue; }
+            int size = frameSize(buf[i + 1] & 0xFF, channels);
+            if (size < 0) { i++; continue; }
+            // Se requiere longitud completa y byte de cierre 0x7C al final
+            if (i + size > length) {
                 // No hay suficientes bytes aún, esperar más datos
                 break;
             }
-            int tail = buf[start + 19] & 0xFF;
-            if (tail == 0x7C) {
-                byte[] f = new byte[20];
-                System.arraycopy(buf, start, f, 0, 20);
-                frames.add(f);
+            if ((buf[i + 1] & 0xFF) == HEADER_DIGITAL || (buf[i + size - 1] & 0xFF) == 0x7C) {
+                byte[] f = new byte[size];
+                System.arraycopy(buf, i, f, 0, size);
+                out.add(f);
                 // Avanzar al siguiente posible frame después de este
-                i = start + 20;
+                i += size;
+                consumed = i;
             } else {
-                // Cierre no encontrado tras 20 bytes: descartar este header y buscar el siguiente
-                i = start + 1;
+                // Cierre no encontrado: descartar este header y buscar el siguiente
+                i++;
             }
         }
-        return frames;
+        return consumed;
     }
 
     /**
-     * Parsea una trama de 20 bytes en estructura con digitales y 8 ADC.
-     * @param frame arreglo de 20 bytes con formato 7A 7B [digital] [adc0 lo hi] ... 7C
+     * Parsea una trama (legacy de 20 bytes, compacta de 11 o una parte de la
+     * dividida) en estructura con digitales y 8 ADC. En compacta/dividida AN4..AN7
+     * se derivan como ANi/2. Las partes del dividido devuelven digital = -1 (analógica)
+     * o adc = null (digital); {@link #mergeSplit} las combina.
+     * En compacta/dividida solo AN0..AN3 pasan a la estructura; los canales extra
+     * (A4, A5, temperatura, bandgap) se validan por tamaño pero no se persisten.
+     * Las variantes calibradas (0x79/0x78) traen valores int16 en la unidad de la
+     * tabla de cada canal en lugar de cuentas.
+     * @param frame trama completa 7A 7B ... 7C, 7A 7D ... 7C, 7A 7E ... 7C o 7A 7F DIG SEQ
+     * @param channels canales en las tramas empaquetadas
      * @return Frame con datos o null si inválida.
      */
-    private static Frame parseFrame(byte[] frame) {
-        // Validación estricta de trama: longitud y encabezados; verifica tail si está presente
-        if (frame == null || frame.length != 20) return null;
-        if (frame[0] != 0x7A || frame[1] != 0x7B) return null;
-        if (frame[19] != 0x7C) return null;
-        int digital = frame[2] & 0xFF;
+    private static Frame parseFrame(byte[] frame, int channels) {
+        // Validación estricta de trama: longitud, encabezados y tail
+        if (frame == null || frame.length < 2 || frame[0] != 0x7A) return null;
+        int header2 = frame[1] & 0xFF;
+        int size = frameSize(header2, channels);
+        if (size < 0 || frame.length != size) return null;
+        if (header2 == HEADER_DIGITAL) return new Frame(frame[2] & 0xFF, null, -1);
+        if (frame[size - 1] != 0x7C) return null;
         int[] vals = new int[8];
+        if (header2 == HEADER_COMPACT_CAL || header2 == HEADER_ANALOG_CAL) {
+            int digital = header2 == HEADER_COMPACT_CAL ? frame[4] & 0xFF : -1;
+            int first = header2 == HEADER_COMPACT_CAL ? 5 : 4;
+            for (int i = 0; i < 4; i++) {
+                vals[i] = (short) ((frame[first + 2 * i] & 0xFF) | ((frame[first + 2 * i + 1] & 0xFF) << 8));
+                vals[i + 4] = vals[i] / 2;
+            }
+            int tick = (frame[2] & 0xFF) | ((frame[3] & 0xFF) << 8);
+            return new Frame(digital, vals, tick);
+        }
+        if (header2 == HEADER_COMPACT || header2 == HEADER_ANALOG) {
+            int digital = header2 == HEADER_COMPACT ? frame[4] & 0xFF : -1;
+            int first = header2 == HEADER_COMPACT ? 5 : 4;
+            // AN0..AN3 = canales 0..3 empaquetados a 10 bits, LSB primero (40 bits)
+            long packed = 0;
+            for (int b = 0; b < 5; b++) packed |= (long) (frame[first + b] & 0xFF) << (8 * b);
+            for (int i = 0; i < 4; i++) {
+                vals[i] = (int) ((packed >>> (10 * i)) & 0x3FF);
+                vals[i + 4] = vals[i] >> 1;
+            }
+            int tick = (frame[2] & 0xFF) | ((frame[3] & 0xFF) << 8);
+            return new Frame(digital, vals, tick);
+        }
+        int digital = frame[2] & 0xFF;
         for (int i = 0; i < 8; i++) {
             int lo = frame[3 + i * 2] & 0xFF;
             int hi = frame[3 + i * 2 + 1] & 0xFF;
             vals[i] = lo | (hi << 8);
         }
-        return new Frame(digital, vals);
+        return new Frame(digital, vals, -1);
     }
 
     // Valida respuesta con encabezado 55 AB ... CHK (XOR de [status,cmd,len]+payload)
@@ -522,7 +792,7 @@ public class SerialProtocolRunner {
         if (reading && serial != null) {
             try {
                 // Evitar basura de streaming antes de capturar el ACK
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] resp = serial.sendCommand(0x01, new byte[]{ (byte) m }, 64, defaultTimeoutMs);
                 ok = validateResponse(resp);
             } catch (Exception ignored) {}
@@ -576,7 +846,7 @@ public class SerialProtocolRunner {
         if (reading && serial != null) {
             try {
                 // Evitar basura de streaming antes de capturar el ACK
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] resp = serial.sendCommand(0x03, new byte[]{ lo, hi }, 64, defaultTimeoutMs);
                 ok = validateResponse(resp);
             } catch (Exception ignored) {}
@@ -622,7 +892,7 @@ public class SerialProtocolRunner {
         if (reading && serial != null) {
             try {
                 // Evitar basura de streaming antes de capturar el ACK
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] resp = serial.sendCommand(0x08, new byte[]{ lo, hi }, 64, defaultTimeoutMs);
                 ok = validateResponse(resp);
             } catch (Exception ignored) {}
@@ -653,7 +923,7 @@ public class SerialProtocolRunner {
         synchronized (PENDING_LOCK) { pLed = pendingLedMask; }
         if (pLed != null) {
             try {
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] r = serial.sendCommand(0x01, new byte[]{ (byte)(pLed & 0xFF) }, 64, defaultTimeoutMs);
                 if (validateResponse(r)) {
                     synchronized (PENDING_LOCK) { if (pendingLedMask != null && (pendingLedMask & 0xFF) == (pLed & 0xFF)) pendingLedMask = null; }
@@ -669,7 +939,7 @@ public class SerialProtocolRunner {
             int v = pDip;
             byte lo = (byte) (v & 0xFF), hi = (byte)((v >>> 8) & 0xFF);
             try {
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] r = serial.sendCommand(0x03, new byte[]{ lo, hi }, 64, defaultTimeoutMs);
                 if (validateResponse(r)) {
                     synchronized (PENDING_LOCK) { if (pendingTsDip != null && pendingTsDip == v) pendingTsDip = null; }
@@ -685,7 +955,7 @@ public class SerialProtocolRunner {
             int v = pAdc;
             byte lo = (byte) (v & 0xFF), hi = (byte)((v >>> 8) & 0xFF);
             try {
-                try { serial.drainInput(30, Math.max(150L, defaultTimeoutMs / 4)); } catch (Exception ignored) {}
+                discardStale();
                 byte[] r = serial.sendCommand(0x08, new byte[]{ lo, hi }, 64, defaultTimeoutMs);
                 if (validateResponse(r)) {
                     synchronized (PENDING_LOCK) { if (pendingTsAdc != null && pendingTsAdc == v) pendingTsAdc = null; }
@@ -745,6 +1015,7 @@ public class SerialProtocolRunner {
     private synchronized void resetForRetry() {
         reading = false;
         try { if (readerThread != null) readerThread.interrupt(); } catch (Exception ignored) {}
+        try { if (persistThread != null) persistThread.interrupt(); } catch (Exception ignored) {}
         // No cerrar el puerto: evitar reset repetido en placas que reinician al abrir
         try { Thread.sleep(100); } catch (InterruptedException ignored) {}
         // No tocar: connecting, connectThread ni ACTIVE_BY_PORT
@@ -757,14 +1028,17 @@ public class SerialProtocolRunner {
      * @return Cantidad total de muestras pendientes (ADC + digitales).
      */
     public int getBufferedCount() {
-        synchronized (adcBuffer) { synchronized (digitalBuffer) { return adcBuffer.size() + digitalBuffer.size(); } }
+        int n;
+        synchronized (adcCursor) { n = adcCursor.pending(); }
+        synchronized (digitalCursor) { n += digitalCursor.pending(); }
+        return n;
     }
     /**
      * Limpia manualmente los buffers de ADC y digitales.
      */
     public void clearBuffer() {
-        synchronized (adcBuffer) { adcBuffer.clear(); }
-        synchronized (digitalBuffer) { digitalBuffer.clear(); }
+        synchronized (adcCursor) { adcCursor.skipAll(); }
+        synchronized (digitalCursor) { digitalCursor.skipAll(); }
     }
 
     // Estado de conexion/transmision
@@ -811,21 +1085,10 @@ public class SerialProtocolRunner {
     public String getPort() { return port; }
 
     private static class Frame {
-        final int digital;
-        final int[] adc;
-        Frame(int digital, int[] adc) { this.digital = digital; this.adc = adc; }
-    }
-
-    private static class AdcSample {
-        final long tMs;
-        final int[] adc;
-        AdcSample(long tMs, int[] adc) { this.tMs = tMs; this.adc = adc; }
-    }
-
-    private static class DigitalSample {
-        final long tMs;
-        final int digital;
-        DigitalSample(long tMs, int digital) { this.tMs = tMs; this.digital = digital; }
+        final int digital; // -1 en la parte analógica del formato dividido
+        final int[] adc;   // null en la parte digital del formato dividido
+        final int tick; // ms del muestreo (16 bits) o -1 en la trama legacy
+        Frame(int digital, int[] adc, int tick) { this.digital = digital; this.adc = adc; this.tick = tick; }
     }
 
     public static class TimedValue {